@@ -103,6 +103,11 @@ public:
         sendRaw(ss.str());
     }
 
+    /* ===== Client-side attributes (static metadata) ===== */
+    void sendAttributes(const JsonDocument &values) {
+        sendRaw("v1/devices/me/attributes", values.to_string());
+    }
+
 protected:
     void connected(const std::string &) override {}
     void connection_lost(const std::string &) override {}
@@ -115,8 +120,11 @@ private:
     int requestIdCounter_;
 
     void sendRaw(const std::string &payload) {
-        auto msg = mqtt::make_message(
-            "v1/devices/me/telemetry", payload);
+        sendRaw("v1/devices/me/telemetry", payload);
+    }
+
+    void sendRaw(const std::string &topic, const std::string &payload) {
+        auto msg = mqtt::make_message(topic, payload);
         msg->set_qos(1);
         client_.publish(msg);
     }
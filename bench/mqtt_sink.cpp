@@ -0,0 +1,179 @@
+#include "mqtt_sink.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <iostream>
+
+MqttSink::MqttSink(uint16_t port) : m_port(port) {}
+
+MqttSink::~MqttSink() { stop(); }
+
+bool MqttSink::start() {
+  m_listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (m_listenFd < 0)
+    return false;
+
+  int one = 1;
+  ::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(m_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (::bind(m_listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+      ::listen(m_listenFd, 16) < 0) {
+    std::cerr << "MqttSink: cannot listen on port " << m_port << std::endl;
+    ::close(m_listenFd);
+    m_listenFd = -1;
+    return false;
+  }
+
+  m_running = true;
+  m_thread = std::thread(&MqttSink::run, this);
+  return true;
+}
+
+void MqttSink::stop() {
+  m_running = false;
+  if (m_thread.joinable())
+    m_thread.join();
+  if (m_listenFd >= 0) {
+    ::close(m_listenFd);
+    m_listenFd = -1;
+  }
+}
+
+void MqttSink::run() {
+  std::vector<Conn> conns;
+
+  while (m_running) {
+    std::vector<pollfd> fds;
+    fds.push_back({m_listenFd, POLLIN, 0});
+    for (const Conn &c : conns)
+      fds.push_back({c.fd, POLLIN, 0});
+
+    if (::poll(fds.data(), fds.size(), 50) <= 0)
+      continue;
+
+    if (fds[0].revents & POLLIN) {
+      int fd = ::accept(m_listenFd, nullptr, nullptr);
+      if (fd >= 0) {
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        conns.push_back(Conn{fd, {}});
+      }
+    }
+
+    for (size_t i = 1; i < fds.size(); i++) {
+      if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      Conn &c = conns[i - 1];
+      if (!onReadable(c)) {
+        ::close(c.fd);
+        c.fd = -1;
+      }
+    }
+
+    std::erase_if(conns, [](const Conn &c) { return c.fd < 0; });
+  }
+
+  for (Conn &c : conns)
+    ::close(c.fd);
+}
+
+bool MqttSink::onReadable(Conn &c) {
+  uint8_t tmp[4096];
+  ssize_t n = ::recv(c.fd, tmp, sizeof(tmp), 0);
+  if (n <= 0)
+    return n < 0 && (errno == EAGAIN || errno == EINTR);
+  c.buf.insert(c.buf.end(), tmp, tmp + n);
+
+  // Split the stream into MQTT control packets (fixed header + varint length)
+  size_t pos = 0;
+  while (c.buf.size() - pos >= 2) {
+    size_t len = 0;
+    size_t hdr = 1;
+    int shift = 0;
+    bool complete = false;
+    while (pos + hdr < c.buf.size() && hdr <= 4) {
+      uint8_t b = c.buf[pos + hdr++];
+      len |= size_t(b & 0x7F) << shift;
+      shift += 7;
+      if (!(b & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete || c.buf.size() - pos - hdr < len)
+      break;
+
+    handlePacket(c, c.buf[pos], c.buf.data() + pos + hdr, len);
+    pos += hdr + len;
+  }
+  c.buf.erase(c.buf.begin(), c.buf.begin() + pos);
+  return true;
+}
+
+void MqttSink::handlePacket(Conn &c, uint8_t header, const uint8_t *body,
+                            size_t len) {
+  switch (header >> 4) {
+  case 1: { // CONNECT -> CONNACK (session not present, accepted)
+    const uint8_t ack[] = {0x20, 0x02, 0x00, 0x00};
+    ::send(c.fd, ack, sizeof(ack), MSG_NOSIGNAL);
+    break;
+  }
+  case 3: { // PUBLISH
+    uint8_t qos = (header >> 1) & 0x03;
+    if (len < 2)
+      break;
+    size_t topicLen = (size_t(body[0]) << 8) | body[1];
+    size_t off = 2 + topicLen;
+    if (qos > 0) {
+      if (len < off + 2)
+        break;
+      const uint8_t ack[] = {uint8_t(qos == 1 ? 0x40 : 0x50), 0x02, body[off],
+                             body[off + 1]};
+      ::send(c.fd, ack, sizeof(ack), MSG_NOSIGNAL);
+      off += 2;
+    }
+    m_publishes.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(len > off ? len - off : 0, std::memory_order_relaxed);
+    break;
+  }
+  case 6: { // PUBREL -> PUBCOMP
+    if (len >= 2) {
+      const uint8_t ack[] = {0x70, 0x02, body[0], body[1]};
+      ::send(c.fd, ack, sizeof(ack), MSG_NOSIGNAL);
+    }
+    break;
+  }
+  case 8: { // SUBSCRIBE -> SUBACK granting QoS 1 to every filter
+    if (len < 2)
+      break;
+    std::vector<uint8_t> ack = {0x90, 0x00, body[0], body[1]};
+    size_t off = 2;
+    while (off + 2 <= len) {
+      size_t tl = (size_t(body[off]) << 8) | body[off + 1];
+      off += 2 + tl + 1;
+      ack.push_back(0x01);
+    }
+    ack[1] = uint8_t(ack.size() - 2);
+    ::send(c.fd, ack.data(), ack.size(), MSG_NOSIGNAL);
+    break;
+  }
+  case 12: { // PINGREQ -> PINGRESP
+    const uint8_t ack[] = {0xD0, 0x00};
+    ::send(c.fd, ack, sizeof(ack), MSG_NOSIGNAL);
+    break;
+  }
+  default: // DISCONNECT and everything else: ignore
+    break;
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef MQTT_SINK_H
+#define MQTT_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Minimal MQTT 3.1.1 broker stand-in for benchmarks.
+//
+// Accepts any CONNECT, acknowledges QoS 1 PUBLISH with PUBACK, answers
+// PINGREQ and otherwise discards everything. It only counts what arrives, so
+// publish throughput is measured against the client library and the loopback
+// stack rather than a real broker's fan-out.
+class MqttSink {
+public:
+  explicit MqttSink(uint16_t port);
+  ~MqttSink();
+
+  bool start();
+  void stop();
+
+  uint16_t port() const { return m_port; }
+  uint64_t publishes() const { return m_publishes.load(); }
+  uint64_t payloadBytes() const { return m_bytes.load(); }
+
+private:
+  struct Conn {
+    int fd;
+    std::vector<uint8_t> buf;
+  };
+
+  void run();
+  bool onReadable(Conn &c);
+  void handlePacket(Conn &c, uint8_t header, const uint8_t *body,
+                    size_t len);
+
+  uint16_t m_port;
+  int m_listenFd = -1;
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  std::atomic<uint64_t> m_publishes{0};
+  std::atomic<uint64_t> m_bytes{0};
+};
+
+#endif // MQTT_SINK_H
@@ -0,0 +1,390 @@
+// End-to-end throughput benchmark: poll -> SQLite -> MQTT.
+//
+// Spins up simulated PAS600 gateways (Modbus TCP on localhost) and a local
+// MQTT sink, then drives the same cycle main.cpp runs (Run_Cycle).
+// Sweeps device count, extra register load and poll interval, and reports
+// cycle-time percentiles, rows/s, publish/s, CPU and RSS per configuration.
+//
+// Usage:
+//   pipeline_bench [--gateways N] [--devices 1,4,16] [--registers 0,250]
+//                  [--interval-ms 0,1000] [--cycles N] [--latency-us N]
+//                  [--a9 N] [--csv FILE] [--trace FILE]
+
+#include "Run_Cycle.h"
+#include "ThingsBoardClient.h"
+#include "mqtt_sink.h"
+#include "sim_gateway.h"
+#include "storage.h"
+#include "trace.h"
+
+#include <Modbus.h>
+#include <ModbusClient.h>
+#include <ModbusClientPort.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t GATEWAY_BASE_PORT = 15020;
+constexpr uint16_t MQTT_SINK_PORT = 18830;
+constexpr uint16_t MAX_READ_REGS = 125; // Modbus PDU limit for FC03
+
+struct Options {
+  int gateways = 1;
+  std::vector<int> devices = {1, 4, 16};
+  std::vector<int> registers = {0, 250};
+  std::vector<int> intervalsMs = {0};
+  int cycles = 5;
+  int a9PerGateway = 0;
+  uint32_t latencyUs = 500;
+  std::string csvPath;
+  std::string tracePath;
+};
+
+struct Result {
+  int gateways, devices, registers, intervalMs, cycles;
+  double p50, p90, p99, maxMs;
+  double pollMs, publishMs;
+  double rowsPerSec, publishPerSec;
+  double cpuPct;
+  long rssKb, peakRssKb;
+  uint64_t transactions;
+  int overruns;
+};
+
+std::vector<int> parseList(const std::string &s) {
+  std::vector<int> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (!item.empty())
+      out.push_back(std::stoi(item));
+  return out;
+}
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty())
+    return 0.0;
+  std::sort(v.begin(), v.end());
+  size_t idx = size_t(p * (v.size() - 1) + 0.5);
+  return v[std::min(idx, v.size() - 1)];
+}
+
+double cpuSeconds() {
+  rusage ru{};
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec +
+         ru.ru_stime.tv_usec / 1e6;
+}
+
+long procStatusKb(const char *key) {
+  std::ifstream f("/proc/self/status");
+  std::string line;
+  while (std::getline(f, line)) {
+    if (line.rfind(key, 0) == 0)
+      return std::atol(line.c_str() + std::strlen(key));
+  }
+  return 0;
+}
+
+int64_t countRows(sqlite3 *db, const char *table) {
+  std::string sql = std::string("SELECT COUNT(*) FROM ") + table + ";";
+  sqlite3_stmt *stmt = nullptr;
+  int64_t n = 0;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+      sqlite3_step(stmt) == SQLITE_ROW)
+    n = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return n;
+}
+
+// Extra register load on top of the stock Read_iPM2xxx set: `count` holding
+// registers per device in max-size block reads, one connection per gateway.
+void readExtraRegisters(uint16_t port, const std::vector<int> &ids,
+                        int count) {
+  if (count <= 0)
+    return;
+
+  Modbus::TcpSettings settings{};
+  settings.host = "127.0.0.1";
+  settings.port = port;
+  settings.timeout = 2000;
+  std::unique_ptr<ModbusClientPort> cp(
+      Modbus::createClientPort(Modbus::TCP, &settings, true));
+  if (!cp)
+    return;
+
+  // Decode each block as PM2xxx floats, like a real block consumer would
+  std::vector<uint16_t> buf(MAX_READ_REGS);
+  std::vector<float> values(MAX_READ_REGS / 2);
+  for (int id : ids) {
+    ModbusClient client(uint8_t(id), cp.get());
+    for (int done = 0; done < count; done += MAX_READ_REGS) {
+      uint16_t n = uint16_t(std::min<int>(MAX_READ_REGS, count - done));
+      auto status =
+          client.readHoldingRegisters(uint16_t(2999 + done), n, buf.data());
+      if (Modbus::StatusIsGood(status))
+        decodeBlock<float, iPM2xxx::WORD_ORDER>(buf.data(), n / 2,
+                                                values.data());
+    }
+  }
+  cp->close();
+}
+
+Result runConfig(const Options &opt, int devices, int registers,
+                 int intervalMs) {
+  // Fresh working directory so every configuration starts from empty DBs.
+  char tmpl[] = "/tmp/pipeline_bench.XXXXXX";
+  const char *dir = ::mkdtemp(tmpl);
+  if (!dir || ::chdir(dir) != 0)
+    throw std::runtime_error("Cannot create benchmark working directory");
+
+  std::vector<int> pmIds, a9Ids;
+  for (int i = 0; i < devices; i++)
+    pmIds.push_back(1 + i);
+  for (int i = 0; i < opt.a9PerGateway; i++)
+    a9Ids.push_back(100 + i);
+
+  std::vector<std::unique_ptr<SimGateway>> gateways;
+  for (int g = 0; g < opt.gateways; g++) {
+    std::vector<SimUnit> units;
+    for (int id : pmIds)
+      units.push_back({uint8_t(id), SimModel::iPM2xxx});
+    for (int id : a9Ids)
+      units.push_back({uint8_t(id), SimModel::iA9MEM15});
+    gateways.push_back(std::make_unique<SimGateway>(
+        uint16_t(GATEWAY_BASE_PORT + g), units, opt.latencyUs));
+    if (!gateways.back()->start())
+      throw std::runtime_error("Cannot start simulated gateway");
+  }
+
+  MqttSink sink(MQTT_SINK_PORT);
+  if (!sink.start())
+    throw std::runtime_error("Cannot start MQTT sink");
+
+  ThingsBoardClient tb("bench-token", "127.0.0.1", MQTT_SINK_PORT);
+  tb.connect();
+
+  sqlite3 *dbA9 = Storage::instance().a9().writer();
+  sqlite3 *dbPM = Storage::instance().pm().writer();
+  SetupDatabase(dbA9);
+  SetupDatabasePM(dbPM);
+
+  // The pipeline logs every row; keep the report readable.
+  std::ostringstream sinkLog;
+  std::streambuf *coutBuf = std::cout.rdbuf(sinkLog.rdbuf());
+
+  std::vector<CycleGateway> cycleGateways;
+  for (const auto &g : gateways)
+    cycleGateways.push_back({"127.0.0.1", g->port(), a9Ids, pmIds});
+  CycleLimits limits;
+  limits.a9Rows = int(a9Ids.size()) * opt.gateways;
+  limits.pmRows = devices * opt.gateways;
+
+  std::vector<double> cycleMs;
+  double pollTotal = 0.0, publishTotal = 0.0;
+  int overruns = 0;
+
+  double cpu0 = cpuSeconds();
+  auto wall0 = Clock::now();
+
+  for (int c = 0; c < opt.cycles; c++) {
+    auto t0 = Clock::now();
+    CycleTiming timing =
+        Run_Cycle(cycleGateways, dbA9, dbPM, tb, RollupBoundary{}, limits, [&] {
+          for (const auto &g : gateways)
+            readExtraRegisters(g->port(), pmIds, registers);
+        });
+
+    double pollMs = timing.pollUs / 1000.0;
+    double publishMs = timing.publishUs / 1000.0;
+    double ms = pollMs + publishMs;
+    cycleMs.push_back(ms);
+    pollTotal += pollMs;
+    publishTotal += publishMs;
+
+    if (intervalMs > 0) {
+      if (ms > intervalMs)
+        overruns++;
+      else
+        std::this_thread::sleep_until(t0 + std::chrono::milliseconds(intervalMs));
+    }
+  }
+
+  double wall =
+      std::chrono::duration<double>(Clock::now() - wall0).count();
+  double cpu = cpuSeconds() - cpu0;
+  double busy = (pollTotal + publishTotal) / 1000.0;
+
+  std::cout.rdbuf(coutBuf);
+
+  // Give the sink a moment to drain in-flight QoS 1 publishes.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  Result r{};
+  r.gateways = opt.gateways;
+  r.devices = devices;
+  r.registers = registers;
+  r.intervalMs = intervalMs;
+  r.cycles = opt.cycles;
+  r.p50 = percentile(cycleMs, 0.50);
+  r.p90 = percentile(cycleMs, 0.90);
+  r.p99 = percentile(cycleMs, 0.99);
+  r.maxMs = percentile(cycleMs, 1.0);
+  r.pollMs = pollTotal / opt.cycles;
+  r.publishMs = publishTotal / opt.cycles;
+  int64_t rows = countRows(dbPM, "readings_pm2xxx") + countRows(dbA9, "readings");
+  r.rowsPerSec = busy > 0 ? rows / busy : 0.0;
+  r.publishPerSec = publishTotal > 0 ? sink.publishes() / (publishTotal / 1000.0) : 0.0;
+  r.cpuPct = wall > 0 ? 100.0 * cpu / wall : 0.0;
+  r.rssKb = procStatusKb("VmRSS:");
+  r.peakRssKb = procStatusKb("VmHWM:");
+  for (const auto &g : gateways)
+    r.transactions += g->transactions();
+  r.overruns = overruns;
+
+  Storage::instance().close(); // before the scenario directory goes
+  tb.disconnect();
+  sink.stop();
+  for (auto &g : gateways)
+    g->stop();
+
+  std::error_code ec;
+  std::filesystem::remove_all(dir, ec);
+  if (ec)
+    std::cerr << "Warning: could not remove " << dir << ": " << ec.message()
+              << std::endl;
+  return r;
+}
+
+void printHeader() {
+  std::cout << std::left << std::setw(4) << "gw" << std::setw(5) << "dev"
+            << std::setw(6) << "regs" << std::setw(8) << "int_ms"
+            << std::right << std::setw(9) << "p50_ms" << std::setw(9)
+            << "p90_ms" << std::setw(9) << "p99_ms" << std::setw(9) << "max_ms"
+            << std::setw(9) << "poll_ms" << std::setw(9) << "pub_ms"
+            << std::setw(10) << "rows/s" << std::setw(10) << "pub/s"
+            << std::setw(7) << "cpu%" << std::setw(9) << "rss_kb"
+            << std::setw(9) << "txn" << std::setw(6) << "over" << "\n";
+}
+
+void printResult(const Result &r) {
+  std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(4)
+            << r.gateways << std::setw(5) << r.devices << std::setw(6)
+            << r.registers << std::setw(8) << r.intervalMs << std::right
+            << std::setw(9) << r.p50 << std::setw(9) << r.p90 << std::setw(9)
+            << r.p99 << std::setw(9) << r.maxMs << std::setw(9) << r.pollMs
+            << std::setw(9) << r.publishMs << std::setw(10) << r.rowsPerSec
+            << std::setw(10) << r.publishPerSec << std::setw(7) << r.cpuPct
+            << std::setw(9) << r.rssKb << std::setw(9) << r.transactions
+            << std::setw(6) << r.overruns << std::endl;
+}
+
+void writeCsv(const std::string &path, const std::vector<Result> &results) {
+  std::ofstream f(path);
+  f << "gateways,devices,registers,interval_ms,cycles,p50_ms,p90_ms,p99_ms,"
+       "max_ms,poll_ms,publish_ms,rows_per_s,publish_per_s,cpu_pct,rss_kb,"
+       "peak_rss_kb,transactions,overruns\n";
+  for (const Result &r : results) {
+    f << r.gateways << "," << r.devices << "," << r.registers << ","
+      << r.intervalMs << "," << r.cycles << "," << r.p50 << "," << r.p90
+      << "," << r.p99 << "," << r.maxMs << "," << r.pollMs << ","
+      << r.publishMs << "," << r.rowsPerSec << "," << r.publishPerSec << ","
+      << r.cpuPct << "," << r.rssKb << "," << r.peakRssKb << ","
+      << r.transactions << "," << r.overruns << "\n";
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc)
+        throw std::invalid_argument("Missing value for " + arg);
+      return argv[++i];
+    };
+    try {
+      if (arg == "--gateways")
+        opt.gateways = std::stoi(next());
+      else if (arg == "--devices")
+        opt.devices = parseList(next());
+      else if (arg == "--registers")
+        opt.registers = parseList(next());
+      else if (arg == "--interval-ms")
+        opt.intervalsMs = parseList(next());
+      else if (arg == "--cycles")
+        opt.cycles = std::stoi(next());
+      else if (arg == "--latency-us")
+        opt.latencyUs = uint32_t(std::stoul(next()));
+      else if (arg == "--a9")
+        opt.a9PerGateway = std::stoi(next());
+      else if (arg == "--csv")
+        opt.csvPath = next();
+      else if (arg == "--trace")
+        opt.tracePath = next();
+      else {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--gateways N] [--devices 1,4,16] [--registers 0,250]"
+                     " [--interval-ms 0,1000] [--cycles N] [--latency-us N]"
+                     " [--a9 N] [--csv FILE] [--trace FILE]\n";
+        return 1;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "Bad argument " << arg << ": " << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  std::string origDir = std::filesystem::current_path().string();
+  Trace::setEnabled(!opt.tracePath.empty());
+  Trace::setThreadName("bench");
+  std::vector<Result> results;
+
+  std::cout << "Pipeline benchmark: " << opt.gateways << " gateway(s), "
+            << opt.cycles << " cycle(s) per config, " << opt.latencyUs
+            << " us simulated turnaround\n";
+  printHeader();
+
+  try {
+    for (int devices : opt.devices) {
+      for (int registers : opt.registers) {
+        for (int intervalMs : opt.intervalsMs) {
+          results.push_back(runConfig(opt, devices, registers, intervalMs));
+          std::filesystem::current_path(origDir);
+          printResult(results.back());
+        }
+      }
+    }
+  } catch (const std::exception &e) {
+    std::filesystem::current_path(origDir);
+    std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    return 1;
+  }
+
+  if (!opt.csvPath.empty())
+    writeCsv(opt.csvPath, results);
+  if (!opt.tracePath.empty() && Trace::writeChromeJsonFile(opt.tracePath))
+    std::cout << "Trace written to " << opt.tracePath << "\n";
+  return 0;
+}
@@ -0,0 +1,391 @@
+#include "sim_gateway.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+void putFloat(std::vector<uint16_t> &regs, uint16_t address, float v) {
+  uint32_t raw;
+  std::memcpy(&raw, &v, sizeof(raw));
+  regs[address] = uint16_t(raw >> 16);
+  regs[address + 1] = uint16_t(raw & 0xFFFF);
+}
+
+void putU64(std::vector<uint16_t> &regs, uint16_t address, uint64_t v) {
+  regs[address] = uint16_t(v >> 48);
+  regs[address + 1] = uint16_t(v >> 32);
+  regs[address + 2] = uint16_t(v >> 16);
+  regs[address + 3] = uint16_t(v);
+}
+
+uint64_t getU64(const std::vector<uint16_t> &regs, uint16_t address) {
+  return (uint64_t(regs[address]) << 48) | (uint64_t(regs[address + 1]) << 32) |
+         (uint64_t(regs[address + 2]) << 16) | uint64_t(regs[address + 3]);
+}
+
+// Meter DATETIME: year-2000, month<<8|day, hour<<8|minute, ms of the minute.
+void putDateTime(std::vector<uint16_t> &regs, uint16_t address, time_t when) {
+  std::tm lt{};
+  localtime_r(&when, &lt);
+  regs[address] = uint16_t(lt.tm_year - 100);
+  regs[address + 1] = uint16_t(((lt.tm_mon + 1) << 8) | lt.tm_mday);
+  regs[address + 2] = uint16_t((lt.tm_hour << 8) | lt.tm_min);
+  regs[address + 3] = uint16_t(lt.tm_sec * 1000);
+}
+
+// History log window: size, count, most recent entry, then 12-word entries.
+constexpr uint16_t LOG_HEADER = 12315;
+constexpr uint16_t LOG_FIRST_ENTRY = 12318;
+constexpr uint16_t LOG_ENTRY_WORDS = 12;
+constexpr uint16_t LOG_SIZE = 50;
+
+void appendLog(std::vector<uint16_t> &regs, time_t when, uint16_t reg,
+               int64_t value) {
+  uint16_t count = regs[LOG_HEADER + 1];
+  uint16_t last = regs[LOG_HEADER + 2]; // 1-based, 0 when empty
+  uint16_t seq =
+      last ? regs[LOG_FIRST_ENTRY + (last - 1) * LOG_ENTRY_WORDS + 11] : 0;
+  uint16_t entry = uint16_t(last % LOG_SIZE + 1);
+
+  uint16_t at = uint16_t(LOG_FIRST_ENTRY + (entry - 1) * LOG_ENTRY_WORDS);
+  uint16_t *e = &regs[at];
+  e[0] = entry;
+  putDateTime(regs, uint16_t(at + 1), when);
+  e[5] = 0x0001; // register value record
+  e[6] = reg;
+  e[7] = uint16_t(uint64_t(value) >> 48);
+  e[8] = uint16_t(uint64_t(value) >> 32);
+  e[9] = uint16_t(uint64_t(value) >> 16);
+  e[10] = uint16_t(value);
+  e[11] = uint16_t(seq + 1);
+
+  regs[LOG_HEADER + 1] = count < LOG_SIZE ? count + 1 : count;
+  regs[LOG_HEADER + 2] = entry;
+}
+
+void putString(std::vector<uint16_t> &regs, uint16_t address, uint16_t length,
+               const std::string &s) {
+  for (size_t i = 0; i < length; i++) {
+    char hi = (2 * i < s.size()) ? s[2 * i] : 0;
+    char lo = (2 * i + 1 < s.size()) ? s[2 * i + 1] : 0;
+    regs[address + i] = uint16_t((uint8_t(hi) << 8) | uint8_t(lo));
+  }
+}
+
+uint16_t crc16(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+void appendCrc(std::vector<uint8_t> &frame) {
+  uint16_t crc = crc16(frame.data(), frame.size());
+  frame.push_back(uint8_t(crc & 0xFF));
+  frame.push_back(uint8_t(crc >> 8));
+}
+
+} // namespace
+
+SimGateway::SimGateway(uint16_t port, std::vector<SimUnit> units,
+                       uint32_t latencyUs)
+    : m_port(port), m_latencyUs(latencyUs) {
+  for (const SimUnit &u : units) {
+    m_unitIds.push_back(u.unitId);
+    m_images.push_back(Image{u.model, std::vector<uint16_t>(65536, 0)});
+    fillImage(m_images.back(), u.unitId);
+  }
+}
+
+SimGateway::~SimGateway() { stop(); }
+
+void SimGateway::fillImage(Image &img, uint8_t unitId) {
+  std::vector<uint16_t> &r = img.regs;
+  float k = 1.0f + unitId * 0.01f;
+
+  if (img.model == SimModel::iA9MEM15) {
+    putString(r, 29, 20, "Sim A9 " + std::to_string(unitId));
+    putString(r, 49, 20, "A9MEM1540");
+    putString(r, 69, 20, "Schneider Electric");
+    r[89] = 17150;
+    putFloat(r, 2999, 4.2f * k);   // RMS current A
+    putFloat(r, 3019, 230.1f * k); // RMS voltage A-N
+    putFloat(r, 3053, 950.0f * k); // Active power A
+    putFloat(r, 3059, 950.0f * k); // Total active power
+    putFloat(r, 3069, 990.0f * k); // Total apparent power
+    putFloat(r, 3079, 0.96f);      // Total power factor
+    putFloat(r, 3099, 31.5f);      // Internal temperature
+    putU64(r, 3203, 1000000ull + unitId * 1000ull);
+    return;
+  }
+
+  putString(r, 29, 20, "Sim Meter " + std::to_string(unitId));
+  putString(r, 49, 20, "PM2230");
+  putString(r, 69, 20, "Schneider Electric");
+  r[89] = 15210;
+
+  // Nameplate: serial, firmware, restart counter, wiring/CT/VT setup
+  r[402] = uint16_t(4000 + unitId);
+  r[1637] = 1;
+  r[1638] = 4;
+  r[1639] = 2;
+  r[1646] = 1;
+  r[1827] = 3;
+  r[2015] = 11;
+  r[2016] = 50;
+  putFloat(r, 2017, 230.0f);
+  putFloat(r, 2019, 5.0f);
+  putFloat(r, 2025, 400.0f);
+  r[2027] = 400;
+  r[2029] = 100;
+  r[2030] = 5;
+
+  // Instantaneous block 2999..3110 (currents, voltages, powers, PF, freq)
+  for (uint16_t a = 2999; a <= 3009; a += 2)
+    putFloat(r, a, 12.0f * k + (a - 2999) * 0.1f);
+  for (uint16_t a = 3011; a <= 3017; a += 2)
+    putFloat(r, a, 1.5f);
+  for (uint16_t a = 3019; a <= 3025; a += 2)
+    putFloat(r, a, 400.0f * k);
+  for (uint16_t a = 3027; a <= 3035; a += 2)
+    putFloat(r, a, 230.0f * k);
+  for (uint16_t a = 3037; a <= 3051; a += 2)
+    putFloat(r, a, 0.4f);
+  for (uint16_t a = 3053; a <= 3075; a += 2)
+    putFloat(r, a, 2.7f * k);
+  for (uint16_t a = 3077; a <= 3091; a += 2)
+    putFloat(r, a, 0.97f);
+  putFloat(r, 3109, 50.0f);
+
+  // Float energies 2699..2721 and 64-bit energies 3203..3250
+  for (uint16_t a = 2699; a <= 2721; a += 2)
+    putFloat(r, a, 12345.0f * k);
+  for (uint16_t a = 3203; a <= 3247; a += 4)
+    putU64(r, a, 5000000ull + unitId * 1000ull);
+
+  // Demand configuration 3700..3715
+  r[3700] = 1;
+  r[3701] = 15;
+  r[3702] = 0;
+  r[3710] = 1;
+  r[3711] = 15;
+
+  // THD 21299.. and H1..H31 magnitudes (6-register stride) of 9 channels
+  for (uint16_t a = 21299; a <= 21337; a += 2)
+    putFloat(r, a, a < 21321 ? 8.5f * k : 2.1f * k);
+  for (uint16_t base : {21711, 22099, 22487, 22875, 23263, 23651, 24427, 24815,
+                        25203}) {
+    putFloat(r, base, 100.0f);
+    for (uint16_t h = 2; h <= 31; h++)
+      putFloat(r, uint16_t(base + (h - 1) * 6), h % 2 ? 12.0f / h : 0.2f);
+  }
+
+  // Min/max since the last reset (42299..), value + occurrence per quantity
+  time_t now = time(nullptr);
+  putDateTime(r, 42299, now - 86400);
+  for (uint16_t i = 0; i < 8; i++) {
+    putFloat(r, uint16_t(42303 + i * 6), 100.0f * k + i);
+    putDateTime(r, uint16_t(42305 + i * 6), now - 3600 - i * 60);
+    putFloat(r, uint16_t(42591 + i * 6), 10.0f * k + i);
+    putDateTime(r, uint16_t(42593 + i * 6), now - 7200 - i * 60);
+  }
+
+  // Data log: enabled, 15 min interval; a few hours already in the ring
+  r[18999] = 1;
+  r[19010] = 15;
+  r[LOG_HEADER] = LOG_SIZE;
+  for (int i = 12; i > 0; i--)
+    appendLog(r, now - i * 15 * 60, 3203, int64_t(5000000 + unitId * 1000 - i));
+}
+
+void SimGateway::tick(Image &img) {
+  // Energy registers creep forward so the pipeline sees real deltas.
+  putU64(img.regs, 3203, getU64(img.regs, 3203) + 1);
+  if (img.model == SimModel::iPM2xxx)
+    putU64(img.regs, 3211, getU64(img.regs, 3211) + 1);
+}
+
+SimGateway::Image *SimGateway::findUnit(uint8_t unitId) {
+  for (size_t i = 0; i < m_unitIds.size(); i++) {
+    if (m_unitIds[i] == unitId)
+      return &m_images[i];
+  }
+  return nullptr;
+}
+
+Modbus::StatusCode SimGateway::readHoldingRegisters(uint8_t unit,
+                                                    uint16_t offset,
+                                                    uint16_t count,
+                                                    uint16_t *values) {
+  if (m_latencyUs)
+    std::this_thread::sleep_for(std::chrono::microseconds(m_latencyUs));
+
+  Image *img = findUnit(unit);
+  if (!img)
+    return Modbus::Status_BadGatewayTargetDeviceFailedToRespond;
+  if (uint32_t(offset) + count > img->regs.size())
+    return Modbus::Status_BadIllegalDataAddress;
+
+  std::lock_guard<std::mutex> lock(m_imageMutex);
+  tick(*img);
+  std::memcpy(values, img->regs.data() + offset, count * sizeof(uint16_t));
+
+  m_transactions.fetch_add(1, std::memory_order_relaxed);
+  m_registers.fetch_add(count, std::memory_order_relaxed);
+  return Modbus::Status_Good;
+}
+
+bool SimGateway::logRecord(uint8_t unitId, uint16_t reg, int64_t value) {
+  Image *img = findUnit(unitId);
+  if (!img || img->model != SimModel::iPM2xxx)
+    return false;
+  std::lock_guard<std::mutex> lock(m_imageMutex);
+  appendLog(img->regs, time(nullptr), reg, value);
+  return true;
+}
+
+bool SimGateway::setRegisters(uint8_t unitId, uint16_t address,
+                              const std::vector<uint16_t> &values) {
+  Image *img = findUnit(unitId);
+  if (!img || uint32_t(address) + values.size() > img->regs.size())
+    return false;
+  std::lock_guard<std::mutex> lock(m_imageMutex);
+  std::copy(values.begin(), values.end(), img->regs.begin() + address);
+  return true;
+}
+
+bool SimGateway::start() {
+  m_server = std::make_unique<ModbusTcpServer>(this);
+  m_server->setIpaddr("127.0.0.1");
+  m_server->setPort(m_port);
+  m_server->setMaxConnections(64);
+
+  Modbus::StatusCode status = m_server->open();
+  while (Modbus::StatusIsProcessing(status))
+    status = m_server->process();
+  if (Modbus::StatusIsBad(status)) {
+    std::cerr << "SimGateway: cannot listen on port " << m_port << std::endl;
+    m_server.reset();
+    return false;
+  }
+
+  m_running = true;
+  m_thread = std::thread([this] {
+    while (m_running) {
+      m_server->process();
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    m_server->close();
+  });
+  return true;
+}
+
+bool SimGateway::startRtu() {
+  m_rtuFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (m_rtuFd < 0 || grantpt(m_rtuFd) != 0 || unlockpt(m_rtuFd) != 0) {
+    std::cerr << "SimGateway: cannot allocate a pty" << std::endl;
+    if (m_rtuFd >= 0)
+      close(m_rtuFd);
+    m_rtuFd = -1;
+    return false;
+  }
+  m_rtuPath = ptsname(m_rtuFd);
+
+  // Raw line before the client opens it, so nothing is echoed back
+  termios tio{};
+  tcgetattr(m_rtuFd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(m_rtuFd, TCSANOW, &tio);
+
+  m_running = true;
+  m_thread = std::thread([this] { serveRtu(); });
+  return true;
+}
+
+void SimGateway::serveRtu() {
+  // A pty has no baud rate, so the client's frame arrives in one burst;
+  // 5 ms of silence is taken as the end of the frame.
+  std::vector<uint8_t> frame;
+  uint8_t buf[256];
+  while (m_running) {
+    pollfd pfd{m_rtuFd, POLLIN, 0};
+    int ready = poll(&pfd, 1, frame.empty() ? 50 : 5);
+    if (ready > 0 && (pfd.revents & POLLIN)) {
+      ssize_t n = read(m_rtuFd, buf, sizeof(buf));
+      if (n > 0)
+        frame.insert(frame.end(), buf, buf + n);
+      continue;
+    }
+    if (ready > 0 && (pfd.revents & POLLHUP)) {
+      // Client side not open (yet); avoid spinning on HUP
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+    if (frame.empty())
+      continue;
+
+    std::vector<uint8_t> req;
+    req.swap(frame);
+    if (req.size() < 4 ||
+        crc16(req.data(), req.size() - 2) !=
+            uint16_t(req[req.size() - 2] | (req[req.size() - 1] << 8)))
+      continue; // corrupt frame: a slave stays silent
+
+    uint8_t unit = req[0];
+    uint8_t function = req[1];
+    if (!findUnit(unit))
+      continue;
+
+    std::vector<uint8_t> resp{unit, function};
+    if (function != 0x03 || req.size() != 8) {
+      resp[1] |= 0x80;
+      resp.push_back(0x01); // illegal function
+    } else {
+      uint16_t offset = uint16_t((req[2] << 8) | req[3]);
+      uint16_t count = uint16_t((req[4] << 8) | req[5]);
+      std::vector<uint16_t> values(count);
+      Modbus::StatusCode status =
+          count >= 1 && count <= 125
+              ? readHoldingRegisters(unit, offset, count, values.data())
+              : Modbus::Status_BadIllegalDataValue;
+      if (Modbus::StatusIsGood(status)) {
+        resp.push_back(uint8_t(count * 2));
+        for (uint16_t v : values) {
+          resp.push_back(uint8_t(v >> 8));
+          resp.push_back(uint8_t(v & 0xFF));
+        }
+      } else {
+        resp[1] |= 0x80;
+        resp.push_back(status == Modbus::Status_BadIllegalDataAddress ? 0x02
+                                                                      : 0x03);
+      }
+    }
+    appendCrc(resp);
+    if (write(m_rtuFd, resp.data(), resp.size()) < 0)
+      std::cerr << "SimGateway: pty write failed" << std::endl;
+  }
+}
+
+void SimGateway::stop() {
+  m_running = false;
+  if (m_thread.joinable())
+    m_thread.join();
+  m_server.reset();
+  if (m_rtuFd >= 0) {
+    close(m_rtuFd);
+    m_rtuFd = -1;
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef SIM_GATEWAY_H
+#define SIM_GATEWAY_H
+
+#include <Modbus.h>
+#include <ModbusTcpServer.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Meter model a simulated unit answers as (selects its register layout).
+enum class SimModel { iPM2xxx, iA9MEM15 };
+
+struct SimUnit {
+  uint8_t unitId;
+  SimModel model;
+};
+
+// In-process stand-in for a PAS600 gateway: a Modbus TCP server on localhost
+// that answers holding-register reads for a set of simulated meters.
+//
+// Every unit owns a full 64K register image so any block read succeeds; the
+// addresses used by the drivers carry plausible values. `latencyUs` is slept
+// inside each request to emulate the serial turnaround behind a real gateway
+// (requests are serialized, exactly like the RS-485 side of a PAS600).
+//
+// startRtu() serves the same units as RTU slaves on a pseudo-terminal instead:
+// rtuPath() is the slave side, to be used as a driver endpoint
+// ("/dev/pts/N@19200,8E1"). Units that are not configured stay silent, like
+// an absent slave on a real segment.
+//
+// PM units also keep a history log ring (12315.., 50 entries, some records
+// pre-logged); logRecord() appends to it, wrapping like the meter does.
+class SimGateway : public ModbusInterface {
+public:
+  SimGateway(uint16_t port, std::vector<SimUnit> units,
+             uint32_t latencyUs = 0);
+  ~SimGateway();
+
+  bool start();
+  bool startRtu();
+  void stop();
+
+  const std::string &rtuPath() const { return m_rtuPath; }
+
+  // Appends a history log record stamped with the current local time.
+  bool logRecord(uint8_t unitId, uint16_t reg, int64_t value);
+
+  // Overwrites registers of a unit, e.g. to move a min/max or a setting.
+  bool setRegisters(uint8_t unitId, uint16_t address,
+                    const std::vector<uint16_t> &values);
+
+  uint16_t port() const { return m_port; }
+  uint64_t transactions() const { return m_transactions.load(); }
+  uint64_t registersServed() const { return m_registers.load(); }
+
+  Modbus::StatusCode readHoldingRegisters(uint8_t unit, uint16_t offset,
+                                          uint16_t count,
+                                          uint16_t *values) override;
+
+private:
+  struct Image {
+    SimModel model;
+    std::vector<uint16_t> regs;
+  };
+
+  void fillImage(Image &img, uint8_t unitId);
+  void tick(Image &img);
+  Image *findUnit(uint8_t unitId);
+  void serveRtu();
+
+  uint16_t m_port;
+  uint32_t m_latencyUs;
+  std::vector<uint8_t> m_unitIds;
+  std::vector<Image> m_images;
+  std::mutex m_imageMutex; // server thread vs. logRecord()
+
+  std::unique_ptr<ModbusTcpServer> m_server;
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  int m_rtuFd = -1; // pty master
+  std::string m_rtuPath;
+  std::atomic<uint64_t> m_transactions{0};
+  std::atomic<uint64_t> m_registers{0};
+};
+
+#endif // SIM_GATEWAY_H
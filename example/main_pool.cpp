@@ -21,7 +21,7 @@ int main() {
 
     // Connection
     // Now returns std::unique_ptr<PM2xxx>
-    auto client = PM2xxx::createClient(1, "192.168.100.28", 502);
+    auto client = PM2xxx::createClient(unitId, ip, port);
 
     // Wait for connection and initial poll
     std::cout << "Waiting for initial data..." << std::endl;
@@ -0,0 +1,79 @@
+#ifndef A9MEM15_H
+#define A9MEM15_H
+
+#include "device_cache.h"
+#include "iA9MEM15.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Cached façade over iA9MEM15: same idea as PM2xxx. The poller refreshes
+// 2999..3100 and the energy counter at 3203; accessors only read the snapshot.
+class A9MEM15 {
+public:
+  static constexpr int DEFAULT_POLL_INTERVAL_MS = 1000;
+
+  static std::unique_ptr<A9MEM15>
+  createClient(uint8_t unitId,
+               const std::string &ipAddress,
+               int port = 502,
+               int timeout = 2000,
+               int pollIntervalMs = DEFAULT_POLL_INTERVAL_MS);
+
+  A9MEM15(uint8_t unitId, const std::string &ipAddress, int port, int timeout,
+          int pollIntervalMs);
+  ~A9MEM15();
+
+  bool isConnected() const;
+  void Disconnect();
+  int64_t ageMs() const;
+
+  // ===== Cached value + age =====
+  Cached<float> Get_RmsCurrentOnPhaseA() const { return get<float>(2999); }
+  Cached<float> Get_RmsPhasetoneutralVoltageAn() const {
+    return get<float>(3019);
+  }
+  Cached<float> Get_ActivePowerOnPhaseA() const { return get<float>(3053); }
+  Cached<float> Get_TotalActivePower() const { return get<float>(3059); }
+  Cached<float> Get_TotalApparentPowerArithmetic() const {
+    return get<float>(3069);
+  }
+  Cached<float> Get_TotalPowerFactor() const { return get<float>(3079); }
+  Cached<float> Get_DeviceInternalTemperature() const {
+    return get<float>(3099);
+  }
+  Cached<uint64_t> Get_TotalActiveEnergyDelivered_NotResettable() const {
+    return get<uint64_t>(3203);
+  }
+
+  // ===== Cached value only (same names as iA9MEM15) =====
+  float Read_RmsCurrentOnPhaseA() const {
+    return Get_RmsCurrentOnPhaseA().value;
+  }
+  float Read_RmsPhasetoneutralVoltageAn() const {
+    return Get_RmsPhasetoneutralVoltageAn().value;
+  }
+  float Read_ActivePowerOnPhaseA() const {
+    return Get_ActivePowerOnPhaseA().value;
+  }
+  float Read_TotalActivePower() const { return Get_TotalActivePower().value; }
+  float Read_TotalApparentPowerArithmetic() const {
+    return Get_TotalApparentPowerArithmetic().value;
+  }
+  float Read_TotalPowerFactor() const { return Get_TotalPowerFactor().value; }
+  float Read_DeviceInternalTemperature() const {
+    return Get_DeviceInternalTemperature().value;
+  }
+  uint64_t Read_TotalActiveEnergyDelivered_NotResettable() const {
+    return Get_TotalActiveEnergyDelivered_NotResettable().value;
+  }
+
+private:
+  template <typename T> Cached<T> get(uint16_t address) const {
+    return m_poller.snapshot().get<T, iA9MEM15::WORD_ORDER>(address);
+  }
+
+  DevicePoller<iA9MEM15> m_poller;
+};
+
+#endif // A9MEM15_H
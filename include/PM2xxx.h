@@ -0,0 +1,139 @@
+#ifndef PM2XXX_H
+#define PM2XXX_H
+
+#include <string>
+#include <cstdint>
+#include <memory>
+#include "device_cache.h"
+#include "iPM2xxx.h"
+
+// Cached façade over iPM2xxx.
+//
+// A background poller reads the instantaneous block (2999..3110) and the
+// energy block (3203..3246) every `pollIntervalMs` into a RegisterSnapshot.
+// Read_* return the latest cached value and Get_* return it with its age;
+// neither ever touches the network, so they are safe to call from any thread
+// at any rate.
+class PM2xxx {
+public:
+    static constexpr int DEFAULT_POLL_INTERVAL_MS = 1000;
+
+    // Factory method: starts the poller, does not wait for the first read
+    static std::unique_ptr<PM2xxx> createClient(uint8_t unitId, const std::string& ipAddress, int port = 502, int timeout = 2000, int pollIntervalMs = DEFAULT_POLL_INTERVAL_MS);
+
+    PM2xxx(uint8_t unitId, const std::string& ipAddress, int port, int timeout, int pollIntervalMs);
+    ~PM2xxx();
+
+    // True once every block has been read and the device answered last cycle
+    bool isConnected() const;
+    // Stops the poller; cached values stay readable (and keep ageing)
+    void Disconnect();
+
+    // Age of the stalest cached block in ms, -1 before the first full read
+    int64_t ageMs() const;
+
+    // ===== Cached value + age =====
+    Cached<float> Get_CurrentA() const { return get<float>(2999); }
+    Cached<float> Get_CurrentB() const { return get<float>(3001); }
+    Cached<float> Get_CurrentC() const { return get<float>(3003); }
+    Cached<float> Get_CurrentN() const { return get<float>(3005); }
+    Cached<float> Get_CurrentG() const { return get<float>(3007); }
+    Cached<float> Get_CurrentAvg() const { return get<float>(3009); }
+    Cached<float> Get_VoltageAB() const { return get<float>(3019); }
+    Cached<float> Get_VoltageBC() const { return get<float>(3021); }
+    Cached<float> Get_VoltageCA() const { return get<float>(3023); }
+    Cached<float> Get_VoltageLLAvg() const { return get<float>(3025); }
+    Cached<float> Get_VoltageAN() const { return get<float>(3027); }
+    Cached<float> Get_VoltageBN() const { return get<float>(3029); }
+    Cached<float> Get_VoltageCN() const { return get<float>(3031); }
+    Cached<float> Get_VoltageLNAvg() const { return get<float>(3035); }
+    Cached<float> Get_ActivePowerA() const { return get<float>(3053); }
+    Cached<float> Get_ActivePowerB() const { return get<float>(3055); }
+    Cached<float> Get_ActivePowerC() const { return get<float>(3057); }
+    Cached<float> Get_ActivePowerTotal() const { return get<float>(3059); }
+    Cached<float> Get_ReactivePowerA() const { return get<float>(3061); }
+    Cached<float> Get_ReactivePowerB() const { return get<float>(3063); }
+    Cached<float> Get_ReactivePowerC() const { return get<float>(3065); }
+    Cached<float> Get_ReactivePowerTotal() const { return get<float>(3067); }
+    Cached<float> Get_ApparentPowerA() const { return get<float>(3069); }
+    Cached<float> Get_ApparentPowerB() const { return get<float>(3071); }
+    Cached<float> Get_ApparentPowerC() const { return get<float>(3073); }
+    Cached<float> Get_ApparentPowerTotal() const { return get<float>(3075); }
+    Cached<float> Get_PowerFactorA() const { return get<float>(3077); }
+    Cached<float> Get_PowerFactorB() const { return get<float>(3079); }
+    Cached<float> Get_PowerFactorC() const { return get<float>(3081); }
+    Cached<float> Get_PowerFactorTotal() const { return get<float>(3083); }
+    Cached<float> Get_DisplacementPowerFactorA() const { return get<float>(3085); }
+    Cached<float> Get_DisplacementPowerFactorB() const { return get<float>(3087); }
+    Cached<float> Get_DisplacementPowerFactorC() const { return get<float>(3089); }
+    Cached<float> Get_DisplacementPowerFactorTotal() const { return get<float>(3091); }
+    Cached<float> Get_Frequency() const { return get<float>(3109); }
+    Cached<uint64_t> Get_ActiveEnergy_Delivered() const { return get<uint64_t>(3203); }
+    Cached<uint64_t> Get_ActiveEnergy_Received() const { return get<uint64_t>(3207); }
+    Cached<uint64_t> Get_ActiveEnergy_Total() const { return get<uint64_t>(3211); }
+    Cached<uint64_t> Get_ActiveEnergy_DeliveredReceived() const { return get<uint64_t>(3215); }
+    Cached<uint64_t> Get_ReactiveEnergy_Delivered() const { return get<uint64_t>(3219); }
+    Cached<uint64_t> Get_ReactiveEnergy_Received() const { return get<uint64_t>(3223); }
+    Cached<uint64_t> Get_ReactiveEnergy_Total() const { return get<uint64_t>(3227); }
+    Cached<uint64_t> Get_ReactiveEnergy_Net() const { return get<uint64_t>(3231); }
+    Cached<uint64_t> Get_ApparentEnergy_Delivered() const { return get<uint64_t>(3235); }
+    Cached<uint64_t> Get_ApparentEnergy_Received() const { return get<uint64_t>(3239); }
+    Cached<uint64_t> Get_ApparentEnergy_Total() const { return get<uint64_t>(3243); }
+
+    // ===== Cached value only (same names as iPM2xxx) =====
+    float Read_CurrentA() const { return Get_CurrentA().value; }
+    float Read_CurrentB() const { return Get_CurrentB().value; }
+    float Read_CurrentC() const { return Get_CurrentC().value; }
+    float Read_CurrentN() const { return Get_CurrentN().value; }
+    float Read_CurrentG() const { return Get_CurrentG().value; }
+    float Read_CurrentAvg() const { return Get_CurrentAvg().value; }
+    float Read_VoltageAB() const { return Get_VoltageAB().value; }
+    float Read_VoltageBC() const { return Get_VoltageBC().value; }
+    float Read_VoltageCA() const { return Get_VoltageCA().value; }
+    float Read_VoltageLLAvg() const { return Get_VoltageLLAvg().value; }
+    float Read_VoltageAN() const { return Get_VoltageAN().value; }
+    float Read_VoltageBN() const { return Get_VoltageBN().value; }
+    float Read_VoltageCN() const { return Get_VoltageCN().value; }
+    float Read_VoltageLNAvg() const { return Get_VoltageLNAvg().value; }
+    float Read_ActivePowerA() const { return Get_ActivePowerA().value; }
+    float Read_ActivePowerB() const { return Get_ActivePowerB().value; }
+    float Read_ActivePowerC() const { return Get_ActivePowerC().value; }
+    float Read_ActivePowerTotal() const { return Get_ActivePowerTotal().value; }
+    float Read_ReactivePowerA() const { return Get_ReactivePowerA().value; }
+    float Read_ReactivePowerB() const { return Get_ReactivePowerB().value; }
+    float Read_ReactivePowerC() const { return Get_ReactivePowerC().value; }
+    float Read_ReactivePowerTotal() const { return Get_ReactivePowerTotal().value; }
+    float Read_ApparentPowerA() const { return Get_ApparentPowerA().value; }
+    float Read_ApparentPowerB() const { return Get_ApparentPowerB().value; }
+    float Read_ApparentPowerC() const { return Get_ApparentPowerC().value; }
+    float Read_ApparentPowerTotal() const { return Get_ApparentPowerTotal().value; }
+    float Read_PowerFactorA() const { return Get_PowerFactorA().value; }
+    float Read_PowerFactorB() const { return Get_PowerFactorB().value; }
+    float Read_PowerFactorC() const { return Get_PowerFactorC().value; }
+    float Read_PowerFactorTotal() const { return Get_PowerFactorTotal().value; }
+    float Read_DisplacementPowerFactorA() const { return Get_DisplacementPowerFactorA().value; }
+    float Read_DisplacementPowerFactorB() const { return Get_DisplacementPowerFactorB().value; }
+    float Read_DisplacementPowerFactorC() const { return Get_DisplacementPowerFactorC().value; }
+    float Read_DisplacementPowerFactorTotal() const { return Get_DisplacementPowerFactorTotal().value; }
+    float Read_Frequency() const { return Get_Frequency().value; }
+    uint64_t Read_ActiveEnergy_Delivered() const { return Get_ActiveEnergy_Delivered().value; }
+    uint64_t Read_ActiveEnergy_Received() const { return Get_ActiveEnergy_Received().value; }
+    uint64_t Read_ActiveEnergy_Total() const { return Get_ActiveEnergy_Total().value; }
+    uint64_t Read_ActiveEnergy_DeliveredReceived() const { return Get_ActiveEnergy_DeliveredReceived().value; }
+    uint64_t Read_ReactiveEnergy_Delivered() const { return Get_ReactiveEnergy_Delivered().value; }
+    uint64_t Read_ReactiveEnergy_Received() const { return Get_ReactiveEnergy_Received().value; }
+    uint64_t Read_ReactiveEnergy_Total() const { return Get_ReactiveEnergy_Total().value; }
+    uint64_t Read_ReactiveEnergy_Net() const { return Get_ReactiveEnergy_Net().value; }
+    uint64_t Read_ApparentEnergy_Delivered() const { return Get_ApparentEnergy_Delivered().value; }
+    uint64_t Read_ApparentEnergy_Received() const { return Get_ApparentEnergy_Received().value; }
+    uint64_t Read_ApparentEnergy_Total() const { return Get_ApparentEnergy_Total().value; }
+
+private:
+    template <typename T> Cached<T> get(uint16_t address) const {
+        return m_poller.snapshot().get<T, iPM2xxx::WORD_ORDER>(address);
+    }
+
+    DevicePoller<iPM2xxx> m_poller;
+};
+
+#endif // PM2XXX_H
@@ -0,0 +1,688 @@
+#ifndef PUBLISH_TELEMETRY_H
+#define PUBLISH_TELEMETRY_H
+
+#include "Read_Harmonics.h"
+#include "ThingsBoardClient.h"
+#include "energy_calc.h"
+#include "readings_pm2xxx.h"
+#include "pipeline_metrics.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+/* ---------- Helpers ---------- */
+
+inline int64_t now_epoch_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Publishes one telemetry message and records in-flight count and latency.
+// ThingsBoardClient publishes synchronously at QoS 1, so the measured time
+// is publish → PUBACK.
+inline void publish_timed(ThingsBoardClient &tb, int64_t ts,
+                          const JsonDocument &doc) {
+  TRACE_SCOPE("publish", "mqtt", ts);
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  struct InFlight {
+    std::atomic<int64_t> &n;
+    explicit InFlight(std::atomic<int64_t> &v) : n(v) { n.fetch_add(1); }
+    ~InFlight() { n.fetch_sub(1); }
+  } inflight(metrics.mqttInFlight);
+
+  ScopedLatency latency(metrics.mqttPublish);
+  try {
+    tb.sendTelemetry(ts, doc);
+  } catch (...) {
+    metrics.mqttErrors.fetch_add(1, std::memory_order_relaxed);
+    throw;
+  }
+}
+
+// Runs a write statement and records its (autocommit) latency.
+inline bool exec_timed(sqlite3 *db, const std::string &sql) {
+  TRACE_SCOPE("store", "exec");
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  int rc;
+  {
+    ScopedLatency commit(metrics.sqliteCommit);
+    rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+  }
+  if (rc != SQLITE_OK)
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+  return rc == SQLITE_OK;
+}
+
+// Number of unpublished rows in `table`, or -1 if it cannot be counted.
+inline int64_t count_unsent(sqlite3 *db, const char *table) {
+  std::string sql =
+      std::string("SELECT COUNT(*) FROM ") + table + " WHERE is_read=0;";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    return -1;
+  int64_t n = -1;
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    n = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return n;
+}
+
+// Rollup boundaries crossed since the previous cycle (computed by the caller
+// from localtime so every publisher in one cycle agrees on them).
+struct RollupBoundary {
+  bool newHour = false;
+  bool newDay = false;
+  bool newMonth = false;
+};
+
+// Runs `sqlSum` over the previous local period, publishes the result as `key`,
+// stores it with `sqlInsert` and trims old rollups with `sqlCleanup`.
+inline void publish_energy_rollup(sqlite3 *db, ThingsBoardClient &tb,
+                                  const char *sqlSum, const char *key,
+                                  const char *sqlInsert,
+                                  const char *sqlCleanup) {
+  TRACE_SCOPE("rollup", key);
+  sqlite3_stmt *stmt = nullptr;
+  sqlite3_prepare_v2(db, sqlSum, -1, &stmt, nullptr);
+
+  double kwh = 0.0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    kwh = sqlite3_column_double(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  // 👉 ส่งขึ้น ThingsBoard
+  JsonDocument doc;
+  doc.set(key, kwh);
+
+  int64_t ts = now_epoch_ms();
+  publish_timed(tb, ts, doc);
+
+  sqlite3_stmt *stmtIns = nullptr;
+  sqlite3_prepare_v2(db, sqlInsert, -1, &stmtIns, nullptr);
+
+  sqlite3_bind_int64(stmtIns, 1, ts / 1000); // เก็บเป็นวินาที
+  sqlite3_bind_double(stmtIns, 2, kwh);
+
+  sqlite3_step(stmtIns);
+  sqlite3_finalize(stmtIns);
+
+  char *err = nullptr;
+  if (sqlite3_exec(db, sqlCleanup, nullptr, nullptr, &err) != SQLITE_OK) {
+    std::cerr << "SQLite cleanup error: " << err << std::endl;
+    sqlite3_free(err);
+  }
+}
+
+/* ---------- iA9MEM15 → ThingsBoard ---------- */
+
+// Publishes up to `limit` unread rows of `readings` and marks them read.
+// Returns the number of rows sent.
+inline int Publish_iA9MEM15(sqlite3 *db, ThingsBoardClient &tb,
+                            int limit = 100) {
+  TRACE_SCOPE("publish", "Publish_iA9MEM15", limit);
+  const std::string sqlA9 =
+      "SELECT id, COALESCE(acquired_ms, timestamp * 1000), unit_id,"
+      " voltage_an, current_a,"
+      " total_active_power, total_energy "
+      "FROM readings WHERE is_read=0 LIMIT " +
+      std::to_string(limit) + ";";
+
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sqlA9.c_str(), -1, &stmt, nullptr) !=
+      SQLITE_OK) {
+    std::cerr << "SQLite prepare publish error: " << sqlite3_errmsg(db)
+              << std::endl;
+    return 0;
+  }
+
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  int64_t backlog = count_unsent(db, "readings");
+  metrics.publishQueueDepth.store(std::min<int64_t>(backlog, limit),
+                                  std::memory_order_relaxed);
+
+  int sent = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int id = sqlite3_column_int(stmt, 0);
+    int64_t ts = sqlite3_column_int64(stmt, 1); // acquisition, epoch ms
+    int unit_id = sqlite3_column_int(stmt, 2);
+    TRACE_SCOPE("publish", "row", id);
+    TraceSpan decode("decode", "row_to_json", id);
+
+    double voltage = sqlite3_column_double(stmt, 3);
+    double current = sqlite3_column_double(stmt, 4);
+    double power = sqlite3_column_double(stmt, 5);
+    double energy = sqlite3_column_double(stmt, 6);
+
+    JsonDocument doc;
+
+    // 🔑 สร้าง key แยกตาม unit_id
+    doc.set("voltage_iA9MEM15_" + std::to_string(unit_id), voltage);
+    doc.set("current_iA9MEM15_" + std::to_string(unit_id), current);
+    doc.set("power_iA9MEM15_" + std::to_string(unit_id), power);
+    doc.set("energy_iA9MEM15_" + std::to_string(unit_id), energy);
+    decode.end();
+
+    publish_timed(tb, ts, doc);
+
+    exec_timed(db, "UPDATE readings SET is_read=1 WHERE id=" +
+                       std::to_string(id));
+    metrics.publishQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+
+    std::cout << "Sent iA9MEM15 unit=" << unit_id << " id=" << id << "\n";
+    sent++;
+  }
+
+  sqlite3_finalize(stmt);
+  metrics.publishQueueDepth.store(0, std::memory_order_relaxed);
+  metrics.outboxA9.store(backlog < 0 ? -1 : backlog - sent,
+                         std::memory_order_relaxed);
+  return sent;
+}
+
+/* ---------- iPM2xxx → ThingsBoard ---------- */
+
+// Publishes up to `limit` unread rows of `readings_pm2xxx`, derives the
+// energy delta per row and runs the hour/day/month rollups on boundaries.
+// Returns the number of rows sent.
+inline int Publish_iPM2xxx(sqlite3 *db, ThingsBoardClient &tb,
+                           const RollupBoundary &boundary, int limit = 5) {
+  TRACE_SCOPE("publish", "Publish_iPM2xxx", limit);
+
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, PM_SELECT_UNREAD_SQL.c_str(), -1, &stmt,
+                         nullptr) != SQLITE_OK) {
+    std::cerr << "SQLite prepare publish error: " << sqlite3_errmsg(db)
+              << std::endl;
+    return 0;
+  }
+  sqlite3_bind_int(stmt, 1, limit);
+
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  int64_t backlog = count_unsent(db, "readings_pm2xxx");
+  metrics.publishQueueDepth.store(std::min<int64_t>(backlog, limit),
+                                  std::memory_order_relaxed);
+
+  int sent = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int id = sqlite3_column_int(stmt, 0);
+    int64_t ts = sqlite3_column_int64(stmt, 1); // acquisition, epoch ms
+    TRACE_SCOPE("publish", "row", id);
+    // 🔑 Wh สะสมจากมิเตอร์
+    int64_t currentWh = (int64_t)sqlite3_column_double(stmt, pm_select("ActiveEnergyDeliveredIntoLoad64"));
+
+    // 🔥 คำนวณ delta
+    EnergyResult energy{};
+    {
+      TRACE_SCOPE("rollup", "energy_state");
+      energy = calcEnergyFromWh(db, currentWh);
+    }
+
+    if (energy.delta_kWh > 0) {
+      TRACE_SCOPE("rollup", "energy_delta");
+      JsonDocument energyDoc;
+      energyDoc.set("energy/second(kWh)", energy.delta_kWh);
+
+      int64_t now_ms = now_epoch_ms();
+      publish_timed(tb, now_ms, energyDoc);
+
+      const char *sqlInsert = "INSERT INTO energy_delta (timestamp, delta_kwh) "
+                              "VALUES (?, ?);";
+
+      sqlite3_stmt *stmtIns = nullptr;
+      sqlite3_prepare_v2(db, sqlInsert, -1, &stmtIns, nullptr);
+
+      sqlite3_bind_int64(stmtIns, 1, now_ms / 1000); // เก็บเป็นวินาที
+      sqlite3_bind_double(stmtIns, 2, energy.delta_kWh);
+
+      sqlite3_step(stmtIns);
+      sqlite3_finalize(stmtIns);
+
+      // Sqlcleanupเก็บข้อมูลเก่า (> 1 วัน)
+      const char *sqlCleanup = "DELETE FROM energy_delta "
+                               "WHERE timestamp < strftime('%s','now','-1 day');";
+
+      char *err = nullptr;
+      if (sqlite3_exec(db, sqlCleanup, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "SQLite cleanup error: " << err << std::endl;
+        sqlite3_free(err);
+      }
+    }
+
+    if (boundary.newHour) {
+      // รวม kWh ของชั่วโมงที่แล้ว, เก็บข้อมูลเก่า (> 7 วัน)
+      publish_energy_rollup(
+          db, tb,
+          "SELECT SUM(delta_kwh) "
+          "FROM energy_delta "
+          "WHERE strftime('%Y-%m-%d %H', timestamp, 'unixepoch', 'localtime') = "
+          "strftime('%Y-%m-%d %H', 'now', '-1 hour', 'localtime');",
+          "energy/hour(kWh)",
+          "INSERT INTO energy_delta_hourly (timestamp, delta_kwh_hour) "
+          "VALUES (?, ?);",
+          "DELETE FROM energy_delta_hourly "
+          "WHERE timestamp < strftime('%s','now','-7 days');");
+    }
+
+    if (boundary.newDay) {
+      // รวมค่า kWh ของ "เมื่อวาน", เก็บข้อมูลเก่า (> 30 วัน)
+      publish_energy_rollup(
+          db, tb,
+          "SELECT SUM(delta_kwh_hour) "
+          "FROM energy_delta_hourly "
+          "WHERE strftime('%Y-%m-%d', timestamp, 'unixepoch', 'localtime') = "
+          "strftime('%Y-%m-%d', 'now', '-1 day', 'localtime');",
+          "energy/day(kWh)",
+          "INSERT INTO energy_delta_daily (timestamp, delta_kwh_day) "
+          "VALUES (?, ?);",
+          "DELETE FROM energy_delta_daily "
+          "WHERE timestamp < strftime('%s','now','-30 days');");
+    }
+
+    if (boundary.newMonth) {
+      // รวมค่า kWh ของ "เดือนที่แล้ว", เก็บข้อมูลเก่า (> 1 ปี)
+      publish_energy_rollup(
+          db, tb,
+          "SELECT SUM(delta_kwh_day) "
+          "FROM energy_delta_daily "
+          "WHERE strftime('%Y-%m', timestamp, 'unixepoch', 'localtime') = "
+          "strftime('%Y-%m', 'now', '-1 month', 'localtime');",
+          "energy/month(kWh)",
+          "INSERT INTO energy_delta_monthly (timestamp, delta_kwh_month) "
+          "VALUES (?, ?);",
+          "DELETE FROM energy_delta_monthly "
+          "WHERE timestamp < strftime('%s','now','-1 year');");
+    }
+
+    TraceSpan decode("decode", "row_to_json", id);
+    JsonDocument doc;
+    doc.set("unit_id_iPM2xxx", sqlite3_column_int(stmt, pm_select("unit_id")));
+
+    doc.set("voltageA(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("voltage_a")));
+    doc.set("voltageB(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("voltage_b")));
+    doc.set("voltageC(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("voltage_c")));
+    doc.set("voltageAvg(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("voltage_avg")));
+
+    doc.set("currentA(A)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_a")));
+    doc.set("currentB(A)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_b")));
+    doc.set("currentC(A)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_c")));
+    doc.set("currentAvg(A)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_avg")));
+
+    doc.set("activePowerTotal(W)_iPM2xxx", sqlite3_column_double(stmt, pm_select("active_power_total")));
+    doc.set("frequency(Hz)_iPM2xxx", sqlite3_column_double(stmt, pm_select("frequency")));
+    doc.set("totalEnergy(kWh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("total_energy")));
+    doc.set("ActiveEnergyDeliveredIntoLoad(kWh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyDeliveredIntoLoad")));
+
+    doc.set("currentUnbalanceA(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_unbalanceA")));
+    doc.set("currentUnbalanceB(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_unbalanceB")));
+    doc.set("currentUnbalanceC(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_unbalanceC")));
+    doc.set("currentUnbalanceWorst(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("current_unbalanceWorst")));
+
+    doc.set("ActiveEnergyReceived_OutofLoad(kWh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyReceived_OutofLoad")));
+    doc.set("ActiveEnergyDeliveredPlussReceived(kWh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyDeliveredPlussReceived")));
+    doc.set("ActiveEnergyDeliveredDelReceived(kWh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyDeliveredDelReceived")));
+
+    doc.set("ReactiveEnergyDelivered(kVARh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ReactiveEnergyDelivered")));
+    doc.set("ReactiveEnergyReceived(kVARh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ReactiveEnergyReceived")));
+    doc.set("ReactiveEnergyDeliveredPlussReceived(kVARh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ReactiveEnergyDeliveredPlussReceived")));
+    doc.set("ReactiveEnergyDeliveredDelReceived(kVARh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ReactiveEnergyDeliveredDelReceived")));
+
+    doc.set("ApparentEnergyDelivered(kVAh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ApparentEnergyDelivered")));
+    doc.set("ApparentEnergyReceived(kVAh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ApparentEnergyReceived")));
+    doc.set("ApparentEnergyDeliveredPlussReceived(kVAh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ApparentEnergyDeliveredPlussReceived")));
+    doc.set("ApparentEnergyDeliveredDelReceived(kVAh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ApparentEnergyDeliveredDelReceived")));
+
+    doc.set("ActivePowerA(kW)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActivePowerA")));
+    doc.set("ActivePowerB(kW)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActivePowerB")));
+    doc.set("ActivePowerC(kW)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActivePowerC")));
+
+    doc.set("ReactivePowerA(kVAR)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ReactivePowerA")));
+    doc.set("ReactivePowerB(kVAR)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ReactivePowerB")));
+    doc.set("ReactivePowerC(kVAR)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ReactivePowerC")));
+
+    doc.set("ApparentPowerA(kVA)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ApparentPowerA")));
+    doc.set("ApparentPowerB(kVA)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ApparentPowerB")));
+    doc.set("ApparentPowerC(kVA)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ApparentPowerC")));
+
+    doc.set("PowerFactorA(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("PowerFactorA")));
+    doc.set("PowerFactorB(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("PowerFactorB")));
+    doc.set("PowerFactorC(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("PowerFactorC")));
+
+    doc.set("PowerDemandMethod_iPM2xxx", sqlite3_column_int(stmt, pm_select("PowerDemandMethod")));
+    doc.set("PowerDemandIntervalDuration_iPM2xxx", sqlite3_column_int(stmt, pm_select("PowerDemandIntervalDuration")));
+    doc.set("PowerDemandSubintervalDuration_iPM2xxx", sqlite3_column_int(stmt, pm_select("PowerDemandSubintervalDuration")));
+    doc.set("PowerDemandElapsedTimeInInterval_iPM2xxx", sqlite3_column_int(stmt, pm_select("PowerDemandElapsedTimeinInterval")));
+    doc.set("PowerDemandElapsedTimeInSubinterval_iPM2xxx", sqlite3_column_int(stmt, pm_select("PowerDemandElapsedTimeinSubinterval")));
+
+    doc.set("CurrentDemandMethod_iPM2xxx", sqlite3_column_int(stmt, pm_select("CurrentDemandMethod")));
+    doc.set("CurrentDemandIntervalDuration_iPM2xxx", sqlite3_column_int(stmt, pm_select("CurrentDemandIntervalDuration")));
+    doc.set("CurrentDemandElapsedTimein_iPM2xxx", sqlite3_column_int(stmt, pm_select("CurrentDemandElapsedTimein")));
+    doc.set("CurrentDemandSubintervalDuration_iPM2xxx", sqlite3_column_int(stmt, pm_select("CurrentDemandSubintervalDuration")));
+    doc.set("CurrentDemandElapsedTimeinInterval_iPM2xxx", sqlite3_column_int(stmt, pm_select("CurrentDemandElapsedTimeinInterval")));
+    doc.set("VoltageAB(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageAB")));
+    doc.set("VoltageBC(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageBC")));
+    doc.set("VoltageCA(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageCA")));
+    doc.set("VoltageLLAvg(V)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageLLAvg")));
+
+    doc.set("VoltageUnbalanceAB(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceAB")));
+    doc.set("VoltageUnbalanceBC(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceBC")));
+    doc.set("VoltageUnbalanceCA(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceCA")));
+    doc.set("VoltageUnbalanceLLWorst(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceLLWorst")));
+
+    doc.set("VoltageUnbalanceAN(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceAN")));
+    doc.set("VoltageUnbalanceBN(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceBN")));
+    doc.set("VoltageUnbalanceCN(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceCN")));
+    doc.set("VoltageUnbalanceLNWorst(%)_iPM2xxx", sqlite3_column_double(stmt, pm_select("VoltageUnbalanceLNWorst")));
+
+    doc.set("DisplacementPowerFactorA_iPM2xxx", sqlite3_column_double(stmt, pm_select("DisplacementPowerFactorA")));
+    doc.set("DisplacementPowerFactorB_iPM2xxx", sqlite3_column_double(stmt, pm_select("DisplacementPowerFactorB")));
+    doc.set("DisplacementPowerFactorC_iPM2xxx", sqlite3_column_double(stmt, pm_select("DisplacementPowerFactorC")));
+    doc.set("DisplacementPowerFactorTotal_iPM2xxx", sqlite3_column_double(stmt, pm_select("DisplacementPowerFactorTotal")));
+
+    doc.set("ActiveEnergyDeliveredIntoLoad64(Wh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyDeliveredIntoLoad64")));
+    doc.set("ActiveEnergyReceivedOutofLoad64(Wh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyReceivedOutofLoad64")));
+    doc.set("ActiveEnergyDeliveredPlussReceived64(Wh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyDeliveredPlussReceived64")));
+    doc.set("ActiveEnergyDeliveredDelReceived64(Wh)_iPM2xxx", sqlite3_column_double(stmt, pm_select("ActiveEnergyDeliveredDelReceived64")));
+    decode.end();
+
+    publish_timed(tb, ts, doc);
+
+    exec_timed(db, "UPDATE readings_pm2xxx SET is_read=1 WHERE id=" +
+                       std::to_string(id));
+    metrics.publishQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+
+    std::cout << "Sent iPM2xxx id=" << id << "\n";
+    std::cout << "⚡ Delta Energy = " << energy.delta_kWh << " kWh\n";
+    sent++;
+  }
+  sqlite3_finalize(stmt);
+  metrics.publishQueueDepth.store(0, std::memory_order_relaxed);
+  metrics.outboxPM.store(backlog < 0 ? -1 : backlog - sent,
+                         std::memory_order_relaxed);
+  return sent;
+}
+
+// Quoted JSON string value for JsonDocument::set.
+inline std::string json_string(const std::string &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out.push_back('\\');
+    if ((unsigned char)c >= 0x20)
+      out.push_back(c);
+  }
+  return out + "\"";
+}
+
+// Sends nameplates that are new or changed since their last publish as
+// client attributes, then marks them published. Static metadata therefore
+// costs one MQTT message per meter per change, not one per telemetry row.
+inline int Publish_Nameplate(sqlite3 *db, ThingsBoardClient &tb) {
+  TRACE_SCOPE("publish", "Publish_Nameplate");
+  const char *sql =
+      "SELECT gateway_ip, unit_id, meter_name, meter_model, manufacturer, "
+      "product_id, serial_number, date_of_manufacture, hardware_revision, "
+      "fw_major, fw_minor, fw_quality, power_system_configuration, "
+      "nominal_frequency, nominal_voltage, nominal_current, vt_primary, "
+      "vt_secondary, ct_primary, ct_secondary, "
+      "PowerDemandMethod, PowerDemandIntervalDuration, "
+      "CurrentDemandMethod, CurrentDemandIntervalDuration, restarts "
+      "FROM nameplate_pm2xxx WHERE published=0;";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    return 0; // no nameplate table yet
+
+  int sent = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    auto text = [&](int col) {
+      const unsigned char *v = sqlite3_column_text(stmt, col);
+      return json_string(v ? reinterpret_cast<const char *>(v) : "");
+    };
+    const unsigned char *gw = sqlite3_column_text(stmt, 0);
+    std::string gateway = gw ? reinterpret_cast<const char *>(gw) : "";
+    int unit = sqlite3_column_int(stmt, 1);
+    // Attributes have no timestamp to tell meters apart: key them like the
+    // table, (gateway, unit), so two gateways' unit 1 do not overwrite each
+    // other.
+    std::string sfx = "_iPM2xxx_" + gateway + "_" + std::to_string(unit);
+
+    JsonDocument doc;
+    doc.set("GatewayIp" + sfx, json_string(gateway));
+    doc.set("MeterName" + sfx, text(2));
+    doc.set("MeterModel" + sfx, text(3));
+    doc.set("Manufacturer" + sfx, text(4));
+    doc.set("ProductId" + sfx, sqlite3_column_int(stmt, 5));
+    doc.set("SerialNumber" + sfx, sqlite3_column_int(stmt, 6));
+    doc.set("DateOfManufacture" + sfx, sqlite3_column_int(stmt, 7));
+    doc.set("HardwareRevision" + sfx, text(8));
+    doc.set("Firmware" + sfx,
+            json_string(std::to_string(sqlite3_column_int(stmt, 9)) + "." +
+                        std::to_string(sqlite3_column_int(stmt, 10)) + "." +
+                        std::to_string(sqlite3_column_int(stmt, 11))));
+    doc.set("PowerSystemConfiguration" + sfx, sqlite3_column_int(stmt, 12));
+    doc.set("NominalFrequency(Hz)" + sfx, sqlite3_column_int(stmt, 13));
+    doc.set("NominalVoltage(V)" + sfx, sqlite3_column_double(stmt, 14));
+    doc.set("NominalCurrent(A)" + sfx, sqlite3_column_double(stmt, 15));
+    doc.set("VtPrimary(V)" + sfx, sqlite3_column_double(stmt, 16));
+    doc.set("VtSecondary(V)" + sfx, sqlite3_column_int(stmt, 17));
+    doc.set("CtPrimary(A)" + sfx, sqlite3_column_int(stmt, 18));
+    doc.set("CtSecondary(A)" + sfx, sqlite3_column_int(stmt, 19));
+    doc.set("PowerDemandMethod" + sfx, sqlite3_column_int(stmt, 20));
+    doc.set("PowerDemandInterval(min)" + sfx, sqlite3_column_int(stmt, 21));
+    doc.set("CurrentDemandMethod" + sfx, sqlite3_column_int(stmt, 22));
+    doc.set("CurrentDemandInterval(min)" + sfx, sqlite3_column_int(stmt, 23));
+    doc.set("MeteringSystemRestarts" + sfx, sqlite3_column_int(stmt, 24));
+
+    try {
+      ScopedLatency latency(PipelineMetrics::instance().mqttPublish);
+      tb.sendAttributes(doc);
+    } catch (...) {
+      PipelineMetrics::instance().mqttErrors.fetch_add(
+          1, std::memory_order_relaxed);
+      sqlite3_finalize(stmt);
+      throw;
+    }
+
+    sqlite3_stmt *mark = nullptr;
+    if (sqlite3_prepare_v2(db,
+                           "UPDATE nameplate_pm2xxx SET published=1 "
+                           "WHERE gateway_ip = ? AND unit_id = ?;",
+                           -1, &mark, nullptr) == SQLITE_OK) {
+      sqlite3_bind_text(mark, 1, gateway.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_int(mark, 2, unit);
+      sqlite3_step(mark);
+    }
+    sqlite3_finalize(mark);
+    std::cout << "Sent nameplate iPM2xxx " << gateway << " unit=" << unit
+              << "\n";
+    sent++;
+  }
+  sqlite3_finalize(stmt);
+  return sent;
+}
+
+/* ---------- Harmonics → ThingsBoard ---------- */
+
+// Packed float array as a compact JSON array ("[2.31,0.4,null]"), NaN as null.
+template <size_t N>
+inline std::string json_float_array(const std::array<float, N> &v,
+                                    size_t first = 0, size_t count = N) {
+  std::string out = "[";
+  char buf[32];
+  for (size_t i = first; i < first + count; i++) {
+    if (i > first)
+      out += ",";
+    if (std::isnan(v[i])) {
+      out += "null";
+    } else {
+      std::snprintf(buf, sizeof(buf), "%.4g", v[i]);
+      out += buf;
+    }
+  }
+  return out + "]";
+}
+
+// Sends unpublished harmonics snapshots, one message each, stamped with the
+// acquisition time: `thd_iPM2xxx_<unit>` (13 values, order of
+// PM_THD_ADDRESSES) and `harmonics<channel>_iPM2xxx_<unit>` (H1..H31 %).
+inline int Publish_Harmonics(sqlite3 *db, ThingsBoardClient &tb,
+                             int limit = 20) {
+  TRACE_SCOPE("publish", "Publish_Harmonics", limit);
+  const std::string sql =
+      "SELECT rowid, unit_id, acquired_ms, thd, magnitudes "
+      "FROM harmonics_pm2xxx WHERE published=0 "
+      "ORDER BY acquired_ms LIMIT " +
+      std::to_string(limit) + ";";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    return 0; // no harmonics table yet
+
+  int sent = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int64_t rowid = sqlite3_column_int64(stmt, 0);
+    std::string sfx = "_iPM2xxx_" + std::to_string(sqlite3_column_int(stmt, 1));
+    PMHarmonics h;
+    bool ok = unpack_floats(sqlite3_column_blob(stmt, 3),
+                            sqlite3_column_bytes(stmt, 3), h.thd) &&
+              unpack_floats(sqlite3_column_blob(stmt, 4),
+                            sqlite3_column_bytes(stmt, 4), h.magnitudes);
+    if (ok) {
+      JsonDocument doc;
+      doc.set("thd" + sfx, json_float_array(h.thd));
+      for (size_t c = 0; c < PM_HARMONIC_CHANNELS.size(); c++)
+        doc.set(std::string("harmonics") + PM_HARMONIC_CHANNELS[c].name + sfx,
+                json_float_array(h.magnitudes, c * PM_HARMONIC_ORDERS,
+                                 PM_HARMONIC_ORDERS));
+      try {
+        publish_timed(tb, sqlite3_column_int64(stmt, 2), doc);
+      } catch (...) {
+        sqlite3_finalize(stmt);
+        throw;
+      }
+      sent++;
+    } else {
+      std::cerr << "Harmonics row " << rowid << " malformed, skipped"
+                << std::endl;
+    }
+    exec_timed(db, "UPDATE harmonics_pm2xxx SET published=1 WHERE rowid=" +
+                       std::to_string(rowid));
+  }
+  sqlite3_finalize(stmt);
+  return sent;
+}
+
+/* ---------- Min/max events → ThingsBoard ---------- */
+
+// Sends new extremes at the meter's occurrence time, keyed
+// `Max<quantity>_iPM2xxx_<unit>` / `Min<quantity>_iPM2xxx_<unit>`; a reset
+// goes out as `MaxMinReset_iPM2xxx_<unit>` = 1.
+inline int Publish_MinMax(sqlite3 *db, ThingsBoardClient &tb, int limit = 100) {
+  TRACE_SCOPE("publish", "Publish_MinMax", limit);
+  const std::string sql =
+      "SELECT rowid, unit_id, kind, quantity, value, occurred_ms "
+      "FROM minmax_pm2xxx WHERE published=0 ORDER BY occurred_ms LIMIT " +
+      std::to_string(limit) + ";";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    return 0; // no min/max table yet
+
+  int sent = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    auto text = [&](int col) {
+      const unsigned char *v = sqlite3_column_text(stmt, col);
+      return std::string(v ? reinterpret_cast<const char *>(v) : "");
+    };
+    std::string kind = text(2);
+    std::string sfx = "_iPM2xxx_" + std::to_string(sqlite3_column_int(stmt, 1));
+    JsonDocument doc;
+    if (kind == "reset")
+      doc.set("MaxMinReset" + sfx, 1);
+    else
+      doc.set((kind == "max" ? "Max" : "Min") + text(3) + sfx,
+              sqlite3_column_double(stmt, 4));
+    try {
+      publish_timed(tb, sqlite3_column_int64(stmt, 5), doc);
+    } catch (...) {
+      sqlite3_finalize(stmt);
+      throw;
+    }
+    exec_timed(db, "UPDATE minmax_pm2xxx SET published=1 WHERE rowid=" +
+                       std::to_string(sqlite3_column_int64(stmt, 0)));
+    sent++;
+  }
+  sqlite3_finalize(stmt);
+  return sent;
+}
+
+/* ---------- History log backfill → ThingsBoard ---------- */
+
+// Publishes up to `limit` records fetched by Sync_HistoryLog with the meter's
+// own timestamps, so outages show up filled in on the dashboards. Records of
+// one unit logged at the same instant go out as one message, keyed
+// `Log<register>_iPM2xxx_<unit>`. Returns the number of records sent.
+inline int Publish_HistoryLog(sqlite3 *db, ThingsBoardClient &tb,
+                              int limit = 500) {
+  TRACE_SCOPE("publish", "Publish_HistoryLog", limit);
+  const std::string sql =
+      "SELECT rowid, unit_id, ts_ms, register, value "
+      "FROM history_log_pm2xxx WHERE published=0 "
+      "ORDER BY unit_id, ts_ms LIMIT " +
+      std::to_string(limit) + ";";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    return 0; // no history log table yet
+
+  int sent = 0;
+  JsonDocument doc;
+  std::string rowids;
+  int unit = -1;
+  int64_t ts = -1;
+  std::vector<int> regs; // keys in doc, a repeated one starts a new message
+  auto flush = [&]() {
+    if (regs.empty())
+      return;
+    publish_timed(tb, ts, doc);
+    exec_timed(db, "UPDATE history_log_pm2xxx SET published=1 "
+                   "WHERE rowid IN (" + rowids + ")");
+    sent += int(regs.size());
+    doc = JsonDocument();
+    rowids.clear();
+    regs.clear();
+  };
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int rowUnit = sqlite3_column_int(stmt, 1);
+    int64_t rowTs = sqlite3_column_int64(stmt, 2);
+    int reg = sqlite3_column_int(stmt, 3);
+    if (rowUnit != unit || rowTs != ts ||
+        std::find(regs.begin(), regs.end(), reg) != regs.end())
+      flush();
+    unit = rowUnit;
+    ts = rowTs;
+    doc.set("Log" + std::to_string(reg) +
+                "_iPM2xxx_" + std::to_string(unit),
+            int64_t(sqlite3_column_int64(stmt, 4)));
+    if (!rowids.empty())
+      rowids += ",";
+    rowids += std::to_string(sqlite3_column_int64(stmt, 0));
+    regs.push_back(reg);
+  }
+  flush();
+  sqlite3_finalize(stmt);
+  if (sent)
+    std::cout << "Sent " << sent << " history log record(s)\n";
+  return sent;
+}
+
+#endif // PUBLISH_TELEMETRY_H
@@ -0,0 +1,213 @@
+#ifndef READ_HARMONICS_H
+#define READ_HARMONICS_H
+
+#include "block_snapshot.h"
+#include "iPM2xxx.h"
+#include "pipeline_metrics.h"
+#include "trace.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+// THD table 21299..21338: Current A, B, C, N, G (21299..21307), then
+// Voltage A-B, B-C, C-A, L-L, A-N, B-N, C-N (21321..21333) and L-N (21337).
+constexpr RegisterBlock PM_THD_BLOCK{21299, 40};
+constexpr std::array<uint16_t, 13> PM_THD_ADDRESSES = {
+    21299, 21301, 21303, 21305, 21307, 21321, 21323,
+    21325, 21327, 21329, 21331, 21333, 21337};
+
+// Harmonic tables: per channel H1..H31, one entry every 6 registers with the
+// magnitude (% of fundamental) as the first float.
+constexpr uint16_t PM_HARMONIC_ORDERS = 31;
+constexpr uint16_t PM_HARMONIC_STRIDE = 6;
+struct PMHarmonicChannel {
+  const char *name; // telemetry key part
+  uint16_t h1;      // address of the H1 magnitude
+};
+constexpr std::array<PMHarmonicChannel, 9> PM_HARMONIC_CHANNELS = {{
+    {"VAB", 21711},
+    {"VBC", 22099},
+    {"VCA", 22487},
+    {"VAN", 22875},
+    {"VBN", 23263},
+    {"VCN", 23651},
+    {"IA", 24427},
+    {"IB", 24815},
+    {"IC", 25203},
+}};
+// H1..H31 magnitudes of one channel as a single range (2 requests)
+constexpr uint16_t PM_HARMONIC_SPAN =
+    (PM_HARMONIC_ORDERS - 1) * PM_HARMONIC_STRIDE + 2;
+
+// Harmonics change slowly and cost ~19 requests per meter, so they are
+// acquired on their own, slower schedule.
+constexpr int64_t HARMONICS_INTERVAL_SEC = 15 * 60;
+
+// One harmonics acquisition of one unit.
+struct PMHarmonics {
+  std::array<float, PM_THD_ADDRESSES.size()> thd{};
+  // Channel-major: magnitudes[c * PM_HARMONIC_ORDERS + (h - 1)]
+  std::array<float, PM_HARMONIC_CHANNELS.size() * PM_HARMONIC_ORDERS>
+      magnitudes{};
+  int64_t acquiredMs = 0;     // THD block completed
+  uint32_t acquisitionUs = 0; // whole burst
+};
+
+/* ---------- Packed float arrays ---------- */
+
+// Arrays are stored as BLOBs of IEEE-754 float32, little-endian, whatever the
+// host byte order: one column per table instead of one per value.
+template <size_t N>
+inline std::vector<uint8_t> pack_floats(const std::array<float, N> &v) {
+  std::vector<uint8_t> out(N * 4);
+  for (size_t i = 0; i < N; i++) {
+    uint32_t raw;
+    std::memcpy(&raw, &v[i], sizeof(raw));
+    for (int b = 0; b < 4; b++)
+      out[i * 4 + b] = uint8_t(raw >> (8 * b));
+  }
+  return out;
+}
+
+// Decodes a packed BLOB; false if its size does not match.
+template <size_t N>
+inline bool unpack_floats(const void *blob, int bytes,
+                          std::array<float, N> &v) {
+  if (!blob || bytes != int(N * 4))
+    return false;
+  const uint8_t *p = static_cast<const uint8_t *>(blob);
+  for (size_t i = 0; i < N; i++) {
+    uint32_t raw = uint32_t(p[i * 4]) | (uint32_t(p[i * 4 + 1]) << 8) |
+                   (uint32_t(p[i * 4 + 2]) << 16) |
+                   (uint32_t(p[i * 4 + 3]) << 24);
+    std::memcpy(&v[i], &raw, sizeof(raw));
+  }
+  return true;
+}
+
+inline void SetupHarmonicsTable(sqlite3 *db) {
+  char *errMsg = 0;
+  const char *sql =
+      "CREATE TABLE IF NOT EXISTS harmonics_pm2xxx ("
+      "gateway_ip TEXT, "
+      "unit_id INTEGER, "
+      "acquired_ms INTEGER, "
+      "acquisition_us INTEGER, "
+      "thd BLOB, "        // float32[13], order of PM_THD_ADDRESSES
+      "magnitudes BLOB, " // float32[9 x 31], order of PM_HARMONIC_CHANNELS
+      "published INTEGER DEFAULT 0, "
+      "PRIMARY KEY (gateway_ip, unit_id, acquired_ms)"
+      ");"
+      "DELETE FROM harmonics_pm2xxx WHERE acquired_ms < "
+      "(strftime('%s', 'now', '-2 days') * 1000);";
+  if (sqlite3_exec(db, sql, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (create table harmonics): " << errMsg
+              << std::endl;
+    sqlite3_free(errMsg);
+  }
+}
+
+// Burst read of the THD table and all harmonic magnitudes: one request for
+// THD plus two per channel, instead of 292 single-value reads.
+inline bool Read_Harmonics(iPM2xxx &client, PMHarmonics &h) {
+  TRACE_SCOPE("poll", "harmonics_burst");
+  auto t0 = std::chrono::steady_clock::now();
+
+  BlockSnapshot thd =
+      BlockSnapshot::read(client, PM_THD_BLOCK.start, PM_THD_BLOCK.count);
+  if (!thd.ok())
+    return false;
+  for (size_t i = 0; i < PM_THD_ADDRESSES.size(); i++)
+    h.thd[i] = thd.get<float>(PM_THD_ADDRESSES[i]);
+  h.acquiredMs = thd.acquired.wallMs;
+
+  for (size_t c = 0; c < PM_HARMONIC_CHANNELS.size(); c++) {
+    uint16_t h1 = PM_HARMONIC_CHANNELS[c].h1;
+    BlockSnapshot table = BlockSnapshot::read(client, h1, PM_HARMONIC_SPAN);
+    if (!table.ok())
+      return false;
+    for (uint16_t n = 0; n < PM_HARMONIC_ORDERS; n++)
+      h.magnitudes[c * PM_HARMONIC_ORDERS + n] =
+          table.get<float>(uint16_t(h1 + n * PM_HARMONIC_STRIDE));
+  }
+
+  h.acquisitionUs =
+      uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - t0)
+                   .count());
+  return true;
+}
+
+inline bool Store_Harmonics(sqlite3 *db, const std::string &gateway_ip,
+                            int unit_id, const PMHarmonics &h) {
+  TRACE_SCOPE("store", "harmonics", unit_id);
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  ScopedLatency commit(metrics.sqliteCommit);
+
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "INSERT OR REPLACE INTO harmonics_pm2xxx ("
+                         "gateway_ip, unit_id, acquired_ms, acquisition_us, "
+                         "thd, magnitudes, published) "
+                         "VALUES (?, ?, ?, ?, ?, ?, 0);",
+                         -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (harmonics): " << sqlite3_errmsg(db) << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  std::vector<uint8_t> thd = pack_floats(h.thd);
+  std::vector<uint8_t> mags = pack_floats(h.magnitudes);
+  sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, unit_id);
+  sqlite3_bind_int64(stmt, 3, h.acquiredMs);
+  sqlite3_bind_int64(stmt, 4, h.acquisitionUs);
+  sqlite3_bind_blob(stmt, 5, thd.data(), int(thd.size()), SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 6, mags.data(), int(mags.size()), SQLITE_STATIC);
+  bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!ok) {
+    std::cerr << "SQL error (harmonics): " << sqlite3_errmsg(db) << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+  }
+  sqlite3_finalize(stmt);
+  return ok;
+}
+
+// Acquires and stores the harmonics of one unit if its last snapshot is
+// older than HARMONICS_INTERVAL_SEC. Returns true if a snapshot was stored.
+inline bool Refresh_Harmonics(sqlite3 *db, iPM2xxx &client,
+                              const std::string &gateway_ip, int unit_id) {
+  int64_t lastMs = 0;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT MAX(acquired_ms) FROM harmonics_pm2xxx "
+                         "WHERE gateway_ip = ? AND unit_id = ?;",
+                         -1, &stmt, 0) == SQLITE_OK) {
+    sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, unit_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+      lastMs = sqlite3_column_int64(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  if (PipelineMetrics::wallMs() - lastMs < HARMONICS_INTERVAL_SEC * 1000)
+    return false;
+
+  PMHarmonics h;
+  if (!Read_Harmonics(client, h)) {
+    std::cerr << "Harmonics read of Device " << unit_id << " incomplete"
+              << std::endl;
+    return false;
+  }
+  if (!Store_Harmonics(db, gateway_ip, unit_id, h))
+    return false;
+  std::cout << "Harmonics of Device " << unit_id << " stored ("
+            << h.acquisitionUs / 1000 << " ms)" << std::endl;
+  return true;
+}
+
+#endif // READ_HARMONICS_H
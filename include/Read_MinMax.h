@@ -0,0 +1,189 @@
+#ifndef READ_MINMAX_H
+#define READ_MINMAX_H
+
+#include "block_snapshot.h"
+#include "iPM2xxx.h"
+#include "meter_datetime.h"
+#include "pipeline_metrics.h"
+#include "trace.h"
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <sqlite3.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Min/max since the last reset, as tracked by the meter itself. Each table
+// holds one 6-register entry per quantity: value (float) at +0, occurrence
+// DATETIME at +2. The reset DATETIME (42299) sits just before the max table,
+// so reset + max is one read and min another.
+constexpr RegisterBlock PM_MAX_BLOCK{42299, 52}; // reset 42299, max 42303..
+constexpr RegisterBlock PM_MIN_BLOCK{42591, 48};
+constexpr uint16_t PM_MINMAX_STRIDE = 6;
+constexpr std::array<const char *, 8> PM_MINMAX_QUANTITIES = {
+    "CurrentAvg",         "VoltageLLAvg",       "VoltageLNAvg",
+    "ActivePowerTotal",   "ReactivePowerTotal", "ApparentPowerTotal",
+    "PowerFactorTotal",   "Frequency"};
+
+// Extreme events are rare, keep them well past the readings' 2 days. The
+// latest event per kind/quantity is kept however old: Store_MinMax compares
+// against it, so losing it would re-record (and re-publish) every extreme
+// the meter still holds.
+constexpr int MINMAX_RETENTION_DAYS = 90;
+
+// One extreme (or the reset) as reported by the meter.
+struct PMMinMaxEvent {
+  std::string kind; // "max", "min" or "reset"
+  std::string quantity;
+  double value = 0;
+  int64_t occurredMs = -1; // meter clock
+};
+
+inline void SetupMinMaxTable(sqlite3 *db) {
+  char *errMsg = 0;
+  std::string sql =
+      "CREATE TABLE IF NOT EXISTS minmax_pm2xxx ("
+      "gateway_ip TEXT, "
+      "unit_id INTEGER, "
+      "kind TEXT, "
+      "quantity TEXT, "
+      "value REAL, "
+      "occurred_ms INTEGER, "
+      "recorded_ms INTEGER, "
+      "published INTEGER DEFAULT 0, "
+      "PRIMARY KEY (gateway_ip, unit_id, kind, quantity, occurred_ms)"
+      ");"
+      "DELETE FROM minmax_pm2xxx WHERE recorded_ms < "
+      "(strftime('%s', 'now', '-" +
+      std::to_string(MINMAX_RETENTION_DAYS) +
+      " days') * 1000) "
+      "AND rowid NOT IN (SELECT MAX(rowid) FROM minmax_pm2xxx "
+      "GROUP BY gateway_ip, unit_id, kind, quantity);";
+  if (sqlite3_exec(db, sql.c_str(), 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (create table minmax): " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+  }
+}
+
+// Current reset time and extremes of one unit: two block reads (100
+// registers). Entries the meter has not set yet (no valid date) are left out.
+inline bool Read_MinMax(iPM2xxx &client, std::vector<PMMinMaxEvent> &events) {
+  TRACE_SCOPE("poll", "minmax");
+  BlockSnapshot max =
+      BlockSnapshot::read(client, PM_MAX_BLOCK.start, PM_MAX_BLOCK.count);
+  if (!max.ok())
+    return false;
+  BlockSnapshot min =
+      BlockSnapshot::read(client, PM_MIN_BLOCK.start, PM_MIN_BLOCK.count);
+  if (!min.ok())
+    return false;
+
+  int64_t resetMs = decode_meter_datetime(&max.regs[0]);
+  if (resetMs >= 0)
+    events.push_back({"reset", "MaxMin", 0, resetMs});
+
+  auto table = [&](const BlockSnapshot &snap, uint16_t first,
+                   const char *kind) {
+    for (size_t i = 0; i < PM_MINMAX_QUANTITIES.size(); i++) {
+      uint16_t at = uint16_t(first + i * PM_MINMAX_STRIDE);
+      int64_t occurred = decode_meter_datetime(&snap.regs[at + 2 - snap.start]);
+      if (occurred >= 0)
+        events.push_back(
+            {kind, PM_MINMAX_QUANTITIES[i], snap.get<float>(at), occurred});
+    }
+  };
+  table(max, 42303, "max");
+  table(min, PM_MIN_BLOCK.start, "min");
+  return true;
+}
+
+// Stores the events whose occurrence time differs from the last one stored
+// for the same kind/quantity, in one transaction. Nothing is written while
+// the meter's extremes stay put. Returns the number of new events, -1 on
+// error.
+inline int Store_MinMax(sqlite3 *db, const std::string &gateway_ip,
+                        int unit_id, const std::vector<PMMinMaxEvent> &events) {
+  std::map<std::pair<std::string, std::string>, int64_t> last;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT kind, quantity, occurred_ms FROM minmax_pm2xxx "
+                         "WHERE rowid IN (SELECT MAX(rowid) FROM minmax_pm2xxx "
+                         "WHERE gateway_ip = ? AND unit_id = ? "
+                         "GROUP BY kind, quantity);",
+                         -1, &stmt, 0) == SQLITE_OK) {
+    sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, unit_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      auto text = [&](int col) {
+        const unsigned char *v = sqlite3_column_text(stmt, col);
+        return std::string(v ? reinterpret_cast<const char *>(v) : "");
+      };
+      last[{text(0), text(1)}] = sqlite3_column_int64(stmt, 2);
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  std::vector<const PMMinMaxEvent *> fresh;
+  for (const PMMinMaxEvent &e : events) {
+    auto it = last.find({e.kind, e.quantity});
+    if (it == last.end() || it->second != e.occurredMs)
+      fresh.push_back(&e);
+  }
+  if (fresh.empty())
+    return 0;
+
+  TRACE_SCOPE("store", "minmax", unit_id);
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  ScopedLatency commit(metrics.sqliteCommit);
+  sqlite3_exec(db, "BEGIN;", 0, 0, 0);
+  bool ok = sqlite3_prepare_v2(db,
+                               "INSERT OR IGNORE INTO minmax_pm2xxx ("
+                               "gateway_ip, unit_id, kind, quantity, value, "
+                               "occurred_ms, recorded_ms) "
+                               "VALUES (?, ?, ?, ?, ?, ?, ?);",
+                               -1, &stmt, 0) == SQLITE_OK;
+  int64_t now = PipelineMetrics::wallMs();
+  for (size_t i = 0; ok && i < fresh.size(); i++) {
+    const PMMinMaxEvent &e = *fresh[i];
+    sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, unit_id);
+    sqlite3_bind_text(stmt, 3, e.kind.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, e.quantity.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_double(stmt, 5, e.value);
+    sqlite3_bind_int64(stmt, 6, e.occurredMs);
+    sqlite3_bind_int64(stmt, 7, now);
+    ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  if (!ok) {
+    std::cerr << "SQL error (minmax): " << sqlite3_errmsg(db) << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+    sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+    return -1;
+  }
+  sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+  return int(fresh.size());
+}
+
+// Min/max tracking of one unit: two block reads per poll, a write only when
+// the meter reports a new extreme or a reset. Values and occurrence times are
+// the meter's own, so peaks between two polls are not missed.
+inline int Refresh_MinMax(sqlite3 *db, iPM2xxx &client,
+                          const std::string &gateway_ip, int unit_id) {
+  std::vector<PMMinMaxEvent> events;
+  if (!Read_MinMax(client, events)) {
+    std::cerr << "Min/max read of Device " << unit_id << " failed"
+              << std::endl;
+    return -1;
+  }
+  int n = Store_MinMax(db, gateway_ip, unit_id, events);
+  if (n > 0)
+    std::cout << "Min/max of Device " << unit_id << ": " << n
+              << " new event(s)" << std::endl;
+  return n;
+}
+
+#endif // READ_MINMAX_H
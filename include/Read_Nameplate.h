@@ -0,0 +1,352 @@
+#ifndef READ_NAMEPLATE_H
+#define READ_NAMEPLATE_H
+
+#include "block_snapshot.h"
+#include "iPM2xxx.h"
+#include "meter_datetime.h"
+#include "pipeline_metrics.h"
+#include "trace.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <sqlite3.h>
+#include <string>
+
+// Static identity/configuration of one iPM2xxx unit. These registers only
+// change when the meter is reconfigured or reflashed, so they are read once,
+// kept in SQLite and revalidated through two cheap change indicators instead
+// of being polled every cycle.
+struct PMNameplate {
+  // Identity
+  std::string meterName;
+  std::string meterModel;
+  std::string manufacturer;
+  uint16_t productId = 0;
+  uint16_t serialNumber = 0;
+  uint16_t dateOfManufacture = 0;
+  std::string hardwareRevision;
+  uint16_t fwVersion = 0;
+  uint16_t fwMajor = 0, fwMinor = 0, fwQuality = 0;
+
+  // Wiring / transformer setup
+  uint16_t powerSystemConfiguration = 0;
+  uint16_t nominalFrequency = 0;
+  float nominalVoltage = 0;
+  float nominalCurrent = 0;
+  uint16_t numberVts = 0;
+  float vtPrimary = 0;
+  uint16_t vtSecondary = 0;
+  uint16_t numberCts = 0;
+  uint16_t ctPrimary = 0;
+  uint16_t ctSecondary = 0;
+
+  // Demand setup
+  uint16_t powerDemandMethod = 0;
+  uint16_t powerDemandInterval = 0;
+  uint16_t powerDemandSubinterval = 0;
+  uint16_t currentDemandMethod = 0;
+  uint16_t currentDemandInterval = 0;
+  uint16_t currentDemandSubinterval = 0;
+
+  // Change indicators: any difference means the cached copy is stale
+  uint16_t restarts = 0; // Number Of Metering System Restarts (Addr: 1827)
+  // Date/Time Of Last Firmware Download (Addr: 1646..1649), as
+  // decode_meter_datetime() epoch ms; -1 if the meter has none
+  int64_t fwDownloadMs = -1;
+
+  bool operator==(const PMNameplate &) const = default;
+
+  std::string firmware() const {
+    return std::to_string(fwMajor) + "." + std::to_string(fwMinor) + "." +
+           std::to_string(fwQuality);
+  }
+};
+
+// NaN (unconfigured) is stored as 0, same as safe_float_pm()
+inline double nameplate_real(float val) { return std::isnan(val) ? 0.0 : val; }
+
+// Full re-read even without an indicator change, in case a setting was
+// edited from the front panel without a restart.
+constexpr int64_t NAMEPLATE_MAX_AGE_SEC = 24 * 3600;
+
+inline void SetupNameplateTable(sqlite3 *db) {
+  char *errMsg = 0;
+  const char *sqlCreateTable =
+      "CREATE TABLE IF NOT EXISTS nameplate_pm2xxx ("
+      "gateway_ip TEXT, "
+      "unit_id INTEGER, "
+      "meter_name TEXT, meter_model TEXT, manufacturer TEXT, "
+      "product_id INTEGER, serial_number INTEGER, date_of_manufacture INTEGER, "
+      "hardware_revision TEXT, fw_version INTEGER, "
+      "fw_major INTEGER, fw_minor INTEGER, fw_quality INTEGER, "
+      "power_system_configuration INTEGER, nominal_frequency INTEGER, "
+      "nominal_voltage REAL, nominal_current REAL, "
+      "number_vts INTEGER, vt_primary REAL, vt_secondary INTEGER, "
+      "number_cts INTEGER, ct_primary INTEGER, ct_secondary INTEGER, "
+      "PowerDemandMethod INTEGER, PowerDemandIntervalDuration INTEGER, PowerDemandSubintervalDuration INTEGER, "
+      "CurrentDemandMethod INTEGER, CurrentDemandIntervalDuration INTEGER, CurrentDemandSubintervalDuration INTEGER, "
+      "restarts INTEGER, fw_download INTEGER, "
+      "read_at INTEGER, "
+      "published INTEGER DEFAULT 0, "
+      "PRIMARY KEY (gateway_ip, unit_id)"
+      ");";
+  if (sqlite3_exec(db, sqlCreateTable, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (create table nameplate): " << errMsg
+              << std::endl;
+    sqlite3_free(errMsg);
+  }
+}
+
+// Cached copy for (gateway_ip, unit_id); false if there is none yet.
+// `readAt` receives the epoch second of the last full read.
+inline bool Load_Nameplate(sqlite3 *db, const std::string &gateway_ip,
+                           int unit_id, PMNameplate &np, int64_t &readAt) {
+  const char *sql =
+      "SELECT meter_name, meter_model, manufacturer, product_id, "
+      "serial_number, date_of_manufacture, hardware_revision, fw_version, "
+      "fw_major, fw_minor, fw_quality, power_system_configuration, "
+      "nominal_frequency, nominal_voltage, nominal_current, number_vts, "
+      "vt_primary, vt_secondary, number_cts, ct_primary, ct_secondary, "
+      "PowerDemandMethod, PowerDemandIntervalDuration, PowerDemandSubintervalDuration, "
+      "CurrentDemandMethod, CurrentDemandIntervalDuration, CurrentDemandSubintervalDuration, "
+      "restarts, fw_download, read_at "
+      "FROM nameplate_pm2xxx WHERE gateway_ip = ? AND unit_id = ?;";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK)
+    return false;
+  sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, unit_id);
+
+  bool found = sqlite3_step(stmt) == SQLITE_ROW;
+  if (found) {
+    auto text = [&](int col) {
+      const unsigned char *s = sqlite3_column_text(stmt, col);
+      return s ? std::string(reinterpret_cast<const char *>(s)) : std::string();
+    };
+    auto u16 = [&](int col) { return uint16_t(sqlite3_column_int(stmt, col)); };
+    int c = 0;
+    np.meterName = text(c++);
+    np.meterModel = text(c++);
+    np.manufacturer = text(c++);
+    np.productId = u16(c++);
+    np.serialNumber = u16(c++);
+    np.dateOfManufacture = u16(c++);
+    np.hardwareRevision = text(c++);
+    np.fwVersion = u16(c++);
+    np.fwMajor = u16(c++);
+    np.fwMinor = u16(c++);
+    np.fwQuality = u16(c++);
+    np.powerSystemConfiguration = u16(c++);
+    np.nominalFrequency = u16(c++);
+    np.nominalVoltage = float(sqlite3_column_double(stmt, c++));
+    np.nominalCurrent = float(sqlite3_column_double(stmt, c++));
+    np.numberVts = u16(c++);
+    np.vtPrimary = float(sqlite3_column_double(stmt, c++));
+    np.vtSecondary = u16(c++);
+    np.numberCts = u16(c++);
+    np.ctPrimary = u16(c++);
+    np.ctSecondary = u16(c++);
+    np.powerDemandMethod = u16(c++);
+    np.powerDemandInterval = u16(c++);
+    np.powerDemandSubinterval = u16(c++);
+    np.currentDemandMethod = u16(c++);
+    np.currentDemandInterval = u16(c++);
+    np.currentDemandSubinterval = u16(c++);
+    np.restarts = u16(c++);
+    np.fwDownloadMs = sqlite3_column_int64(stmt, c++);
+    readAt = sqlite3_column_int64(stmt, c++);
+  }
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+// Replaces the cached copy and marks it for (re)publishing.
+inline bool Store_Nameplate(sqlite3 *db, const std::string &gateway_ip,
+                            int unit_id, const PMNameplate &np) {
+  TRACE_SCOPE("store", "nameplate", unit_id);
+  const char *sql =
+      "INSERT OR REPLACE INTO nameplate_pm2xxx ("
+      "gateway_ip, unit_id, meter_name, meter_model, manufacturer, "
+      "product_id, serial_number, date_of_manufacture, hardware_revision, "
+      "fw_version, fw_major, fw_minor, fw_quality, "
+      "power_system_configuration, nominal_frequency, nominal_voltage, "
+      "nominal_current, number_vts, vt_primary, vt_secondary, number_cts, "
+      "ct_primary, ct_secondary, "
+      "PowerDemandMethod, PowerDemandIntervalDuration, PowerDemandSubintervalDuration, "
+      "CurrentDemandMethod, CurrentDemandIntervalDuration, CurrentDemandSubintervalDuration, "
+      "restarts, fw_download, read_at, published) "
+      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, "
+      "?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, strftime('%s', 'now'), 0);";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "SQL Prepare Nameplate Error: " << sqlite3_errmsg(db)
+              << std::endl;
+    return false;
+  }
+
+  int idx = 1;
+  sqlite3_bind_text(stmt, idx++, gateway_ip.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, idx++, unit_id);
+  sqlite3_bind_text(stmt, idx++, np.meterName.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, idx++, np.meterModel.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, idx++, np.manufacturer.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, idx++, np.productId);
+  sqlite3_bind_int(stmt, idx++, np.serialNumber);
+  sqlite3_bind_int(stmt, idx++, np.dateOfManufacture);
+  sqlite3_bind_text(stmt, idx++, np.hardwareRevision.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, idx++, np.fwVersion);
+  sqlite3_bind_int(stmt, idx++, np.fwMajor);
+  sqlite3_bind_int(stmt, idx++, np.fwMinor);
+  sqlite3_bind_int(stmt, idx++, np.fwQuality);
+  sqlite3_bind_int(stmt, idx++, np.powerSystemConfiguration);
+  sqlite3_bind_int(stmt, idx++, np.nominalFrequency);
+  sqlite3_bind_double(stmt, idx++, nameplate_real(np.nominalVoltage));
+  sqlite3_bind_double(stmt, idx++, nameplate_real(np.nominalCurrent));
+  sqlite3_bind_int(stmt, idx++, np.numberVts);
+  sqlite3_bind_double(stmt, idx++, nameplate_real(np.vtPrimary));
+  sqlite3_bind_int(stmt, idx++, np.vtSecondary);
+  sqlite3_bind_int(stmt, idx++, np.numberCts);
+  sqlite3_bind_int(stmt, idx++, np.ctPrimary);
+  sqlite3_bind_int(stmt, idx++, np.ctSecondary);
+  sqlite3_bind_int(stmt, idx++, np.powerDemandMethod);
+  sqlite3_bind_int(stmt, idx++, np.powerDemandInterval);
+  sqlite3_bind_int(stmt, idx++, np.powerDemandSubinterval);
+  sqlite3_bind_int(stmt, idx++, np.currentDemandMethod);
+  sqlite3_bind_int(stmt, idx++, np.currentDemandInterval);
+  sqlite3_bind_int(stmt, idx++, np.currentDemandSubinterval);
+  sqlite3_bind_int(stmt, idx++, np.restarts);
+  sqlite3_bind_int64(stmt, idx++, np.fwDownloadMs);
+
+  int rc;
+  {
+    ScopedLatency commit(PipelineMetrics::instance().sqliteCommit);
+    rc = sqlite3_step(stmt);
+  }
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) {
+    std::cerr << "SQL Insert Nameplate Error: " << sqlite3_errmsg(db)
+              << std::endl;
+    PipelineMetrics::instance().sqliteErrors.fetch_add(
+        1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+// Firmware download date/time: all 4 DATETIME registers in one request, so
+// a download later in the same year is seen too. False if the read failed.
+inline bool Read_FirmwareDownload(iPM2xxx &client, int64_t &ms) {
+  BlockSnapshot snap = BlockSnapshot::read(client, 1646, 4);
+  if (!snap.ok())
+    return false;
+  ms = decode_meter_datetime(snap.regs.data());
+  return true;
+}
+
+// Reads every nameplate register. False if any read failed, in which case
+// `np` must not be cached.
+inline bool Read_Nameplate(iPM2xxx &client, PMNameplate &np) {
+  TRACE_SCOPE("poll", "nameplate");
+  uint32_t errors = client.readErrors();
+
+  np.restarts = client.Read_NumberOfMeteringSystemRestarts();
+  Read_FirmwareDownload(client, np.fwDownloadMs);
+
+  np.meterName = client.Read_MeterName();
+  np.meterModel = client.Read_MeterModel();
+  np.manufacturer = client.Read_Manufacturer();
+  np.productId = client.Read_ProductIdNumber();
+  np.serialNumber = client.Read_SerialNumber();
+  np.dateOfManufacture = client.Read_DateOfManufacture();
+  np.hardwareRevision = client.Read_HardwareRevision();
+  np.fwVersion = client.Read_FwVersion();
+  np.fwMajor = client.Read_XMajor();
+  np.fwMinor = client.Read_YMinor();
+  np.fwQuality = client.Read_ZQuality();
+
+  np.powerSystemConfiguration = client.Read_PowerSystemConfiguration();
+  np.nominalFrequency = client.Read_NominalFrequency();
+  np.nominalVoltage = float(nameplate_real(client.Read_NominalVoltage()));
+  np.nominalCurrent = float(nameplate_real(client.Read_NominalCurrent()));
+  np.numberVts = client.Read_NumberVts();
+  np.vtPrimary = float(nameplate_real(client.Read_VtPrimary()));
+  np.vtSecondary = client.Read_VtSecondary();
+  np.numberCts = client.Read_NumberCts();
+  np.ctPrimary = client.Read_CtPrimary();
+  np.ctSecondary = client.Read_CtSecondary();
+
+  np.powerDemandMethod = client.Read_PowerDemandMethod();
+  np.powerDemandInterval = client.Read_PowerDemandIntervalDuration();
+  np.powerDemandSubinterval = client.Read_PowerDemandSubintervalDuration();
+  np.currentDemandMethod = client.Read_CurrentDemandMethod();
+  np.currentDemandInterval = client.Read_CurrentDemandIntervalDuration();
+  np.currentDemandSubinterval = client.Read_CurrentDemandSubintervalDuration();
+
+  return client.readErrors() == errors;
+}
+
+// Nameplate of one unit, from SQLite when still valid.
+//
+// Each call costs two requests (restart counter and firmware download
+// date/time). The full ~30-register read only happens when there is no cached
+// copy, an indicator moved, or the copy is older than NAMEPLATE_MAX_AGE_SEC.
+// A new copy is stored with published=0 so Publish_Nameplate() sends it once.
+// Returns false if no valid nameplate is available for this unit.
+inline bool Refresh_Nameplate(sqlite3 *db, iPM2xxx &client,
+                              const std::string &gateway_ip, int unit_id,
+                              PMNameplate &np) {
+  TRACE_SCOPE("poll", "nameplate_check", unit_id);
+  int64_t readAt = 0;
+  bool cached = Load_Nameplate(db, gateway_ip, unit_id, np, readAt);
+
+  if (cached) {
+    uint32_t errors = client.readErrors();
+    uint16_t restarts = client.Read_NumberOfMeteringSystemRestarts();
+    int64_t fwDownloadMs = -1;
+    if (!Read_FirmwareDownload(client, fwDownloadMs) ||
+        client.readErrors() != errors)
+      return true; // unreachable right now: keep serving the cached copy
+
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    if (restarts != np.restarts || fwDownloadMs != np.fwDownloadMs)
+      std::cout << "Nameplate of Device " << unit_id
+                << " changed (restarts " << np.restarts << " -> " << restarts
+                << ", fw download " << np.fwDownloadMs << " -> "
+                << fwDownloadMs << " ms), re-reading" << std::endl;
+    else if (now - readAt >= NAMEPLATE_MAX_AGE_SEC)
+      std::cout << "Nameplate of Device " << unit_id << " is "
+                << (now - readAt) / 3600 << " h old, re-reading" << std::endl;
+    else
+      return true;
+  }
+
+  PMNameplate fresh;
+  if (!Read_Nameplate(client, fresh)) {
+    std::cerr << "Nameplate read of Device " << unit_id << " incomplete"
+              << std::endl;
+    return cached;
+  }
+  if (cached && fresh == np) {
+    // Periodic re-read found nothing new: no need to publish it again
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db,
+                           "UPDATE nameplate_pm2xxx SET read_at = "
+                           "strftime('%s', 'now') WHERE gateway_ip = ? AND "
+                           "unit_id = ?;",
+                           -1, &stmt, 0) == SQLITE_OK) {
+      sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int(stmt, 2, unit_id);
+      sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return true;
+  }
+  np = fresh;
+  Store_Nameplate(db, gateway_ip, unit_id, np);
+  return true;
+}
+
+#endif // READ_NAMEPLATE_H
@@ -1,7 +1,15 @@
 #ifndef READ_IA9MEM15_H
 #define READ_IA9MEM15_H
 
+#include "block_snapshot.h"
+#include "channel_store.h"
 #include "iA9MEM15.h"
+#include "live_image.h"
+#include "pipeline_metrics.h"
+#include "snapshot_store.h"
+#include "sqlite_schema.h"
+#include "storage.h"
+#include "trace.h"
 #include <chrono>
 #include <cmath>
 #include <iostream>
@@ -11,6 +19,10 @@
 #include <thread>
 #include <vector>
 
+// Snapshot groups read per poll (one acquisition each)
+constexpr RegisterBlock A9_INSTANT_BLOCK{2999, 102}; // I, V, P, S, PF, temp
+constexpr RegisterBlock A9_ENERGY_BLOCK{3203, 4};    // INT64 active energy
+
 /* ---------- Helpers ---------- */
 
 inline float safe_float(float v) {
@@ -20,16 +32,13 @@ inline float safe_float(float v) {
 inline uint64_t get_historical_energy(sqlite3_stmt *stmt,
                                       int unit_id,
                                       const std::string &gateway_ip,
-                                      int seconds_ago) {
+                                      int64_t now, int seconds_ago) {
   if (!stmt)
     return 0;
 
   uint64_t energy = 0;
-  long now = std::chrono::duration_cast<std::chrono::seconds>(
-                 std::chrono::system_clock::now().time_since_epoch())
-                 .count();
-
-  long target = now - seconds_ago;
+  TRACE_SCOPE("store", "history", seconds_ago);
+  int64_t target = now - seconds_ago;
 
   sqlite3_reset(stmt);
   sqlite3_bind_int(stmt, 1, unit_id);
@@ -66,7 +75,10 @@ inline void SetupDatabase(sqlite3 *db) {
       "total_energy_last_5M INTEGER DEFAULT 0,"
       "total_energy_last_30M INTEGER DEFAULT 0,"
       "total_energy_last_1H INTEGER DEFAULT 0,"
-      "total_energy_last_2H INTEGER DEFAULT 0"
+      "total_energy_last_2H INTEGER DEFAULT 0,"
+      "is_read INTEGER DEFAULT 0,"
+      "acquired_ms INTEGER,"
+      "acquisition_us INTEGER"
       ");";
 
   char *err = nullptr;
@@ -75,6 +87,11 @@ inline void SetupDatabase(sqlite3 *db) {
     sqlite3_free(err);
   }
 
+  // Columns missing from databases created by older builds
+  ensure_column(db, "readings", "is_read", "INTEGER DEFAULT 0");
+  ensure_column(db, "readings", "acquired_ms", "INTEGER");
+  ensure_column(db, "readings", "acquisition_us", "INTEGER");
+
   // 2. Cleanup old data (> 2 days)
   const char *sqlCleanup ="DELETE FROM readings WHERE timestamp < "
                            "strftime('%s', 'now', '-2 days');";
@@ -91,15 +108,15 @@ inline void SetupDatabase(sqlite3 *db) {
 inline void Read_iA9MEM15(const std::vector<int> &ids,
                           const std::string &ipAddr,
                           int port) {
-  sqlite3 *db = nullptr;
-
-  if (sqlite3_open("iA9MEM15.db", &db) != SQLITE_OK) {
-    std::cerr << "SQLite open error: " << sqlite3_errmsg(db) << std::endl;
-    db = nullptr;
-  }
+  TRACE_SCOPE("poll", "Read_iA9MEM15", port);
+  sqlite3 *db = Storage::instance().a9().writer(); // shared, stays open
 
-  if (db)
+  if (db) {
+    TRACE_SCOPE("store", "setup");
     SetupDatabase(db);
+  }
+  std::unique_ptr<ChannelStore> channels = ChannelStore::create(db);
+  std::unique_ptr<SnapshotStore> raw = SnapshotStore::create(db);
 
   /* ---- Prepare statements ---- */
 
@@ -126,8 +143,9 @@ inline void Read_iA9MEM15(const std::vector<int> &ids,
         "total_active_power, total_apparent_power, total_power_factor,"
         "total_energy, temp,"
         "total_energy_last_1M, total_energy_last_5M,"
-        "total_energy_last_30M, total_energy_last_1H, total_energy_last_2H"
-        ") VALUES (strftime('%s','now'),?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);";
+        "total_energy_last_30M, total_energy_last_1H, total_energy_last_2H,"
+        "acquired_ms, acquisition_us"
+        ") VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);";
 
     if (sqlite3_prepare_v2(db, sqlInsert, -1, &stmtInsert, nullptr) !=
         SQLITE_OK) {
@@ -139,30 +157,73 @@ inline void Read_iA9MEM15(const std::vector<int> &ids,
 
   /* ---- Loop Devices ---- */
 
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  const std::string gateway = ipAddr + ":" + std::to_string(port);
+  metrics.pollQueueDepth.fetch_add(ids.size(), std::memory_order_relaxed);
+
   for (int unitId : ids) {
     std::cout << "\nStarting Monitor (Device " << unitId << ")...\n";
 
-    auto client = iA9MEM15::createClient(unitId, ipAddr, port);
+    TRACE_SCOPE("poll", "device", unitId);
+    DeviceHealth *health = metrics.device(gateway, unitId, "iA9MEM15");
+    health->polls.fetch_add(1, std::memory_order_relaxed);
+    health->lastPollMs.store(PipelineMetrics::wallMs(), std::memory_order_relaxed);
+    bool stored = false;
+
+    // Dead unit: one probe per backoff window instead of a timeout per read
+    CircuitBreaker *breaker = CircuitBreakers::instance().breaker(gateway, unitId);
+    if (breaker->skipPoll()) {
+      std::cerr << "Skipping device " << unitId << " (circuit open, next probe in "
+                << breaker->retryInMs() / 1000 << " s)" << std::endl;
+      health->failures.fetch_add(1, std::memory_order_relaxed);
+      metrics.pollQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    std::unique_ptr<iA9MEM15> client;
+    {
+      TRACE_SCOPE("poll", "connect");
+      client = iA9MEM15::createClient(unitId, ipAddr, port);
+    }
     if (!client || !client->isConnected()) {
       std::cerr << "Failed to connect device " << unitId << std::endl;
+      health->failures.fetch_add(1, std::memory_order_relaxed);
+      metrics.pollQueueDepth.fetch_sub(1, std::memory_order_relaxed);
       continue;
     }
 
-    float powerA = client->Read_ActivePowerOnPhaseA();
-    float voltage = client->Read_RmsPhasetoneutralVoltageAn();
-    float current = client->Read_RmsCurrentOnPhaseA();
-    float totalP = client->Read_TotalActivePower();
-    float apparent = client->Read_TotalApparentPowerArithmetic();
-    float pf = client->Read_TotalPowerFactor();
-    float temp = client->Read_DeviceInternalTemperature();
-    uint64_t energy =
-        client->Read_TotalActiveEnergyDelivered_NotResettable();
-
-    uint64_t e1m = get_historical_energy(stmtHistory, unitId, ipAddr, 60);
-    uint64_t e5m = get_historical_energy(stmtHistory, unitId, ipAddr, 300);
-    uint64_t e30m = get_historical_energy(stmtHistory, unitId, ipAddr, 1800);
-    uint64_t e1h = get_historical_energy(stmtHistory, unitId, ipAddr, 3600);
-    uint64_t e2h = get_historical_energy(stmtHistory, unitId, ipAddr, 7200);
+    // One acquisition for the instantaneous values, one for the energy;
+    // the row is stamped with the time the first one completed.
+    BlockSnapshot inst;
+    {
+      TRACE_SCOPE("poll", "snapshot", unitId);
+      inst = BlockSnapshot::read(*client, A9_INSTANT_BLOCK.start,
+                                 A9_INSTANT_BLOCK.count);
+    }
+    BlockSnapshot energyBlock = BlockSnapshot::read(
+        *client, A9_ENERGY_BLOCK.start, A9_ENERGY_BLOCK.count);
+
+    // Same blocks, kept in RAM for the Modbus façade
+    LiveImage *live = LiveImages::instance().image(
+        gateway, unitId, "iA9MEM15", {A9_INSTANT_BLOCK, A9_ENERGY_BLOCK});
+    live->publish(0, inst);
+    live->publish(1, energyBlock);
+
+    float powerA = inst.get<float>(3053);
+    float voltage = inst.get<float>(3019);
+    float current = inst.get<float>(2999);
+    float totalP = inst.get<float>(3059);
+    float apparent = inst.get<float>(3069);
+    float pf = inst.get<float>(3079);
+    float temp = inst.get<float>(3099);
+    uint64_t energy = energyBlock.get<uint64_t>(3203);
+
+    const int64_t acquiredSec = inst.acquired.wallMs / 1000;
+    uint64_t e1m = get_historical_energy(stmtHistory, unitId, ipAddr, acquiredSec, 60);
+    uint64_t e5m = get_historical_energy(stmtHistory, unitId, ipAddr, acquiredSec, 300);
+    uint64_t e30m = get_historical_energy(stmtHistory, unitId, ipAddr, acquiredSec, 1800);
+    uint64_t e1h = get_historical_energy(stmtHistory, unitId, ipAddr, acquiredSec, 3600);
+    uint64_t e2h = get_historical_energy(stmtHistory, unitId, ipAddr, acquiredSec, 7200);
 
     std::cout << "Active Power A: " << powerA << " W\n";
     std::cout << "Total Power: " << totalP << " W\n";
@@ -174,36 +235,66 @@ inline void Read_iA9MEM15(const std::vector<int> &ids,
     std::cout << " - Last 2H: " << e2h << " Wh\n";
 
     /* ---- Insert DB (ถ้า DB ใช้ได้) ---- */
-    if (stmtInsert) {
+    if (breaker->state() == CircuitBreaker::Open) {
+      // Tripped during this poll: the values above are fail-fast zeros
+      std::cerr << "Device " << unitId << " stopped answering, row not stored"
+                << std::endl;
+    } else if (stmtInsert) {
       sqlite3_reset(stmtInsert);
-      sqlite3_bind_text(stmtInsert, 1, ipAddr.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_int(stmtInsert, 2, unitId);
-      sqlite3_bind_double(stmtInsert, 3, safe_float(powerA));
-      sqlite3_bind_double(stmtInsert, 4, safe_float(voltage));
-      sqlite3_bind_double(stmtInsert, 5, safe_float(current));
-      sqlite3_bind_double(stmtInsert, 6, safe_float(totalP));
-      sqlite3_bind_double(stmtInsert, 7, safe_float(apparent));
-      sqlite3_bind_double(stmtInsert, 8, safe_float(pf));
-      sqlite3_bind_int64(stmtInsert, 9, energy);
-      sqlite3_bind_double(stmtInsert, 10, safe_float(temp));
-      sqlite3_bind_int64(stmtInsert, 11, e1m);
-      sqlite3_bind_int64(stmtInsert, 12, e5m);
-      sqlite3_bind_int64(stmtInsert, 13, e30m);
-      sqlite3_bind_int64(stmtInsert, 14, e1h);
-      sqlite3_bind_int64(stmtInsert, 15, e2h);
-
-      if (sqlite3_step(stmtInsert) != SQLITE_DONE) {
+      sqlite3_bind_int64(stmtInsert, 1, acquiredSec);
+      sqlite3_bind_text(stmtInsert, 2, ipAddr.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int(stmtInsert, 3, unitId);
+      sqlite3_bind_double(stmtInsert, 4, safe_float(powerA));
+      sqlite3_bind_double(stmtInsert, 5, safe_float(voltage));
+      sqlite3_bind_double(stmtInsert, 6, safe_float(current));
+      sqlite3_bind_double(stmtInsert, 7, safe_float(totalP));
+      sqlite3_bind_double(stmtInsert, 8, safe_float(apparent));
+      sqlite3_bind_double(stmtInsert, 9, safe_float(pf));
+      sqlite3_bind_int64(stmtInsert, 10, energy);
+      sqlite3_bind_double(stmtInsert, 11, safe_float(temp));
+      sqlite3_bind_int64(stmtInsert, 12, e1m);
+      sqlite3_bind_int64(stmtInsert, 13, e5m);
+      sqlite3_bind_int64(stmtInsert, 14, e30m);
+      sqlite3_bind_int64(stmtInsert, 15, e1h);
+      sqlite3_bind_int64(stmtInsert, 16, e2h);
+      sqlite3_bind_int64(stmtInsert, 17, inst.acquired.wallMs);
+      sqlite3_bind_int64(stmtInsert, 18, inst.durationUs);
+
+      int rc;
+      {
+        TRACE_SCOPE("store", "insert", unitId);
+        ScopedLatency commit(metrics.sqliteCommit);
+        rc = sqlite3_step(stmtInsert);
+      }
+      if (rc != SQLITE_DONE) {
         std::cerr << "SQLite insert error: "
                   << sqlite3_errmsg(db) << std::endl;
+        metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
       } else {
         std::cout << "Data saved to SQLite.\n";
+        if (channels)
+          channels->append(channels->unitKey(ipAddr, unitId, "iA9MEM15"),
+                           inst.acquired.wallMs,
+                           collect_channels(A9_CHANNELS, {&inst, &energyBlock}));
+        if (raw)
+          raw->append(raw->unitKey(ipAddr, unitId, "iA9MEM15"),
+                      inst.acquired.wallMs, A9_MAP_VERSION,
+                      {&inst, &energyBlock});
+        stored = client->readErrors() == 0;
       }
     }
 
+    if (stored)
+      health->lastOkMs.store(PipelineMetrics::wallMs(), std::memory_order_relaxed);
+    else
+      health->failures.fetch_add(1, std::memory_order_relaxed);
+    metrics.pollQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+
     client->Disconnect();
   }
     /* >>> CLEANUP 7 DAYS <<< */
   if (db) {
+    TRACE_SCOPE("store", "cleanup");
     const char* sqlCleanup =
         "DELETE FROM readings "
         "WHERE timestamp < strftime('%s','now','-7 days');";
@@ -220,9 +311,6 @@ inline void Read_iA9MEM15(const std::vector<int> &ids,
     sqlite3_finalize(stmtHistory);
   if (stmtInsert)
     sqlite3_finalize(stmtInsert);
-  if (db)
-    sqlite3_close(db);
-
 }
 
 #endif // READ_IA9MEM15_H
@@ -1,7 +1,19 @@
 #ifndef READ_IPM2XXX_H
 #define READ_IPM2XXX_H
 
+#include "Read_Harmonics.h"
+#include "Read_MinMax.h"
+#include "Read_Nameplate.h"
+#include "block_snapshot.h"
+#include "channel_store.h"
 #include "iPM2xxx.h"
+#include "live_image.h"
+#include "readings_pm2xxx.h"
+#include "pipeline_metrics.h"
+#include "snapshot_store.h"
+#include "sqlite_schema.h"
+#include "storage.h"
+#include "trace.h"
 #include <chrono>
 #include <cmath> // For std::isnan
 #include <iostream>
@@ -12,6 +24,11 @@
 #include <vector>
 #include <cstdint>
 
+// Snapshot groups read per poll (one acquisition each)
+constexpr RegisterBlock PM_INSTANT_BLOCK{2999, 112};     // V, I, P, Q, S, PF, Hz
+constexpr RegisterBlock PM_ENERGY_FLOAT_BLOCK{2699, 22}; // float energies
+constexpr RegisterBlock PM_ENERGY_U64_BLOCK{3203, 16};   // INT64 active energies
+
 // Helper to sanitize float for SQLite (replace NaN with 0)
 inline float safe_float_pm(float val) {
   if (std::isnan(val)) {
@@ -22,17 +39,15 @@ inline float safe_float_pm(float val) {
 
 // Helper to get historical energy values using a reused prepared statement
 inline int64_t get_historical_energy_pm(sqlite3_stmt *stmt, int unit_id, const std::string& gateway_ip,
-                                        int seconds_ago) {
+                                        int64_t now, int seconds_ago) {
   int64_t energy = 0;
+  TRACE_SCOPE("store", "history", seconds_ago);
 
   if (stmt) {
-    long now = std::chrono::duration_cast<std::chrono::seconds>(
-                   std::chrono::system_clock::now().time_since_epoch())
-                   .count();
-    long target_time = now - seconds_ago;
+    int64_t target_time = now - seconds_ago;
     // Window +/- 30s
-    long start_window = target_time - 30;
-    long end_window = target_time + 30;
+    int64_t start_window = target_time - 30;
+    int64_t end_window = target_time + 30;
 
     sqlite3_reset(stmt);
     sqlite3_bind_int(stmt, 1, unit_id);
@@ -52,57 +67,18 @@ inline void SetupDatabasePM(sqlite3 *db) {
   char *errMsg = 0;
   int rc;
 
-  // 1. Create Table
-  const char *sqlCreateTable =
-      "CREATE TABLE IF NOT EXISTS readings_pm2xxx ("
-      "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-      "timestamp INTEGER, "
-      "gateway_ip TEXT, "
-      "unit_id INTEGER, "
-      "voltage_a REAL, voltage_b REAL, voltage_c REAL, voltage_avg REAL, "
-      "current_a REAL, current_b REAL, current_c REAL, current_avg REAL, "
-      "active_power_total REAL, "
-      "reactive_power_total REAL, "
-      "apparent_power_total REAL, "
-      "power_factor_total REAL, "
-      "frequency REAL, "
-      "total_energy INTEGER, "
-      "total_energy_last_1M INTEGER DEFAULT 0, "
-      "total_energy_last_5M INTEGER DEFAULT 0, "
-      "total_energy_last_30M INTEGER DEFAULT 0, "
-      "total_energy_last_1H INTEGER DEFAULT 0, "
-      "total_energy_last_2H INTEGER DEFAULT 0, "
-      "total_energy_last_1D INTEGER DEFAULT 0, "
-      "ActiveEnergyDeliveredIntoLoad REAL, "
-      "current_unbalanceA REAL, current_unbalanceB REAL, current_unbalanceC REAL, "
-      "current_unbalanceWorst REAL, "
-      "ActiveEnergyReceived_OutofLoad REAL, ActiveEnergyDeliveredPlussReceived REAL, ActiveEnergyDeliveredDelReceived REAL, "
-      "ReactiveEnergyDelivered REAL, ReactiveEnergyReceived REAL, ReactiveEnergyDeliveredPlussReceived REAL, ReactiveEnergyDeliveredDelReceived REAL, "
-      "ApparentEnergyDelivered REAL, ApparentEnergyReceived REAL, ApparentEnergyDeliveredPlussReceived REAL, ApparentEnergyDeliveredDelReceived REAL, "
-      "ActivePowerA REAL, ActivePowerB REAL, ActivePowerC REAL, "
-      "ReactivePowerA REAL, ReactivePowerB REAL, ReactivePowerC REAL, "
-      "ApparentPowerA REAL, ApparentPowerB REAL, ApparentPowerC REAL, "
-      "PowerFactorA REAL, PowerFactorB REAL, PowerFactorC REAL, "
-      "PowerDemandMethod INTEGER, PowerDemandIntervalDuration INTEGER, PowerDemandSubintervalDuration INTEGER, PowerDemandElapsedTimeinInterval INTEGER, PowerDemandElapsedTimeinSubinterval INTEGER, "
-      "CurrentDemandMethod INTEGER, CurrentDemandIntervalDuration INTEGER, CurrentDemandElapsedTimein INTEGER, CurrentDemandSubintervalDuration INTEGER, CurrentDemandElapsedTimeinInterval INTEGER, "
-      "VoltageAB REAL, VoltageBC REAL, VoltageCA REAL, VoltageLLAvg REAL, "
-      "VoltageUnbalanceAB REAL, VoltageUnbalanceBC REAL, VoltageUnbalanceCA REAL, VoltageUnbalanceLLWorst REAL, "
-      "VoltageUnbalanceAN REAL, VoltageUnbalanceBN REAL, VoltageUnbalanceCN REAL, VoltageUnbalanceLNWorst REAL, "
-      "DisplacementPowerFactorA REAL, DisplacementPowerFactorB REAL, DisplacementPowerFactorC REAL, DisplacementPowerFactorTotal REAL, "
-      "ActiveEnergyDeliveredIntoLoad64 INTEGER, "
-      "ActiveEnergyReceivedOutofLoad64 INTEGER, "
-      "ActiveEnergyDeliveredPlussReceived64 INTEGER, "
-      "ActiveEnergyDeliveredDelReceived64 INTEGER, "
-      "is_read INTEGER DEFAULT 0"
-      ");";
-
-  rc = sqlite3_exec(db, sqlCreateTable, 0, 0, &errMsg);
+  // 1. Create Table (generated from PM_COLUMNS)
+  rc = sqlite3_exec(db, PM_CREATE_SQL.c_str(), 0, 0, &errMsg);
   if (rc != SQLITE_OK) {
     std::cerr << "SQL error (create table): " << errMsg << std::endl;
     sqlite3_free(errMsg);
     return;
   }
 
+  // Databases from before the snapshot reads lack these
+  ensure_column(db, "readings_pm2xxx", "acquired_ms", "INTEGER");
+  ensure_column(db, "readings_pm2xxx", "acquisition_us", "INTEGER");
+
   const char *sqlCreateTableDelta =
       "CREATE TABLE IF NOT EXISTS energy_delta ("
       "id INTEGER PRIMARY KEY AUTOINCREMENT, "
@@ -181,18 +157,24 @@ inline void SetupDatabasePM(sqlite3 *db) {
 
 inline void Read_iPM2xxx(const std::vector<int> &ids, const std::string &ipAddr,
                          int port) {
-  sqlite3 *db;
+  TRACE_SCOPE("poll", "Read_iPM2xxx", port);
   int rc;
 
-  // 1. Open Database
-  rc = sqlite3_open("iPM2xxx.db", &db);
-  if (rc) {
-    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+  // 1. Shared connection (stays open across cycles)
+  sqlite3 *db = Storage::instance().pm().writer();
+  if (!db)
     return;
-  }
 
   // 2. Setup
-  SetupDatabasePM(db);
+  {
+    TRACE_SCOPE("store", "setup");
+    SetupDatabasePM(db);
+    SetupNameplateTable(db);
+    SetupHarmonicsTable(db);
+    SetupMinMaxTable(db);
+  }
+  std::unique_ptr<ChannelStore> channels = ChannelStore::create(db);
+  std::unique_ptr<SnapshotStore> raw = SnapshotStore::create(db);
 
   // 3. Prepare Statements
   sqlite3_stmt *stmtHistory = nullptr;
@@ -203,71 +185,49 @@ inline void Read_iPM2xxx(const std::vector<int> &ids, const std::string &ipAddr,
   if (sqlite3_prepare_v2(db, sqlHistory, -1, &stmtHistory, 0) != SQLITE_OK) {
     std::cerr << "SQL Prepare History Error: " << sqlite3_errmsg(db)
               << std::endl;
-    sqlite3_close(db);
     return;
   }
 
   sqlite3_stmt *stmtInsert = nullptr;
-  const char *sqlInsert =
-      "INSERT INTO readings_pm2xxx ("
-      "timestamp, gateway_ip, unit_id, "
-      "voltage_a, voltage_b, voltage_c, voltage_avg, "
-      "current_a, current_b, current_c, current_avg, "
-      "active_power_total, reactive_power_total, apparent_power_total, "
-      "power_factor_total, frequency, total_energy, "
-      "total_energy_last_1M, total_energy_last_5M, total_energy_last_30M, total_energy_last_1H, total_energy_last_2H, "
-      "ActiveEnergyDeliveredIntoLoad, current_unbalanceA, current_unbalanceB, current_unbalanceC, current_unbalanceWorst, "
-      "ActiveEnergyReceived_OutofLoad, ActiveEnergyDeliveredPlussReceived, ActiveEnergyDeliveredDelReceived, "
-      "ReactiveEnergyDelivered, ReactiveEnergyReceived, ReactiveEnergyDeliveredPlussReceived, ReactiveEnergyDeliveredDelReceived, "
-      "ApparentEnergyDelivered, ApparentEnergyReceived, ApparentEnergyDeliveredPlussReceived, ApparentEnergyDeliveredDelReceived, "
-      "ActivePowerA, ActivePowerB, ActivePowerC, ReactivePowerA, ReactivePowerB, ReactivePowerC, "
-      "ApparentPowerA, ApparentPowerB, ApparentPowerC, PowerFactorA, PowerFactorB, PowerFactorC, "
-      "PowerDemandMethod, PowerDemandIntervalDuration, PowerDemandSubintervalDuration, PowerDemandElapsedTimeinInterval, PowerDemandElapsedTimeinSubinterval, "
-      "CurrentDemandMethod, CurrentDemandIntervalDuration, CurrentDemandElapsedTimein, CurrentDemandSubintervalDuration, CurrentDemandElapsedTimeinInterval, "
-      "VoltageAB, VoltageBC, VoltageCA, VoltageLLAvg, "
-      "VoltageUnbalanceAB, VoltageUnbalanceBC, VoltageUnbalanceCA, VoltageUnbalanceLLWorst, "
-      "VoltageUnbalanceAN, VoltageUnbalanceBN, VoltageUnbalanceCN, VoltageUnbalanceLNWorst, "
-      "DisplacementPowerFactorA, DisplacementPowerFactorB, DisplacementPowerFactorC, DisplacementPowerFactorTotal, "
-      "ActiveEnergyDeliveredIntoLoad64, ActiveEnergyReceivedOutofLoad64, ActiveEnergyDeliveredPlussReceived64, ActiveEnergyDeliveredDelReceived64) "
-      "VALUES (strftime('%s', 'now'), "
-      "?, ?, " // gateway_ip, unit_id (2)
-      "?, ?, ?, ?, " // voltages (4)
-      "?, ?, ?, ?, " // currents (4)
-      "?, ?, ?, "    // powers (3)
-      "?, ?, ?, "    // pf, freq, energy (3)
-      "?, ?, ?, ?, ?, " // energy history (5)
-      "?, ?, ?, ?, ?, " // unbalance/energy1 (5)
-      "?, ?, ?, "       // active energy +/- (3)
-      "?, ?, ?, ?, "    // reactive energy (4)
-      "?, ?, ?, ?, "    // apparent energy (4)
-      "?, ?, ?, ?, ?, ?, " // active/reactive power A,B,C (6)
-      "?, ?, ?, ?, ?, ?, " // apparent/pf A,B,C (6)
-      "?, ?, ?, ?, ?, " // power demand (5)
-      "?, ?, ?, ?, ?, " // current demand (5)
-      "?, ?, ?, ?, "    // voltage LL (4)
-      "?, ?, ?, ?, "    // voltage unbalance LL (4)
-      "?, ?, ?, ?, "    // voltage unbalance LN (4)
-      "?, ?, ?, ?, "    // displacement PF (4)
-      "?, ?, ?, ?);";   // energy 64-bit (4)
-
-  if (sqlite3_prepare_v2(db, sqlInsert, -1, &stmtInsert, 0) != SQLITE_OK) {
+  if (sqlite3_prepare_v2(db, PM_INSERT_SQL.c_str(), -1, &stmtInsert, 0) != SQLITE_OK) {
     std::cerr << "SQL Prepare Insert Error: " << sqlite3_errmsg(db)
               << std::endl;
     if (stmtHistory)
       sqlite3_finalize(stmtHistory);
-    sqlite3_close(db);
     return;
   }
 
   // 4. Loop through IDs
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  const std::string gateway = ipAddr + ":" + std::to_string(port);
+  metrics.pollQueueDepth.fetch_add(ids.size(), std::memory_order_relaxed);
+
   for (int unitId : ids) {
     std::cout << "\nStarting Monitor iPM2xxx (Device " << unitId << ")..."
               << std::endl;
+    TRACE_SCOPE("poll", "device", unitId);
     std::unique_ptr<iPM2xxx> client;
     bool connected = false;
+    bool stored = false;
+
+    DeviceHealth *health = metrics.device(gateway, unitId, "iPM2xxx");
+    health->polls.fetch_add(1, std::memory_order_relaxed);
+    health->lastPollMs.store(PipelineMetrics::wallMs(),
+                             std::memory_order_relaxed);
+
+    // Dead unit: one probe per backoff window instead of a timeout per read
+    CircuitBreaker *breaker = CircuitBreakers::instance().breaker(gateway, unitId);
+    if (breaker->skipPoll()) {
+      std::cerr << "Skipping Device " << unitId << " (circuit open, next probe in "
+                << breaker->retryInMs() / 1000 << " s)" << std::endl;
+      health->failures.fetch_add(1, std::memory_order_relaxed);
+      metrics.pollQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+      continue;
+    }
 
     // Retry logic
     for (int j = 0; j < 3; j++) {
+      TRACE_SCOPE("poll", "connect", j);
       client = iPM2xxx::createClient(unitId, ipAddr, port);
       if (client->isConnected()) {
         std::cout << "Port Opened Successfully (Device " << unitId << ")."
@@ -283,225 +243,147 @@ inline void Read_iPM2xxx(const std::vector<int> &ids, const std::string &ipAddr,
       std::cout << "----------------------------------------" << std::endl;
       std::cout << "Reading Device " << unitId << "..." << std::endl;
 
+      // --- Nameplate (read once, revalidated by 2 change indicators) ---
+      PMNameplate nameplate;
+      Refresh_Nameplate(db, *client, ipAddr, unitId, nameplate);
+
       // --- Read Values ---
-      // Voltage
-      float vA = client->Read_VoltageAN();
-      float vB = client->Read_VoltageBN();
-      float vC = client->Read_VoltageCN();
-      float vAvg = client->Read_VoltageLNAvg();
-
-      // Current
-      float cA = client->Read_CurrentA();
-      float cB = client->Read_CurrentB();
-      float cC = client->Read_CurrentC();
-      float cAvg = client->Read_CurrentAvg();
-      
-
-      // Power
-      float pTotal = client->Read_ActivePowerTotal();
-      float qTotal = client->Read_ReactivePowerTotal();
-      float sTotal = client->Read_ApparentPowerTotal();
-
-      // Basics
-      float pf = client->Read_PowerFactorTotal();
-      float freq = client->Read_Frequency();
+      // Snapshot group: every V/I/P/Q/S/PF value of the meter comes from one
+      // acquisition of 2999..3110, so a row never mixes instants.
+      BlockSnapshot inst;
+      {
+        TRACE_SCOPE("poll", "snapshot", unitId);
+        inst = BlockSnapshot::read(*client, PM_INSTANT_BLOCK.start,
+                                   PM_INSTANT_BLOCK.count);
+      }
+
+      // Energy registers: one acquisition each for the float and 64-bit sets
+      BlockSnapshot energyF = BlockSnapshot::read(
+          *client, PM_ENERGY_FLOAT_BLOCK.start, PM_ENERGY_FLOAT_BLOCK.count);
+      BlockSnapshot energy64 = BlockSnapshot::read(
+          *client, PM_ENERGY_U64_BLOCK.start, PM_ENERGY_U64_BLOCK.count);
+
+      // Same blocks, kept in RAM for the Modbus façade
+      LiveImage *live = LiveImages::instance().image(
+          gateway, unitId, "iPM2xxx",
+          {PM_INSTANT_BLOCK, PM_ENERGY_FLOAT_BLOCK, PM_ENERGY_U64_BLOCK});
+      live->publish(0, inst);
+      live->publish(1, energyF);
+      live->publish(2, energy64);
+
+      // --- Build the row ---
+      // Every register column comes from PM_CHANNELS in one loop; the rest
+      // is set by name, checked against PM_COLUMNS at compile time.
+      PMRow row;
+      fill_pm_channels(row, {&inst, &energyF, &energy64});
+
+      const int64_t acquiredSec = inst.acquired.wallMs / 1000;
+      row.set<pm_col("timestamp")>(acquiredSec);
+      row.set<pm_col("gateway_ip")>(ipAddr.c_str());
+      row.set<pm_col("unit_id")>(unitId);
 
       // Energy (64-bit)
-      int64_t energy = client->Read_ActiveEnergy_Total();
-
-     
-
-      // History
-      int64_t last_1M = get_historical_energy_pm(stmtHistory, unitId, ipAddr, 60);
-      int64_t last_5M = get_historical_energy_pm(stmtHistory, unitId, ipAddr, 300);
-      int64_t last_30M = get_historical_energy_pm(stmtHistory, unitId, ipAddr, 1800);
-      int64_t last_1H = get_historical_energy_pm(stmtHistory, unitId, ipAddr, 3600);
-      int64_t last_2H = get_historical_energy_pm(stmtHistory, unitId, ipAddr, 7200);
-
-      // Energy (Float 32-bit)
-      float energy1 = client->Read_ActiveEnergyDeliveredIntoLoad();
-      float cUnbA = client->Read_CurrentUnbalanceA();
-      float cUnbB = client->Read_CurrentUnbalanceB();
-      float cUnbC = client->Read_CurrentUnbalanceC();
-      float ActiveEnergyReceived_OutofLoad = client->Read_ActiveEnergyReceivedOutOfLoad();
-      float cUnbWorst = client->Read_CurrentUnbalanceWorst();
-      float ActiveEnergyDeliveredPlussReceived = client->Read_ActiveEnergyDeliveredPlusReceived();
-      float ActiveEnergyDeliveredDelReceived = client->Read_ActiveEnergyDeliveredReceived();
-      float ReactiveEnergyDelivered = client->Read_ReactiveEnergyDelivered();
-      float ReactiveEnergyReceived = client->Read_ReactiveEnergyReceived();
-      float ReactiveEnergyDeliveredPlussReceived = client->Read_ReactiveEnergyDeliveredPlusReceived();
-      float ReactiveEnergyDeliveredDelReceived = client->Read_ReactiveEnergyDeliveredReceived();
-      float ApparentEnergyDelivered = client->Read_ApparentEnergyDelivered();
-      float ApparentEnergyReceived = client->Read_ApparentEnergyReceived();
-      float ApparentEnergyDeliveredPlussReceived = client->Read_ApparentEnergyDeliveredPlusReceived();
-      float ApparentEnergyDeliveredDelReceived = client->Read_ApparentEnergyDeliveredReceived();
-      float ApparentPowerA = client->Read_ApparentPowerA();
-      float ApparentPowerB = client->Read_ApparentPowerB();
-      float ApparentPowerC = client->Read_ApparentPowerC();
-      float ActivePowerA = client->Read_ActivePowerA();
-      float ActivePowerB = client->Read_ActivePowerB();
-      float ActivePowerC = client->Read_ActivePowerC();
-      float ReactivePowerA = client->Read_ReactivePowerA();
-      float ReactivePowerB = client->Read_ReactivePowerB();
-      float ReactivePowerC = client->Read_ReactivePowerC();
-      float PowerFactorA = client->Read_PowerFactorA();
-      float PowerFactorB = client->Read_PowerFactorB();
-      float PowerFactorC = client->Read_PowerFactorC();
-      uint16_t PowerDemandMethod = client->Read_PowerDemandMethod();
-      uint16_t PowerDemandIntervalDuration = client->Read_PowerDemandIntervalDuration();
-      uint16_t PowerDemandSubintervalDuration = client->Read_PowerDemandSubintervalDuration();
-      uint16_t PowerDemandElapsedTimeinInterval = client->Read_PowerDemandElapsedTimeInInterval();
-      uint16_t PowerDemandElapsedTimeinSubinterval = client->Read_PowerDemandElapsedTimeInSubinterval();
-      uint16_t CurrentDemandMethod = client->Read_CurrentDemandMethod();
-      uint16_t CurrentDemandIntervalDuration = client->Read_CurrentDemandIntervalDuration();
-      uint16_t CurrentDemandElapsedTimein = client->Read_CurrentDemandElapsedTimeInInterval();
-      uint16_t CurrentDemandSubintervalDuration = client->Read_CurrentDemandSubintervalDuration();
-      uint16_t CurrentDemandElapsedTimeinInterval = client->Read_CurrentDemandElapsedTimeInInterval();
-      float VoltageAB = client->Read_VoltageAB();
-      float VoltageBC = client->Read_VoltageBC();
-      float VoltageCA = client->Read_VoltageCA();
-      float VoltageLLAvg = client->Read_VoltageLLAvg();
-      float VoltageUnbalanceAB = client->Read_VoltageUnbalanceAB();
-      float VoltageUnbalanceBC = client->Read_VoltageUnbalanceBC();
-      float VoltageUnbalanceCA = client->Read_VoltageUnbalanceCA();
-      float VoltageUnbalanceLLWorst = client->Read_VoltageUnbalanceLLWorst();
-      float VoltageUnbalanceAN = client->Read_VoltageUnbalanceAN();
-      float VoltageUnbalanceBN = client->Read_VoltageUnbalanceBN();
-      float VoltageUnbalanceCN = client->Read_VoltageUnbalanceCN();
-      float VoltageUnbalanceLNWorst = client->Read_VoltageUnbalanceLNWorst();
-      float DisplacementPowerFactorA = client->Read_DisplacementPowerFactorA();
-      float DisplacementPowerFactorB = client->Read_DisplacementPowerFactorB();
-      float DisplacementPowerFactorC = client->Read_DisplacementPowerFactorC();
-      float DisplacementPowerFactorTotal = client->Read_DisplacementPowerFactorTotal();
-
-      int64_t ActiveEnergyDeliveredIntoLoad64 = client->Read_ActiveEnergy_Delivered();
-      int64_t ActiveEnergyReceivedOutofLoad64 = client->Read_ActiveEnergy_Received();
-      int64_t ActiveEnergyDeliveredPlussReceived64 = client->Read_ActiveEnergy_Total();
-      int64_t ActiveEnergyDeliveredDelReceived64 = client->Read_ActiveEnergy_DeliveredReceived();
+      int64_t energy = energy64.get<uint64_t>(3211);
+      row.set<pm_col("total_energy")>(energy);
 
+      // History, relative to when the snapshot was taken
+      row.set<pm_col("total_energy_last_1M")>(get_historical_energy_pm(stmtHistory, unitId, ipAddr, acquiredSec, 60));
+      row.set<pm_col("total_energy_last_5M")>(get_historical_energy_pm(stmtHistory, unitId, ipAddr, acquiredSec, 300));
+      row.set<pm_col("total_energy_last_30M")>(get_historical_energy_pm(stmtHistory, unitId, ipAddr, acquiredSec, 1800));
+      row.set<pm_col("total_energy_last_1H")>(get_historical_energy_pm(stmtHistory, unitId, ipAddr, acquiredSec, 3600));
+      row.set<pm_col("total_energy_last_2H")>(get_historical_energy_pm(stmtHistory, unitId, ipAddr, acquiredSec, 7200));
 
+      // Outside the snapshot blocks
+      row.set<pm_col("ReactiveEnergyDeliveredDelReceived")>(safe_float_pm(client->Read_ReactiveEnergyDeliveredReceived()));
+      row.set<pm_col("ApparentEnergyDeliveredDelReceived")>(safe_float_pm(client->Read_ApparentEnergyDeliveredReceived()));
+
+      // Demand setup is static: served from the nameplate cache
+      uint16_t CurrentDemandElapsedTimein = client->Read_CurrentDemandElapsedTimeInInterval();
+      row.set<pm_col("PowerDemandMethod")>(nameplate.powerDemandMethod);
+      row.set<pm_col("PowerDemandIntervalDuration")>(nameplate.powerDemandInterval);
+      row.set<pm_col("PowerDemandSubintervalDuration")>(nameplate.powerDemandSubinterval);
+      row.set<pm_col("PowerDemandElapsedTimeinInterval")>(client->Read_PowerDemandElapsedTimeInInterval());
+      row.set<pm_col("PowerDemandElapsedTimeinSubinterval")>(client->Read_PowerDemandElapsedTimeInSubinterval());
+      row.set<pm_col("CurrentDemandMethod")>(nameplate.currentDemandMethod);
+      row.set<pm_col("CurrentDemandIntervalDuration")>(nameplate.currentDemandInterval);
+      row.set<pm_col("CurrentDemandElapsedTimein")>(CurrentDemandElapsedTimein);
+      row.set<pm_col("CurrentDemandSubintervalDuration")>(nameplate.currentDemandSubinterval);
+      row.set<pm_col("CurrentDemandElapsedTimeinInterval")>(CurrentDemandElapsedTimein);
+
+      row.set<pm_col("acquired_ms")>(inst.acquired.wallMs);
+      row.set<pm_col("acquisition_us")>(inst.durationUs);
 
       // --- Print to Console ---
-      std::cout << "Voltage (L-N): A=" << vA << ", B=" << vB << ", C=" << vC
-                << " V" << std::endl;
-      std::cout << "Current: A=" << cA << ", B=" << cB << ", C=" << cC << " A"
-                << std::endl;
-      std::cout << "Power: Active=" << pTotal << " W, Reactive=" << qTotal
-                << " VAR, Apparent=" << sTotal << " VA" << std::endl;
-      std::cout << "Power Factor: " << pf << ", Freq: " << freq << " Hz"
+      std::cout << "Snapshot: " << inst.durationUs / 1000.0 << " ms"
+                << (inst.ok() ? "" : " (failed)") << std::endl;
+      std::cout << "Voltage (L-N): A=" << row.get<pm_col("voltage_a")>()
+                << ", B=" << row.get<pm_col("voltage_b")>()
+                << ", C=" << row.get<pm_col("voltage_c")>() << " V" << std::endl;
+      std::cout << "Current: A=" << row.get<pm_col("current_a")>()
+                << ", B=" << row.get<pm_col("current_b")>()
+                << ", C=" << row.get<pm_col("current_c")>() << " A" << std::endl;
+      std::cout << "Power: Active=" << row.get<pm_col("active_power_total")>()
+                << " W, Reactive=" << row.get<pm_col("reactive_power_total")>()
+                << " VAR, Apparent=" << row.get<pm_col("apparent_power_total")>()
+                << " VA" << std::endl;
+      std::cout << "Power Factor: " << row.get<pm_col("power_factor_total")>()
+                << ", Freq: " << row.get<pm_col("frequency")>() << " Hz"
                 << std::endl;
       std::cout << "Total Energy: " << energy << " Wh" << std::endl;
-      std::cout << "  - Last 1M: " << last_1M << " Wh" << std::endl;
-      std::cout << "  - Last 5M: " << last_5M << " Wh" << std::endl;
-      std::cout << "  - Last 30M: " << last_30M << " Wh" << std::endl;
-      std::cout << "  - Last 1H: " << last_1H << " Wh" << std::endl;
-      std::cout << "  - Last 2H: " << last_2H << " Wh" << std::endl;
-      std::cout << "Active Energy Delivered Into Load: " << energy1 << " Wh"
+      std::cout << "  - Last 1M: " << row.get<pm_col("total_energy_last_1M")>() << " Wh" << std::endl;
+      std::cout << "  - Last 5M: " << row.get<pm_col("total_energy_last_5M")>() << " Wh" << std::endl;
+      std::cout << "  - Last 30M: " << row.get<pm_col("total_energy_last_30M")>() << " Wh" << std::endl;
+      std::cout << "  - Last 1H: " << row.get<pm_col("total_energy_last_1H")>() << " Wh" << std::endl;
+      std::cout << "  - Last 2H: " << row.get<pm_col("total_energy_last_2H")>() << " Wh" << std::endl;
+      std::cout << "Active Energy Delivered Into Load: " << row.get<pm_col("ActiveEnergyDeliveredIntoLoad")>() << " Wh"
                 << std::endl;
-      std::cout << "Current Unbalance: A=" << cUnbA << "%, B=" << cUnbB
-                << "%, C=" << cUnbC << "%, Worst=" << cUnbWorst << "%" << std::endl;
-      std::cout << "Active Energy Received Out of Load: " << ActiveEnergyReceived_OutofLoad << " Wh" << std::endl;
-      std::cout << "Active Energy Delivered Plus Received: " << ActiveEnergyDeliveredPlussReceived << " Wh" << std::endl;
-      std::cout << "Active Energy Delivered Delivered Received: " << ActiveEnergyDeliveredDelReceived << " Wh" << std::endl;
-      std::cout << "Reactive Energy Delivered: " << ReactiveEnergyDelivered << " VARh" << std::endl;
-      std::cout << "Reactive Energy Received: " << ReactiveEnergyReceived << " VARh" << std::endl;
+      std::cout << "Current Unbalance: A=" << row.get<pm_col("current_unbalanceA")>()
+                << "%, B=" << row.get<pm_col("current_unbalanceB")>()
+                << "%, C=" << row.get<pm_col("current_unbalanceC")>()
+                << "%, Worst=" << row.get<pm_col("current_unbalanceWorst")>() << "%" << std::endl;
+      std::cout << "Active Energy Received Out of Load: " << row.get<pm_col("ActiveEnergyReceived_OutofLoad")>() << " Wh" << std::endl;
+      std::cout << "Active Energy Delivered Plus Received: " << row.get<pm_col("ActiveEnergyDeliveredPlussReceived")>() << " Wh" << std::endl;
+      std::cout << "Active Energy Delivered Delivered Received: " << row.get<pm_col("ActiveEnergyDeliveredDelReceived")>() << " Wh" << std::endl;
+      std::cout << "Reactive Energy Delivered: " << row.get<pm_col("ReactiveEnergyDelivered")>() << " VARh" << std::endl;
+      std::cout << "Reactive Energy Received: " << row.get<pm_col("ReactiveEnergyReceived")>() << " VARh" << std::endl;
 
       // --- Insert to DB ---
-      sqlite3_reset(stmtInsert);
-      int idx = 1;
-      sqlite3_bind_text(stmtInsert, idx++, ipAddr.c_str(), -1, SQLITE_STATIC); // Gateway IP
-      sqlite3_bind_int(stmtInsert, idx++, unitId);
-      // Voltage
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(vA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(vB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(vC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(vAvg));
-      // Current
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cAvg));
-      // Power
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(pTotal));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(qTotal));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(sTotal));
-      // Basics
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(pf));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(freq));
-      // Energy
-      sqlite3_bind_int64(stmtInsert, idx++, energy);
-      
-      // History
-      sqlite3_bind_int64(stmtInsert, idx++, last_1M);
-      sqlite3_bind_int64(stmtInsert, idx++, last_5M);
-      sqlite3_bind_int64(stmtInsert, idx++, last_30M);
-      sqlite3_bind_int64(stmtInsert, idx++, last_1H);
-      sqlite3_bind_int64(stmtInsert, idx++, last_2H);
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(energy1));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cUnbA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cUnbB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cUnbC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(cUnbWorst));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ActiveEnergyReceived_OutofLoad));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ActiveEnergyDeliveredPlussReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ActiveEnergyDeliveredDelReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ReactiveEnergyDelivered));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ReactiveEnergyReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ReactiveEnergyDeliveredPlussReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ReactiveEnergyDeliveredDelReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ApparentEnergyDelivered));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ApparentEnergyReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ApparentEnergyDeliveredPlussReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ApparentEnergyDeliveredDelReceived));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ActivePowerA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ActivePowerB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ActivePowerC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ReactivePowerA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ReactivePowerB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ReactivePowerC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ApparentPowerA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ApparentPowerB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(ApparentPowerC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(PowerFactorA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(PowerFactorB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(PowerFactorC));
-      sqlite3_bind_int(stmtInsert, idx++, PowerDemandMethod);
-      sqlite3_bind_int(stmtInsert, idx++, PowerDemandIntervalDuration);
-      sqlite3_bind_int(stmtInsert, idx++, PowerDemandSubintervalDuration);
-      sqlite3_bind_int(stmtInsert, idx++, PowerDemandElapsedTimeinInterval);
-      sqlite3_bind_int(stmtInsert, idx++, PowerDemandElapsedTimeinSubinterval);
-      sqlite3_bind_int(stmtInsert, idx++, CurrentDemandMethod);
-      sqlite3_bind_int(stmtInsert, idx++, CurrentDemandIntervalDuration);
-      sqlite3_bind_int(stmtInsert, idx++, CurrentDemandElapsedTimein);
-      sqlite3_bind_int(stmtInsert, idx++, CurrentDemandSubintervalDuration);
-      sqlite3_bind_int(stmtInsert, idx++, CurrentDemandElapsedTimeinInterval);
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageAB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageBC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageCA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageLLAvg));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceAB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceBC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceCA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceLLWorst));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceAN));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceBN));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceCN));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(VoltageUnbalanceLNWorst));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(DisplacementPowerFactorA));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(DisplacementPowerFactorB));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(DisplacementPowerFactorC));
-      sqlite3_bind_double(stmtInsert, idx++, safe_float_pm(DisplacementPowerFactorTotal));
-      sqlite3_bind_int64(stmtInsert, idx++, ActiveEnergyDeliveredIntoLoad64);
-      sqlite3_bind_int64(stmtInsert, idx++, ActiveEnergyReceivedOutofLoad64);
-      sqlite3_bind_int64(stmtInsert, idx++, ActiveEnergyDeliveredPlussReceived64);
-      sqlite3_bind_int64(stmtInsert, idx++, ActiveEnergyDeliveredDelReceived64);
-
-      if (sqlite3_step(stmtInsert) != SQLITE_DONE) {
-        std::cerr << "SQL Insert Error: " << sqlite3_errmsg(db) << std::endl;
-      } else {
-        std::cout << "Data saved to SQLite (readings_pm2xxx)." << std::endl;
-        std::cout << "----------------------------------------"
+      row.bind(stmtInsert);
+
+      if (breaker->state() == CircuitBreaker::Open) {
+        // Tripped during this poll: the values above are fail-fast zeros
+        std::cerr << "Device " << unitId << " stopped answering, row not stored"
                   << std::endl;
+      } else {
+        {
+          TRACE_SCOPE("store", "insert", unitId);
+          ScopedLatency commit(metrics.sqliteCommit);
+          rc = sqlite3_step(stmtInsert);
+        }
+        if (rc != SQLITE_DONE) {
+          std::cerr << "SQL Insert Error: " << sqlite3_errmsg(db) << std::endl;
+          metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          std::cout << "Data saved to SQLite (readings_pm2xxx)." << std::endl;
+          if (channels)
+            channels->append(
+                channels->unitKey(ipAddr, unitId, "iPM2xxx"),
+                inst.acquired.wallMs,
+                collect_channels(PM_CHANNELS, {&inst, &energyF, &energy64}));
+          if (raw)
+            raw->append(raw->unitKey(ipAddr, unitId, "iPM2xxx"),
+                        inst.acquired.wallMs, PM_MAP_VERSION,
+                        {&inst, &energyF, &energy64});
+          std::cout << "----------------------------------------"
+                    << std::endl;
+          stored = client->readErrors() == 0;
+        }
+
+        // --- Harmonics / THD burst (own, slower schedule) ---
+        Refresh_Harmonics(db, *client, ipAddr, unitId);
+
+        // --- Meter min/max (stored only when an extreme moves) ---
+        Refresh_MinMax(db, *client, ipAddr, unitId);
       }
 
       client->Disconnect();
@@ -509,12 +391,18 @@ inline void Read_iPM2xxx(const std::vector<int> &ids, const std::string &ipAddr,
       std::cerr << "Skipping Device " << unitId << " (Not Connected)"
                 << std::endl;
     }
+
+    if (stored)
+      health->lastOkMs.store(PipelineMetrics::wallMs(),
+                             std::memory_order_relaxed);
+    else
+      health->failures.fetch_add(1, std::memory_order_relaxed);
+    metrics.pollQueueDepth.fetch_sub(1, std::memory_order_relaxed);
   }
   if (stmtHistory)
     sqlite3_finalize(stmtHistory);
   if (stmtInsert)
     sqlite3_finalize(stmtInsert);
-  sqlite3_close(db);
 }
 
 #endif // READ_IPM2XXX_H
@@ -0,0 +1,98 @@
+#ifndef RUN_CYCLE_H
+#define RUN_CYCLE_H
+
+#include "Publish_Telemetry.h"
+#include "Read_iA9MEM15.h"
+#include "Read_iPM2xxx.h"
+#include "Sync_HistoryLog.h"
+#include "ThingsBoardClient.h"
+#include "pipeline_metrics.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+// Meters polled through one gateway.
+struct CycleGateway {
+  std::string ip;
+  int port = 502;
+  std::vector<int> a9Units; // iA9MEM15
+  std::vector<int> pmUnits; // iPM2xxx
+};
+
+// Rows each publish stage sends per cycle; defaults are the stages' own.
+struct CycleLimits {
+  int a9Rows = 100;
+  int pmRows = 5;
+  int harmonics = 20;
+  int minMax = 100;
+  int historyLog = 500;
+};
+
+struct CycleTiming {
+  uint64_t pollUs = 0;    // Read_*, Sync_HistoryLog and afterPoll
+  uint64_t publishUs = 0; // Publish_*
+};
+
+// One poll + publish cycle of the service, so the benchmark measures the
+// same stage list main.cpp runs:
+//
+//   per gateway  Read_iA9MEM15, Read_iPM2xxx (refreshes nameplate, harmonics
+//                and min/max when due), Sync_HistoryLog (backfill priority,
+//                due units only)
+//   afterPoll    e.g. façade mapping of devices seen for the first time
+//   publish      Publish_iA9MEM15, Publish_iPM2xxx (+ rollups on `boundary`),
+//                Publish_Nameplate, Publish_Harmonics, Publish_MinMax,
+//                Publish_HistoryLog
+//
+// The cycle duration goes to PipelineMetrics (pollCycle, lastPollCycleUs).
+inline CycleTiming Run_Cycle(const std::vector<CycleGateway> &gateways,
+                             sqlite3 *dbA9, sqlite3 *dbPM,
+                             ThingsBoardClient &tb,
+                             const RollupBoundary &boundary,
+                             const CycleLimits &limits = {},
+                             const std::function<void()> &afterPoll = {}) {
+  using Clock = std::chrono::steady_clock;
+  auto elapsedUs = [](Clock::time_point from, Clock::time_point to) {
+    return uint64_t(
+        std::chrono::duration_cast<std::chrono::microseconds>(to - from)
+            .count());
+  };
+  TraceSpan cycleSpan("cycle", "cycle");
+  auto start = Clock::now();
+
+  for (const CycleGateway &g : gateways) {
+    if (!g.a9Units.empty())
+      Read_iA9MEM15(g.a9Units, g.ip, g.port);
+    if (!g.pmUnits.empty()) {
+      Read_iPM2xxx(g.pmUnits, g.ip, g.port);
+      Sync_HistoryLog(g.pmUnits, g.ip, g.port);
+    }
+  }
+  if (afterPoll)
+    afterPoll();
+  auto polled = Clock::now();
+
+  /* ===== iA9MEM15 ===== */
+  Publish_iA9MEM15(dbA9, tb, limits.a9Rows);
+
+  /* ===== iPM2xxx ===== */
+  Publish_iPM2xxx(dbPM, tb, boundary, limits.pmRows);
+  Publish_Nameplate(dbPM, tb);                     // only new/changed nameplates
+  Publish_Harmonics(dbPM, tb, limits.harmonics);   // THD + H1..H31 arrays
+  Publish_MinMax(dbPM, tb, limits.minMax);         // new meter extremes only
+  Publish_HistoryLog(dbPM, tb, limits.historyLog); // backfilled records
+
+  CycleTiming timing{elapsedUs(start, polled), elapsedUs(polled, Clock::now())};
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  metrics.pollCycle.record(timing.pollUs + timing.publishUs);
+  metrics.lastPollCycleUs.store(timing.pollUs + timing.publishUs);
+  cycleSpan.end();
+  return timing;
+}
+
+#endif // RUN_CYCLE_H
@@ -0,0 +1,347 @@
+#ifndef SYNC_HISTORY_LOG_H
+#define SYNC_HISTORY_LOG_H
+
+#include "block_snapshot.h"
+#include "iPM2xxx.h"
+#include "meter_datetime.h"
+#include "pipeline_metrics.h"
+#include "storage.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+// History log window of the iPM2xxx map: a header (size of the log, entries
+// in it, entry number of the most recent one) followed by a ring of
+// fixed-size entries:
+//
+//   +0 Entry Number   +1..+4 Date/Time   +5 Record Type
+//   +6 Register Number or Event Code     +7..+10 Value   +11 Sequence Number
+constexpr RegisterBlock PM_LOG_HEADER_BLOCK{12315, 3};
+constexpr uint16_t PM_LOG_FIRST_ENTRY = 12318;
+constexpr uint16_t PM_LOG_ENTRY_WORDS = 12;
+// Data log setup: Logging Status (18999) .. Interval Control Seconds (19011)
+constexpr RegisterBlock PM_LOG_SETUP_BLOCK{18999, 13};
+
+// Sync cadence when the meter reports no logging interval.
+constexpr int64_t LOG_SYNC_DEFAULT_INTERVAL_SEC = 15 * 60;
+
+struct PMLogRecord {
+  uint16_t entry = 0;
+  int64_t tsMs = -1; // meter clock, -1 if the date/time is invalid
+  uint16_t recordType = 0;
+  uint16_t reg = 0; // register number or event code
+  int64_t value = 0;
+  uint16_t seq = 0;
+};
+
+// Sync position of one meter, persisted in log_sync_pm2xxx.
+struct PMLogSyncState {
+  bool known = false;     // false until the first sync
+  uint16_t lastEntry = 0; // entry number of the newest record fetched
+  uint16_t lastSeq = 0;   // its sequence number
+  int64_t intervalSec = LOG_SYNC_DEFAULT_INTERVAL_SEC;
+  int64_t syncedAt = 0; // epoch s of the last sync
+  int64_t records = 0;  // fetched so far
+  int64_t lost = 0;     // overwritten on the meter before we got to them
+};
+
+inline PMLogRecord decode_log_entry(const uint16_t *r) {
+  PMLogRecord rec;
+  rec.entry = r[0];
+  rec.tsMs = decode_meter_datetime(r + 1);
+  rec.recordType = r[5];
+  rec.reg = r[6];
+  rec.value = int64_t(RegisterCodec<uint64_t>::decode(r + 7));
+  rec.seq = r[11];
+  return rec;
+}
+
+// Sequence numbers are 16-bit and wrap.
+inline bool log_seq_after(uint16_t seq, uint16_t than) {
+  return int16_t(uint16_t(seq - than)) > 0;
+}
+
+inline void SetupHistoryLogTables(sqlite3 *db) {
+  char *errMsg = 0;
+  const char *sql =
+      "CREATE TABLE IF NOT EXISTS history_log_pm2xxx ("
+      "gateway_ip TEXT, "
+      "unit_id INTEGER, "
+      "ts_ms INTEGER, "
+      "seq_no INTEGER, "
+      "entry INTEGER, "
+      "record_type INTEGER, "
+      "register INTEGER, "
+      "value INTEGER, "
+      "published INTEGER DEFAULT 0, "
+      "PRIMARY KEY (gateway_ip, unit_id, ts_ms, seq_no)"
+      ");"
+      "CREATE INDEX IF NOT EXISTS idx_history_log_unpublished "
+      "ON history_log_pm2xxx(published) WHERE published = 0;"
+      "CREATE TABLE IF NOT EXISTS log_sync_pm2xxx ("
+      "gateway_ip TEXT, "
+      "unit_id INTEGER, "
+      "last_entry INTEGER, "
+      "last_seq INTEGER, "
+      "interval_sec INTEGER, "
+      "synced_at INTEGER, "
+      "records INTEGER DEFAULT 0, "
+      "lost INTEGER DEFAULT 0, "
+      "PRIMARY KEY (gateway_ip, unit_id)"
+      ");";
+  if (sqlite3_exec(db, sql, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (create table history_log): " << errMsg
+              << std::endl;
+    sqlite3_free(errMsg);
+  }
+}
+
+inline PMLogSyncState Load_LogSyncState(sqlite3 *db,
+                                        const std::string &gateway_ip,
+                                        int unit_id) {
+  PMLogSyncState st;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT last_entry, last_seq, interval_sec, "
+                         "synced_at, records, lost FROM log_sync_pm2xxx "
+                         "WHERE gateway_ip = ? AND unit_id = ?;",
+                         -1, &stmt, 0) != SQLITE_OK)
+    return st;
+  sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, unit_id);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    st.known = true;
+    st.lastEntry = uint16_t(sqlite3_column_int(stmt, 0));
+    st.lastSeq = uint16_t(sqlite3_column_int(stmt, 1));
+    st.intervalSec = sqlite3_column_int64(stmt, 2);
+    st.syncedAt = sqlite3_column_int64(stmt, 3);
+    st.records = sqlite3_column_int64(stmt, 4);
+    st.lost = sqlite3_column_int64(stmt, 5);
+  }
+  sqlite3_finalize(stmt);
+  return st;
+}
+
+// Merges `records` and the new sync position in one transaction, so a crash
+// can neither lose fetched records nor fetch them twice. Records already
+// stored (same timestamp and sequence number) are left alone.
+inline bool Store_LogRecords(sqlite3 *db, const std::string &gateway_ip,
+                             int unit_id,
+                             const std::vector<PMLogRecord> &records,
+                             const PMLogSyncState &st) {
+  TRACE_SCOPE("store", "history_log", unit_id);
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  ScopedLatency commit(metrics.sqliteCommit);
+
+  sqlite3_exec(db, "BEGIN;", 0, 0, 0);
+  bool ok = true;
+  sqlite3_stmt *ins = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "INSERT OR IGNORE INTO history_log_pm2xxx ("
+                         "gateway_ip, unit_id, ts_ms, seq_no, entry, "
+                         "record_type, register, value) "
+                         "VALUES (?, ?, ?, ?, ?, ?, ?, ?);",
+                         -1, &ins, 0) != SQLITE_OK)
+    ok = false;
+  for (size_t i = 0; ok && i < records.size(); i++) {
+    const PMLogRecord &r = records[i];
+    sqlite3_bind_text(ins, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(ins, 2, unit_id);
+    sqlite3_bind_int64(ins, 3, r.tsMs);
+    sqlite3_bind_int(ins, 4, r.seq);
+    sqlite3_bind_int(ins, 5, r.entry);
+    sqlite3_bind_int(ins, 6, r.recordType);
+    sqlite3_bind_int(ins, 7, r.reg);
+    sqlite3_bind_int64(ins, 8, r.value);
+    ok = sqlite3_step(ins) == SQLITE_DONE;
+    sqlite3_reset(ins);
+  }
+  sqlite3_finalize(ins);
+
+  sqlite3_stmt *pos = nullptr;
+  if (ok && sqlite3_prepare_v2(db,
+                               "INSERT OR REPLACE INTO log_sync_pm2xxx ("
+                               "gateway_ip, unit_id, last_entry, last_seq, "
+                               "interval_sec, synced_at, records, lost) "
+                               "VALUES (?, ?, ?, ?, ?, ?, ?, ?);",
+                               -1, &pos, 0) == SQLITE_OK) {
+    sqlite3_bind_text(pos, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(pos, 2, unit_id);
+    sqlite3_bind_int(pos, 3, st.lastEntry);
+    sqlite3_bind_int(pos, 4, st.lastSeq);
+    sqlite3_bind_int64(pos, 5, st.intervalSec);
+    sqlite3_bind_int64(pos, 6, st.syncedAt);
+    sqlite3_bind_int64(pos, 7, st.records);
+    sqlite3_bind_int64(pos, 8, st.lost);
+    ok = sqlite3_step(pos) == SQLITE_DONE;
+  } else {
+    ok = false;
+  }
+  sqlite3_finalize(pos);
+
+  if (!ok) {
+    std::cerr << "SQL error (history log): " << sqlite3_errmsg(db)
+              << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+    sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+    return false;
+  }
+  sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+  return true;
+}
+
+// Fetches the records added to the meter's log since the last sync.
+//
+// Costs three small reads (setup, header, newest sequence number) when nothing
+// is new. New entries end at the most-recent entry number and are read as
+// whole runs of the ring (at most two, split into <=125-register requests by readBlock), then
+// filtered by sequence number so a record is never taken twice. A gap in the
+// sequence means the ring wrapped while we were away; it is counted as lost.
+// Returns the number of new records, or -1 if the meter could not be read.
+inline int Sync_HistoryLog_Unit(sqlite3 *db, iPM2xxx &client,
+                                const std::string &gateway_ip, int unit_id,
+                                PMLogSyncState &st) {
+  TRACE_SCOPE("backfill", "history_log", unit_id);
+  BlockSnapshot setup = BlockSnapshot::read(client, PM_LOG_SETUP_BLOCK.start,
+                                            PM_LOG_SETUP_BLOCK.count);
+  BlockSnapshot header = BlockSnapshot::read(client, PM_LOG_HEADER_BLOCK.start,
+                                             PM_LOG_HEADER_BLOCK.count);
+  if (!header.ok())
+    return -1;
+
+  if (setup.ok()) {
+    int64_t interval = int64_t(setup.get<uint16_t>(19010)) * 60 +
+                       setup.get<uint16_t>(19011);
+    st.intervalSec = interval > 0 ? interval : LOG_SYNC_DEFAULT_INTERVAL_SEC;
+  }
+
+  uint16_t size = header.get<uint16_t>(12315);
+  uint16_t count = std::min(header.get<uint16_t>(12316), size);
+  uint16_t newest = header.get<uint16_t>(12317);
+  st.syncedAt = header.acquired.wallMs / 1000;
+
+  std::vector<PMLogRecord> fresh;
+  if (size > 0 && count > 0 && newest >= 1 && newest <= size) {
+    // How many entries are newer than the last sync: the entry number alone
+    // cannot tell "nothing new" from "a whole ring's worth", the sequence
+    // number of the most recent entry can.
+    uint16_t pending = count;
+    if (st.known) {
+      uint16_t newestSeq = 0;
+      if (!Modbus::StatusIsGood(client.readBlock(
+              uint16_t(PM_LOG_FIRST_ENTRY + (newest - 1) * PM_LOG_ENTRY_WORDS +
+                       11),
+              1, &newestSeq)))
+        return -1;
+      pending = log_seq_after(newestSeq, st.lastSeq)
+                    ? std::min(uint16_t(newestSeq - st.lastSeq), count)
+                    : 0;
+    }
+    uint16_t oldest = uint16_t((newest - pending + size) % size);
+
+    std::vector<uint16_t> regs;
+    for (uint16_t done = 0; done < pending;) {
+      uint16_t slot = uint16_t((oldest + done) % size);
+      uint16_t run = std::min<uint16_t>(pending - done, size - slot);
+      regs.assign(size_t(run) * PM_LOG_ENTRY_WORDS, 0);
+      if (!Modbus::StatusIsGood(client.readBlock(
+              uint16_t(PM_LOG_FIRST_ENTRY + slot * PM_LOG_ENTRY_WORDS),
+              uint16_t(regs.size()), regs.data())))
+        return -1; // position unchanged: retried next time
+      for (uint16_t i = 0; i < run; i++)
+        fresh.push_back(decode_log_entry(regs.data() + i * PM_LOG_ENTRY_WORDS));
+      done += run;
+    }
+  }
+
+  // Oldest first; drop anything not newer than what we already have
+  std::sort(fresh.begin(), fresh.end(),
+            [](const PMLogRecord &a, const PMLogRecord &b) {
+              return log_seq_after(b.seq, a.seq);
+            });
+  std::vector<PMLogRecord> records;
+  bool first = !st.known;
+  for (const PMLogRecord &r : fresh) {
+    if (!first && !log_seq_after(r.seq, st.lastSeq))
+      continue;
+    if (!first && r.seq != uint16_t(st.lastSeq + 1))
+      st.lost += uint16_t(r.seq - st.lastSeq - 1);
+    st.lastSeq = r.seq;
+    first = false;
+    if (r.tsMs < 0) {
+      std::cerr << "History log of Device " << unit_id << ": entry "
+                << r.entry << " has no valid date, skipped" << std::endl;
+      continue;
+    }
+    records.push_back(r);
+  }
+  st.lastEntry = newest;
+  st.known = true;
+  st.records += int64_t(records.size());
+
+  if (!Store_LogRecords(db, gateway_ip, unit_id, records, st))
+    return -1;
+  return int(records.size());
+}
+
+// Backfill pass over the history logs of `ids`.
+//
+// Runs at ModbusPriority::Backfill, so its reads only take gateway time the
+// poll loop leaves free, and only for units whose logging interval has
+// elapsed since their last sync. After an outage of the collector or the
+// network the first pass picks up every record the meter still holds.
+inline void Sync_HistoryLog(const std::vector<int> &ids,
+                            const std::string &ipAddr, int port) {
+  TRACE_SCOPE("backfill", "Sync_HistoryLog", port);
+  sqlite3 *db = Storage::instance().pm().writer();
+  if (!db)
+    return;
+  SetupHistoryLogTables(db);
+
+  const std::string gateway = ipAddr + ":" + std::to_string(port);
+  int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+
+  for (int unitId : ids) {
+    PMLogSyncState st = Load_LogSyncState(db, ipAddr, unitId);
+    if (st.known && now - st.syncedAt < st.intervalSec)
+      continue; // nothing new can have been logged yet
+    if (CircuitBreakers::instance().breaker(gateway, unitId)->skipPoll())
+      continue;
+
+    std::unique_ptr<iPM2xxx> client;
+    try {
+      client = iPM2xxx::createClient(unitId, ipAddr, port);
+    } catch (const std::exception &e) {
+      std::cerr << "History log of Device " << unitId << ": " << e.what()
+                << std::endl;
+      continue;
+    }
+    if (!client->isConnected())
+      continue;
+    client->setPriority(ModbusPriority::Backfill);
+
+    int64_t lostBefore = st.lost;
+    int n = Sync_HistoryLog_Unit(db, *client, ipAddr, unitId, st);
+    if (n < 0) {
+      std::cerr << "History log of Device " << unitId << " not readable"
+                << std::endl;
+    } else if (n > 0 || st.lost != lostBefore) {
+      std::cout << "History log of Device " << unitId << ": " << n
+                << " new record(s)";
+      if (st.lost != lostBefore)
+        std::cout << ", " << st.lost - lostBefore << " overwritten before sync";
+      std::cout << std::endl;
+    }
+    client->Disconnect();
+  }
+}
+
+#endif // SYNC_HISTORY_LOG_H
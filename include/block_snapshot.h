@@ -0,0 +1,96 @@
+#ifndef BLOCK_SNAPSHOT_H
+#define BLOCK_SNAPSHOT_H
+
+#include "register_decode.h"
+
+#include <Modbus.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/* ---------- Acquisition clock ---------- */
+
+// Timestamp of one acquisition on both clocks.
+//
+// wallMs is the steady clock shifted onto the epoch, so successive stamps are
+// monotonic and keep sub-millisecond spacing even while NTP slews the system
+// clock; two reads can never be reordered by a clock adjustment. The offset
+// is re-anchored when the two clocks drift more than a second apart (clock
+// set by hand, resume from suspend).
+struct AcquisitionTime {
+  int64_t steadyMs = 0;
+  int64_t wallMs = 0; // epoch ms
+
+  static AcquisitionTime now() {
+    using namespace std::chrono;
+    static std::atomic<int64_t> offsetMs{INT64_MIN};
+    AcquisitionTime t;
+    t.steadyMs =
+        duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+            .count();
+    int64_t sysMs =
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+            .count();
+    int64_t offset = offsetMs.load(std::memory_order_relaxed);
+    if (offset == INT64_MIN || std::llabs(t.steadyMs + offset - sysMs) > 1000) {
+      offset = sysMs - t.steadyMs;
+      offsetMs.store(offset, std::memory_order_relaxed);
+    }
+    t.wallMs = t.steadyMs + offset;
+    return t;
+  }
+};
+
+// Contiguous register range refreshed by one readBlock() call.
+struct RegisterBlock {
+  uint16_t start;
+  uint16_t count;
+};
+
+// One contiguous register range fetched in a single acquisition (one FC03 up
+// to 125 registers, back-to-back FC03s beyond that), stamped once.
+//
+// Every value decoded from a snapshot belongs to the same instant, so e.g.
+// per-phase powers and their total can be compared directly; with one Read_*
+// per value they were up to a few seconds apart.
+struct BlockSnapshot {
+  uint16_t start = 0;
+  std::vector<uint16_t> regs;
+  Modbus::StatusCode status = Modbus::Status_Bad;
+  AcquisitionTime acquired; // when the reply completed
+  uint32_t durationUs = 0;  // request start -> reply complete
+
+  bool ok() const { return Modbus::StatusIsGood(status); }
+
+  // Value at `address`; T{} if the read failed or the address lies outside
+  // the range (same as a failed Read_*).
+  template <typename T, WordOrder Order = WordOrder::ABCD>
+  T get(uint16_t address) const {
+    using Codec = RegisterCodec<T, Order>;
+    if (!ok() || address < start ||
+        uint32_t(address - start) + Codec::WORDS > regs.size())
+      return T{};
+    return Codec::decode(regs.data() + (address - start));
+  }
+
+  // Driver is iPM2xxx / iA9MEM15 (anything with readBlock).
+  template <typename Driver>
+  static BlockSnapshot read(Driver &client, uint16_t address, uint16_t count) {
+    BlockSnapshot snap;
+    snap.start = address;
+    snap.regs.assign(count, 0);
+    auto begin = std::chrono::steady_clock::now();
+    snap.status = client.readBlock(address, count, snap.regs.data());
+    auto end = std::chrono::steady_clock::now();
+    snap.acquired = AcquisitionTime::now();
+    snap.durationUs = uint32_t(
+        std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+            .count());
+    return snap;
+  }
+};
+
+#endif // BLOCK_SNAPSHOT_H
@@ -0,0 +1,172 @@
+#ifndef CHANNEL_STORE_H
+#define CHANNEL_STORE_H
+
+#include "register_map.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <sqlite3.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Samples older than this are pruned, same as the wide readings tables.
+constexpr int CHANNEL_RETENTION_DAYS = 2;
+
+// Catalogue refresh and retention pruning run at most this often per
+// database file; create() is called every poll cycle.
+constexpr int64_t CHANNEL_MAINTENANCE_MS = 3600 * 1000;
+
+/* ---------- Aggregate tiers ---------- */
+
+// Pre-aggregated resolutions of the samples, maintained on ingest and kept
+// much longer than the raw rows. `id` is stored: never renumber a tier.
+struct AggTier {
+  uint8_t id;
+  const char *name;
+  int64_t widthMs;
+  int retentionDays;
+};
+
+inline constexpr AggTier AGG_TIERS[] = {
+    {1, "1m", 60 * 1000, 14},
+    {2, "15m", 15 * 60 * 1000, 180},
+    {3, "1h", 3600 * 1000, 3 * 365},
+};
+
+// count / min / max / sum / first / last of the samples of one interval. A
+// raw sample is an aggregate of one; aggregates merge in time order.
+struct SeriesAggregate {
+  int64_t ts = 0; // interval start, epoch ms
+  int64_t count = 0;
+  double min = 0, max = 0, sum = 0, first = 0, last = 0;
+
+  void add(double v) { merge({ts, 1, v, v, v, v, v}); }
+
+  void merge(const SeriesAggregate &o) {
+    if (!o.count)
+      return;
+    if (!count) {
+      *this = {ts, o.count, o.min, o.max, o.sum, o.first, o.last};
+      return;
+    }
+    count += o.count;
+    min = std::min(min, o.min);
+    max = std::max(max, o.max);
+    sum += o.sum;
+    last = o.last;
+  }
+
+  double avg() const { return count ? sum / double(count) : NAN; }
+};
+
+/* ---------- Narrow channel store ---------- */
+
+// Long-format copy of the polled registers: one row per (channel, unit, ts).
+//
+//   samples(channel_id, unit_key, ts, value)  WITHOUT ROWID,
+//                                             PRIMARY KEY (channel_id, unit_key, ts)
+//   channels(channel_id, model, name, address, unit)  from register_map.h
+//   units(unit_key, gateway_ip, unit_id, model)
+//   samples_agg(tier, channel_id, unit_key, ts, count, min, max, sum,
+//               first, last)  WITHOUT ROWID, one row per AGG_TIERS interval
+//
+// The table is clustered on its key, so the samples of one channel of one
+// meter are contiguous in the B-tree: a range query reads only that
+// channel's pages instead of whole 80-column rows, and a new register is a
+// new channel ID rather than an ALTER TABLE.
+//
+// Bound to a connection; statements are prepared once per instance.
+class ChannelStore {
+public:
+  explicit ChannelStore(sqlite3 *db);
+  ~ChannelStore();
+  ChannelStore(const ChannelStore &) = delete;
+  ChannelStore &operator=(const ChannelStore &) = delete;
+
+  // Opt-in (CHANNEL_STORE=1); the wide tables stay the publish source.
+  static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+  static void setEnabled(bool on) { s_enabled.store(on); }
+
+  // Store on `db`; nullptr when disabled or the tables cannot be created.
+  // The first call per file, then one per CHANNEL_MAINTENANCE_MS, also sets
+  // up the tables and prunes samples and tiers past their retention.
+  static std::unique_ptr<ChannelStore> create(sqlite3 *db);
+
+  // Creates the tables and refreshes the channel catalogue.
+  bool setup();
+
+  // Stable key of a meter, created on first use.
+  int64_t unitKey(const std::string &gateway_ip, int unit_id,
+                  const std::string &model);
+
+  // Stores one poll's samples at `tsMs` in a single transaction and folds
+  // them into the open interval of every tier: aggregated per channel in
+  // memory first, then one upsert per (tier, channel). A sample whose
+  // (channel, unit, ts) is already stored is ignored, in the tiers too, so
+  // they cannot drift from the samples. Samples are expected in time order
+  // per meter.
+  bool append(int64_t unitKey, int64_t tsMs,
+              const std::vector<ChannelSample> &samples);
+
+  // Overwrites the samples at `tsMs` without touching the tiers; follow with
+  // rebuildTiers() over the rewritten range.
+  bool rewrite(int64_t unitKey, int64_t tsMs,
+               const std::vector<ChannelSample> &samples);
+
+  // Streams (ts, value) of one channel of one meter in [fromMs, toMs), in
+  // time order, straight from the statement. Return false from `fn` to stop.
+  bool scan(uint16_t channel, int64_t unitKey, int64_t fromMs, int64_t toMs,
+            const std::function<bool(int64_t, double)> &fn);
+
+  // Streams the `tier` intervals of one channel of one meter starting in
+  // [fromMs, toMs), in time order. Return false from `fn` to stop.
+  bool scanTier(const AggTier &tier, uint16_t channel, int64_t unitKey,
+                int64_t fromMs, int64_t toMs,
+                const std::function<bool(const SeriesAggregate &)> &fn);
+
+  // Timestamp of the oldest sample still kept for (channel, unit); -1 if
+  // there is none.
+  int64_t oldestSample(uint16_t channel, int64_t unitKey);
+
+  // Recomputes the tier intervals of `list` channels of one meter touching
+  // [fromMs, toMs) from the samples, e.g. after SnapshotStore::rederive
+  // rewrote them. Samples are kept far shorter than the tiers, so an
+  // interval that may have lost samples to prune() (it starts before both
+  // the channel's oldest sample and the retention horizon) is left as it
+  // is: rebuilding it would drop the part already pruned.
+  bool rebuildTiers(int64_t unitKey, std::span<const RegisterDesc> list,
+                    int64_t fromMs, int64_t toMs);
+
+  // Deletes samples older than `beforeMs`, one key-range delete per
+  // (channel, unit) of the same model. Returns the number of rows removed,
+  // -1 on error.
+  int64_t prune(int64_t beforeMs);
+
+  // Same for each tier past its own retention, counted from `nowMs`.
+  int64_t pruneTiers(int64_t nowMs);
+
+private:
+  bool exec(const char *sql);
+  bool prepareTiers();
+  bool foldTier(const AggTier &tier, uint16_t channel, int64_t unitKey,
+                const SeriesAggregate &agg);
+
+  static std::atomic<bool> s_enabled;
+
+  sqlite3 *m_db;
+  sqlite3_stmt *m_insert = nullptr;
+  sqlite3_stmt *m_replace = nullptr;
+  sqlite3_stmt *m_scan = nullptr;
+  sqlite3_stmt *m_aggFold = nullptr;
+  sqlite3_stmt *m_aggScan = nullptr;
+  std::map<std::pair<std::string, int>, int64_t> m_units;
+};
+
+#endif // CHANNEL_STORE_H
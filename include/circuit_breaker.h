@@ -0,0 +1,103 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <Modbus.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/* ---------- Policy ---------- */
+
+struct CircuitPolicy {
+  uint32_t failureThreshold = 2;   // consecutive dead replies before tripping
+  int64_t baseBackoffMs = 30000;   // first open window
+  int64_t maxBackoffMs = 900000;   // cap for the doubling (15 min)
+};
+
+/* ---------- Breaker ---------- */
+
+// Per-(gateway, unit) circuit breaker.
+//
+//   Closed    every request goes out; `failureThreshold` dead replies in a row
+//             (timeout, gateway 0x0A/0x0B, socket/CRC errors) trip it.
+//   Open      requests fail fast without touching the wire until the backoff
+//             window (base * 2^n, ±10 % jitter, capped) expires.
+//   HalfOpen  exactly one request goes out as a probe: success closes the
+//             breaker, failure re-opens it with the next longer window.
+//
+// Modbus exception replies other than 0x0A/0x0B prove the unit is alive and
+// count as success. All transitions run under a per-breaker mutex (requests
+// are milliseconds apart); the exported fields are atomics so scrapes never
+// lock.
+class CircuitBreaker {
+public:
+  enum State : int { Closed = 0, Open = 1, HalfOpen = 2 };
+
+  std::string gateway;
+  uint8_t unit = 0;
+
+  static int64_t nowMs();
+  static bool isDeadStatus(Modbus::StatusCode status);
+
+  // Before a request: false = fail fast (counted in `rejected`).
+  bool allow(int64_t now = nowMs());
+  // After a request that went out.
+  void onResult(Modbus::StatusCode status, int64_t now = nowMs());
+
+  // Poll-scheduler check that does not consume the half-open probe: true while
+  // the open window has not expired, i.e. the whole device can be skipped.
+  bool skipPoll(int64_t now = nowMs()) const;
+  int64_t retryInMs(int64_t now = nowMs()) const;
+
+  State state() const { return State(m_state.load(std::memory_order_relaxed)); }
+
+  std::atomic<uint64_t> trips{0};    // Closed/HalfOpen -> Open
+  std::atomic<uint64_t> rejected{0}; // requests failed fast
+  std::atomic<uint64_t> probes{0};   // half-open probes sent
+
+  CircuitBreaker *next = nullptr; // registry list, immutable once published
+
+private:
+  friend class CircuitBreakers;
+
+  void trip(int64_t now);
+
+  CircuitPolicy m_policy;
+  std::mutex m_mutex;
+  std::atomic<int> m_state{Closed};
+  std::atomic<int64_t> m_openUntilMs{0};
+  uint32_t m_failures = 0;    // consecutive, while closed
+  uint32_t m_openCount = 0;   // consecutive trips, drives the backoff
+  bool m_probeInFlight = false;
+};
+
+/* ---------- Registry ---------- */
+
+// Process-wide breakers, same append-only scheme as ModbusMetrics: resolve
+// once per client, keep the pointer, walk without locking.
+class CircuitBreakers {
+public:
+  static CircuitBreakers &instance();
+
+  // Applies to breakers created afterwards.
+  void setPolicy(const CircuitPolicy &policy);
+
+  CircuitBreaker *breaker(const std::string &gateway, uint8_t unit);
+
+  template <typename Fn> void forEach(Fn &&fn) const {
+    for (const CircuitBreaker *b = m_head.load(std::memory_order_acquire); b;
+         b = b->next)
+      fn(*b);
+  }
+
+private:
+  CircuitBreakers() = default;
+
+  std::mutex m_createMutex;
+  CircuitPolicy m_policy;
+  std::atomic<CircuitBreaker *> m_head{nullptr};
+};
+
+#endif // CIRCUIT_BREAKER_H
@@ -0,0 +1,315 @@
+#ifndef DEVICE_CACHE_H
+#define DEVICE_CACHE_H
+
+#include "block_snapshot.h"
+#include "circuit_breaker.h"
+#include "pipeline_metrics.h"
+#include "register_decode.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* ---------- Cached value ---------- */
+
+// A value served from a RegisterSnapshot plus the age of the registers it was
+// decoded from. ageMs < 0 means its block has never been read successfully
+// (value is then T{}, same as a failed direct Read_*).
+template <typename T> struct Cached {
+  T value{};
+  int64_t ageMs = -1;
+
+  bool valid() const { return ageMs >= 0; }
+};
+
+/* ---------- Snapshot ---------- */
+
+// Latest register image of one device, one seqlock per block.
+//
+// Only the poller thread writes; any number of threads read. Registers are
+// relaxed atomics so a reader racing a store never sees torn words, and the
+// block sequence number tells it whether the words it copied belong to one
+// acquisition (odd = store in progress, changed = retry). Readers never block
+// the writer and never touch the network.
+class RegisterSnapshot {
+public:
+  explicit RegisterSnapshot(std::vector<RegisterBlock> blocks)
+      : m_blocks(std::move(blocks)), m_slots(new Slot[m_blocks.size()]) {
+    size_t offset = 0;
+    for (size_t i = 0; i < m_blocks.size(); i++) {
+      m_slots[i].offset = offset;
+      offset += m_blocks[i].count;
+    }
+    m_regs.reset(new std::atomic<uint16_t>[offset]);
+    for (size_t i = 0; i < offset; i++)
+      m_regs[i].store(0, std::memory_order_relaxed);
+  }
+
+  static int64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  const std::vector<RegisterBlock> &blocks() const { return m_blocks; }
+
+  // Writer side (poller thread only): publishes a freshly read block.
+  void store(size_t block, const uint16_t *regs, int64_t acquiredMs) {
+    Slot &s = m_slots[block];
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::atomic<uint16_t> *dst = m_regs.get() + s.offset;
+    for (uint16_t i = 0; i < m_blocks[block].count; i++)
+      dst[i].store(regs[i], std::memory_order_relaxed);
+    s.acquiredMs.store(acquiredMs, std::memory_order_relaxed);
+
+    s.seq.store(seq + 2, std::memory_order_release);
+  }
+
+  // Reader side: decodes the value at `address` from the latest image.
+  template <typename T, WordOrder Order = WordOrder::ABCD>
+  Cached<T> get(uint16_t address) const {
+    using Codec = RegisterCodec<T, Order>;
+    Cached<T> out;
+    int b = find(address, Codec::WORDS);
+    if (b < 0)
+      return out;
+
+    const Slot &s = m_slots[b];
+    const std::atomic<uint16_t> *src =
+        m_regs.get() + s.offset + (address - m_blocks[b].start);
+    uint16_t r[Codec::WORDS];
+    int64_t acquiredMs;
+    uint32_t before, after;
+    do {
+      before = s.seq.load(std::memory_order_acquire);
+      for (uint16_t i = 0; i < Codec::WORDS; i++)
+        r[i] = src[i].load(std::memory_order_relaxed);
+      acquiredMs = s.acquiredMs.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = s.seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    if (before == 0) // never stored
+      return out;
+    out.value = Codec::decode(r);
+    out.ageMs = steadyMs() - acquiredMs;
+    return out;
+  }
+
+  // Reader side: raw registers address..address+count-1, which may span
+  // adjacent blocks. Each block's words are copied from one acquisition.
+  // False if any register lies outside the blocks; otherwise ageMs is the age
+  // of the stalest block touched (-1 if one of them was never stored).
+  bool copy(uint16_t address, uint16_t count, uint16_t *out,
+            int64_t &ageMs) const {
+    ageMs = 0;
+    int64_t now = steadyMs();
+    while (count > 0) {
+      int b = find(address, 1);
+      if (b < 0)
+        return false;
+      const Slot &s = m_slots[b];
+      uint16_t n = uint16_t(std::min<uint32_t>(
+          count, uint32_t(m_blocks[b].start) + m_blocks[b].count - address));
+      const std::atomic<uint16_t> *src =
+          m_regs.get() + s.offset + (address - m_blocks[b].start);
+      int64_t acquiredMs;
+      uint32_t before, after;
+      do {
+        before = s.seq.load(std::memory_order_acquire);
+        for (uint16_t i = 0; i < n; i++)
+          out[i] = src[i].load(std::memory_order_relaxed);
+        acquiredMs = s.acquiredMs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = s.seq.load(std::memory_order_relaxed);
+      } while ((before & 1) || before != after);
+
+      if (before == 0)
+        ageMs = -1;
+      else if (ageMs >= 0)
+        ageMs = std::max(ageMs, now - acquiredMs);
+      address += n;
+      out += n;
+      count -= n;
+    }
+    return true;
+  }
+
+  // Age of the stalest block, -1 until every block has been stored once.
+  int64_t ageMs() const {
+    int64_t oldest = -1;
+    for (size_t i = 0; i < m_blocks.size(); i++) {
+      if (m_slots[i].seq.load(std::memory_order_acquire) == 0)
+        return -1;
+      int64_t age = steadyMs() -
+                    m_slots[i].acquiredMs.load(std::memory_order_relaxed);
+      if (age > oldest)
+        oldest = age;
+    }
+    return oldest;
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq{0}; // 0 = never stored, odd = store running
+    std::atomic<int64_t> acquiredMs{0};
+    size_t offset = 0;
+  };
+
+  int find(uint16_t address, uint16_t words) const {
+    for (size_t i = 0; i < m_blocks.size(); i++)
+      if (address >= m_blocks[i].start &&
+          uint32_t(address) + words <=
+              uint32_t(m_blocks[i].start) + m_blocks[i].count)
+        return int(i);
+    return -1;
+  }
+
+  std::vector<RegisterBlock> m_blocks;
+  std::unique_ptr<Slot[]> m_slots;
+  std::unique_ptr<std::atomic<uint16_t>[]> m_regs;
+};
+
+/* ---------- Poller ---------- */
+
+// Background thread that keeps a RegisterSnapshot fresh for one unit.
+//
+// Driver is iPM2xxx / iA9MEM15 (anything with createClient + readBlock). The
+// thread owns the driver outright, so Modbus I/O never happens on a caller's
+// thread. A failed block keeps its previous contents (and keeps ageing); the
+// client is re-created after a cycle where every block failed. Cycles are
+// skipped outright while the unit's circuit breaker is open.
+template <typename Driver> class DevicePoller {
+public:
+  DevicePoller(uint8_t unitId, const std::string &ipAddress, int port,
+               int timeout, int intervalMs, std::vector<RegisterBlock> blocks,
+               const char *model)
+      : m_unitId(unitId), m_ipAddress(ipAddress), m_port(port),
+        m_timeout(timeout), m_intervalMs(intervalMs),
+        m_snapshot(std::move(blocks)),
+        m_health(PipelineMetrics::instance().device(
+            ipAddress + ":" + std::to_string(port), unitId, model)),
+        m_breaker(CircuitBreakers::instance().breaker(
+            ipAddress + ":" + std::to_string(port), unitId)) {}
+
+  ~DevicePoller() { stop(); }
+
+  void start() {
+    if (m_running.exchange(true))
+      return;
+    m_thread = std::thread(&DevicePoller::run, this);
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_wakeMutex);
+      m_running = false;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  const RegisterSnapshot &snapshot() const { return m_snapshot; }
+
+  // Every block read at least once and the last cycle reached the device.
+  bool ready() const {
+    return m_online.load(std::memory_order_acquire) &&
+           m_snapshot.ageMs() >= 0;
+  }
+
+  uint64_t cycles() const { return m_cycles.load(std::memory_order_relaxed); }
+
+private:
+  void run() {
+    Trace::setThreadName("cache " + m_ipAddress + "/" +
+                         std::to_string(m_unitId));
+    std::unique_ptr<Driver> client;
+    std::vector<uint16_t> buf;
+
+    while (m_running.load()) {
+      auto next = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(m_intervalMs);
+      TraceSpan refresh("cache", "refresh", m_unitId);
+      m_health->polls.fetch_add(1, std::memory_order_relaxed);
+      m_health->lastPollMs.store(PipelineMetrics::wallMs(),
+                                 std::memory_order_relaxed);
+
+      bool skip = m_breaker->skipPoll();
+      if (!client && !skip) {
+        try {
+          client = Driver::createClient(m_unitId, m_ipAddress, m_port,
+                                        m_timeout);
+        } catch (const std::exception &e) {
+          std::cerr << "Cache " << m_ipAddress << "/" << int(m_unitId)
+                    << ": " << e.what() << std::endl;
+        }
+      }
+
+      size_t good = 0;
+      const auto &blocks = m_snapshot.blocks();
+      for (size_t i = 0; client && !skip && i < blocks.size() &&
+                         m_running.load();
+           i++) {
+        buf.resize(blocks[i].count);
+        auto status =
+            client->readBlock(blocks[i].start, blocks[i].count, buf.data());
+        if (Modbus::StatusIsGood(status)) {
+          m_snapshot.store(i, buf.data(), RegisterSnapshot::steadyMs());
+          good++;
+        }
+      }
+
+      bool ok = client && good == blocks.size();
+      m_online.store(good > 0, std::memory_order_release);
+      if (ok)
+        m_health->lastOkMs.store(PipelineMetrics::wallMs(),
+                                 std::memory_order_relaxed);
+      else
+        m_health->failures.fetch_add(1, std::memory_order_relaxed);
+      if (good == 0 && !skip)
+        client.reset(); // reconnect on the next cycle
+      m_cycles.fetch_add(1, std::memory_order_relaxed);
+      refresh.end();
+
+      std::unique_lock<std::mutex> lock(m_wakeMutex);
+      m_wake.wait_until(lock, next, [this] { return !m_running.load(); });
+    }
+
+    if (client)
+      client->Disconnect();
+    m_online = false;
+  }
+
+  uint8_t m_unitId;
+  std::string m_ipAddress;
+  int m_port;
+  int m_timeout;
+  int m_intervalMs;
+
+  RegisterSnapshot m_snapshot;
+  DeviceHealth *m_health;
+  CircuitBreaker *m_breaker;
+
+  std::thread m_thread;
+  std::mutex m_wakeMutex;
+  std::condition_variable m_wake;
+  std::atomic<bool> m_running{false};
+  std::atomic<bool> m_online{false};
+  std::atomic<uint64_t> m_cycles{0};
+};
+
+#endif // DEVICE_CACHE_H
@@ -0,0 +1,58 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct GatewayAddress {
+  std::string host;
+  int port = 502;
+
+  // "192.168.100.28" or "192.168.100.28:502"
+  static GatewayAddress parse(const std::string &text);
+  std::string name() const { return host + ":" + std::to_string(port); }
+};
+
+struct DiscoveryOptions {
+  uint8_t firstUnit = 1;
+  uint8_t lastUnit = 247;
+  int probeTimeoutMs = 300;    // per probe; absent units cost about this much
+  int workersPerGateway = 4;   // probes in flight per gateway (TCP sessions)
+  int identifyTimeoutMs = 2000;
+};
+
+struct DiscoveredDevice {
+  std::string gateway; // host:port
+  uint8_t unit = 0;
+  std::string model;   // "iPM2xxx" / "iA9MEM15" / "unknown"
+  std::string meterModel;
+  uint16_t productId = 0;
+  std::string meterName;
+  std::string manufacturer;
+  uint32_t probeUs = 0; // round trip of the probe that found it
+};
+
+// "iPM2xxx" / "iA9MEM15" / "unknown" from the Read_MeterModel string.
+std::string classifyModel(const std::string &meterModel);
+
+// Scans unit IDs on every gateway at once.
+//
+// Each gateway gets `workersPerGateway` TCP sessions pulling unit IDs from a
+// shared counter, so that many short-timeout probes (FC03 on the product ID
+// register) are in flight per gateway. Any reply, even a Modbus exception
+// other than gateway 0x0A/0x0B, marks the unit present; responders are then
+// identified with Read_MeterModel / Read_ProductIdNumber. A full 1..247 scan
+// costs roughly 247 * probeTimeoutMs / workersPerGateway instead of
+// 247 * 2 s sequentially. Results are sorted by gateway and unit.
+std::vector<DiscoveredDevice>
+discoverDevices(const std::vector<GatewayAddress> &gateways,
+                const DiscoveryOptions &options = {});
+
+void writeInventoryJson(std::ostream &out,
+                        const std::vector<DiscoveredDevice> &devices);
+bool writeInventoryJsonFile(const std::string &path,
+                            const std::vector<DiscoveredDevice> &devices);
+
+#endif // DISCOVERY_H
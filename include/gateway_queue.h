@@ -0,0 +1,116 @@
+#ifndef GATEWAY_QUEUE_H
+#define GATEWAY_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* ---------- Priority ---------- */
+
+// Who is asking. Lower value goes first.
+enum class ModbusPriority : uint8_t {
+  Interactive = 0, // on-demand read waiting for a live value (unused so far)
+  Poll = 1,        // regular acquisition cycle
+  Backfill = 2,    // history / log catch-up, only uses idle line time
+};
+
+constexpr size_t MODBUS_PRIORITIES = 3;
+
+const char *priorityName(ModbusPriority p);
+
+struct QueuePolicy {
+  uint32_t maxInFlight = 1; // transactions on the gateway at once
+  // A waiting Backfill request is promoted one class per agingMs waited, so
+  // continuous polling cannot starve it. Interactive is never overtaken.
+  uint32_t agingMs = 5000;
+};
+
+/* ---------- Queue ---------- */
+
+// Admission to one gateway, one grant per Modbus transaction.
+//
+// The PAS600 works through its RS-485 side one request at a time, so with
+// every client of a gateway sending freely an RPC read lands behind whatever
+// the poll loop and pollers already have queued at the gateway. Here each
+// driver transaction first takes a Slot; a freed slot goes to the waiter with
+// the best (class - waited/agingMs), Interactive first, ties in arrival order.
+// An interactive read therefore waits for at most the transaction in flight,
+// not a whole poll cycle.
+class GatewayQueue {
+public:
+  std::string gateway; // "ip:port"
+
+  class Slot {
+  public:
+    Slot(GatewayQueue &queue, ModbusPriority priority);
+    ~Slot();
+    Slot(const Slot &) = delete;
+    Slot &operator=(const Slot &) = delete;
+
+  private:
+    GatewayQueue &m_queue;
+  };
+
+  void setPolicy(const QueuePolicy &policy);
+
+  // Exported counters, per priority class
+  std::atomic<uint64_t> granted[MODBUS_PRIORITIES] = {};
+  std::atomic<uint64_t> waitUs[MODBUS_PRIORITIES] = {};
+  std::atomic<uint64_t> maxWaitUs[MODBUS_PRIORITIES] = {};
+  std::atomic<int64_t> waiting[MODBUS_PRIORITIES] = {};
+  std::atomic<uint64_t> aged{0}; // grants that jumped ahead through aging
+
+  GatewayQueue *next = nullptr; // registry list, immutable once published
+
+private:
+  friend class GatewayQueues;
+
+  struct Waiter {
+    ModbusPriority priority;
+    std::chrono::steady_clock::time_point since;
+    uint64_t seq;
+    bool granted = false;
+  };
+
+  void dispatch(); // caller holds m_mutex
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<Waiter *> m_waiters;
+  QueuePolicy m_policy;
+  uint32_t m_inFlight = 0;
+  uint64_t m_seq = 0;
+};
+
+/* ---------- Registry ---------- */
+
+// Process-wide queues keyed by gateway, same append-only scheme as
+// ModbusMetrics.
+class GatewayQueues {
+public:
+  static GatewayQueues &instance();
+
+  // Applies to queues created afterwards.
+  void setPolicy(const QueuePolicy &policy);
+
+  GatewayQueue *queue(const std::string &gateway);
+
+  template <typename Fn> void forEach(Fn &&fn) const {
+    for (const GatewayQueue *q = m_head.load(std::memory_order_acquire); q;
+         q = q->next)
+      fn(*q);
+  }
+
+private:
+  GatewayQueues() = default;
+
+  std::mutex m_createMutex;
+  QueuePolicy m_policy;
+  std::atomic<GatewayQueue *> m_head{nullptr};
+};
+
+#endif // GATEWAY_QUEUE_H
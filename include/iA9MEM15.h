@@ -1,27 +1,58 @@
 #ifndef IA9MEM15_H
 #define IA9MEM15_H
 
-#include <ModbusClient.h>
-#include <ModbusClientPort.h>
+#include "meter_transport.h"
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <vector>
 
+// iA9MEM15 register map over a MeterTransport.
 class iA9MEM15 {
 public:
+  // `ipAddress` may also be a serial line such as "/dev/ttyUSB0@19200,8E1"
+  // (see RtuLine); `port` then only names the bus.
   static std::unique_ptr<iA9MEM15>
   createClient(uint8_t unitId,
                const std::string &ipAddress,
                int port = 502,
                int timeout = 2000);
 
+  explicit iA9MEM15(std::unique_ptr<MeterTransport> transport)
+      : m_io(std::move(transport)) {}
   iA9MEM15(std::shared_ptr<ModbusClientPort> port,
-           std::shared_ptr<ModbusClient> client);
-  ~iA9MEM15();
+           std::shared_ptr<ModbusClient> client,
+           const std::string &gateway = "")
+      : m_io(std::make_unique<MeterTransport>(std::move(port),
+                                              std::move(client), gateway)) {}
 
-  bool isConnected() const;
-  void Disconnect();
+  bool isConnected() const { return m_io->isConnected(); }
+  void Disconnect() { m_io->disconnect(); }
+
+  // Register layout: IEEE-754 floats and INT64 energies, high word first
+  static constexpr WordOrder WORD_ORDER = WordOrder::ABCD;
+  static constexpr uint16_t MAX_READ_REGS = MeterTransport::MAX_READ_REGS;
+
+  // Raw block read (split into <=125-register requests); decode the result
+  // with RegisterField<T, WORD_ORDER> / decodeBlock<T, WORD_ORDER>.
+  Modbus::StatusCode readBlock(uint16_t address, uint16_t count,
+                               uint16_t *values) {
+    return m_io->readBlock(address, count, values);
+  }
+
+  // Breaker, queue, RTT and bus of this unit, and the status of the most
+  // recent transaction (Read_* return 0 on failure)
+  MeterTransport &transport() { return *m_io; }
+  Modbus::StatusCode lastStatus() const { return m_io->lastStatus(); }
+  uint32_t readErrors() const { return m_io->readErrors(); }
+  CircuitBreaker *breaker() const { return m_io->breaker(); }
+  RttEstimator *rtt() const { return m_io->rtt(); }
+  // Admission class of this client's transactions on its gateway queue
+  // (default Poll; Backfill for catch-up, Interactive for on-demand reads)
+  void setPriority(ModbusPriority priority) { m_io->setPriority(priority); }
+  ModbusPriority priority() const { return m_io->priority(); }
+  GatewayQueue *queue() const { return m_io->queue(); }
+  // RS-485 bus this unit is polled on (nullptr for TCP)
+  RtuBus *bus() const { return m_io->bus(); }
 
   // ===== High-level Read =====
   float Read_RmsCurrentOnPhaseA();
@@ -34,14 +65,14 @@ public:
   uint64_t Read_TotalActiveEnergyDelivered_NotResettable();
 
 private:
-  std::shared_ptr<ModbusClientPort> m_port;
-  std::shared_ptr<ModbusClient> m_client;
-
-  // ===== Low-level helpers =====
-  uint16_t readU16(uint16_t address);
-  uint32_t readU32(uint16_t address);
-  float readFloat(uint16_t address);
-  uint64_t readU64(uint16_t address);
+  float readFloat(uint16_t address) {
+    return m_io->readValue<float, WORD_ORDER>(address);
+  }
+  uint64_t readU64(uint16_t address) {
+    return m_io->readValue<uint64_t, WORD_ORDER>(address);
+  }
+
+  std::unique_ptr<MeterTransport> m_io;
 };
 
 #endif // IA9MEM15_H
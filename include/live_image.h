@@ -0,0 +1,61 @@
+#ifndef LIVE_IMAGE_H
+#define LIVE_IMAGE_H
+
+#include "block_snapshot.h"
+#include "device_cache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* ---------- Live images ---------- */
+
+// The register blocks the collector read last for one unit, kept in RAM so
+// other consumers can be answered without touching the gateway again.
+struct LiveImage {
+  LiveImage(std::string gateway, uint8_t unit, std::string model,
+            std::vector<RegisterBlock> blocks)
+      : gateway(std::move(gateway)), unit(unit), model(std::move(model)),
+        regs(std::move(blocks)) {}
+
+  std::string gateway; // "ip:port"
+  uint8_t unit;
+  std::string model; // "iA9MEM15" / "iPM2xxx"
+  RegisterSnapshot regs;
+
+  // Stores `snap` as block `block` (index into the blocks given at creation).
+  // Failed reads are dropped, so the previous contents keep ageing.
+  void publish(size_t block, const BlockSnapshot &snap) {
+    if (snap.ok() && snap.regs.size() == regs.blocks()[block].count)
+      regs.store(block, snap.regs.data(), snap.acquired.steadyMs);
+  }
+
+  LiveImage *next = nullptr; // registry list, immutable once published
+};
+
+// Process-wide images keyed by gateway/unit, same append-only scheme as
+// ModbusMetrics. Only the Read_* loop writes an image; the façade reads.
+class LiveImages {
+public:
+  static LiveImages &instance();
+
+  // The first caller's block layout wins.
+  LiveImage *image(const std::string &gateway, uint8_t unit,
+                   const char *model, std::vector<RegisterBlock> blocks);
+
+  template <typename Fn> void forEach(Fn &&fn) const {
+    for (const LiveImage *i = m_head.load(std::memory_order_acquire); i;
+         i = i->next)
+      fn(*i);
+  }
+
+private:
+  LiveImages() = default;
+
+  std::mutex m_createMutex;
+  std::atomic<LiveImage *> m_head{nullptr};
+};
+
+#endif // LIVE_IMAGE_H
@@ -0,0 +1,64 @@
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+#include <cstdint>
+#include <ostream>
+#include <sqlite3.h>
+#include <string>
+
+// Online maintenance of the collector's database files. Backup and export
+// read one WAL snapshot through their own connection, so they run next to
+// a live service (e.g. `main --backup` from a shell) without stopping the
+// poll loop or blocking its writes.
+
+/* ---------- Backup ---------- */
+
+struct BackupOptions {
+  int pagesPerStep = 256; // ~1 MiB at the default page size
+  int sleepMs = 10;       // pause between steps, leaves I/O to the poller
+};
+
+// Copies `src` to `destPath` with sqlite3_backup_step, `pagesPerStep` pages
+// at a time. A read transaction is held on `src` for the whole copy, so the
+// result is one consistent snapshot and concurrent commits never restart
+// it; checkpoints cannot pass that snapshot until the copy ends. Written to
+// `destPath`.tmp and renamed when complete.
+bool Backup_Database(sqlite3 *src, const std::string &destPath,
+                     const BackupOptions &options = {});
+
+/* ---------- Export ---------- */
+
+enum class ExportFormat { Csv, Columnar };
+
+// Streams the rows of `table` whose time column lies in [fromS, toS)
+// (epoch seconds) to `out`, in table order, holding at most one row (CSV)
+// or one row group (columnar) in memory. The time column is `ts` (epoch ms)
+// or `timestamp` (epoch s), whichever the table has. Returns the number of
+// rows written, -1 on error.
+//
+// Columnar layout, little-endian:
+//   "PSC1", u16 column count, per column: u8 kind (1 integer, 2 real,
+//   3 text/blob), u16 name length, name
+//   row groups of up to EXPORT_GROUP_ROWS: u32 rows, then per column a
+//   null bitmap (1 bit per row) followed by the non-null values:
+//   integers as zigzag LEB128 deltas from the previous value in the group,
+//   reals as f64, text/blob as LEB128 length + bytes
+//   u32 0 ends the file.
+constexpr uint32_t EXPORT_GROUP_ROWS = 4096;
+
+int64_t Export_Range(sqlite3 *db, const std::string &table, int64_t fromS,
+                     int64_t toS, ExportFormat format, std::ostream &out);
+
+/* ---------- Re-derivation ---------- */
+
+// After a register-map fix: rewrites the channel-store samples of every
+// meter in `db` from its raw snapshots in [fromS, toS) (epoch seconds),
+// decoded with the current register map, and rebuilds the tiers over that
+// range (SnapshotStore::rederive). Only the samples still kept are rewritten
+// (the last CHANNEL_RETENTION_DAYS); tiers older than that keep their
+// values. One write transaction per meter, so the
+// poller's inserts wait at most one meter's range. Returns the number of
+// snapshots re-derived, -1 on error.
+int64_t Rederive_Range(sqlite3 *db, int64_t fromS, int64_t toS);
+
+#endif // MAINTENANCE_H
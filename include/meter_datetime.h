@@ -0,0 +1,25 @@
+#ifndef METER_DATETIME_H
+#define METER_DATETIME_H
+
+#include <cstdint>
+#include <ctime>
+
+// Meter DATETIME (4 registers, meter local time):
+//   r0 year - 2000 (bits 0-6)   r1 month (bits 8-11), day (bits 0-4)
+//   r2 hour (bits 8-12), minute (bits 0-5)   r3 milliseconds of the minute
+inline int64_t decode_meter_datetime(const uint16_t *r) {
+  std::tm tm{};
+  tm.tm_year = 100 + (r[0] & 0x7F);
+  tm.tm_mon = ((r[1] >> 8) & 0x0F) - 1;
+  tm.tm_mday = r[1] & 0x1F;
+  tm.tm_hour = (r[2] >> 8) & 0x1F;
+  tm.tm_min = r[2] & 0x3F;
+  tm.tm_isdst = -1;
+  if (tm.tm_mon < 0 || tm.tm_mon > 11 || tm.tm_mday < 1 || tm.tm_hour > 23 ||
+      tm.tm_min > 59 || r[3] > 59999)
+    return -1;
+  std::time_t t = std::mktime(&tm);
+  return t < 0 ? -1 : int64_t(t) * 1000 + r[3];
+}
+
+#endif // METER_DATETIME_H
@@ -0,0 +1,94 @@
+#ifndef METER_TRANSPORT_H
+#define METER_TRANSPORT_H
+
+#include "circuit_breaker.h"
+#include "gateway_queue.h"
+#include "modbus_metrics.h"
+#include "register_decode.h"
+#include "rtt_estimator.h"
+#include "rtu_bus.h"
+
+#include <ModbusClient.h>
+#include <ModbusClientPort.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// FC03 path to one meter, shared by the register-map drivers (iPM2xxx,
+// iA9MEM15): owns the port and client and routes every read through the
+// unit's circuit breaker, gateway queue slot, RS-485 line turn, adaptive
+// timeout/retry budget and metrics series.
+class MeterTransport {
+public:
+  static constexpr uint16_t MAX_READ_REGS = 125;
+
+  // TCP client to ipAddress:port, or a unit on a shared RS-485 bus when
+  // `ipAddress` is a serial line such as "/dev/ttyUSB0@19200,8E1" (see
+  // RtuLine; `port` then only names the bus). Throws std::runtime_error if
+  // the port cannot be created.
+  static std::unique_ptr<MeterTransport> create(uint8_t unitId,
+                                                const std::string &ipAddress,
+                                                int port, int timeout);
+
+  MeterTransport(std::shared_ptr<ModbusClientPort> port,
+                 std::shared_ptr<ModbusClient> client,
+                 const std::string &gateway = "", RtuBus *bus = nullptr);
+  ~MeterTransport();
+  MeterTransport(const MeterTransport &) = delete;
+  MeterTransport &operator=(const MeterTransport &) = delete;
+
+  bool isConnected() const;
+  void disconnect();
+
+  // One FC03 transaction (<= MAX_READ_REGS); timed, counted and retried.
+  Modbus::StatusCode readRegisters(uint16_t address, uint16_t count,
+                                   uint16_t *values);
+  // Any length, split into <= MAX_READ_REGS requests.
+  Modbus::StatusCode readBlock(uint16_t address, uint16_t count,
+                               uint16_t *values);
+
+  // Typed reads; T{} / "" on failure (see lastStatus()).
+  template <typename T, WordOrder Order> T readValue(uint16_t address) {
+    using Codec = RegisterCodec<T, Order>;
+    uint16_t r[Codec::WORDS] = {};
+    if (!Modbus::StatusIsGood(readRegisters(address, Codec::WORDS, r)))
+      return T{};
+    return Codec::decode(r);
+  }
+  uint16_t readU16(uint16_t address);
+  // Two ASCII characters per register, NULs dropped.
+  std::string readString(uint16_t address, uint16_t length);
+
+  // Status of the most recent Modbus transaction
+  Modbus::StatusCode lastStatus() const { return m_lastStatus; }
+  // Failed transactions since this transport was created
+  uint32_t readErrors() const { return m_readErrors; }
+  CircuitBreaker *breaker() const { return m_breaker; }
+  RttEstimator *rtt() const { return m_rtt; }
+  void setPriority(ModbusPriority priority) { m_priority = priority; }
+  ModbusPriority priority() const { return m_priority; }
+  GatewayQueue *queue() const { return m_queue; }
+  RtuBus *bus() const { return m_bus; }
+
+private:
+  void applyTimeout();
+  void reconnect(uint32_t timeoutMs);
+
+  std::shared_ptr<ModbusClientPort> m_port;
+  std::shared_ptr<ModbusClient> m_client;
+
+  // Resolved once in the ctor: FC03 series, breaker, queue and RTT of this
+  // gateway/unit
+  ModbusSeries *m_series = nullptr;
+  CircuitBreaker *m_breaker = nullptr;
+  RttEstimator *m_rtt = nullptr;
+  RtuBus *m_bus = nullptr;
+  GatewayQueue *m_queue = nullptr;
+  ModbusPriority m_priority = ModbusPriority::Poll;
+  uint32_t m_timeoutMs = 0; // currently set on the port
+  ModbusWireTap m_tap;
+  Modbus::StatusCode m_lastStatus = Modbus::Status_Good;
+  uint32_t m_readErrors = 0;
+};
+
+#endif // METER_TRANSPORT_H
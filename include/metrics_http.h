@@ -0,0 +1,80 @@
+#ifndef METRICS_HTTP_H
+#define METRICS_HTTP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Renders ModbusMetrics + PipelineMetrics in OpenMetrics text format.
+// Only loads atomics and walks the append-only registries: never locks.
+std::string renderOpenMetrics();
+
+// Minimal embedded HTTP server for Prometheus scrapes (GET /metrics),
+// on-demand trace dumps (GET /trace, Chrome trace-event JSON) and downsampled
+// channel series for charts (GET /series, see series_query.h).
+//
+// Runs on its own thread with non-blocking sockets and poll(), so a slow or
+// stuck scraper can never hold up the poll loop. Each response is rendered
+// fresh from the atomics and the connection is closed afterwards.
+//
+// /series runs SQLite queries, so those requests are handed to a second
+// thread (at most SERIES_QUEUE_MAX waiting, 503 beyond) and their connection
+// is parked until the answer is ready: a /metrics scrape never waits behind
+// a chart query.
+class MetricsHttpServer {
+public:
+  explicit MetricsHttpServer(uint16_t port,
+                             const std::string &bindAddr = "0.0.0.0");
+  ~MetricsHttpServer();
+
+  bool start();
+  void stop();
+
+  static constexpr size_t SERIES_QUEUE_MAX = 8;
+
+  uint16_t port() const { return m_port; }
+  uint64_t scrapes() const { return m_scrapes.load(); }
+
+private:
+  struct Conn {
+    int fd;
+    uint64_t id; // fds are reused, ids are not
+    std::string in;
+    std::string out;
+    size_t sent = 0;
+    bool parked = false; // waiting for the series thread
+  };
+  struct SeriesJob {
+    uint64_t conn;
+    std::string query;
+    std::string response;
+  };
+
+  void run();
+  void runSeries();
+  bool onReadable(Conn &c);
+  bool onWritable(Conn &c);
+  void respond(Conn &c);
+  void collectSeries(std::vector<Conn> &conns);
+
+  uint16_t m_port;
+  std::string m_bindAddr;
+  int m_listenFd = -1;
+  int m_wakeFd = -1; // eventfd: series answers ready
+  std::atomic<bool> m_running{false};
+  std::atomic<uint64_t> m_scrapes{0};
+  std::thread m_thread;
+
+  std::thread m_seriesThread;
+  std::mutex m_seriesMutex;
+  std::condition_variable m_seriesCv;
+  std::deque<SeriesJob> m_seriesJobs;  // waiting, guarded by m_seriesMutex
+  std::vector<SeriesJob> m_seriesDone; // answered, guarded by m_seriesMutex
+};
+
+#endif // METRICS_HTTP_H
@@ -0,0 +1,82 @@
+#ifndef MODBUS_FACADE_H
+#define MODBUS_FACADE_H
+
+#include "device_cache.h"
+#include "live_image.h"
+
+#include <Modbus.h>
+#include <ModbusTcpServer.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* ---------- Façade ---------- */
+
+// Modbus TCP server that answers FC03 from cached register images instead
+// of the meters, so SCADA / HMI polls never reach the PAS600.
+//
+// Each virtual unit ID maps to one RegisterSnapshot (a LiveImage or a
+// DevicePoller's) and exposes it with the meter's own register layout:
+// a client reads 2999..3110 from virtual unit 1 exactly as it would from the
+// physical meter. Requests are answered from RAM on the server thread:
+//
+//   range inside the cached blocks, fresh  -> registers
+//   range outside the cached blocks        -> exception 02 (illegal address)
+//   never read / older than maxAgeMs       -> exception 0B (target failed to
+//                                             respond), like a gateway whose
+//                                             meter is offline
+//   unmapped unit                          -> exception 0B
+//
+// Outcomes are counted in PipelineMetrics (facade_requests_total).
+//
+// The library's process() never blocks and does not expose its sockets, so
+// the server thread calls it back to back while there is traffic and backs
+// off to IDLE_SLEEP_MAX_US sleeps once a pass did nothing.
+class ModbusFacade : public ModbusInterface {
+public:
+  static constexpr uint32_t IDLE_SLEEP_MAX_US = 5000;
+
+  explicit ModbusFacade(uint16_t port, const std::string &bindAddr = "0.0.0.0",
+                        uint32_t maxAgeMs = 180000);
+  ~ModbusFacade();
+
+  bool start();
+  void stop();
+
+  // Serves `snapshot` as `virtualUnit`; nullptr unmaps it. The snapshot must
+  // outlive the mapping. Safe while the server is running.
+  void map(uint8_t virtualUnit, const RegisterSnapshot *snapshot);
+
+  // Maps every LiveImage not mapped yet. `rules` is a comma-separated list
+  // of "<virtual unit>=<gateway ip:port>/<unit>"; images without a rule are
+  // served under their own unit ID unless that ID is taken. Call after each
+  // poll cycle to pick up devices that answered for the first time.
+  void mapLive(const std::string &rules = "");
+
+  uint16_t port() const { return m_port; }
+
+  Modbus::StatusCode readHoldingRegisters(uint8_t unit, uint16_t offset,
+                                          uint16_t count,
+                                          uint16_t *values) override;
+
+private:
+  void onRx(const Modbus::Char *source, const uint8_t *buff, uint16_t size);
+  void onConnection(const Modbus::Char *source);
+
+  uint16_t m_port;
+  std::string m_bindAddr;
+  uint32_t m_maxAgeMs;
+  std::atomic<const RegisterSnapshot *> m_units[256];
+  std::vector<const LiveImage *> m_mapped; // mapLive() bookkeeping
+
+  std::unique_ptr<ModbusTcpServer> m_server;
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  bool m_busy = false; // set during process(), server thread only
+};
+
+#endif // MODBUS_FACADE_H
@@ -0,0 +1,156 @@
+#ifndef MODBUS_METRICS_H
+#define MODBUS_METRICS_H
+
+#include <Modbus.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* ---------- Latency histogram ---------- */
+
+// HDR-style log-linear histogram of microsecond latencies.
+//
+// Values below 8 us get exact buckets; above that every power of two is split
+// into 8 linear sub-buckets, so any recorded value is reported within 12.5 %.
+// Range is 0 .. ~134 s; larger values land in the last bucket. All updates are
+// relaxed atomics, so recording never blocks and readers may scrape at any
+// time (a snapshot can be a few samples behind, never torn per counter).
+class LatencyHistogram {
+public:
+  static constexpr int SUB_BUCKET_BITS = 3;
+  static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static constexpr int MAX_MAGNITUDE = 27; // 2^27 us ≈ 134 s
+  static constexpr int BUCKETS =
+      (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+  void record(uint64_t us);
+
+  uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+  uint64_t sumUs() const { return m_sum.load(std::memory_order_relaxed); }
+  uint64_t maxUs() const { return m_max.load(std::memory_order_relaxed); }
+  uint64_t bucketCount(int idx) const {
+    return m_buckets[idx].load(std::memory_order_relaxed);
+  }
+
+  // Upper bound (inclusive, us) of the bucket holding quantile `q` (0..1).
+  uint64_t percentileUs(double q) const;
+
+  static int bucketIndex(uint64_t us);
+  static uint64_t bucketUpperUs(int idx);
+
+private:
+  std::atomic<uint64_t> m_buckets[BUCKETS] = {};
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_sum{0};
+  std::atomic<uint64_t> m_max{0};
+};
+
+/* ---------- Outcome ---------- */
+
+// How a transaction ended, one counter of ModbusSeries each. The single
+// classification of a status: retries, RTT sampling and RTU line timing use
+// it too, so "timeout" means the same everywhere.
+enum class ModbusOutcome : uint8_t {
+  Ok,
+  Timeout,      // no answer within the port timeout
+  GatewayError, // exception 0x0A / 0x0B from the gateway
+  Exception,    // other Modbus exception response
+  CrcError,     // RTU CRC / ASCII LRC
+  OtherError,   // socket, framing, closed port ...
+};
+
+ModbusOutcome classifyStatus(Modbus::StatusCode status);
+
+/* ---------- Per (gateway, unit, function) series ---------- */
+
+struct ModbusSeries {
+  std::string gateway; // "ip:port" or serial device
+  uint8_t unit = 0;
+  uint8_t function = 0; // Modbus function code, e.g. 3 = Read Holding
+
+  LatencyHistogram latency;
+
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> ok{0};
+  std::atomic<uint64_t> timeouts{0};       // no answer within the port timeout
+  std::atomic<uint64_t> exceptions{0};     // Modbus exception response
+  std::atomic<uint64_t> gatewayErrors{0};  // exception 0x0A / 0x0B from gateway
+  std::atomic<uint64_t> crcErrors{0};      // RTU CRC / ASCII LRC
+  std::atomic<uint64_t> otherErrors{0};    // socket, framing, closed port ...
+  std::atomic<uint64_t> registers{0};      // registers successfully read
+  std::atomic<uint64_t> bytesTx{0};
+  std::atomic<uint64_t> bytesRx{0};
+
+  ModbusSeries *next = nullptr; // registry list, immutable once published
+};
+
+// Plain copy of one series for reporting.
+struct ModbusSeriesSnapshot {
+  std::string gateway;
+  uint8_t unit;
+  uint8_t function;
+  uint64_t requests, ok, timeouts, exceptions, gatewayErrors, crcErrors,
+      otherErrors, registers, bytesTx, bytesRx;
+  uint64_t p50Us, p90Us, p99Us, maxUs, sumUs;
+};
+
+/* ---------- Registry ---------- */
+
+// Process-wide registry of Modbus transaction metrics.
+//
+// Drivers resolve their series once (`series()`, takes a mutex) and keep the
+// pointer; the per-transaction `record()` path is lock-free. Series are never
+// removed, so pointers stay valid for the life of the process and readers can
+// walk the list without locking.
+class ModbusMetrics {
+public:
+  static ModbusMetrics &instance();
+
+  ModbusSeries *series(const std::string &gateway, uint8_t unit,
+                       uint8_t function);
+
+  static void record(ModbusSeries *s, Modbus::StatusCode status,
+                     uint64_t latencyUs, uint16_t registers);
+
+  // Walks every series without taking the creation lock.
+  template <typename Fn> void forEach(Fn &&fn) const {
+    for (const ModbusSeries *s = m_head.load(std::memory_order_acquire); s;
+         s = s->next)
+      fn(*s);
+  }
+
+  std::vector<ModbusSeriesSnapshot> snapshot() const;
+  void writeJson(std::ostream &out) const;
+  bool writeJsonFile(const std::string &path) const;
+
+private:
+  ModbusMetrics() = default;
+
+  std::mutex m_createMutex;
+  std::atomic<ModbusSeries *> m_head{nullptr};
+};
+
+/* ---------- Wire byte counter ---------- */
+
+// Connected to a ModbusClientPort's Tx/Rx signals; attributes every frame on
+// the wire (including retries) to the series of the transaction in flight.
+class ModbusWireTap {
+public:
+  void attach(class ModbusClientPort *port);
+  void detach(class ModbusClientPort *port);
+  void setCurrent(ModbusSeries *s) {
+    m_current.store(s, std::memory_order_relaxed);
+  }
+
+  void onTx(const Modbus::Char *source, const uint8_t *buff, uint16_t size);
+  void onRx(const Modbus::Char *source, const uint8_t *buff, uint16_t size);
+
+private:
+  std::atomic<ModbusSeries *> m_current{nullptr};
+};
+
+#endif // MODBUS_METRICS_H
@@ -0,0 +1,110 @@
+#ifndef PIPELINE_METRICS_H
+#define PIPELINE_METRICS_H
+
+#include "modbus_metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/* ---------- Per-device health ---------- */
+
+struct DeviceHealth {
+  std::string gateway;
+  uint8_t unit = 0;
+  std::string model; // "iA9MEM15" / "iPM2xxx"
+
+  std::atomic<int64_t> lastPollMs{0}; // wall clock of the last attempt
+  std::atomic<int64_t> lastOkMs{0};   // last row stored with no read errors
+  std::atomic<uint64_t> polls{0};
+  std::atomic<uint64_t> failures{0};
+
+  DeviceHealth *next = nullptr; // registry list, immutable once published
+};
+
+/* ---------- Pipeline registry ---------- */
+
+// Process-wide gauges and histograms for the poll → store → publish loop.
+//
+// Everything the hot path touches is a relaxed atomic; the scrape side
+// (MetricsHttpServer) only loads them, so a scrape can never stall a poll
+// cycle. Devices follow the same append-only list scheme as ModbusMetrics.
+class PipelineMetrics {
+public:
+  static PipelineMetrics &instance();
+
+  static int64_t wallMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Poll cycle (Read_* for every gateway + publish)
+  LatencyHistogram pollCycle;
+  std::atomic<uint64_t> lastPollCycleUs{0};
+
+  // Work still waiting in each stage of the current cycle
+  std::atomic<int64_t> pollQueueDepth{0};    // devices not yet polled
+  std::atomic<int64_t> publishQueueDepth{0}; // selected rows not yet sent
+
+  // SQLite write latency (each INSERT / UPDATE runs in autocommit)
+  LatencyHistogram sqliteCommit;
+  std::atomic<uint64_t> sqliteErrors{0};
+
+  // MQTT publish (ThingsBoard, QoS 1)
+  LatencyHistogram mqttPublish;
+  std::atomic<int64_t> mqttInFlight{0};
+  std::atomic<uint64_t> mqttErrors{0};
+
+  // Unsent rows (is_read=0) left after the last publish pass, -1 = unknown
+  std::atomic<int64_t> outboxA9{-1};
+  std::atomic<int64_t> outboxPM{-1};
+
+  // Modbus façade requests answered from the live images
+  std::atomic<uint64_t> facadeServed{0};
+  std::atomic<uint64_t> facadeStale{0};    // never read / too old: exception 0B
+  std::atomic<uint64_t> facadeBadRange{0}; // outside the cached blocks: 02
+  std::atomic<uint64_t> facadeUnmapped{0}; // no such virtual unit: 0B
+
+  DeviceHealth *device(const std::string &gateway, uint8_t unit,
+                       const std::string &model);
+
+  template <typename Fn> void forEachDevice(Fn &&fn) const {
+    for (const DeviceHealth *d = m_devices.load(std::memory_order_acquire); d;
+         d = d->next)
+      fn(*d);
+  }
+
+private:
+  PipelineMetrics() = default;
+
+  std::mutex m_createMutex;
+  std::atomic<DeviceHealth *> m_devices{nullptr};
+};
+
+/* ---------- Scoped timer ---------- */
+
+// Records the lifetime of the scope into a histogram (microseconds).
+class ScopedLatency {
+public:
+  explicit ScopedLatency(LatencyHistogram &h)
+      : m_hist(h), m_start(std::chrono::steady_clock::now()) {}
+  ~ScopedLatency() { m_hist.record(elapsedUs()); }
+
+  uint64_t elapsedUs() const {
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - m_start)
+                        .count());
+  }
+
+  ScopedLatency(const ScopedLatency &) = delete;
+  ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+  LatencyHistogram &m_hist;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+#endif // PIPELINE_METRICS_H
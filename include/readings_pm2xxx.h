@@ -0,0 +1,170 @@
+#ifndef READINGS_PM2XXX_H
+#define READINGS_PM2XXX_H
+
+#include "register_map.h"
+#include "sqlite_schema.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+/* ---------- readings_pm2xxx ---------- */
+
+// Columns in table order. CREATE TABLE, the INSERT and its binds
+// (Read_iPM2xxx) and the publisher's SELECT are all generated from this
+// list; add a point here and nowhere else.
+inline constexpr ColumnDesc PM_COLUMNS[] = {
+    {"id", ColType::Integer, "PRIMARY KEY AUTOINCREMENT", false},
+    {"timestamp", ColType::Integer}, // snapshot acquisition (s)
+    {"gateway_ip", ColType::Text},
+    {"unit_id", ColType::Integer},
+    {"voltage_a", ColType::Real},
+    {"voltage_b", ColType::Real},
+    {"voltage_c", ColType::Real},
+    {"voltage_avg", ColType::Real},
+    {"current_a", ColType::Real},
+    {"current_b", ColType::Real},
+    {"current_c", ColType::Real},
+    {"current_avg", ColType::Real},
+    {"active_power_total", ColType::Real},
+    {"reactive_power_total", ColType::Real},
+    {"apparent_power_total", ColType::Real},
+    {"power_factor_total", ColType::Real},
+    {"frequency", ColType::Real},
+    {"total_energy", ColType::Integer},
+    {"total_energy_last_1M", ColType::Integer, "DEFAULT 0"},
+    {"total_energy_last_5M", ColType::Integer, "DEFAULT 0"},
+    {"total_energy_last_30M", ColType::Integer, "DEFAULT 0"},
+    {"total_energy_last_1H", ColType::Integer, "DEFAULT 0"},
+    {"total_energy_last_2H", ColType::Integer, "DEFAULT 0"},
+    {"total_energy_last_1D", ColType::Integer, "DEFAULT 0", false},
+    {"ActiveEnergyDeliveredIntoLoad", ColType::Real},
+    {"current_unbalanceA", ColType::Real},
+    {"current_unbalanceB", ColType::Real},
+    {"current_unbalanceC", ColType::Real},
+    {"current_unbalanceWorst", ColType::Real},
+    {"ActiveEnergyReceived_OutofLoad", ColType::Real},
+    {"ActiveEnergyDeliveredPlussReceived", ColType::Real},
+    {"ActiveEnergyDeliveredDelReceived", ColType::Real},
+    {"ReactiveEnergyDelivered", ColType::Real},
+    {"ReactiveEnergyReceived", ColType::Real},
+    {"ReactiveEnergyDeliveredPlussReceived", ColType::Real},
+    {"ReactiveEnergyDeliveredDelReceived", ColType::Real},
+    {"ApparentEnergyDelivered", ColType::Real},
+    {"ApparentEnergyReceived", ColType::Real},
+    {"ApparentEnergyDeliveredPlussReceived", ColType::Real},
+    {"ApparentEnergyDeliveredDelReceived", ColType::Real},
+    {"ActivePowerA", ColType::Real},
+    {"ActivePowerB", ColType::Real},
+    {"ActivePowerC", ColType::Real},
+    {"ReactivePowerA", ColType::Real},
+    {"ReactivePowerB", ColType::Real},
+    {"ReactivePowerC", ColType::Real},
+    {"ApparentPowerA", ColType::Real},
+    {"ApparentPowerB", ColType::Real},
+    {"ApparentPowerC", ColType::Real},
+    {"PowerFactorA", ColType::Real},
+    {"PowerFactorB", ColType::Real},
+    {"PowerFactorC", ColType::Real},
+    {"PowerDemandMethod", ColType::Integer},
+    {"PowerDemandIntervalDuration", ColType::Integer},
+    {"PowerDemandSubintervalDuration", ColType::Integer},
+    {"PowerDemandElapsedTimeinInterval", ColType::Integer},
+    {"PowerDemandElapsedTimeinSubinterval", ColType::Integer},
+    {"CurrentDemandMethod", ColType::Integer},
+    {"CurrentDemandIntervalDuration", ColType::Integer},
+    {"CurrentDemandElapsedTimein", ColType::Integer},
+    {"CurrentDemandSubintervalDuration", ColType::Integer},
+    {"CurrentDemandElapsedTimeinInterval", ColType::Integer},
+    {"VoltageAB", ColType::Real},
+    {"VoltageBC", ColType::Real},
+    {"VoltageCA", ColType::Real},
+    {"VoltageLLAvg", ColType::Real},
+    {"VoltageUnbalanceAB", ColType::Real},
+    {"VoltageUnbalanceBC", ColType::Real},
+    {"VoltageUnbalanceCA", ColType::Real},
+    {"VoltageUnbalanceLLWorst", ColType::Real},
+    {"VoltageUnbalanceAN", ColType::Real},
+    {"VoltageUnbalanceBN", ColType::Real},
+    {"VoltageUnbalanceCN", ColType::Real},
+    {"VoltageUnbalanceLNWorst", ColType::Real},
+    {"DisplacementPowerFactorA", ColType::Real},
+    {"DisplacementPowerFactorB", ColType::Real},
+    {"DisplacementPowerFactorC", ColType::Real},
+    {"DisplacementPowerFactorTotal", ColType::Real},
+    {"ActiveEnergyDeliveredIntoLoad64", ColType::Integer},
+    {"ActiveEnergyReceivedOutofLoad64", ColType::Integer},
+    {"ActiveEnergyDeliveredPlussReceived64", ColType::Integer},
+    {"ActiveEnergyDeliveredDelReceived64", ColType::Integer},
+    {"is_read", ColType::Integer, "DEFAULT 0", false},
+    {"acquired_ms", ColType::Integer},
+    {"acquisition_us", ColType::Integer},
+};
+
+using PMRow = SqlRow<PM_COLUMNS>;
+
+// Bind position of a column, e.g. row.set<pm_col("voltage_a")>(v). A typo
+// or a column the INSERT leaves out does not compile.
+consteval size_t pm_col(std::string_view name) {
+  return column_index(PM_COLUMNS, name);
+}
+
+inline constexpr auto PM_CREATE_SQL = make_sql<[](SqlWriter &w) {
+  write_create_table(w, "readings_pm2xxx", PM_COLUMNS);
+}>();
+
+inline constexpr auto PM_INSERT_SQL = make_sql<[](SqlWriter &w) {
+  write_insert(w, "readings_pm2xxx", PM_COLUMNS);
+}>();
+
+// Unread rows for the publisher: id, acquisition time (ms), then every
+// inserted column at PM_SELECT_FIRST + pm_col(name).
+constexpr int PM_SELECT_FIRST = 2;
+inline constexpr auto PM_SELECT_UNREAD_SQL = make_sql<[](SqlWriter &w) {
+  w << "SELECT id, COALESCE(acquired_ms, timestamp * 1000), ";
+  write_column_list(w, PM_COLUMNS);
+  w << " FROM readings_pm2xxx WHERE is_read=0 LIMIT ?;";
+}>();
+
+// Result column of `name` in PM_SELECT_UNREAD_SQL.
+consteval int pm_select(std::string_view name) {
+  return PM_SELECT_FIRST + int(pm_col(name));
+}
+
+// Row position of each PM_CHANNELS register. A channel without a column of
+// its name, or of the wrong type, does not compile.
+inline constexpr auto PM_CHANNEL_COLUMNS = [] {
+  std::array<uint8_t, std::size(PM_CHANNELS)> pos{};
+  for (size_t i = 0; i < pos.size(); i++) {
+    size_t col = column_index(PM_COLUMNS, PM_CHANNELS[i].name);
+    size_t j = 0;
+    for (const ColumnDesc &c : PM_COLUMNS)
+      if (c.inserted && j++ == col &&
+          (c.type == ColType::Integer) !=
+              (PM_CHANNELS[i].type == RegType::UInt64))
+        throw "channel type does not match its column";
+    pos[i] = uint8_t(col);
+  }
+  return pos;
+}();
+
+// Fills every register column of `row` from the poll's snapshots, in one
+// loop over PM_CHANNELS. A failed or missing read stores 0, NaN too.
+inline void fill_pm_channels(PMRow &row,
+                             std::initializer_list<const BlockSnapshot *> blocks) {
+  for (size_t i = 0; i < std::size(PM_CHANNELS); i++) {
+    const RegisterDesc &d = PM_CHANNELS[i];
+    const BlockSnapshot *b = covering_block(d, blocks);
+    if (d.type == RegType::UInt64) {
+      row.setInteger(PM_CHANNEL_COLUMNS[i],
+                     b ? int64_t(b->get<uint64_t>(d.address)) : 0);
+    } else {
+      float v = b ? b->get<float>(d.address) : 0.0f;
+      row.setReal(PM_CHANNEL_COLUMNS[i], std::isnan(v) ? 0.0 : v);
+    }
+  }
+}
+
+#endif // READINGS_PM2XXX_H
@@ -0,0 +1,189 @@
+#ifndef REGISTER_DECODE_H
+#define REGISTER_DECODE_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ratio>
+#include <type_traits>
+
+/* ---------- Word order ---------- */
+
+// Layout of a multi-register value, named after the byte order of a 32-bit
+// value 0xAABBCCDD as it appears on the wire. ModbusLib already hands us each
+// register as a host uint16_t (wire bytes A,B -> 0xAABB), so:
+//
+//   ABCD  high word first, bytes as sent  (Schneider PM2xxx, iA9 MEM15)
+//   CDAB  low word first                  ("word swapped")
+//   BADC  high word first, bytes swapped
+//   DCBA  low word first, bytes swapped   (fully little-endian)
+enum class WordOrder { ABCD, CDAB, BADC, DCBA };
+
+namespace decode_detail {
+
+constexpr uint16_t bswap16(uint16_t v) { return uint16_t((v << 8) | (v >> 8)); }
+
+template <typename T> struct Unsigned;
+template <> struct Unsigned<uint16_t> { using type = uint16_t; };
+template <> struct Unsigned<int16_t> { using type = uint16_t; };
+template <> struct Unsigned<uint32_t> { using type = uint32_t; };
+template <> struct Unsigned<int32_t> { using type = uint32_t; };
+template <> struct Unsigned<float> { using type = uint32_t; };
+template <> struct Unsigned<uint64_t> { using type = uint64_t; };
+template <> struct Unsigned<int64_t> { using type = uint64_t; };
+template <> struct Unsigned<double> { using type = uint64_t; };
+
+} // namespace decode_detail
+
+/* ---------- Single value ---------- */
+
+// Decodes one value of type T from consecutive registers. Everything is
+// resolved at compile time: the loops below unroll to a few shifts/ors and at
+// most one byte swap per word.
+template <typename T, WordOrder Order = WordOrder::ABCD> struct RegisterCodec {
+  using Bits = typename decode_detail::Unsigned<T>::type;
+  static constexpr uint16_t WORDS = sizeof(T) / 2;
+
+  static constexpr bool LOW_WORD_FIRST =
+      Order == WordOrder::CDAB || Order == WordOrder::DCBA;
+  static constexpr bool SWAP_BYTES =
+      Order == WordOrder::BADC || Order == WordOrder::DCBA;
+
+  static constexpr T decode(const uint16_t *r) {
+    Bits v = 0;
+    for (uint16_t i = 0; i < WORDS; i++) {
+      uint16_t w = r[LOW_WORD_FIRST ? WORDS - 1 - i : i];
+      if constexpr (SWAP_BYTES)
+        w = decode_detail::bswap16(w);
+      if constexpr (WORDS > 1)
+        v = Bits(v << 16);
+      v |= Bits(w);
+    }
+    return std::bit_cast<T>(v);
+  }
+
+  static constexpr void encode(T value, uint16_t *r) {
+    Bits v = std::bit_cast<Bits>(value);
+    for (uint16_t i = 0; i < WORDS; i++) {
+      uint16_t w = uint16_t(v >> (16 * (WORDS - 1 - i)));
+      if constexpr (SWAP_BYTES)
+        w = decode_detail::bswap16(w);
+      r[LOW_WORD_FIRST ? WORDS - 1 - i : i] = w;
+    }
+  }
+};
+
+/* ---------- Typed register field ---------- */
+
+// A register of raw type T, word order `Order`, scaled by `Scale` (e.g.
+// std::milli for a value sent in thousandths). Unscaled fields decode to T;
+// scaled ones to double.
+template <typename T, WordOrder Order = WordOrder::ABCD,
+          typename Scale = std::ratio<1>>
+struct RegisterField {
+  using Codec = RegisterCodec<T, Order>;
+  static constexpr uint16_t WORDS = Codec::WORDS;
+  static constexpr bool SCALED = !std::ratio_equal_v<Scale, std::ratio<1>>;
+  using value_type = std::conditional_t<SCALED, double, T>;
+
+  static constexpr value_type decode(const uint16_t *r) {
+    if constexpr (SCALED)
+      return double(Codec::decode(r)) * double(Scale::num) /
+             double(Scale::den);
+    else
+      return Codec::decode(r);
+  }
+
+  // Value at `address` inside a block that starts at `blockStart`.
+  static constexpr value_type at(const uint16_t *block, uint16_t blockStart,
+                                 uint16_t address) {
+    return decode(block + (address - blockStart));
+  }
+};
+
+/* ---------- Bulk block decode ---------- */
+
+namespace decode_detail {
+
+// Reverses the 16-bit words of v (word 0 <-> word N-1).
+template <typename Bits> constexpr Bits reverseWords(Bits v) {
+  if constexpr (sizeof(Bits) == 2) {
+    return v;
+  } else if constexpr (sizeof(Bits) == 4) {
+    return Bits((v << 16) | (v >> 16));
+  } else {
+    v = (v << 32) | (v >> 32);
+    return ((v & 0x0000FFFF0000FFFFull) << 16) |
+           ((v >> 16) & 0x0000FFFF0000FFFFull);
+  }
+}
+
+// Swaps the two bytes of every 16-bit word of v.
+template <typename Bits> constexpr Bits swapBytesInWords(Bits v) {
+  constexpr Bits mask = Bits(0x00FF00FF00FF00FFull);
+  return Bits(((v & mask) << 8) | ((v >> 8) & mask));
+}
+
+// One element of the bulk path: a plain load of the whole value followed by
+// lane-wise shifts/masks, which map directly onto SIMD shuffles.
+template <typename T, WordOrder Order>
+inline void decodeOne(const uint16_t *regs, T *out) {
+  using Codec = RegisterCodec<T, Order>;
+  using Bits = typename Codec::Bits;
+
+  Bits v;
+  std::memcpy(&v, regs, sizeof(v)); // word 0 lands in the low bits
+  if constexpr (!Codec::LOW_WORD_FIRST)
+    v = reverseWords(v);
+  if constexpr (Codec::SWAP_BYTES)
+    v = swapBytesInWords(v);
+  std::memcpy(out, &v, sizeof(v));
+}
+
+} // namespace decode_detail
+
+// Decodes `count` back-to-back values of T from `regs` into `out`.
+//
+// On little-endian hosts the body is branch-free with a fixed 8-wide inner
+// loop, so GCC/Clang vectorize it at -O2 (word rotate + byte swap on
+// SSE/NEON lanes) and a 125-register block decodes in a few dozen cycles.
+// Other hosts fall back to RegisterCodec::decode per element.
+template <typename T, WordOrder Order = WordOrder::ABCD>
+inline void decodeBlock(const uint16_t *__restrict regs, size_t count,
+                        T *__restrict out) {
+  using Codec = RegisterCodec<T, Order>;
+  if constexpr (std::endian::native == std::endian::little) {
+    constexpr size_t LANES = 8;
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES)
+      for (size_t j = 0; j < LANES; j++)
+        decode_detail::decodeOne<T, Order>(regs + (i + j) * Codec::WORDS,
+                                           out + i + j);
+    for (; i < count; i++)
+      decode_detail::decodeOne<T, Order>(regs + i * Codec::WORDS, out + i);
+  } else {
+    for (size_t i = 0; i < count; i++)
+      out[i] = Codec::decode(regs + i * Codec::WORDS);
+  }
+}
+
+// Same, then applies a compile-time scale and widens to float.
+template <typename T, WordOrder Order = WordOrder::ABCD,
+          typename Scale = std::ratio<1>>
+inline void decodeBlockScaled(const uint16_t *__restrict regs, size_t count,
+                              float *__restrict out) {
+  constexpr float factor = float(Scale::num) / float(Scale::den);
+  if constexpr (std::is_same_v<T, float>) {
+    decodeBlock<float, Order>(regs, count, out);
+    if constexpr (factor != 1.0f)
+      for (size_t i = 0; i < count; i++)
+        out[i] *= factor;
+  } else {
+    using Codec = RegisterCodec<T, Order>;
+    for (size_t i = 0; i < count; i++)
+      out[i] = float(Codec::decode(regs + i * Codec::WORDS)) * factor;
+  }
+}
+
+#endif // REGISTER_DECODE_H
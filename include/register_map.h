@@ -0,0 +1,208 @@
+#ifndef REGISTER_MAP_H
+#define REGISTER_MAP_H
+
+#include "block_snapshot.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+/* ---------- Channel descriptors ---------- */
+
+enum class RegType : uint8_t { Float32, UInt64 };
+
+// One polled register as a storage channel. `channel` is the stable ID used
+// by the narrow store: never renumber or reuse one, append new registers
+// with a fresh ID. `name` matches the wide-table column where there is one.
+struct RegisterDesc {
+  uint16_t channel;
+  const char *name;
+  uint16_t address;
+  RegType type;
+  const char *unit;
+};
+
+// iPM2xxx: every register decoded from the instant (2999..) and energy
+// (2699.., 3203..) blocks of Read_iPM2xxx.
+inline constexpr RegisterDesc PM_CHANNELS[] = {
+    {1, "voltage_a", 3027, RegType::Float32, "V"},
+    {2, "voltage_b", 3029, RegType::Float32, "V"},
+    {3, "voltage_c", 3031, RegType::Float32, "V"},
+    {4, "voltage_avg", 3035, RegType::Float32, "V"},
+    {5, "current_a", 2999, RegType::Float32, "A"},
+    {6, "current_b", 3001, RegType::Float32, "A"},
+    {7, "current_c", 3003, RegType::Float32, "A"},
+    {8, "current_avg", 3009, RegType::Float32, "A"},
+    {9, "active_power_total", 3059, RegType::Float32, "kW"},
+    {10, "reactive_power_total", 3067, RegType::Float32, "kVAR"},
+    {11, "apparent_power_total", 3075, RegType::Float32, "kVA"},
+    {12, "power_factor_total", 3083, RegType::Float32, ""},
+    {13, "frequency", 3109, RegType::Float32, "Hz"},
+    {14, "current_unbalanceA", 3011, RegType::Float32, "%"},
+    {15, "current_unbalanceB", 3013, RegType::Float32, "%"},
+    {16, "current_unbalanceC", 3015, RegType::Float32, "%"},
+    {17, "current_unbalanceWorst", 3017, RegType::Float32, "%"},
+    {18, "ActivePowerA", 3053, RegType::Float32, "kW"},
+    {19, "ActivePowerB", 3055, RegType::Float32, "kW"},
+    {20, "ActivePowerC", 3057, RegType::Float32, "kW"},
+    {21, "ReactivePowerA", 3061, RegType::Float32, "kVAR"},
+    {22, "ReactivePowerB", 3063, RegType::Float32, "kVAR"},
+    {23, "ReactivePowerC", 3065, RegType::Float32, "kVAR"},
+    {24, "ApparentPowerA", 3069, RegType::Float32, "kVA"},
+    {25, "ApparentPowerB", 3071, RegType::Float32, "kVA"},
+    {26, "ApparentPowerC", 3073, RegType::Float32, "kVA"},
+    {27, "PowerFactorA", 3077, RegType::Float32, ""},
+    {28, "PowerFactorB", 3079, RegType::Float32, ""},
+    {29, "PowerFactorC", 3081, RegType::Float32, ""},
+    {30, "VoltageAB", 3019, RegType::Float32, "V"},
+    {31, "VoltageBC", 3021, RegType::Float32, "V"},
+    {32, "VoltageCA", 3023, RegType::Float32, "V"},
+    {33, "VoltageLLAvg", 3025, RegType::Float32, "V"},
+    {34, "VoltageUnbalanceAB", 3037, RegType::Float32, "%"},
+    {35, "VoltageUnbalanceBC", 3039, RegType::Float32, "%"},
+    {36, "VoltageUnbalanceCA", 3041, RegType::Float32, "%"},
+    {37, "VoltageUnbalanceLLWorst", 3043, RegType::Float32, "%"},
+    {38, "VoltageUnbalanceAN", 3045, RegType::Float32, "%"},
+    {39, "VoltageUnbalanceBN", 3047, RegType::Float32, "%"},
+    {40, "VoltageUnbalanceCN", 3049, RegType::Float32, "%"},
+    {41, "VoltageUnbalanceLNWorst", 3051, RegType::Float32, "%"},
+    {42, "DisplacementPowerFactorA", 3085, RegType::Float32, ""},
+    {43, "DisplacementPowerFactorB", 3087, RegType::Float32, ""},
+    {44, "DisplacementPowerFactorC", 3089, RegType::Float32, ""},
+    {45, "DisplacementPowerFactorTotal", 3091, RegType::Float32, ""},
+    {46, "ActiveEnergyDeliveredIntoLoad", 2699, RegType::Float32, "Wh"},
+    {47, "ActiveEnergyReceived_OutofLoad", 2701, RegType::Float32, "Wh"},
+    {48, "ActiveEnergyDeliveredPlussReceived", 2703, RegType::Float32, "Wh"},
+    {49, "ActiveEnergyDeliveredDelReceived", 2705, RegType::Float32, "Wh"},
+    {50, "ReactiveEnergyDelivered", 2707, RegType::Float32, "VARh"},
+    {51, "ReactiveEnergyReceived", 2709, RegType::Float32, "VARh"},
+    {52, "ReactiveEnergyDeliveredPlussReceived", 2711, RegType::Float32,
+     "VARh"},
+    {53, "ApparentEnergyDelivered", 2715, RegType::Float32, "VAh"},
+    {54, "ApparentEnergyReceived", 2717, RegType::Float32, "VAh"},
+    {55, "ApparentEnergyDeliveredPlussReceived", 2719, RegType::Float32,
+     "VAh"},
+    {56, "ActiveEnergyDeliveredIntoLoad64", 3203, RegType::UInt64, "Wh"},
+    {57, "ActiveEnergyReceivedOutofLoad64", 3207, RegType::UInt64, "Wh"},
+    {58, "ActiveEnergyDeliveredPlussReceived64", 3211, RegType::UInt64, "Wh"},
+    {59, "ActiveEnergyDeliveredDelReceived64", 3215, RegType::UInt64, "Wh"},
+};
+
+// iA9MEM15: instant (2999..) and energy (3203..) blocks of Read_iA9MEM15.
+inline constexpr RegisterDesc A9_CHANNELS[] = {
+    {101, "current", 2999, RegType::Float32, "A"},
+    {102, "voltage", 3019, RegType::Float32, "V"},
+    {103, "power_a", 3053, RegType::Float32, "kW"},
+    {104, "total_power", 3059, RegType::Float32, "kW"},
+    {105, "apparent_power", 3069, RegType::Float32, "kVA"},
+    {106, "power_factor", 3079, RegType::Float32, ""},
+    {107, "temperature", 3099, RegType::Float32, "C"},
+    {108, "total_energy", 3203, RegType::UInt64, "Wh"},
+};
+
+template <size_t N>
+constexpr bool channels_unique(const RegisterDesc (&list)[N]) {
+  for (size_t i = 0; i < N; i++)
+    for (size_t j = i + 1; j < N; j++)
+      if (list[i].channel == list[j].channel)
+        return false;
+  return true;
+}
+static_assert(channels_unique(PM_CHANNELS), "duplicate iPM2xxx channel ID");
+static_assert(channels_unique(A9_CHANNELS), "duplicate iA9MEM15 channel ID");
+
+// Descriptor of a channel ID and the model it belongs to; nullptr if the ID
+// is unknown.
+inline const RegisterDesc *find_channel(uint16_t channel,
+                                        const char **model = nullptr) {
+  for (const RegisterDesc &d : PM_CHANNELS)
+    if (d.channel == channel) {
+      if (model)
+        *model = "iPM2xxx";
+      return &d;
+    }
+  for (const RegisterDesc &d : A9_CHANNELS)
+    if (d.channel == channel) {
+      if (model)
+        *model = "iA9MEM15";
+      return &d;
+    }
+  return nullptr;
+}
+
+/* ---------- Map version ---------- */
+
+// FNV-1a over every descriptor (ID, name, address, type). Rows that keep raw
+// registers record the version current when they were written, so values
+// derived under an older, wrong map can be found and re-derived. Any edit to
+// a list changes its version; nothing to bump by hand.
+template <size_t N>
+constexpr uint32_t map_version(const RegisterDesc (&list)[N]) {
+  uint32_t h = 2166136261u;
+  auto mix = [&h](uint32_t byte) { h = (h ^ (byte & 0xFF)) * 16777619u; };
+  for (const RegisterDesc &d : list) {
+    mix(d.channel);
+    mix(d.channel >> 8);
+    for (const char *c = d.name; *c; c++)
+      mix(uint8_t(*c));
+    mix(d.address);
+    mix(d.address >> 8);
+    mix(uint32_t(d.type));
+  }
+  return h;
+}
+
+inline constexpr uint32_t PM_MAP_VERSION = map_version(PM_CHANNELS);
+inline constexpr uint32_t A9_MAP_VERSION = map_version(A9_CHANNELS);
+
+/* ---------- Sampling ---------- */
+
+struct ChannelSample {
+  uint16_t channel;
+  double value;
+};
+
+// The successful snapshot that covers `desc`, nullptr if none does.
+inline const BlockSnapshot *
+covering_block(const RegisterDesc &desc,
+               std::initializer_list<const BlockSnapshot *> blocks) {
+  uint16_t words = desc.type == RegType::UInt64 ? 4 : 2;
+  for (const BlockSnapshot *b : blocks) {
+    if (b->ok() && desc.address >= b->start &&
+        uint32_t(desc.address - b->start) + words <= b->regs.size())
+      return b;
+  }
+  return nullptr;
+}
+
+// Value of `desc` from whichever snapshot covers its address; NaN if none
+// does or that read failed.
+inline double channel_value(const RegisterDesc &desc,
+                            std::initializer_list<const BlockSnapshot *> blocks) {
+  const BlockSnapshot *b = covering_block(desc, blocks);
+  if (!b)
+    return NAN;
+  if (desc.type == RegType::UInt64)
+    return double(b->get<uint64_t>(desc.address));
+  return b->get<float>(desc.address);
+}
+
+// One sample per channel of `list` from a poll's snapshots. Registers that
+// were not read or hold NaN (not applicable to the wiring) are left out.
+template <size_t N>
+inline std::vector<ChannelSample>
+collect_channels(const RegisterDesc (&list)[N],
+                 std::initializer_list<const BlockSnapshot *> blocks) {
+  std::vector<ChannelSample> out;
+  out.reserve(N);
+  for (const RegisterDesc &d : list) {
+    double v = channel_value(d, blocks);
+    if (!std::isnan(v))
+      out.push_back({d.channel, v});
+  }
+  return out;
+}
+
+#endif // REGISTER_MAP_H
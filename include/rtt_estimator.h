@@ -0,0 +1,106 @@
+#ifndef RTT_ESTIMATOR_H
+#define RTT_ESTIMATOR_H
+
+#include <Modbus.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/* ---------- Policy ---------- */
+
+struct RttPolicy {
+  uint32_t minTimeoutMs = 100;   // floor for the derived timeout
+  uint32_t maxTimeoutMs = 10000; // ceiling, also caps the backoff
+  uint32_t granularityMs = 10;   // RFC 6298 "G"
+  uint32_t maxRetries = 2;
+};
+
+/* ---------- Estimator ---------- */
+
+// Request timeout and retry budget for one (gateway, unit), derived from the
+// observed round-trip time the way TCP derives its RTO (RFC 6298):
+//
+//   SRTT   <- 7/8 SRTT + 1/8 R
+//   RTTVAR <- 3/4 RTTVAR + 1/4 |SRTT - R|
+//   RTO     = clamp(SRTT + max(G, 4 RTTVAR)) << backoff
+//
+// Until the first sample the timeout is the one the client was created with.
+// Every timeout doubles the RTO until a fresh sample arrives, and only replies
+// to first attempts are sampled (Karn), so a slow link widens the timeout
+// instead of timing out forever and a late reply never shrinks it.
+//
+// The retry budget keeps the worst case of one read within the configured
+// timeout: a fast LAN (RTO ~100 ms) gets `maxRetries` quick retries, a link
+// whose RTO is close to the configured timeout gets none.
+class RttEstimator {
+public:
+  std::string gateway;
+  uint8_t unit = 0;
+
+  void sample(uint64_t rttUs);
+  void onTimeout();
+
+  uint32_t timeoutMs() const {
+    return m_timeoutMs.load(std::memory_order_relaxed);
+  }
+  uint32_t retries() const;
+
+  // Exported state (microseconds for the smoothed values)
+  std::atomic<uint64_t> srttUs{0};
+  std::atomic<uint64_t> rttvarUs{0};
+  std::atomic<uint64_t> samples{0};
+  std::atomic<uint64_t> timeouts{0};
+  std::atomic<uint64_t> retriesSent{0};
+  std::atomic<uint64_t> recovered{0}; // reads that succeeded on a retry
+
+  RttEstimator *next = nullptr; // registry list, immutable once published
+
+private:
+  friend class RttEstimators;
+
+  void update(); // recomputes m_timeoutMs, caller holds m_mutex
+
+  RttPolicy m_policy;
+  uint32_t m_initialMs = 2000;
+  std::mutex m_mutex;
+  double m_srttUs = 0;
+  double m_rttvarUs = 0;
+  bool m_hasSample = false;
+  int m_backoff = 0;
+  std::atomic<uint32_t> m_timeoutMs{2000};
+};
+
+/* ---------- Registry ---------- */
+
+// Process-wide estimators, same append-only scheme as ModbusMetrics. Every
+// client of a unit shares its estimator, so a re-created client starts from
+// what the previous one learned.
+class RttEstimators {
+public:
+  static RttEstimators &instance();
+
+  // Applies to estimators created afterwards.
+  void setPolicy(const RttPolicy &policy);
+
+  // `initialTimeoutMs` is the timeout used before the first sample and the
+  // per-read budget for retries.
+  RttEstimator *estimator(const std::string &gateway, uint8_t unit,
+                          uint32_t initialTimeoutMs);
+
+  template <typename Fn> void forEach(Fn &&fn) const {
+    for (const RttEstimator *e = m_head.load(std::memory_order_acquire); e;
+         e = e->next)
+      fn(*e);
+  }
+
+private:
+  RttEstimators() = default;
+
+  std::mutex m_createMutex;
+  RttPolicy m_policy;
+  std::atomic<RttEstimator *> m_head{nullptr};
+};
+
+#endif // RTT_ESTIMATOR_H
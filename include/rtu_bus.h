@@ -0,0 +1,128 @@
+#ifndef RTU_BUS_H
+#define RTU_BUS_H
+
+#include <Modbus.h>
+#include <ModbusClientPort.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/* ---------- Line settings ---------- */
+
+// One RS-485 segment, written in place of a gateway IP:
+//
+//   /dev/ttyUSB0                 19200 baud, 8E1 (PM2xxx / iA9 factory default)
+//   /dev/ttyUSB0@9600            9600 baud, 8E1
+//   /dev/ttyUSB0@38400,8N2       38400 baud, 8 data bits, no parity, 2 stop
+//   /dev/ttyUSB0@19200,8E1,t500  plus 500 us extra turnaround after replies
+struct RtuLine {
+  std::string device;
+  int32_t baudRate = 19200;
+  int8_t dataBits = 8;
+  Modbus::Parity parity = Modbus::EvenParity;
+  Modbus::StopBits stopBits = Modbus::OneStop;
+  uint32_t turnaroundUs = 0; // slave/transceiver release time on top of t3.5
+
+  // True for "/dev/..." and "COMn" endpoints.
+  static bool isSerial(const std::string &endpoint);
+  static RtuLine parse(const std::string &endpoint);
+
+  // One character on the wire: start + data + parity + stop bits.
+  uint32_t charUs() const;
+  // t3.5 (frame delimiter). Fixed at 1750 us above 19200 baud, as the
+  // Modbus serial line spec recommends.
+  uint32_t silentIntervalUs() const;
+  // End-of-reply detection for the port: t3.5 rounded up to whole ms.
+  uint32_t interByteTimeoutMs() const;
+};
+
+/* ---------- Bus ---------- */
+
+// Shared serial port of one RS-485 segment.
+//
+// Every unit on the segment talks through this one port, and only one
+// request may be on the wire at a time. Transaction hands the line out in
+// arrival order and starts the next request as soon as the silent interval
+// after the previous frame has elapsed, so polls of different units (from
+// Read_* or DevicePoller threads) go out back-to-back with no more idle time
+// than the framing needs:
+//
+//   reply received  -> the port already waited interByteTimeoutMs() of silence
+//                      to see the frame end; only the rest of t3.5 plus the
+//                      turnaround is left to wait.
+//   no reply        -> full t3.5 + turnaround after giving up.
+//
+// The wait is a sleep to within 200 us of the deadline, then a spin, because
+// t3.5 at 19200 baud (1.75 ms) is below typical sleep granularity.
+class RtuBus {
+public:
+  std::string name; // device path
+  RtuLine line;
+
+  std::shared_ptr<ModbusClientPort> port() const { return m_port; }
+
+  class Transaction {
+  public:
+    explicit Transaction(RtuBus &bus);
+    ~Transaction();
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+
+    // Outcome of the request, decides how much silence is still owed.
+    void done(Modbus::StatusCode status) { m_status = status; }
+
+  private:
+    RtuBus &m_bus;
+    std::chrono::steady_clock::time_point m_start;
+    Modbus::StatusCode m_status = Modbus::Status_BadSerialReadTimeout;
+  };
+
+  // Exported counters (microseconds)
+  std::atomic<uint64_t> transactions{0};
+  std::atomic<uint64_t> busyUs{0};    // line owned by a request
+  std::atomic<uint64_t> queuedUs{0};  // requests waiting for the line
+  std::atomic<uint64_t> silenceUs{0}; // inter-frame gaps enforced here
+
+  RtuBus *next = nullptr; // registry list, immutable once published
+
+private:
+  friend class RtuBuses;
+
+  std::shared_ptr<ModbusClientPort> m_port;
+  std::mutex m_mutex;
+  std::condition_variable m_turn;
+  uint64_t m_nextTicket = 0;
+  uint64_t m_serving = 0;
+  std::chrono::steady_clock::time_point m_idleFrom{}; // earliest next frame
+};
+
+/* ---------- Registry ---------- */
+
+// Process-wide buses keyed by device path, same append-only scheme as
+// ModbusMetrics. The first caller's line settings win; the port is opened
+// once and never closed, so drivers on a bus do not close it on Disconnect.
+class RtuBuses {
+public:
+  static RtuBuses &instance();
+
+  RtuBus *bus(const RtuLine &line, uint32_t timeoutMs);
+
+  template <typename Fn> void forEach(Fn &&fn) const {
+    for (const RtuBus *b = m_head.load(std::memory_order_acquire); b;
+         b = b->next)
+      fn(*b);
+  }
+
+private:
+  RtuBuses() = default;
+
+  std::mutex m_createMutex;
+  std::atomic<RtuBus *> m_head{nullptr};
+};
+
+#endif // RTU_BUS_H
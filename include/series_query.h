@@ -0,0 +1,81 @@
+#ifndef SERIES_QUERY_H
+#define SERIES_QUERY_H
+
+#include "channel_store.h"
+
+#include <cstdint>
+#include <functional>
+#include <sqlite3.h>
+#include <string>
+
+/* ---------- Downsampling query ---------- */
+
+// A raw sample has min == max == value; a tier row carries its interval's
+// average and envelope.
+struct SeriesPoint {
+  int64_t ts;
+  double value;
+  double min, max;
+};
+
+// Chart-sized reads of one channel of one meter from the channel store:
+// never more than the requested number of results however long the range,
+// streamed to the callback as they are produced. Bucket mode holds one
+// aggregate at a time, LTTB at most two buckets of points.
+//
+// Meant for a Storage reader() connection, so a long scan never holds up
+// the poll loop's writes.
+class SeriesQuery {
+public:
+  explicit SeriesQuery(sqlite3 *db) : m_db(db), m_samples(db) {}
+
+  // Key of a meter in the channel store; -1 if it has none.
+  int64_t unitKey(const std::string &gateway_ip, int unit_id);
+
+  // Finest source still holding data at `fromMs`: nullptr for the samples
+  // (CHANNEL_RETENTION_DAYS), else the first AGG_TIERS entry whose retention
+  // reaches back that far, or the coarsest when none does.
+  static const AggTier *sourceFor(int64_t fromMs, int64_t nowMs);
+
+  // At most `buckets` equal-width time buckets over [fromMs, toMs); empty
+  // buckets are left out. Return false from `out` to stop.
+  //
+  // Buckets are merged from sourceFor(fromMs), so a range older than the
+  // samples reads the finest tier still covering it, or from the coarsest
+  // tier (AGG_TIERS) that fits in a bucket when that is coarser. With a
+  // tier, the width is rounded up to whole intervals and the first bucket
+  // starts on an interval boundary at or before `fromMs`.
+  bool buckets(uint16_t channel, int64_t unitKey, int64_t fromMs,
+               int64_t toMs, size_t buckets,
+               const std::function<bool(const SeriesAggregate &)> &out);
+
+  // Largest-Triangle-Three-Buckets over equal-width time buckets: at most
+  // `points` points, the first and last of the range included, picked to
+  // keep the visual shape (peaks survive, unlike averaging). Below 3 points
+  // there is no middle bucket: 1 gives the first point, 2 the first and
+  // last.
+  //
+  // Points are raw samples while the samples still reach back to `fromMs`,
+  // else the rows of sourceFor()'s tier, picked by their average. `source`,
+  // if given, receives the tier used (nullptr for the samples).
+  bool lttb(uint16_t channel, int64_t unitKey, int64_t fromMs, int64_t toMs,
+            size_t points, const std::function<bool(const SeriesPoint &)> &out,
+            const AggTier **source = nullptr);
+
+private:
+  sqlite3 *m_db;
+  ChannelStore m_samples;
+};
+
+// Body of GET /series (metrics HTTP server). Query parameters:
+//   channel  channel ID (register_map.h), required
+//   gateway, unit  the meter
+//   from, to  epoch ms, default the last 24 h
+//   points  default 300, at most 10000
+//   method  lttb (default) or buckets
+// LTTB points are [ts, value] raw samples, or [ts, avg, min, max] tier rows
+// when the range starts before the samples' retention; "source" names which.
+// `status` is set to an HTTP status line on errors.
+std::string renderSeriesJson(const std::string &query, std::string &status);
+
+#endif // SERIES_QUERY_H
@@ -0,0 +1,135 @@
+#ifndef SNAPSHOT_STORE_H
+#define SNAPSHOT_STORE_H
+
+#include "block_snapshot.h"
+#include "channel_store.h"
+#include "register_map.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <span>
+#include <sqlite3.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Raw images are small (~320 bytes per iPM2xxx poll); keep them long enough
+// to re-derive a week of values after a register-map fix.
+constexpr int RAW_RETENTION_DAYS = 7;
+
+// Setup and pruning run at most this often per database file; create() is
+// called every poll cycle.
+constexpr int64_t RAW_MAINTENANCE_MS = 3600 * 1000;
+
+/* ---------- Raw image ---------- */
+
+// Layout of the BLOB, all integers little-endian:
+//
+//   u8 format (RAW_FORMAT_VERSION)   u8 block count
+//   per block: u16 start, u16 count, count x u16 register words
+//
+// A block whose read failed is stored with count 0.
+constexpr uint8_t RAW_FORMAT_VERSION = 1;
+
+// The register blocks of one poll, decoded only when a value is asked for.
+// Views the BLOB it was parsed from; that buffer must outlive it.
+class RawImage {
+public:
+  static std::vector<uint8_t>
+  pack(std::initializer_list<const BlockSnapshot *> blocks);
+
+  // False if the format is unknown or the BLOB is truncated.
+  bool parse(const void *blob, int bytes);
+
+  // Copies registers [address, address + count) from the block covering
+  // them; false if no block does.
+  bool words(uint16_t address, uint16_t count, uint16_t *out) const;
+
+  // Value of one channel; NaN if its registers were not read.
+  double value(const RegisterDesc &desc) const;
+
+  size_t blocks() const { return m_blocks.size(); }
+
+private:
+  struct Block {
+    uint16_t start;
+    uint16_t count;
+    const uint8_t *data;
+  };
+  std::vector<Block> m_blocks;
+};
+
+/* ---------- Snapshot store ---------- */
+
+// One row per poll and meter holding the raw register blocks:
+//
+//   raw_snapshots(unit_key, ts, map_version, blocks)  WITHOUT ROWID,
+//                                                      PRIMARY KEY (unit_key, ts)
+//   register_maps(model, version, descriptors, first_seen)
+//
+// A poll costs one small insert however many registers were read. Values are
+// decoded at query time with the current register map; `map_version` (see
+// map_version() in register_map.h) records the map in force when the row was
+// written, and register_maps keeps each version's descriptor list, so values
+// derived under a map that turned out wrong can be found and re-derived.
+class SnapshotStore {
+public:
+  explicit SnapshotStore(sqlite3 *db);
+  ~SnapshotStore();
+  SnapshotStore(const SnapshotStore &) = delete;
+  SnapshotStore &operator=(const SnapshotStore &) = delete;
+
+  // Opt-in (RAW_SNAPSHOTS=1).
+  static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+  static void setEnabled(bool on) { s_enabled.store(on); }
+
+  // Store on `db`; nullptr when disabled or the tables cannot be created.
+  // The first call per file, then one per RAW_MAINTENANCE_MS, also sets up
+  // the tables and prunes images past their retention.
+  static std::unique_ptr<SnapshotStore> create(sqlite3 *db);
+
+  bool setup();
+
+  int64_t unitKey(const std::string &gateway_ip, int unit_id,
+                  const std::string &model);
+
+  bool append(int64_t unitKey, int64_t tsMs, uint32_t mapVersion,
+              std::initializer_list<const BlockSnapshot *> blocks);
+
+  // Streams the images of one meter in [fromMs, toMs), time order. The image
+  // is only valid during the call. Return false from `fn` to stop.
+  bool scan(int64_t unitKey, int64_t fromMs, int64_t toMs,
+            const std::function<bool(int64_t ts, uint32_t mapVersion,
+                                     const RawImage &image)> &fn);
+
+  // One channel decoded on the fly from the images.
+  bool scanChannel(const RegisterDesc &desc, int64_t unitKey, int64_t fromMs,
+                   int64_t toMs,
+                   const std::function<bool(int64_t, double)> &fn);
+
+  // Re-decodes the images of [fromMs, toMs) with `list` and rewrites their
+  // samples in `channels`, then rebuilds the tier intervals those images
+  // cover, in one transaction. The range is clipped to the samples still
+  // kept (CHANNEL_RETENTION_DAYS); older tier rows are left untouched.
+  // Returns the number of images re-derived, -1 on error.
+  int64_t rederive(ChannelStore &channels, std::span<const RegisterDesc> list,
+                   int64_t unitKey, int64_t fromMs, int64_t toMs);
+
+  int64_t prune(int64_t beforeMs);
+
+private:
+  bool exec(const char *sql);
+
+  static std::atomic<bool> s_enabled;
+
+  sqlite3 *m_db;
+  sqlite3_stmt *m_insert = nullptr;
+  sqlite3_stmt *m_scan = nullptr;
+  std::map<std::pair<std::string, int>, int64_t> m_units;
+};
+
+#endif // SNAPSHOT_STORE_H
@@ -0,0 +1,234 @@
+#ifndef SQLITE_SCHEMA_H
+#define SQLITE_SCHEMA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Adds `column` to an existing `table` unless it is already there.
+// CREATE TABLE IF NOT EXISTS leaves databases created by an older build
+// untouched, so columns added later are migrated with this.
+inline bool ensure_column(sqlite3 *db, const char *table, const char *column,
+                          const char *decl) {
+  std::string sql = std::string("PRAGMA table_info(") + table + ");";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK)
+    return false;
+  bool found = false;
+  while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+    const unsigned char *name = sqlite3_column_text(stmt, 1);
+    found = name && std::string(reinterpret_cast<const char *>(name)) == column;
+  }
+  sqlite3_finalize(stmt);
+  if (found)
+    return true;
+
+  char *errMsg = 0;
+  sql = std::string("ALTER TABLE ") + table + " ADD COLUMN " + column + " " +
+        decl + ";";
+  if (sqlite3_exec(db, sql.c_str(), 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (add column " << table << "." << column
+              << "): " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+    return false;
+  }
+  return true;
+}
+
+/* ---------- Generated table statements ---------- */
+
+enum class ColType : uint8_t { Integer, Real, Text };
+
+// One column of a table whose CREATE TABLE, INSERT and binds are generated
+// at compile time. `extra` is appended to the declaration; columns with
+// `inserted` false are left to their default by the INSERT.
+struct ColumnDesc {
+  const char *name;
+  ColType type;
+  const char *extra = "";
+  bool inserted = true;
+};
+
+template <size_t N>
+constexpr size_t inserted_count(const ColumnDesc (&cols)[N]) {
+  size_t n = 0;
+  for (const ColumnDesc &c : cols)
+    n += c.inserted;
+  return n;
+}
+
+// Bind position (0-based) of `name` in the generated INSERT. Throws, which
+// is a compile error in a constant expression, if no inserted column has
+// that name.
+template <size_t N>
+constexpr size_t column_index(const ColumnDesc (&cols)[N],
+                              std::string_view name) {
+  size_t pos = 0;
+  for (const ColumnDesc &c : cols) {
+    if (!c.inserted)
+      continue;
+    if (name == c.name)
+      return pos;
+    pos++;
+  }
+  throw "no inserted column of that name";
+}
+
+// SQL text of a known length, built at compile time.
+template <size_t Len> struct SqlText {
+  char text[Len + 1] = {};
+  constexpr const char *c_str() const { return text; }
+};
+
+// Appends to `out`, or only measures when it is null.
+struct SqlWriter {
+  char *out = nullptr;
+  size_t len = 0;
+
+  constexpr SqlWriter &operator<<(std::string_view s) {
+    for (char c : s) {
+      if (out)
+        out[len] = c;
+      len++;
+    }
+    return *this;
+  }
+};
+
+// Runs `Write` once to size the text and once to fill it.
+template <auto Write> consteval auto make_sql() {
+  constexpr size_t len = [] {
+    SqlWriter w;
+    Write(w);
+    return w.len;
+  }();
+  SqlText<len> sql;
+  SqlWriter w{sql.text};
+  Write(w);
+  return sql;
+}
+
+constexpr std::string_view col_type_name(ColType t) {
+  return t == ColType::Integer ? "INTEGER" : t == ColType::Real ? "REAL"
+                                                                : "TEXT";
+}
+
+template <size_t N>
+constexpr void write_create_table(SqlWriter &w, std::string_view table,
+                                  const ColumnDesc (&cols)[N]) {
+  w << "CREATE TABLE IF NOT EXISTS " << table << " (";
+  for (size_t i = 0; i < N; i++) {
+    w << (i ? ", " : "") << cols[i].name << " " << col_type_name(cols[i].type);
+    if (*cols[i].extra)
+      w << " " << cols[i].extra;
+  }
+  w << ");";
+}
+
+// "a, b, c" over the inserted columns, in bind order.
+template <size_t N>
+constexpr void write_column_list(SqlWriter &w, const ColumnDesc (&cols)[N]) {
+  bool first = true;
+  for (const ColumnDesc &c : cols) {
+    if (!c.inserted)
+      continue;
+    w << (first ? "" : ", ") << c.name;
+    first = false;
+  }
+}
+
+template <size_t N>
+constexpr void write_insert(SqlWriter &w, std::string_view table,
+                            const ColumnDesc (&cols)[N]) {
+  w << "INSERT INTO " << table << " (";
+  write_column_list(w, cols);
+  w << ") VALUES (";
+  for (size_t i = 0; i < inserted_count(cols); i++)
+    w << (i ? ", ?" : "?");
+  w << ");";
+}
+
+union ColumnValue {
+  int64_t integer;
+  double real;
+  const char *text; // not copied; must outlive the bind
+};
+
+// One row for the generated INSERT of `Columns`. Values sit in bind order
+// in one contiguous array and are bound by a single loop. set<I>() takes a
+// compile-time position (column_index) and checks the value against the
+// column type, so a wrong column or type does not compile.
+template <const auto &Columns> class SqlRow {
+public:
+  static constexpr size_t size = inserted_count(Columns);
+
+  template <size_t I, typename T> void set(T v) {
+    static_assert(I < size, "column position out of range");
+    constexpr ColType type = types[I];
+    if constexpr (type == ColType::Real) {
+      static_assert(std::is_arithmetic_v<T>, "REAL column");
+      m_values[I].real = double(v);
+    } else if constexpr (type == ColType::Integer) {
+      static_assert(std::is_integral_v<T>, "INTEGER column");
+      m_values[I].integer = int64_t(v);
+    } else {
+      static_assert(std::is_convertible_v<T, const char *>, "TEXT column");
+      m_values[I].text = v;
+    }
+  }
+
+  template <size_t I> auto get() const {
+    static_assert(I < size, "column position out of range");
+    if constexpr (types[I] == ColType::Real)
+      return m_values[I].real;
+    else if constexpr (types[I] == ColType::Integer)
+      return m_values[I].integer;
+    else
+      return m_values[I].text;
+  }
+
+  // Run-time positions, for loops over descriptor tables whose positions
+  // were resolved at compile time.
+  void setReal(size_t i, double v) { m_values[i].real = v; }
+  void setInteger(size_t i, int64_t v) { m_values[i].integer = v; }
+
+  // Resets `stmt` and binds every value in one pass.
+  bool bind(sqlite3_stmt *stmt) const {
+    sqlite3_reset(stmt);
+    for (size_t i = 0; i < size; i++) {
+      int pos = int(i) + 1, rc;
+      switch (types[i]) {
+      case ColType::Integer:
+        rc = sqlite3_bind_int64(stmt, pos, m_values[i].integer);
+        break;
+      case ColType::Real:
+        rc = sqlite3_bind_double(stmt, pos, m_values[i].real);
+        break;
+      default:
+        rc = sqlite3_bind_text(stmt, pos, m_values[i].text, -1, SQLITE_STATIC);
+      }
+      if (rc != SQLITE_OK)
+        return false;
+    }
+    return true;
+  }
+
+private:
+  static constexpr std::array<ColType, size> types = [] {
+    std::array<ColType, size> t{};
+    size_t i = 0;
+    for (const ColumnDesc &c : Columns)
+      if (c.inserted)
+        t[i++] = c.type;
+    return t;
+  }();
+
+  std::array<ColumnValue, size> m_values{};
+};
+
+#endif // SQLITE_SCHEMA_H
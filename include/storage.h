@@ -0,0 +1,92 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <utility>
+
+/* ---------- Database file ---------- */
+
+// One database file of the collector and the only connections the process
+// holds to it:
+//
+//   writer  read-write, WAL. Every INSERT / UPDATE / DELETE: poller,
+//           publisher bookkeeping, rollups, retention.
+//   reader  SQLITE_OPEN_READONLY + query_only. Range scans and exports read
+//           a consistent snapshot under WAL without blocking the writer.
+//
+// Both are opened on first use and stay open until close(), so the page
+// cache and prepared schema survive from one poll cycle to the next.
+class Database {
+public:
+  explicit Database(std::string path) : m_path(std::move(path)) {}
+  ~Database() { close(); }
+  Database(const Database &) = delete;
+  Database &operator=(const Database &) = delete;
+
+  // nullptr if the file cannot be opened; retried on the next call.
+  sqlite3 *writer();
+  sqlite3 *reader();
+
+  // Closes both connections. Statements still open on them are finalized
+  // by their owners first; a connection with leftovers is closed lazily.
+  void close();
+
+  const std::string &path() const { return m_path; }
+
+private:
+  std::mutex m_mutex;
+  std::string m_path;
+  sqlite3 *m_writer = nullptr;
+  sqlite3 *m_reader = nullptr;
+};
+
+/* ---------- Storage service ---------- */
+
+// The collector's database files, opened once per process and shared by
+// Read_*, Sync_HistoryLog and the Publish_* stages. Paths are relative to
+// the working directory, as before.
+class Storage {
+public:
+  static Storage &instance();
+
+  Database &a9() { return m_a9; } // iA9MEM15.db: readings
+  Database &pm() { return m_pm; } // iPM2xxx.db: readings_pm2xxx and friends
+
+  void close();
+
+private:
+  Storage() = default;
+
+  Database m_a9{"iA9MEM15.db"};
+  Database m_pm{"iPM2xxx.db"};
+};
+
+/* ---------- Maintenance schedule ---------- */
+
+// Last run of the periodic jobs of a store (setup, retention deletes), per
+// database file and job, so the stores created every cycle only do them
+// once per interval:
+//
+//   if (MaintenanceSchedule::instance().due(db, "raw", now, RAW_MAINTENANCE_MS))
+//     { ...; MaintenanceSchedule::instance().done(db, "raw", now); }
+class MaintenanceSchedule {
+public:
+  static MaintenanceSchedule &instance();
+
+  // True on the first call for (file of `db`, job), then once `intervalMs`
+  // has passed since done().
+  bool due(sqlite3 *db, const char *job, int64_t nowMs, int64_t intervalMs);
+  void done(sqlite3 *db, const char *job, int64_t nowMs);
+
+private:
+  MaintenanceSchedule() = default;
+
+  std::mutex m_mutex;
+  std::map<std::pair<std::string, std::string>, int64_t> m_last; // epoch ms
+};
+
+#endif // STORAGE_H
@@ -0,0 +1,64 @@
+#ifndef STORAGE_UNITS_H
+#define STORAGE_UNITS_H
+
+#include <cstdint>
+#include <iostream>
+#include <sqlite3.h>
+#include <string>
+
+// units(unit_key, gateway_ip, unit_id, model): a small integer key per meter
+// so the long-format tables do not repeat the gateway string in every row.
+inline bool SetupUnitsTable(sqlite3 *db) {
+  char *errMsg = 0;
+  const char *sql = "CREATE TABLE IF NOT EXISTS units ("
+                    "unit_key INTEGER PRIMARY KEY, "
+                    "gateway_ip TEXT, unit_id INTEGER, model TEXT, "
+                    "UNIQUE (gateway_ip, unit_id)"
+                    ");";
+  if (sqlite3_exec(db, sql, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (create table units): " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+    return false;
+  }
+  return true;
+}
+
+// Key of an existing meter; -1 if it has none (read-only connections too).
+inline int64_t Find_UnitKey(sqlite3 *db, const std::string &gateway_ip,
+                            int unit_id) {
+  int64_t key = -1;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT unit_key FROM units "
+                         "WHERE gateway_ip = ? AND unit_id = ?;",
+                         -1, &stmt, 0) == SQLITE_OK) {
+    sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, unit_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+      key = sqlite3_column_int64(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return key;
+}
+
+// Key of a meter, created on first use; -1 on error.
+inline int64_t Lookup_UnitKey(sqlite3 *db, const std::string &gateway_ip,
+                              int unit_id, const std::string &model) {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "INSERT OR IGNORE INTO units (gateway_ip, unit_id, "
+                         "model) VALUES (?, ?, ?);",
+                         -1, &stmt, 0) == SQLITE_OK) {
+    sqlite3_bind_text(stmt, 1, gateway_ip.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, unit_id);
+    sqlite3_bind_text(stmt, 3, model.c_str(), -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+  }
+  sqlite3_finalize(stmt);
+  int64_t key = Find_UnitKey(db, gateway_ip, unit_id);
+  if (key < 0)
+    std::cerr << "SQL error (units): " << sqlite3_errmsg(db) << std::endl;
+  return key;
+}
+
+#endif // STORAGE_UNITS_H
@@ -0,0 +1,135 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/* ---------- Trace events ---------- */
+
+// One complete span ("ph":"X" in Chrome trace-event terms). Every field is a
+// relaxed atomic so a dump can read a slot while its owner thread overwrites
+// it; `seq` tells the reader whether the copy it took is consistent.
+struct TraceSlot {
+  std::atomic<uint64_t> seq{0}; // index + 1 once written, 0 while writing
+  std::atomic<const char *> name{nullptr};
+  std::atomic<const char *> cat{nullptr};
+  std::atomic<uint64_t> startNs{0};
+  std::atomic<uint64_t> durNs{0};
+  std::atomic<int64_t> arg{0};
+};
+
+// Per-thread ring buffer. Only its owner thread writes; readers copy.
+//
+// A ring outlives its thread so a dump still shows finished threads, and is
+// handed to the next new thread once its owner has exited (dropping the old
+// spans): the registry holds as many rings as threads ever ran at once.
+struct TraceRing {
+  static constexpr uint64_t CAPACITY = 1 << 14;
+  static constexpr size_t NAME_SIZE = 64;
+
+  TraceSlot slots[CAPACITY];
+  std::atomic<uint64_t> head{0}; // number of spans ever written
+  std::atomic<bool> free{false}; // owner exited, reusable
+
+  // Owner of the spans from `begin` on: its tid and display name
+  // (NUL-terminated, truncated to NAME_SIZE - 1). Written as a seqlock (odd
+  // `ownerSeq` while writing), like TraceSlot, so a dump never reads a
+  // half-written name or pairs one owner's tid with another's spans.
+  std::atomic<uint32_t> ownerSeq{0};
+  std::atomic<int> tid{0};
+  std::atomic<uint64_t> begin{0};
+  std::atomic<char> threadName[NAME_SIZE] = {};
+
+  struct Owner {
+    int tid;
+    uint64_t begin, head; // spans [begin, head) are this owner's
+    char name[NAME_SIZE];
+  };
+
+  // Starts the spans of a new owner (the ring's first or a reuse).
+  void setOwner(int ownerTid, const std::string &name);
+  void setName(const std::string &name);
+  // Copy of the owner; false if it was being rewritten meanwhile.
+  bool readOwner(Owner &out) const;
+
+  TraceRing *next = nullptr; // registry list, immutable once published
+
+private:
+  void writeOwner(int ownerTid, uint64_t from, const std::string &name);
+};
+
+/* ---------- Tracer ---------- */
+
+// Process-wide span recorder.
+//
+// Spans are written into a ring owned by the recording thread, so the hot
+// path is two clock reads and a handful of relaxed stores, no locks and no
+// allocation (names must be string literals). Old spans are overwritten once
+// a ring is full. Dumps walk every ring and emit Chrome / Perfetto JSON
+// (load in chrome://tracing or ui.perfetto.dev).
+class Trace {
+public:
+  static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+  static void setEnabled(bool on) { s_enabled.store(on); }
+
+  // Nanoseconds since the trace epoch (first use), steady clock.
+  static uint64_t nowNs();
+
+  static void record(const char *cat, const char *name, uint64_t startNs,
+                     uint64_t durNs, int64_t arg);
+
+  // Label for the calling thread in the dump (defaults to its tid). Call it
+  // before the thread records its first span.
+  static void setThreadName(const std::string &name);
+
+  static void writeChromeJson(std::ostream &out);
+  static bool writeChromeJsonFile(const std::string &path);
+
+  // Dumps to `path` whenever the process receives SIGUSR1. The handler only
+  // raises a flag; a small watcher thread does the file I/O.
+  static void dumpOnSignal(const std::string &path);
+
+private:
+  static TraceRing *ring(const std::string *name = nullptr);
+
+  static std::atomic<bool> s_enabled;
+};
+
+/* ---------- Scoped span ---------- */
+
+class TraceSpan {
+public:
+  TraceSpan(const char *cat, const char *name, int64_t arg = 0)
+      : m_cat(cat), m_name(name), m_arg(arg),
+        m_start(Trace::enabled() ? Trace::nowNs() : 0) {}
+
+  ~TraceSpan() { end(); }
+
+  // Closes the span early (e.g. before the enclosing block finishes).
+  void end() {
+    if (m_start)
+      Trace::record(m_cat, m_name, m_start, Trace::nowNs() - m_start, m_arg);
+    m_start = 0;
+  }
+
+  void setArg(int64_t arg) { m_arg = arg; }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *m_cat;
+  const char *m_name;
+  int64_t m_arg;
+  uint64_t m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// TRACE_SCOPE("poll", "device", unitId);
+#define TRACE_SCOPE(...) TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(__VA_ARGS__)
+
+#endif // TRACE_H
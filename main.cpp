@@ -1,28 +1,218 @@
-#include "Read_iA9MEM15.h"
-#include "Read_iPM2xxx.h"
+#include "Run_Cycle.h"
 #include "ThingsBoardClient.h"
-#include "energy_calc.h"
+#include "channel_store.h"
+#include "snapshot_store.h"
+#include "storage.h"
+#include "discovery.h"
+#include "maintenance.h"
+#include "metrics_http.h"
+#include "modbus_facade.h"
+#include "modbus_metrics.h"
+#include "pipeline_metrics.h"
+#include "trace.h"
 
 #include <sqlite3.h>
 #include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 constexpr int SEND_INTERVAL_SEC = 60;
 
+// Commissioning: scan unit IDs on each gateway and write the inventory.
+static int runDiscovery(int argc, char *argv[]) {
+    std::vector<GatewayAddress> gateways;
+    for (int i = 2; i < argc; i++)
+        gateways.push_back(GatewayAddress::parse(argv[i]));
+    if (gateways.empty())
+        gateways.push_back(GatewayAddress::parse("192.168.100.28:502"));
+
+    DiscoveryOptions options;
+    if (const char *env = std::getenv("DISCOVERY_TIMEOUT_MS"))
+        options.probeTimeoutMs = std::atoi(env);
+    if (const char *env = std::getenv("DISCOVERY_WORKERS"))
+        options.workersPerGateway = std::atoi(env);
+    const char *fileEnv = std::getenv("DISCOVERY_FILE");
+    std::string file = fileEnv ? fileEnv : "inventory.json";
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<DiscoveredDevice> devices = discoverDevices(gateways, options);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    for (const DiscoveredDevice &d : devices)
+        std::cout << d.gateway << "  unit " << int(d.unit) << "  " << d.model
+                  << "  (" << d.meterModel << ", product " << d.productId
+                  << ")  " << d.meterName << std::endl;
+    std::cout << devices.size() << " device(s) found in " << seconds << " s"
+              << std::endl;
+
+    if (!writeInventoryJsonFile(file, devices)) {
+        std::cerr << "Cannot write " << file << std::endl;
+        return 1;
+    }
+    std::cout << "Inventory written to " << file << std::endl;
+    return 0;
+}
+
+// Maintenance: consistent copies of both DB files while the service keeps
+// polling (WAL); no need to stop it.
+static int runBackup(int argc, char *argv[]) {
+    std::string dir = argc >= 3 ? argv[2] : "backup";
+    BackupOptions options;
+    if (const char *env = std::getenv("BACKUP_PAGES_PER_STEP"))
+        options.pagesPerStep = std::atoi(env);
+    if (const char *env = std::getenv("BACKUP_STEP_SLEEP_MS"))
+        options.sleepMs = std::atoi(env);
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    int failed = 0;
+    for (Database *db : {&Storage::instance().a9(), &Storage::instance().pm()}) {
+        sqlite3 *src = db->reader();
+        if (!src || !Backup_Database(src, dir + "/" + db->path(), options))
+            failed++;
+    }
+    Storage::instance().close();
+    return failed ? 1 : 0;
+}
+
+// Maintenance: one table's rows in [from, to) (epoch s) to stdout.
+static int runExport(int argc, char *argv[]) {
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --export <iA9MEM15.db|iPM2xxx.db> <table> <from> <to>"
+                     " [csv|columnar]\n";
+        return 1;
+    }
+    std::string file = argv[2];
+    Database *db = file == Storage::instance().a9().path() ? &Storage::instance().a9()
+                   : file == Storage::instance().pm().path() ? &Storage::instance().pm()
+                                                              : nullptr;
+    if (!db) {
+        std::cerr << "Unknown database " << file << std::endl;
+        return 1;
+    }
+    ExportFormat format = argc >= 7 && std::string(argv[6]) == "columnar"
+                              ? ExportFormat::Columnar
+                              : ExportFormat::Csv;
+    sqlite3 *src = db->reader();
+    int64_t rows = src ? Export_Range(src, argv[3], std::atoll(argv[4]),
+                                      std::atoll(argv[5]), format, std::cout)
+                       : -1;
+    Storage::instance().close();
+    if (rows < 0)
+        return 1;
+    std::cerr << rows << " row(s) exported" << std::endl;
+    return 0;
+}
+
+// Maintenance: after a register-map fix, rewrite the channel store of one
+// file over [from, to) (epoch s) from its raw snapshots. Only the samples
+// still kept (CHANNEL_RETENTION_DAYS) are rewritten.
+static int runRederive(int argc, char *argv[]) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --rederive <iA9MEM15.db|iPM2xxx.db> <from> <to>\n"
+                  << "Rewrites the samples of the last " << CHANNEL_RETENTION_DAYS
+                  << " days only; older tier rows are kept as they are.\n";
+        return 1;
+    }
+    std::string file = argv[2];
+    Database *db = file == Storage::instance().a9().path() ? &Storage::instance().a9()
+                   : file == Storage::instance().pm().path() ? &Storage::instance().pm()
+                                                              : nullptr;
+    if (!db) {
+        std::cerr << "Unknown database " << file << std::endl;
+        return 1;
+    }
+    sqlite3 *dst = db->writer();
+    int64_t rows = dst ? Rederive_Range(dst, std::atoll(argv[3]),
+                                        std::atoll(argv[4]))
+                       : -1;
+    Storage::instance().close();
+    if (rows < 0)
+        return 1;
+    std::cerr << rows << " snapshot(s) re-derived" << std::endl;
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
+    if (argc >= 2 && std::string(argv[1]) == "--discover")
+        return runDiscovery(argc, argv);
+    if (argc >= 2 && std::string(argv[1]) == "--backup")
+        return runBackup(argc, argv);
+    if (argc >= 2 && std::string(argv[1]) == "--export")
+        return runExport(argc, argv);
+    if (argc >= 2 && std::string(argv[1]) == "--rederive")
+        return runRederive(argc, argv);
+
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <TB_TOKEN>\n";
+        std::cerr << "Usage: " << argv[0] << " <TB_TOKEN>\n"
+                  << "       " << argv[0] << " --discover [host[:port] ...]\n"
+                  << "       " << argv[0] << " --backup [dir]\n"
+                  << "       " << argv[0]
+                  << " --export <db> <table> <from> <to> [csv|columnar]\n"
+                  << "       " << argv[0]
+                  << " --rederive <db> <from> <to>  (last " << CHANNEL_RETENTION_DAYS
+                  << " days)\n";
         return 1;
     }
 
     ThingsBoardClient tb(argv[1], "thingsboard.tricommtha.com");
     tb.connect();
 
-    sqlite3 *dbA9 = nullptr;
-    sqlite3 *dbPM = nullptr;
-    sqlite3_open("iA9MEM15.db", &dbA9);
-    sqlite3_open("iPM2xxx.db", &dbPM);
+    const std::vector<CycleGateway> gateways = {
+        {"192.168.100.28", 502, {100, 101, 102}, {1}},
+    };
+
+    // One writer connection per DB file, shared with the Read_* stages
+    sqlite3 *dbA9 = Storage::instance().a9().writer();
+    sqlite3 *dbPM = Storage::instance().pm().writer();
+
+    // Narrow (channel, unit, ts) -> value copy of every polled register
+    const char *channelEnv = std::getenv("CHANNEL_STORE");
+    ChannelStore::setEnabled(channelEnv && std::string(channelEnv) == "1");
+    // Raw register blocks per poll, decodable with any register-map version
+    const char *rawEnv = std::getenv("RAW_SNAPSHOTS");
+    SnapshotStore::setEnabled(rawEnv && std::string(rawEnv) == "1");
+
+    const char *metricsEnv = std::getenv("MODBUS_METRICS_FILE");
+    std::string metricsFile = metricsEnv ? metricsEnv : "modbus_metrics.json";
+
+    // Trace spans: kill -USR1 <pid> writes TRACE_FILE (PIPELINE_TRACE=0 disables)
+    const char *traceEnv = std::getenv("PIPELINE_TRACE");
+    Trace::setEnabled(!traceEnv || std::string(traceEnv) != "0");
+    Trace::setThreadName("poll loop");
+    const char *traceFile = std::getenv("TRACE_FILE");
+    Trace::dumpOnSignal(traceFile ? traceFile : "trace.json");
+
+    // OpenMetrics endpoint: http://<host>:9108/metrics (METRICS_PORT=0 disables)
+    const char *portEnv = std::getenv("METRICS_PORT");
+    int metricsPort = portEnv ? std::atoi(portEnv) : 9108;
+    MetricsHttpServer metricsServer(uint16_t(metricsPort > 0 ? metricsPort : 0));
+    if (metricsPort > 0 && !metricsServer.start())
+        std::cerr << "Metrics endpoint disabled" << std::endl;
+
+    // Modbus TCP façade for SCADA / HMI: serves the last values read from
+    // RAM under the meters' own register layout (MODBUS_FACADE_PORT, off by
+    // default). MODBUS_FACADE_UNITS remaps units, e.g. "11=192.168.100.28:502/1".
+    const char *facadePortEnv = std::getenv("MODBUS_FACADE_PORT");
+    const char *facadeUnitsEnv = std::getenv("MODBUS_FACADE_UNITS");
+    const char *facadeAgeEnv = std::getenv("MODBUS_FACADE_MAX_AGE_MS");
+    int facadePort = facadePortEnv ? std::atoi(facadePortEnv) : 0;
+    std::string facadeUnits = facadeUnitsEnv ? facadeUnitsEnv : "";
+    ModbusFacade facade(uint16_t(facadePort > 0 ? facadePort : 0), "0.0.0.0",
+                        facadeAgeEnv ? uint32_t(std::atol(facadeAgeEnv))
+                                     : 3 * SEND_INTERVAL_SEC * 1000);
+    if (facadePort > 0 && !facade.start()) {
+        std::cerr << "Modbus facade disabled" << std::endl;
+        facadePort = 0;
+    }
 
     while (true) {
         time_t now = time(nullptr);
@@ -40,373 +230,16 @@ int main(int argc, char *argv[]) {
         bool newMonth = (last_month != -1 && lt->tm_mon != last_month);
         last_month = lt->tm_mon;
 
+        Run_Cycle(gateways, dbA9, dbPM, tb, {newHour, newDay, newMonth}, {},
+                  [&] {
+                      if (facadePort > 0)
+                          facade.mapLive(facadeUnits); // devices seen for the first time
+                  });
 
-        Read_iA9MEM15({100,101,102}, "192.168.100.28", 502);
-        Read_iPM2xxx({1}, "192.168.100.28", 502);   
-        
-        /* ===== iA9MEM15 ===== */
-        const char *sqlA9 =
-            "SELECT id, timestamp, unit_id, voltage_an, current_a,"
-            " total_active_power, total_energy "
-            "FROM readings WHERE is_read=0 LIMIT 100;";
-
-        sqlite3_stmt *stmt = nullptr;
-        sqlite3_prepare_v2(dbA9, sqlA9, -1, &stmt, nullptr);
-
-       while (sqlite3_step(stmt) == SQLITE_ROW) {
-    int id       = sqlite3_column_int(stmt, 0);
-    int64_t ts   = sqlite3_column_int64(stmt, 1) * 1000;
-    int unit_id  = sqlite3_column_int(stmt, 2);
-
-    double voltage = sqlite3_column_double(stmt, 3);
-    double current = sqlite3_column_double(stmt, 4);
-    double power   = sqlite3_column_double(stmt, 5);
-    double energy  = sqlite3_column_double(stmt, 6);
-
-    JsonDocument doc;
-
-    // 🔑 สร้าง key แยกตาม unit_id
-    doc.set("voltage_iA9MEM15_" + std::to_string(unit_id), voltage);
-    doc.set("current_iA9MEM15_" + std::to_string(unit_id), current);
-    doc.set("power_iA9MEM15_"   + std::to_string(unit_id), power);
-    doc.set("energy_iA9MEM15_"  + std::to_string(unit_id), energy);
-
-    tb.sendTelemetry(ts, doc);
-
-    sqlite3_exec(
-        dbA9,
-        ("UPDATE readings SET is_read=1 WHERE id=" +
-         std::to_string(id)).c_str(),
-        nullptr, nullptr, nullptr);
-
-    std::cout << "Sent iA9MEM15 unit=" << unit_id
-              << " id=" << id << "\n";
-}
-
-        sqlite3_finalize(stmt);
+        /* ===== Modbus metrics snapshot ===== */
+        if (!ModbusMetrics::instance().writeJsonFile(metricsFile))
+            std::cerr << "Cannot write " << metricsFile << std::endl;
 
-        /* ===== iPM2xxx ===== */
-        const char *sqlPM =
-            "SELECT id, timestamp, unit_id, voltage_a, voltage_b, voltage_c, voltage_avg, current_a, current_b, current_c, current_avg, "
-            " active_power_total, frequency, total_energy, ActiveEnergyDeliveredIntoLoad, current_unbalanceA, current_unbalanceB, current_unbalanceC, current_unbalanceWorst, "
-            " ActiveEnergyReceived_OutofLoad, ActiveEnergyDeliveredPlussReceived, ActiveEnergyDeliveredDelReceived, ReactiveEnergyDelivered, ReactiveEnergyReceived, "
-            " ReactiveEnergyDeliveredPlussReceived, ReactiveEnergyDeliveredDelReceived, ApparentEnergyDelivered, ApparentEnergyReceived, ApparentEnergyDeliveredPlussReceived, ApparentEnergyDeliveredDelReceived, "
-            " ActivePowerA, ActivePowerB, ActivePowerC, ReactivePowerA, ReactivePowerB, ReactivePowerC, ApparentPowerA, ApparentPowerB, ApparentPowerC, "
-            " PowerFactorA, PowerFactorB, PowerFactorC, PowerDemandMethod, PowerDemandIntervalDuration, PowerDemandSubintervalDuration, PowerDemandElapsedTimeinInterval, PowerDemandElapsedTimeinSubinterval, "
-            " CurrentDemandMethod, CurrentDemandIntervalDuration, CurrentDemandElapsedTimein, CurrentDemandSubintervalDuration, CurrentDemandElapsedTimeinInterval, "
-            " VoltageAB, VoltageBC, VoltageCA, VoltageLLAvg, "
-            " VoltageUnbalanceAB, VoltageUnbalanceBC, VoltageUnbalanceCA, VoltageUnbalanceLLWorst, "
-            " VoltageUnbalanceAN, VoltageUnbalanceBN, VoltageUnbalanceCN, VoltageUnbalanceLNWorst, "
-            " DisplacementPowerFactorA, DisplacementPowerFactorB, DisplacementPowerFactorC, DisplacementPowerFactorTotal, "
-            "ActiveEnergyDeliveredIntoLoad64, ActiveEnergyReceivedOutofLoad64, ActiveEnergyDeliveredPlussReceived64, ActiveEnergyDeliveredDelReceived64 "
-            "FROM readings_pm2xxx WHERE is_read=0 LIMIT 5;";
-
-        sqlite3_prepare_v2(dbPM, sqlPM, -1, &stmt, nullptr); 
-
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            int id = sqlite3_column_int(stmt, 0);
-            int64_t ts = sqlite3_column_int64(stmt, 1) * 1000;
-             // 🔑 Wh สะสมจากมิเตอร์
-            int64_t currentWh =
-                (int64_t)sqlite3_column_double(stmt, 68);
-
-             // 🔥 คำนวณ delta
-             EnergyResult energy = calcEnergyFromWh(dbPM, currentWh);
-
-            if (energy.delta_kWh > 0) {
-                 JsonDocument energyDoc;
-                energyDoc.set("energy/second(kWh)", energy.delta_kWh);
-
-                int64_t now_ms =
-                std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count();
-
-                tb.sendTelemetry(now_ms, energyDoc);
-
-                  const char* sqlInsert =
-                    "INSERT INTO energy_delta (timestamp, delta_kwh) "
-                    "VALUES (?, ?);";
-
-                sqlite3_stmt* stmtIns = nullptr;
-                sqlite3_prepare_v2(dbPM, sqlInsert, -1, &stmtIns, nullptr);
-
-                sqlite3_bind_int64(stmtIns, 1, now_ms / 1000);   // เก็บเป็นวินาที
-                sqlite3_bind_double(stmtIns, 2, energy.delta_kWh);
-
-                sqlite3_step(stmtIns);
-                sqlite3_finalize(stmtIns);
-                    
-               // Sqlcleanupเก็บข้อมูลเก่า (> 1 วัน)
-                const char* sqlCleanup =
-                      "DELETE FROM energy_delta "
-                      "WHERE timestamp < strftime('%s','now','-1 day');";
-    
-                 char* err = nullptr;
-                 if (sqlite3_exec(dbPM, sqlCleanup, nullptr, nullptr, &err) != SQLITE_OK) {
-                      std::cerr << "SQLite cleanup error: " << err << std::endl;
-                      sqlite3_free(err);
-                 }
-
-            }
-                if (newHour) {
-                    const char* sql =
-                        "SELECT SUM(delta_kwh) "
-                        "FROM energy_delta "
-                        "WHERE strftime('%Y-%m-%d %H', timestamp, 'unixepoch', 'localtime') = "
-                        "strftime('%Y-%m-%d %H', 'now', '-1 hour', 'localtime');";
-                
-                    sqlite3_stmt* stmt = nullptr;
-                    sqlite3_prepare_v2(dbPM, sql, -1, &stmt, nullptr);
-                
-                    double hourly_kwh = 0.0;
-                    if (sqlite3_step(stmt) == SQLITE_ROW) {
-                        hourly_kwh = sqlite3_column_double(stmt, 0);
-                    }
-                    sqlite3_finalize(stmt);
-                
-                    // 👉 ส่งขึ้น ThingsBoard
-                    JsonDocument energyHourdoc;
-                    energyHourdoc.set("energy/hour(kWh)", hourly_kwh);
-                
-                    int64_t ts =
-                        std::chrono::duration_cast<std::chrono::milliseconds>(
-                            std::chrono::system_clock::now().time_since_epoch()).count();
-                        
-                    tb.sendTelemetry(ts, energyHourdoc);
-
-                     const char* sqlInsert =
-                    "INSERT INTO energy_delta_hourly (timestamp, delta_kwh_hour) "
-                    "VALUES (?, ?);";
-
-                    sqlite3_stmt* stmtIns = nullptr;
-                    sqlite3_prepare_v2(dbPM, sqlInsert, -1, &stmtIns, nullptr);
-
-                    sqlite3_bind_int64(stmtIns, 1, ts / 1000);   // เก็บเป็นวินาที
-                    sqlite3_bind_double(stmtIns, 2, hourly_kwh);
-
-                    sqlite3_step(stmtIns);
-                    sqlite3_finalize(stmtIns);
-                        
-                    // Sqlcleanupเก็บข้อมูลเก่า (> 7 วัน)
-                    const char* sqlCleanup =
-                          "DELETE FROM energy_delta_hourly "
-                          "WHERE timestamp < strftime('%s','now','-7 days');";
-                    char* err = nullptr;
-                    if (sqlite3_exec(dbPM, sqlCleanup, nullptr, nullptr, &err) != SQLITE_OK) {
-                        std::cerr << "SQLite cleanup error: " << err << std::endl;
-                        sqlite3_free(err);
-                    }
-                }
-
-                if (newDay) {
-                 // 1. รวมค่า kWh ของ "เมื่อวาน"
-                const char* sql =
-                    "SELECT SUM(delta_kwh_hour) "
-                    "FROM energy_delta_hourly "
-                    "WHERE strftime('%Y-%m-%d', timestamp, 'unixepoch', 'localtime') = "
-                    "strftime('%Y-%m-%d', 'now', '-1 day', 'localtime');";
-
-                sqlite3_stmt* stmt = nullptr;
-                sqlite3_prepare_v2(dbPM, sql, -1, &stmt, nullptr);
-
-                double daily_kwh = 0.0;
-                if (sqlite3_step(stmt) == SQLITE_ROW) {
-                    daily_kwh = sqlite3_column_double(stmt, 0);
-                }
-                sqlite3_finalize(stmt);
-            
-                // 2. ส่งขึ้น ThingsBoard
-                JsonDocument energyDayDoc;
-                energyDayDoc.set("energy/day(kWh)", daily_kwh);
-            
-                int64_t ts =
-                    std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::system_clock::now().time_since_epoch()).count();
-                    
-                tb.sendTelemetry(ts, energyDayDoc);
-                    
-                // 3. บันทึกลง DB (รายวัน)
-                const char* sqlInsert =
-                    "INSERT INTO energy_delta_daily (timestamp, delta_kwh_day) "
-                    "VALUES (?, ?);";
-                    
-                sqlite3_stmt* stmtIns = nullptr;
-                sqlite3_prepare_v2(dbPM, sqlInsert, -1, &stmtIns, nullptr);
-                    
-                sqlite3_bind_int64(stmtIns, 1, ts / 1000);  // เก็บเป็นวินาที
-                sqlite3_bind_double(stmtIns, 2, daily_kwh);
-                    
-                sqlite3_step(stmtIns);
-                sqlite3_finalize(stmtIns);
-                    
-                // Sqlcleanupเก็บข้อมูลเก่า (> 30 วัน)
-                const char* sqlCleanup =
-                      "DELETE FROM energy_delta_daily "
-                      "WHERE timestamp < strftime('%s','now','-30 days');";
-                char* err = nullptr;
-                if (sqlite3_exec(dbPM, sqlCleanup, nullptr, nullptr, &err) != SQLITE_OK) {
-                    std::cerr << "SQLite cleanup error: " << err << std::endl;
-                    sqlite3_free(err);
-                }
-            }
-
-            if (newMonth) {
-                // 1. รวมค่า kWh ของ "เดือนที่แล้ว"
-                const char* sql =
-                    "SELECT SUM(delta_kwh_day) "
-                    "FROM energy_delta_daily "
-                    "WHERE strftime('%Y-%m', timestamp, 'unixepoch', 'localtime') = "
-                    "strftime('%Y-%m', 'now', '-1 month', 'localtime');";
-
-                sqlite3_stmt* stmt = nullptr;
-                sqlite3_prepare_v2(dbPM, sql, -1, &stmt, nullptr);
-
-                double monthly_kwh = 0.0;
-                if (sqlite3_step(stmt) == SQLITE_ROW) {
-                    monthly_kwh = sqlite3_column_double(stmt, 0);
-                }
-                sqlite3_finalize(stmt);
-            
-                // 2. ส่งขึ้น ThingsBoard
-                JsonDocument energyMonthDoc;
-                energyMonthDoc.set("energy/month(kWh)", monthly_kwh);
-            
-                int64_t ts =
-                    std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::system_clock::now().time_since_epoch()).count();
-                    
-                tb.sendTelemetry(ts, energyMonthDoc);
-                    
-                // 3. บันทึกลง DB (รายเดือน)
-                const char* sqlInsert =
-                    "INSERT INTO energy_delta_monthly (timestamp, delta_kwh_month) "
-                    "VALUES (?, ?);";
-                    
-                sqlite3_stmt* stmtIns = nullptr;
-                sqlite3_prepare_v2(dbPM, sqlInsert, -1, &stmtIns, nullptr);
-                    
-                sqlite3_bind_int64(stmtIns, 1, ts / 1000);  // เก็บเป็นวินาที
-                sqlite3_bind_double(stmtIns, 2, monthly_kwh);
-                    
-                sqlite3_step(stmtIns);
-                sqlite3_finalize(stmtIns);
-                    
-                // Sqlcleanupเก็บข้อมูลเก่า (> 1 ปี)
-                const char* sqlCleanup =
-                      "DELETE FROM energy_delta_monthly "
-                      "WHERE timestamp < strftime('%s','now','-1 year');";
-                char* err = nullptr;
-                if (sqlite3_exec(dbPM, sqlCleanup, nullptr, nullptr, &err) != SQLITE_OK) {
-                    std::cerr << "SQLite cleanup error: " << err << std::endl;
-                    sqlite3_free(err); 
-                }
-            }
-            
-
-          JsonDocument doc;
-            doc.set("unit_id_iPM2xxx", sqlite3_column_int(stmt, 2));
-                    
-            doc.set("voltageA(V)_iPM2xxx", sqlite3_column_double(stmt, 3));
-            doc.set("voltageB(V)_iPM2xxx", sqlite3_column_double(stmt, 4));
-            doc.set("voltageC(V)_iPM2xxx", sqlite3_column_double(stmt, 5));
-            doc.set("voltageAvg(V)_iPM2xxx", sqlite3_column_double(stmt, 6));
-                    
-            doc.set("currentA(A)_iPM2xxx", sqlite3_column_double(stmt, 7));
-            doc.set("currentB(A)_iPM2xxx", sqlite3_column_double(stmt, 8));
-            doc.set("currentC(A)_iPM2xxx", sqlite3_column_double(stmt, 9));
-            doc.set("currentAvg(A)_iPM2xxx", sqlite3_column_double(stmt,10));
-                    
-            doc.set("activePowerTotal(W)_iPM2xxx", sqlite3_column_double(stmt,11));
-            doc.set("frequency(Hz)_iPM2xxx", sqlite3_column_double(stmt,12));
-            doc.set("totalEnergy(kWh)_iPM2xxx", sqlite3_column_double(stmt,13));
-            doc.set("ActiveEnergyDeliveredIntoLoad(kWh)_iPM2xxx", sqlite3_column_double(stmt,14));
-                    
-            doc.set("currentUnbalanceA(%)_iPM2xxx", sqlite3_column_double(stmt,15));
-            doc.set("currentUnbalanceB(%)_iPM2xxx", sqlite3_column_double(stmt,16));
-            doc.set("currentUnbalanceC(%)_iPM2xxx", sqlite3_column_double(stmt,17));
-            doc.set("currentUnbalanceWorst(%)_iPM2xxx", sqlite3_column_double(stmt,18));
-
-            doc.set("ActiveEnergyReceived_OutofLoad(kWh)_iPM2xxx", sqlite3_column_double(stmt,19));
-            doc.set("ActiveEnergyDeliveredPlussReceived(kWh)_iPM2xxx", sqlite3_column_double(stmt,20));
-            doc.set("ActiveEnergyDeliveredDelReceived(kWh)_iPM2xxx", sqlite3_column_double(stmt,21));
-                    
-            doc.set("ReactiveEnergyDelivered(kVARh)_iPM2xxx", sqlite3_column_double(stmt,22));
-            doc.set("ReactiveEnergyReceived(kVARh)_iPM2xxx", sqlite3_column_double(stmt,23));
-            doc.set("ReactiveEnergyDeliveredPlussReceived(kVARh)_iPM2xxx", sqlite3_column_double(stmt,24));
-            doc.set("ReactiveEnergyDeliveredDelReceived(kVARh)_iPM2xxx", sqlite3_column_double(stmt,25));
-                    
-            doc.set("ApparentEnergyDelivered(kVAh)_iPM2xxx", sqlite3_column_double(stmt,26));
-            doc.set("ApparentEnergyReceived(kVAh)_iPM2xxx", sqlite3_column_double(stmt,27));
-            doc.set("ApparentEnergyDeliveredPlussReceived(kVAh)_iPM2xxx", sqlite3_column_double(stmt,28));
-            doc.set("ApparentEnergyDeliveredDelReceived(kVAh)_iPM2xxx", sqlite3_column_double(stmt,29));
-                    
-            doc.set("ActivePowerA(kW)_iPM2xxx", sqlite3_column_double(stmt,30));
-            doc.set("ActivePowerB(kW)_iPM2xxx", sqlite3_column_double(stmt,31));
-            doc.set("ActivePowerC(kW)_iPM2xxx", sqlite3_column_double(stmt,32));
-                    
-            doc.set("ReactivePowerA(kVAR)_iPM2xxx", sqlite3_column_double(stmt,33));
-            doc.set("ReactivePowerB(kVAR)_iPM2xxx", sqlite3_column_double(stmt,34));
-            doc.set("ReactivePowerC(kVAR)_iPM2xxx", sqlite3_column_double(stmt,35));
-
-            doc.set("ApparentPowerA(kVA)_iPM2xxx", sqlite3_column_double(stmt,36));
-            doc.set("ApparentPowerB(kVA)_iPM2xxx", sqlite3_column_double(stmt,37));
-            doc.set("ApparentPowerC(kVA)_iPM2xxx", sqlite3_column_double(stmt,38));
-                    
-            doc.set("PowerFactorA(%)_iPM2xxx", sqlite3_column_double(stmt,39));
-            doc.set("PowerFactorB(%)_iPM2xxx", sqlite3_column_double(stmt,40));
-            doc.set("PowerFactorC(%)_iPM2xxx", sqlite3_column_double(stmt,41));
-                    
-            doc.set("PowerDemandMethod_iPM2xxx", sqlite3_column_int(stmt,42));
-            doc.set("PowerDemandIntervalDuration_iPM2xxx", sqlite3_column_int(stmt,43));
-            doc.set("PowerDemandSubintervalDuration_iPM2xxx", sqlite3_column_int(stmt,44));
-            doc.set("PowerDemandElapsedTimeInInterval_iPM2xxx", sqlite3_column_int(stmt,45));
-            doc.set("PowerDemandElapsedTimeInSubinterval_iPM2xxx", sqlite3_column_int(stmt,46));
-
-            doc.set("CurrentDemandMethod_iPM2xxx", sqlite3_column_int(stmt,47));
-            doc.set("CurrentDemandIntervalDuration_iPM2xxx", sqlite3_column_int(stmt,48));
-            doc.set("CurrentDemandElapsedTimein_iPM2xxx", sqlite3_column_int(stmt,49));
-            doc.set("CurrentDemandSubintervalDuration_iPM2xxx", sqlite3_column_int(stmt,50));
-            doc.set("CurrentDemandElapsedTimeinInterval_iPM2xxx", sqlite3_column_int(stmt,51));
-            doc.set("VoltageAB(V)_iPM2xxx", sqlite3_column_double(stmt,52));
-            doc.set("VoltageBC(V)_iPM2xxx", sqlite3_column_double(stmt,53));
-            doc.set("VoltageCA(V)_iPM2xxx", sqlite3_column_double(stmt,54));
-            doc.set("VoltageLLAvg(V)_iPM2xxx", sqlite3_column_double(stmt,55));
-
-            doc.set("VoltageUnbalanceAB(%)_iPM2xxx", sqlite3_column_double(stmt,56));;
-            doc.set("VoltageUnbalanceBC(%)_iPM2xxx", sqlite3_column_double(stmt,57));;
-            doc.set("VoltageUnbalanceCA(%)_iPM2xxx", sqlite3_column_double(stmt,58));;
-            doc.set("VoltageUnbalanceLLWorst(%)_iPM2xxx", sqlite3_column_double(stmt,59));;
-
-            doc.set("VoltageUnbalanceAN(%)_iPM2xxx", sqlite3_column_double(stmt,60));;
-            doc.set("VoltageUnbalanceBN(%)_iPM2xxx", sqlite3_column_double(stmt,61));;
-            doc.set("VoltageUnbalanceCN(%)_iPM2xxx", sqlite3_column_double(stmt,62));;
-            doc.set("VoltageUnbalanceLNWorst(%)_iPM2xxx", sqlite3_column_double(stmt,63));;
-
-            doc.set("DisplacementPowerFactorA_iPM2xxx", sqlite3_column_double(stmt,64));;
-            doc.set("DisplacementPowerFactorB_iPM2xxx", sqlite3_column_double(stmt,65));;
-            doc.set("DisplacementPowerFactorC_iPM2xxx", sqlite3_column_double(stmt,66));;
-            doc.set("DisplacementPowerFactorTotal_iPM2xxx", sqlite3_column_double(stmt,67));;
-
-            
-            doc.set("ActiveEnergyDeliveredIntoLoad64(Wh)_iPM2xxx", sqlite3_column_double(stmt,68));;
-            doc.set("ActiveEnergyReceivedOutofLoad64(Wh)_iPM2xxx", sqlite3_column_double(stmt,69));;
-            doc.set("ActiveEnergyDeliveredPlussReceived64(Wh)_iPM2xxx", sqlite3_column_double(stmt,70));;
-            doc.set("ActiveEnergyDeliveredDelReceived64(Wh)_iPM2xxx", sqlite3_column_double(stmt,71));;
-
-            tb.sendTelemetry(ts, doc);
-
-            sqlite3_exec(
-                dbPM,
-                ("UPDATE readings_pm2xxx SET is_read=1 WHERE id=" +
-                 std::to_string(id)).c_str(),
-                nullptr, nullptr, nullptr);
-
-            std::cout << "Sent iPM2xxx id=" << id << "\n";
-            std::cout << "⚡ Delta Energy = "
-                    << energy.delta_kWh << " kWh\n";
-        }
-        sqlite3_finalize(stmt);
-        
         std::this_thread::sleep_for(
             std::chrono::seconds(SEND_INTERVAL_SEC));
     }
@@ -0,0 +1,30 @@
+#include "A9MEM15.h"
+
+static const std::vector<RegisterBlock> A9MEM15_BLOCKS = {
+    {2999, 102}, // current ... internal temperature (3099)
+    {3203, 4},   // INT64 active energy
+};
+
+std::unique_ptr<A9MEM15> A9MEM15::createClient(uint8_t unitId,
+                                               const std::string &ipAddress,
+                                               int port,
+                                               int timeout,
+                                               int pollIntervalMs) {
+  auto client = std::make_unique<A9MEM15>(unitId, ipAddress, port, timeout,
+                                          pollIntervalMs);
+  client->m_poller.start();
+  return client;
+}
+
+A9MEM15::A9MEM15(uint8_t unitId, const std::string &ipAddress, int port,
+                 int timeout, int pollIntervalMs)
+    : m_poller(unitId, ipAddress, port, timeout, pollIntervalMs,
+               A9MEM15_BLOCKS, "iA9MEM15") {}
+
+A9MEM15::~A9MEM15() { Disconnect(); }
+
+bool A9MEM15::isConnected() const { return m_poller.ready(); }
+
+void A9MEM15::Disconnect() { m_poller.stop(); }
+
+int64_t A9MEM15::ageMs() const { return m_poller.snapshot().ageMs(); }
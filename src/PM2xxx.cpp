@@ -0,0 +1,32 @@
+#include "PM2xxx.h"
+
+// Registers kept in the cache (each block is a single FC03 request)
+static const std::vector<RegisterBlock> PM2XXX_BLOCKS = {
+    {2999, 112}, // currents, voltages, P/Q/S, PF, DPF ... frequency (3109)
+    {3203, 44},  // INT64 energies 3203..3246
+};
+
+std::unique_ptr<PM2xxx> PM2xxx::createClient(uint8_t unitId, const std::string& ipAddress, int port, int timeout, int pollIntervalMs) {
+    auto client = std::make_unique<PM2xxx>(unitId, ipAddress, port, timeout, pollIntervalMs);
+    client->m_poller.start();
+    return client;
+}
+
+PM2xxx::PM2xxx(uint8_t unitId, const std::string& ipAddress, int port, int timeout, int pollIntervalMs)
+    : m_poller(unitId, ipAddress, port, timeout, pollIntervalMs, PM2XXX_BLOCKS, "iPM2xxx") {}
+
+PM2xxx::~PM2xxx() {
+    Disconnect();
+}
+
+bool PM2xxx::isConnected() const {
+    return m_poller.ready();
+}
+
+void PM2xxx::Disconnect() {
+    m_poller.stop();
+}
+
+int64_t PM2xxx::ageMs() const {
+    return m_poller.snapshot().ageMs();
+}
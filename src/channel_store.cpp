@@ -0,0 +1,477 @@
+#include "channel_store.h"
+#include "pipeline_metrics.h"
+#include "storage.h"
+#include "storage_units.h"
+#include "trace.h"
+
+#include <iostream>
+
+std::atomic<bool> ChannelStore::s_enabled{false};
+
+namespace {
+
+template <size_t N>
+bool storeCatalogue(sqlite3_stmt *stmt, const char *model,
+                    const RegisterDesc (&list)[N]) {
+  for (const RegisterDesc &d : list) {
+    sqlite3_bind_int(stmt, 1, d.channel);
+    sqlite3_bind_text(stmt, 2, model, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, d.name, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, d.address);
+    sqlite3_bind_text(stmt, 5, d.unit, -1, SQLITE_STATIC);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// (channel, unit) pairs that can hold samples: a unit only has the channels
+// of its own model.
+constexpr const char *CHANNEL_UNIT_PAIRS =
+    "SELECT channel_id, unit_key FROM channels JOIN units USING (model);";
+
+} // namespace
+
+// ================= STORE =================
+
+ChannelStore::ChannelStore(sqlite3 *db) : m_db(db) {}
+
+std::unique_ptr<ChannelStore> ChannelStore::create(sqlite3 *db) {
+  if (!enabled() || !db)
+    return nullptr;
+  auto store = std::make_unique<ChannelStore>(db);
+  int64_t now = PipelineMetrics::wallMs();
+  MaintenanceSchedule &schedule = MaintenanceSchedule::instance();
+  if (!schedule.due(db, "channels", now, CHANNEL_MAINTENANCE_MS))
+    return store;
+  if (!store->setup())
+    return nullptr;
+  store->prune(now - int64_t(CHANNEL_RETENTION_DAYS) * 86400 * 1000);
+  store->pruneTiers(now);
+  schedule.done(db, "channels", now);
+  return store;
+}
+
+ChannelStore::~ChannelStore() {
+  sqlite3_finalize(m_insert);
+  sqlite3_finalize(m_replace);
+  sqlite3_finalize(m_scan);
+  sqlite3_finalize(m_aggFold);
+  sqlite3_finalize(m_aggScan);
+}
+
+bool ChannelStore::exec(const char *sql) {
+  char *errMsg = 0;
+  if (sqlite3_exec(m_db, sql, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (channel store): " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+    PipelineMetrics::instance().sqliteErrors.fetch_add(
+        1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool ChannelStore::setup() {
+  TRACE_SCOPE("store", "channel_setup");
+  if (!exec("CREATE TABLE IF NOT EXISTS samples ("
+            "channel_id INTEGER NOT NULL, "
+            "unit_key INTEGER NOT NULL, "
+            "ts INTEGER NOT NULL, " // epoch ms of the acquisition
+            "value REAL, "
+            "PRIMARY KEY (channel_id, unit_key, ts)"
+            ") WITHOUT ROWID;"
+            "CREATE TABLE IF NOT EXISTS samples_agg ("
+            "tier INTEGER NOT NULL, " // AggTier::id
+            "channel_id INTEGER NOT NULL, "
+            "unit_key INTEGER NOT NULL, "
+            "ts INTEGER NOT NULL, " // interval start, epoch ms
+            "count INTEGER, min REAL, max REAL, sum REAL, "
+            "first REAL, last REAL, "
+            "PRIMARY KEY (tier, channel_id, unit_key, ts)"
+            ") WITHOUT ROWID;"
+            "CREATE TABLE IF NOT EXISTS channels ("
+            "channel_id INTEGER PRIMARY KEY, "
+            "model TEXT, name TEXT, address INTEGER, unit TEXT"
+            ");") ||
+      !SetupUnitsTable(m_db))
+    return false;
+
+  // Catalogue rows only change when register_map.h does; the upsert is a
+  // no-op write otherwise.
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(
+          m_db,
+          "INSERT INTO channels (channel_id, model, name, address, unit) "
+          "VALUES (?, ?, ?, ?, ?) ON CONFLICT (channel_id) DO UPDATE SET "
+          "model = excluded.model, name = excluded.name, "
+          "address = excluded.address, unit = excluded.unit "
+          "WHERE name IS NOT excluded.name OR address IS NOT excluded.address "
+          "OR unit IS NOT excluded.unit OR model IS NOT excluded.model;",
+          -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (channel catalogue): " << sqlite3_errmsg(m_db)
+              << std::endl;
+    return false;
+  }
+  exec("BEGIN;");
+  bool ok = storeCatalogue(stmt, "iPM2xxx", PM_CHANNELS) &&
+            storeCatalogue(stmt, "iA9MEM15", A9_CHANNELS);
+  sqlite3_finalize(stmt);
+  exec(ok ? "COMMIT;" : "ROLLBACK;");
+  return ok;
+}
+
+int64_t ChannelStore::unitKey(const std::string &gateway_ip, int unit_id,
+                              const std::string &model) {
+  auto cached = m_units.find({gateway_ip, unit_id});
+  if (cached != m_units.end())
+    return cached->second;
+
+  int64_t key = Lookup_UnitKey(m_db, gateway_ip, unit_id, model);
+  if (key < 0)
+    return -1;
+  m_units[{gateway_ip, unit_id}] = key;
+  return key;
+}
+
+bool ChannelStore::append(int64_t unitKey, int64_t tsMs,
+                          const std::vector<ChannelSample> &samples) {
+  if (samples.empty())
+    return true;
+  TRACE_SCOPE("store", "channels", int64_t(samples.size()));
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  ScopedLatency commit(metrics.sqliteCommit);
+
+  if ((!m_insert &&
+       sqlite3_prepare_v2(m_db,
+                          "INSERT OR IGNORE INTO samples "
+                          "(channel_id, unit_key, ts, value) "
+                          "VALUES (?, ?, ?, ?);",
+                          -1, &m_insert, 0) != SQLITE_OK) ||
+      !prepareTiers()) {
+    std::cerr << "SQL error (samples): " << sqlite3_errmsg(m_db) << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // A savepoint rather than BEGIN so callers can batch many polls in one
+  // outer transaction.
+  exec("SAVEPOINT channels;");
+  std::map<uint16_t, SeriesAggregate> stored;
+  bool ok = true;
+  for (size_t i = 0; ok && i < samples.size(); i++) {
+    sqlite3_bind_int(m_insert, 1, samples[i].channel);
+    sqlite3_bind_int64(m_insert, 2, unitKey);
+    sqlite3_bind_int64(m_insert, 3, tsMs);
+    sqlite3_bind_double(m_insert, 4, samples[i].value);
+    ok = sqlite3_step(m_insert) == SQLITE_DONE;
+    if (ok && sqlite3_changes(m_db) > 0)
+      stored[samples[i].channel].add(samples[i].value);
+    sqlite3_reset(m_insert);
+  }
+  // All samples of a poll fall into the same interval of a tier: one upsert
+  // per (tier, channel) into that row, hot in the page cache for the whole
+  // interval.
+  for (const AggTier &tier : AGG_TIERS) {
+    for (auto &[channel, agg] : stored) {
+      if (!ok)
+        break;
+      agg.ts = tsMs - tsMs % tier.widthMs;
+      ok = foldTier(tier, channel, unitKey, agg);
+    }
+  }
+  if (!ok) {
+    std::cerr << "SQL error (samples): " << sqlite3_errmsg(m_db) << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+    exec("ROLLBACK TO channels; RELEASE channels;");
+    return false;
+  }
+  return exec("RELEASE channels;");
+}
+
+bool ChannelStore::rewrite(int64_t unitKey, int64_t tsMs,
+                           const std::vector<ChannelSample> &samples) {
+  if (!m_replace &&
+      sqlite3_prepare_v2(m_db,
+                         "INSERT OR REPLACE INTO samples "
+                         "(channel_id, unit_key, ts, value) "
+                         "VALUES (?, ?, ?, ?);",
+                         -1, &m_replace, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (samples): " << sqlite3_errmsg(m_db) << std::endl;
+    return false;
+  }
+  bool ok = true;
+  for (size_t i = 0; ok && i < samples.size(); i++) {
+    sqlite3_bind_int(m_replace, 1, samples[i].channel);
+    sqlite3_bind_int64(m_replace, 2, unitKey);
+    sqlite3_bind_int64(m_replace, 3, tsMs);
+    sqlite3_bind_double(m_replace, 4, samples[i].value);
+    ok = sqlite3_step(m_replace) == SQLITE_DONE;
+    sqlite3_reset(m_replace);
+  }
+  if (!ok) {
+    std::cerr << "SQL error (samples): " << sqlite3_errmsg(m_db) << std::endl;
+    PipelineMetrics::instance().sqliteErrors.fetch_add(
+        1, std::memory_order_relaxed);
+  }
+  return ok;
+}
+
+bool ChannelStore::scan(uint16_t channel, int64_t unitKey, int64_t fromMs,
+                        int64_t toMs,
+                        const std::function<bool(int64_t, double)> &fn) {
+  if (!m_scan &&
+      sqlite3_prepare_v2(m_db,
+                         "SELECT ts, value FROM samples "
+                         "WHERE channel_id = ? AND unit_key = ? "
+                         "AND ts >= ? AND ts < ? ORDER BY ts;",
+                         -1, &m_scan, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (samples scan): " << sqlite3_errmsg(m_db)
+              << std::endl;
+    return false;
+  }
+  sqlite3_bind_int(m_scan, 1, channel);
+  sqlite3_bind_int64(m_scan, 2, unitKey);
+  sqlite3_bind_int64(m_scan, 3, fromMs);
+  sqlite3_bind_int64(m_scan, 4, toMs);
+  int rc;
+  while ((rc = sqlite3_step(m_scan)) == SQLITE_ROW) {
+    if (!fn(sqlite3_column_int64(m_scan, 0), sqlite3_column_double(m_scan, 1)))
+      break;
+  }
+  sqlite3_reset(m_scan);
+  return rc == SQLITE_ROW || rc == SQLITE_DONE;
+}
+
+int64_t ChannelStore::prune(int64_t beforeMs) {
+  TRACE_SCOPE("store", "channel_prune");
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(m_db,
+                         "DELETE FROM samples WHERE channel_id = ?1 "
+                         "AND unit_key = ?2 AND ts < ?3;",
+                         -1, &stmt, 0) != SQLITE_OK)
+    return -1;
+  sqlite3_stmt *pairs = nullptr;
+  if (sqlite3_prepare_v2(m_db, CHANNEL_UNIT_PAIRS, -1, &pairs, 0) !=
+      SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return -1;
+  }
+
+  int64_t removed = 0;
+  exec("BEGIN;");
+  while (sqlite3_step(pairs) == SQLITE_ROW) {
+    sqlite3_bind_int64(stmt, 1, sqlite3_column_int64(pairs, 0));
+    sqlite3_bind_int64(stmt, 2, sqlite3_column_int64(pairs, 1));
+    sqlite3_bind_int64(stmt, 3, beforeMs);
+    if (sqlite3_step(stmt) == SQLITE_DONE)
+      removed += sqlite3_changes(m_db);
+    sqlite3_reset(stmt);
+  }
+  exec("COMMIT;");
+  sqlite3_finalize(pairs);
+  sqlite3_finalize(stmt);
+  return removed;
+}
+
+// ================= TIERS =================
+
+bool ChannelStore::prepareTiers() {
+  return m_aggFold ||
+         sqlite3_prepare_v2(
+             m_db,
+             "INSERT INTO samples_agg "
+             "(tier, channel_id, unit_key, ts, count, min, max, sum, first, "
+             "last) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+             "ON CONFLICT (tier, channel_id, unit_key, ts) DO UPDATE SET "
+             "count = count + excluded.count, "
+             "min = MIN(min, excluded.min), max = MAX(max, excluded.max), "
+             "sum = sum + excluded.sum, last = excluded.last;",
+             -1, &m_aggFold, 0) == SQLITE_OK;
+}
+
+bool ChannelStore::foldTier(const AggTier &tier, uint16_t channel,
+                            int64_t unitKey, const SeriesAggregate &agg) {
+  sqlite3_bind_int(m_aggFold, 1, tier.id);
+  sqlite3_bind_int(m_aggFold, 2, channel);
+  sqlite3_bind_int64(m_aggFold, 3, unitKey);
+  sqlite3_bind_int64(m_aggFold, 4, agg.ts);
+  sqlite3_bind_int64(m_aggFold, 5, agg.count);
+  sqlite3_bind_double(m_aggFold, 6, agg.min);
+  sqlite3_bind_double(m_aggFold, 7, agg.max);
+  sqlite3_bind_double(m_aggFold, 8, agg.sum);
+  sqlite3_bind_double(m_aggFold, 9, agg.first);
+  sqlite3_bind_double(m_aggFold, 10, agg.last);
+  bool ok = sqlite3_step(m_aggFold) == SQLITE_DONE;
+  sqlite3_reset(m_aggFold);
+  return ok;
+}
+
+bool ChannelStore::scanTier(
+    const AggTier &tier, uint16_t channel, int64_t unitKey, int64_t fromMs,
+    int64_t toMs, const std::function<bool(const SeriesAggregate &)> &fn) {
+  if (!m_aggScan &&
+      sqlite3_prepare_v2(m_db,
+                         "SELECT ts, count, min, max, sum, first, last "
+                         "FROM samples_agg WHERE tier = ? AND channel_id = ? "
+                         "AND unit_key = ? AND ts >= ? AND ts < ? "
+                         "ORDER BY ts;",
+                         -1, &m_aggScan, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (samples_agg scan): " << sqlite3_errmsg(m_db)
+              << std::endl;
+    return false;
+  }
+  sqlite3_bind_int(m_aggScan, 1, tier.id);
+  sqlite3_bind_int(m_aggScan, 2, channel);
+  sqlite3_bind_int64(m_aggScan, 3, unitKey);
+  sqlite3_bind_int64(m_aggScan, 4, fromMs);
+  sqlite3_bind_int64(m_aggScan, 5, toMs);
+  int rc;
+  while ((rc = sqlite3_step(m_aggScan)) == SQLITE_ROW) {
+    SeriesAggregate agg{sqlite3_column_int64(m_aggScan, 0),
+                        sqlite3_column_int64(m_aggScan, 1),
+                        sqlite3_column_double(m_aggScan, 2),
+                        sqlite3_column_double(m_aggScan, 3),
+                        sqlite3_column_double(m_aggScan, 4),
+                        sqlite3_column_double(m_aggScan, 5),
+                        sqlite3_column_double(m_aggScan, 6)};
+    if (!fn(agg))
+      break;
+  }
+  sqlite3_reset(m_aggScan);
+  return rc == SQLITE_ROW || rc == SQLITE_DONE;
+}
+
+int64_t ChannelStore::oldestSample(uint16_t channel, int64_t unitKey) {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(m_db,
+                         "SELECT MIN(ts) FROM samples "
+                         "WHERE channel_id = ? AND unit_key = ?;",
+                         -1, &stmt, 0) != SQLITE_OK)
+    return -1;
+  sqlite3_bind_int(stmt, 1, channel);
+  sqlite3_bind_int64(stmt, 2, unitKey);
+  int64_t ts = -1;
+  if (sqlite3_step(stmt) == SQLITE_ROW &&
+      sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    ts = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return ts;
+}
+
+bool ChannelStore::rebuildTiers(int64_t unitKey,
+                                std::span<const RegisterDesc> list,
+                                int64_t fromMs, int64_t toMs) {
+  TRACE_SCOPE("store", "tier_rebuild", unitKey);
+  if (!prepareTiers())
+    return false;
+  sqlite3_stmt *clear = nullptr;
+  if (sqlite3_prepare_v2(m_db,
+                         "DELETE FROM samples_agg WHERE tier = ? "
+                         "AND channel_id = ? AND unit_key = ? "
+                         "AND ts >= ? AND ts < ?;",
+                         -1, &clear, 0) != SQLITE_OK)
+    return false;
+
+  if (!exec("SAVEPOINT tiers;")) {
+    sqlite3_finalize(clear);
+    return false;
+  }
+  bool ok = true;
+  int64_t horizon = PipelineMetrics::wallMs() -
+                    int64_t(CHANNEL_RETENTION_DAYS) * 86400 * 1000;
+  auto rebuild = [&](uint16_t channel) {
+    int64_t oldest = oldestSample(channel, unitKey);
+    if (oldest < 0)
+      return;
+    // Before this, samples of the channel may have been pruned; after it
+    // the store just had none yet.
+    int64_t kept = std::min(oldest, horizon);
+    for (const AggTier &tier : AGG_TIERS) {
+      // Whole intervals only: the edges also hold samples outside the range.
+      int64_t lo = fromMs - fromMs % tier.widthMs;
+      int64_t hi = toMs + (tier.widthMs - toMs % tier.widthMs) % tier.widthMs;
+      if (lo < kept)
+        lo = kept + (tier.widthMs - kept % tier.widthMs) % tier.widthMs;
+      if (lo >= hi)
+        continue;
+      sqlite3_bind_int(clear, 1, tier.id);
+      sqlite3_bind_int(clear, 2, channel);
+      sqlite3_bind_int64(clear, 3, unitKey);
+      sqlite3_bind_int64(clear, 4, lo);
+      sqlite3_bind_int64(clear, 5, hi);
+      ok = sqlite3_step(clear) == SQLITE_DONE;
+      sqlite3_reset(clear);
+
+      SeriesAggregate agg;
+      auto flush = [&] {
+        if (agg.count)
+          ok = foldTier(tier, channel, unitKey, agg);
+        agg = {};
+        return ok;
+      };
+      ok = ok && scan(channel, unitKey, lo, hi, [&](int64_t ts, double v) {
+             int64_t start = ts - ts % tier.widthMs;
+             if (agg.count && start != agg.ts && !flush())
+               return false;
+             agg.ts = start;
+             agg.add(v);
+             return true;
+           });
+      ok = ok && flush();
+      if (!ok)
+        return;
+    }
+  };
+  for (const RegisterDesc &d : list)
+    if (ok)
+      rebuild(d.channel);
+  sqlite3_finalize(clear);
+
+  if (!ok) {
+    std::cerr << "SQL error (samples_agg): " << sqlite3_errmsg(m_db)
+              << std::endl;
+    PipelineMetrics::instance().sqliteErrors.fetch_add(
+        1, std::memory_order_relaxed);
+    exec("ROLLBACK TO tiers; RELEASE tiers;");
+    return false;
+  }
+  return exec("RELEASE tiers;");
+}
+
+int64_t ChannelStore::pruneTiers(int64_t nowMs) {
+  TRACE_SCOPE("store", "tier_prune");
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(m_db,
+                         "DELETE FROM samples_agg WHERE tier = ?1 "
+                         "AND channel_id = ?2 AND unit_key = ?3 AND ts < ?4;",
+                         -1, &stmt, 0) != SQLITE_OK)
+    return -1;
+  sqlite3_stmt *pairs = nullptr;
+  if (sqlite3_prepare_v2(m_db, CHANNEL_UNIT_PAIRS, -1, &pairs, 0) !=
+      SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return -1;
+  }
+
+  int64_t removed = 0;
+  exec("BEGIN;");
+  while (sqlite3_step(pairs) == SQLITE_ROW) {
+    for (const AggTier &tier : AGG_TIERS) {
+      sqlite3_bind_int(stmt, 1, tier.id);
+      sqlite3_bind_int64(stmt, 2, sqlite3_column_int64(pairs, 0));
+      sqlite3_bind_int64(stmt, 3, sqlite3_column_int64(pairs, 1));
+      sqlite3_bind_int64(stmt, 4,
+                         nowMs - int64_t(tier.retentionDays) * 86400 * 1000);
+      if (sqlite3_step(stmt) == SQLITE_DONE)
+        removed += sqlite3_changes(m_db);
+      sqlite3_reset(stmt);
+    }
+  }
+  exec("COMMIT;");
+  sqlite3_finalize(pairs);
+  sqlite3_finalize(stmt);
+  return removed;
+}
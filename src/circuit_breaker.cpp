@@ -0,0 +1,127 @@
+#include "circuit_breaker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// ================= BREAKER =================
+
+int64_t CircuitBreaker::nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool CircuitBreaker::isDeadStatus(Modbus::StatusCode status) {
+  if (Modbus::StatusIsGood(status))
+    return false;
+  // The gateway answered for a unit that did not
+  if (status == Modbus::Status_BadGatewayPathUnavailable ||
+      status == Modbus::Status_BadGatewayTargetDeviceFailedToRespond)
+    return true;
+  // Any other exception reply means the unit itself is alive. Everything else
+  // (timeout reported as Processing, socket, CRC ...) got no usable answer.
+  return !Modbus::StatusIsStandardError(status);
+}
+
+bool CircuitBreaker::allow(int64_t now) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  switch (state()) {
+  case Closed:
+    return true;
+  case Open:
+    if (now < m_openUntilMs.load(std::memory_order_relaxed))
+      break;
+    m_state.store(HalfOpen, std::memory_order_relaxed);
+    [[fallthrough]];
+  case HalfOpen:
+    if (m_probeInFlight)
+      break;
+    m_probeInFlight = true;
+    probes.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  rejected.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void CircuitBreaker::onResult(Modbus::StatusCode status, int64_t now) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  bool dead = isDeadStatus(status);
+
+  if (state() == HalfOpen) {
+    m_probeInFlight = false;
+    if (dead) {
+      trip(now);
+      return;
+    }
+  }
+  if (!dead) {
+    m_state.store(Closed, std::memory_order_relaxed);
+    m_failures = 0;
+    m_openCount = 0;
+    return;
+  }
+  if (state() == Closed && ++m_failures >= m_policy.failureThreshold)
+    trip(now);
+}
+
+void CircuitBreaker::trip(int64_t now) {
+  // base * 2^n with +-10 % jitter so units tripped together probe apart
+  static thread_local std::minstd_rand rng{std::random_device{}()};
+  int shift = int(std::min<uint32_t>(m_openCount, 20));
+  int64_t window =
+      std::min(m_policy.baseBackoffMs << shift, m_policy.maxBackoffMs);
+  window += int64_t(std::uniform_real_distribution<double>(-0.1, 0.1)(rng) *
+                    double(window));
+
+  m_openCount++;
+  m_failures = 0;
+  m_openUntilMs.store(now + window, std::memory_order_relaxed);
+  m_state.store(Open, std::memory_order_relaxed);
+  trips.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CircuitBreaker::skipPoll(int64_t now) const {
+  return state() == Open &&
+         now < m_openUntilMs.load(std::memory_order_relaxed);
+}
+
+int64_t CircuitBreaker::retryInMs(int64_t now) const {
+  if (state() != Open)
+    return 0;
+  return std::max<int64_t>(
+      0, m_openUntilMs.load(std::memory_order_relaxed) - now);
+}
+
+// ================= REGISTRY =================
+
+CircuitBreakers &CircuitBreakers::instance() {
+  static CircuitBreakers breakers;
+  return breakers;
+}
+
+void CircuitBreakers::setPolicy(const CircuitPolicy &policy) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+  m_policy = policy;
+}
+
+CircuitBreaker *CircuitBreakers::breaker(const std::string &gateway,
+                                         uint8_t unit) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+
+  for (CircuitBreaker *b = m_head.load(std::memory_order_acquire); b;
+       b = b->next) {
+    if (b->unit == unit && b->gateway == gateway)
+      return b;
+  }
+
+  // Intentionally never freed, same as ModbusSeries.
+  CircuitBreaker *b = new CircuitBreaker;
+  b->gateway = gateway;
+  b->unit = unit;
+  b->m_policy = m_policy;
+  b->next = m_head.load(std::memory_order_relaxed);
+  m_head.store(b, std::memory_order_release);
+  return b;
+}
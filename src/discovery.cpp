@@ -0,0 +1,214 @@
+#include "discovery.h"
+#include "circuit_breaker.h"
+#include "iPM2xxx.h"
+#include "trace.h"
+
+#include <ModbusClientPort.h>
+#include <ModbusPort.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// ================= HELPERS =================
+
+GatewayAddress GatewayAddress::parse(const std::string &text) {
+  GatewayAddress gw;
+  size_t colon = text.rfind(':');
+  if (colon == std::string::npos) {
+    gw.host = text;
+  } else {
+    gw.host = text.substr(0, colon);
+    gw.port = std::atoi(text.c_str() + colon + 1);
+  }
+  return gw;
+}
+
+std::string classifyModel(const std::string &meterModel) {
+  if (meterModel.find("PM2") != std::string::npos)
+    return "iPM2xxx";
+  if (meterModel.find("MEM15") != std::string::npos ||
+      meterModel.rfind("A9", 0) == 0)
+    return "iA9MEM15";
+  return "unknown";
+}
+
+namespace {
+
+// Product ID Number (Addr: 89), present on both meter families
+constexpr uint16_t PROBE_REGISTER = 89;
+
+std::string jsonEscape(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if ((unsigned char)c < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+ModbusClientPort *openProbePort(const GatewayAddress &gw, int timeoutMs) {
+  Modbus::TcpSettings settings;
+  settings.host = gw.host.c_str();
+  settings.port = gw.port;
+  settings.timeout = timeoutMs;
+
+  ModbusClientPort *port =
+      Modbus::createClientPort(Modbus::TCP, &settings, true);
+  if (port)
+    port->port()->open();
+  return port;
+}
+
+// One probe session: pulls unit IDs until the range is exhausted.
+void probeWorker(const GatewayAddress &gw, const DiscoveryOptions &options,
+                 std::atomic<int> &nextUnit, std::mutex &foundMutex,
+                 std::vector<DiscoveredDevice> &found) {
+  std::unique_ptr<ModbusClientPort> port(
+      openProbePort(gw, options.probeTimeoutMs));
+  if (!port) {
+    std::cerr << "Discovery: cannot create port for " << gw.name()
+              << std::endl;
+    return;
+  }
+
+  for (int unit = nextUnit++; unit <= options.lastUnit; unit = nextUnit++) {
+    TRACE_SCOPE("discovery", "probe", unit);
+    uint16_t value = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto status =
+        port->readHoldingRegisters(uint8_t(unit), PROBE_REGISTER, 1, &value);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    if (Modbus::StatusIsProcessing(status)) {
+      // Reconnect so the late reply cannot be taken for the next unit's
+      port->close();
+      port->port()->open();
+      continue;
+    }
+    if (CircuitBreaker::isDeadStatus(status))
+      continue;
+
+    DiscoveredDevice d;
+    d.gateway = gw.name();
+    d.unit = uint8_t(unit);
+    d.probeUs = uint32_t(us);
+    std::lock_guard<std::mutex> lock(foundMutex);
+    found.push_back(d);
+  }
+  port->close();
+}
+
+void identify(const GatewayAddress &gw, const DiscoveryOptions &options,
+              DiscoveredDevice &d) {
+  TRACE_SCOPE("discovery", "identify", d.unit);
+  try {
+    // Name/model/manufacturer/product ID share one map on both families
+    auto client = iPM2xxx::createClient(d.unit, gw.host, gw.port,
+                                        options.identifyTimeoutMs);
+    d.meterModel = client->Read_MeterModel();
+    d.productId = client->Read_ProductIdNumber();
+    d.meterName = client->Read_MeterName();
+    d.manufacturer = client->Read_Manufacturer();
+    client->Disconnect();
+  } catch (const std::exception &e) {
+    std::cerr << "Discovery: " << gw.name() << " unit " << int(d.unit) << ": "
+              << e.what() << std::endl;
+  }
+  d.model = classifyModel(d.meterModel);
+}
+
+void scanGateway(const GatewayAddress &gw, const DiscoveryOptions &options,
+                 std::vector<DiscoveredDevice> &out) {
+  std::atomic<int> nextUnit{options.firstUnit};
+  std::mutex foundMutex;
+  std::vector<DiscoveredDevice> found;
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::max(1, options.workersPerGateway); i++)
+    workers.emplace_back(probeWorker, std::cref(gw), std::cref(options),
+                         std::ref(nextUnit), std::ref(foundMutex),
+                         std::ref(found));
+  for (std::thread &t : workers)
+    t.join();
+
+  for (DiscoveredDevice &d : found)
+    identify(gw, options, d);
+  out = std::move(found);
+}
+
+} // namespace
+
+// ================= SCAN =================
+
+std::vector<DiscoveredDevice>
+discoverDevices(const std::vector<GatewayAddress> &gateways,
+                const DiscoveryOptions &options) {
+  std::vector<std::vector<DiscoveredDevice>> perGateway(gateways.size());
+  std::vector<std::thread> scans;
+  for (size_t i = 0; i < gateways.size(); i++)
+    scans.emplace_back(scanGateway, std::cref(gateways[i]), std::cref(options),
+                       std::ref(perGateway[i]));
+  for (std::thread &t : scans)
+    t.join();
+
+  std::vector<DiscoveredDevice> devices;
+  for (auto &list : perGateway)
+    devices.insert(devices.end(), list.begin(), list.end());
+  std::sort(devices.begin(), devices.end(),
+            [](const DiscoveredDevice &a, const DiscoveredDevice &b) {
+              return a.gateway != b.gateway ? a.gateway < b.gateway
+                                            : a.unit < b.unit;
+            });
+  return devices;
+}
+
+// ================= INVENTORY =================
+
+void writeInventoryJson(std::ostream &out,
+                        const std::vector<DiscoveredDevice> &devices) {
+  out << "{\"devices\":[";
+  bool first = true;
+  for (const DiscoveredDevice &d : devices) {
+    if (!first)
+      out << ",";
+    first = false;
+    out << "\n  {\"gateway\":\"" << jsonEscape(d.gateway)
+        << "\",\"unit\":" << int(d.unit) << ",\"model\":\"" << d.model
+        << "\",\"meter_model\":\"" << jsonEscape(d.meterModel)
+        << "\",\"product_id\":" << d.productId << ",\"meter_name\":\""
+        << jsonEscape(d.meterName) << "\",\"manufacturer\":\""
+        << jsonEscape(d.manufacturer) << "\",\"probe_us\":" << d.probeUs
+        << "}";
+  }
+  out << "\n]}\n";
+}
+
+bool writeInventoryJsonFile(const std::string &path,
+                            const std::vector<DiscoveredDevice> &devices) {
+  // Write-then-rename so readers never see a half-written inventory.
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::trunc);
+    if (!f)
+      return false;
+    writeInventoryJson(f, devices);
+  }
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,122 @@
+#include "gateway_queue.h"
+
+#include <algorithm>
+
+const char *priorityName(ModbusPriority p) {
+  switch (p) {
+  case ModbusPriority::Interactive: return "interactive";
+  case ModbusPriority::Poll: return "poll";
+  case ModbusPriority::Backfill: return "backfill";
+  }
+  return "unknown";
+}
+
+// ================= SLOT =================
+
+GatewayQueue::Slot::Slot(GatewayQueue &queue, ModbusPriority priority)
+    : m_queue(queue) {
+  size_t cls = size_t(priority);
+  Waiter w{priority, std::chrono::steady_clock::now(), 0};
+  {
+    std::unique_lock<std::mutex> lock(queue.m_mutex);
+    w.seq = queue.m_seq++;
+    queue.m_waiters.push_back(&w);
+    queue.waiting[cls].fetch_add(1, std::memory_order_relaxed);
+    queue.dispatch();
+    queue.m_cv.wait(lock, [&] { return w.granted; });
+    queue.waiting[cls].fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  uint64_t us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - w.since)
+                             .count());
+  queue.granted[cls].fetch_add(1, std::memory_order_relaxed);
+  queue.waitUs[cls].fetch_add(us, std::memory_order_relaxed);
+  uint64_t prev = queue.maxWaitUs[cls].load(std::memory_order_relaxed);
+  while (us > prev && !queue.maxWaitUs[cls].compare_exchange_weak(
+                          prev, us, std::memory_order_relaxed)) {
+  }
+}
+
+GatewayQueue::Slot::~Slot() {
+  std::lock_guard<std::mutex> lock(m_queue.m_mutex);
+  m_queue.m_inFlight--;
+  m_queue.dispatch();
+}
+
+// ================= QUEUE =================
+
+void GatewayQueue::setPolicy(const QueuePolicy &policy) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_policy = policy;
+  m_policy.maxInFlight = std::max<uint32_t>(m_policy.maxInFlight, 1);
+  dispatch();
+}
+
+void GatewayQueue::dispatch() {
+  bool any = false;
+  auto now = std::chrono::steady_clock::now();
+  int64_t aging = std::max<int64_t>(m_policy.agingMs, 1);
+
+  while (m_inFlight < m_policy.maxInFlight && !m_waiters.empty()) {
+    // Rank: Interactive strictly first; Poll and Backfill by class minus
+    // time waited, a Backfill never ranking above a fresh Poll's level.
+    auto rank = [&](const Waiter *w) {
+      int64_t waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           now - w->since)
+                           .count();
+      int64_t level = w->priority == ModbusPriority::Interactive
+                          ? 0
+                          : std::max<int64_t>(
+                                int64_t(w->priority) * aging - waited, aging);
+      return std::make_pair(level, w->seq);
+    };
+    auto best = std::min_element(
+        m_waiters.begin(), m_waiters.end(),
+        [&](const Waiter *a, const Waiter *b) { return rank(a) < rank(b); });
+
+    Waiter *w = *best;
+    for (const Waiter *other : m_waiters) {
+      if (other->priority < w->priority) {
+        aged.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+    m_waiters.erase(best);
+    w->granted = true;
+    m_inFlight++;
+    any = true;
+  }
+  if (any)
+    m_cv.notify_all();
+}
+
+// ================= REGISTRY =================
+
+GatewayQueues &GatewayQueues::instance() {
+  static GatewayQueues queues;
+  return queues;
+}
+
+void GatewayQueues::setPolicy(const QueuePolicy &policy) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+  m_policy = policy;
+}
+
+GatewayQueue *GatewayQueues::queue(const std::string &gateway) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+
+  for (GatewayQueue *q = m_head.load(std::memory_order_acquire); q;
+       q = q->next) {
+    if (q->gateway == gateway)
+      return q;
+  }
+
+  // Intentionally never freed, same as ModbusSeries.
+  GatewayQueue *q = new GatewayQueue;
+  q->gateway = gateway;
+  q->setPolicy(m_policy);
+  q->next = m_head.load(std::memory_order_relaxed);
+  m_head.store(q, std::memory_order_release);
+  return q;
+}
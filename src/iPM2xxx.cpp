@@ -1,113 +1,10 @@
 #include "iPM2xxx.h"
-#include <ModbusPort.h>
-#include <cstring>
-#include <iostream>
-#include <stdexcept>
 
 std::unique_ptr<iPM2xxx> iPM2xxx::createClient(uint8_t unitId,
                                                const std::string &ipAddress,
                                                int port, int timeout) {
-  Modbus::TcpSettings settings;
-  settings.host = ipAddress.c_str();
-  settings.port = port;
-  settings.timeout = timeout;
-
-  ModbusClientPort *rawPort =
-      Modbus::createClientPort(Modbus::TCP, &settings, true);
-  if (!rawPort) {
-    throw std::runtime_error("Failed to create Modbus client port");
-  }
-
-  // Explicitly open the port
-  Modbus::StatusCode status = rawPort->port()->open();
-  if (Modbus::StatusIsBad(status)) {
-    std::cerr << "[DEBUG] Port open failed. Status: " << status
-              << " Error: " << rawPort->port()->lastErrorText() << std::endl;
-    // We continue, returning the object, so calling code can check
-    // isConnected() and see false
-  }
-
-  std::shared_ptr<ModbusClientPort> sharedPort(rawPort);
-
-  ModbusClient *rawClient = new ModbusClient(unitId, rawPort);
-  std::shared_ptr<ModbusClient> sharedClient(rawClient);
-
-  return std::make_unique<iPM2xxx>(sharedPort, sharedClient);
-}
-
-iPM2xxx::iPM2xxx(std::shared_ptr<ModbusClientPort> port,
-                 std::shared_ptr<ModbusClient> client)
-    : m_port(port), m_client(client) {}
-
-iPM2xxx::~iPM2xxx() { Disconnect(); }
-
-bool iPM2xxx::isConnected() const {
-  return m_client != nullptr && m_client->isOpen();
-}
-
-void iPM2xxx::Disconnect() {
-  if (m_port) {
-    m_port->close();
-  }
-}
-
-// ---------------- Helpers ----------------
-uint16_t iPM2xxx::readU16(uint16_t address) {
-  uint16_t val = 0;
-  auto status = m_client->readHoldingRegisters(address, 1, &val);
-  return Modbus::StatusIsGood(status) ? val : 0;
-}
-
-uint32_t iPM2xxx::readU32(uint16_t address) {
-  uint16_t r[2] = {0};
-  auto status = m_client->readHoldingRegisters(address, 2, r);
-  if (!Modbus::StatusIsGood(status))
-    return 0;
-
-  // Big-endian WORD
-  return (uint32_t(r[0]) << 16) | r[1];
-}
-
-float iPM2xxx::readFloat(uint16_t address) {
-  uint32_t raw = readU32(address);
-  float f;
-  std::memcpy(&f, &raw, sizeof(f));
-  return f;
-}
-
-uint64_t iPM2xxx::readU64(uint16_t address) {
-  uint16_t r[4] = {0};
-  auto status = m_client->readHoldingRegisters(address, 4, r);
-  if (!Modbus::StatusIsGood(status))
-    return 0;
-
-  // Big-endian WORD (Schneider iA9 MEM15)
-  uint64_t v = 0;
-  v |= uint64_t(r[0]) << 48;
-  v |= uint64_t(r[1]) << 32;
-  v |= uint64_t(r[2]) << 16;
-  v |= uint64_t(r[3]);
-  return v;
-}
-
-std::string iPM2xxx::readString(uint16_t address, uint16_t length) {
-  std::vector<uint16_t> buff(length);
-  Modbus::StatusCode status =
-      m_client->readHoldingRegisters(address, length, buff.data());
-  if (!Modbus::StatusIsGood(status))
-    return "";
-
-  std::string s;
-  s.reserve(length * 2);
-  for (uint16_t r : buff) {
-    char high = (char)(r >> 8);
-    char low = (char)(r & 0xFF);
-    if (high != 0)
-      s.push_back(high);
-    if (low != 0)
-      s.push_back(low);
-  }
-  return s;
+  return std::make_unique<iPM2xxx>(
+      MeterTransport::create(unitId, ipAddress, port, timeout));
 }
 
 // ---------------- Generated Methods ----------------
@@ -0,0 +1,29 @@
+#include "live_image.h"
+
+// ================= LIVE IMAGES =================
+
+LiveImages &LiveImages::instance() {
+  static LiveImages images;
+  return images;
+}
+
+LiveImage *LiveImages::image(const std::string &gateway, uint8_t unit,
+                             const char *model,
+                             std::vector<RegisterBlock> blocks) {
+  for (LiveImage *i = m_head.load(std::memory_order_acquire); i; i = i->next) {
+    if (i->unit == unit && i->gateway == gateway)
+      return i;
+  }
+
+  std::lock_guard<std::mutex> lock(m_createMutex);
+  for (LiveImage *i = m_head.load(std::memory_order_acquire); i; i = i->next) {
+    if (i->unit == unit && i->gateway == gateway)
+      return i;
+  }
+
+  // Intentionally never freed, same as ModbusSeries.
+  LiveImage *i = new LiveImage(gateway, unit, model, std::move(blocks));
+  i->next = m_head.load(std::memory_order_relaxed);
+  m_head.store(i, std::memory_order_release);
+  return i;
+}
@@ -0,0 +1,378 @@
+#include "maintenance.h"
+#include "channel_store.h"
+#include "pipeline_metrics.h"
+#include "snapshot_store.h"
+#include "trace.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+bool exec(sqlite3 *db, const char *sql, const char *what) {
+  char *errMsg = 0;
+  if (sqlite3_exec(db, sql, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (" << what << "): " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+    PipelineMetrics::instance().sqliteErrors.fetch_add(
+        1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+// "name" with embedded quotes doubled.
+std::string quoteIdentifier(const std::string &name) {
+  std::string q = "\"";
+  for (char c : name)
+    q += c == '"' ? std::string("\"\"") : std::string(1, c);
+  return q + "\"";
+}
+
+void putVarint(std::string &out, uint64_t v) {
+  while (v >= 0x80) {
+    out += char(uint8_t(v) | 0x80);
+    v >>= 7;
+  }
+  out += char(uint8_t(v));
+}
+
+template <typename T> void putLE(std::string &out, T v) {
+  for (size_t i = 0; i < sizeof(T); i++)
+    out += char(uint8_t(uint64_t(v) >> (8 * i)));
+}
+
+void putDouble(std::string &out, double v) {
+  uint64_t bits;
+  static_assert(sizeof(bits) == sizeof(v));
+  std::memcpy(&bits, &v, sizeof(v));
+  putLE(out, bits);
+}
+
+/* ---------- CSV ---------- */
+
+void writeCsvField(std::ostream &out, sqlite3_stmt *stmt, int col) {
+  char buf[32];
+  switch (sqlite3_column_type(stmt, col)) {
+  case SQLITE_NULL:
+    break;
+  case SQLITE_INTEGER:
+    out << sqlite3_column_int64(stmt, col);
+    break;
+  case SQLITE_FLOAT:
+    out.write(buf, std::snprintf(buf, sizeof(buf), "%.17g",
+                                 sqlite3_column_double(stmt, col)));
+    break;
+  case SQLITE_BLOB: {
+    auto bytes = static_cast<const uint8_t *>(sqlite3_column_blob(stmt, col));
+    int n = sqlite3_column_bytes(stmt, col);
+    for (int i = 0; i < n; i++)
+      out.write(buf, std::snprintf(buf, sizeof(buf), "%02x", bytes[i]));
+    break;
+  }
+  default: {
+    std::string text(
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, col)),
+        sqlite3_column_bytes(stmt, col));
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+      out << text;
+      break;
+    }
+    out << '"';
+    for (char c : text)
+      out << (c == '"' ? "\"\"" : std::string(1, c));
+    out << '"';
+  }
+  }
+}
+
+/* ---------- Columnar ---------- */
+
+enum ColumnKind : uint8_t { KindInteger = 1, KindReal = 2, KindBytes = 3 };
+
+// Storage class from the declared type, by SQLite's affinity rules.
+ColumnKind columnKind(const char *decltype_) {
+  std::string t = decltype_ ? decltype_ : "";
+  for (char &c : t)
+    c = char(std::toupper(uint8_t(c)));
+  if (t.find("INT") != std::string::npos)
+    return KindInteger;
+  if (t.empty() || t.find("CHAR") != std::string::npos ||
+      t.find("CLOB") != std::string::npos ||
+      t.find("TEXT") != std::string::npos ||
+      t.find("BLOB") != std::string::npos)
+    return KindBytes;
+  return KindReal;
+}
+
+// One row group of every column, flushed every EXPORT_GROUP_ROWS rows.
+class ColumnarWriter {
+public:
+  ColumnarWriter(sqlite3_stmt *stmt, std::ostream &out)
+      : m_out(out), m_columns(size_t(sqlite3_column_count(stmt))) {
+    std::string header = "PSC1";
+    putLE(header, uint16_t(m_columns.size()));
+    for (size_t i = 0; i < m_columns.size(); i++) {
+      m_columns[i].kind = columnKind(sqlite3_column_decltype(stmt, int(i)));
+      std::string name = sqlite3_column_name(stmt, int(i));
+      header += char(m_columns[i].kind);
+      putLE(header, uint16_t(name.size()));
+      header += name;
+    }
+    m_out << header;
+  }
+
+  void add(sqlite3_stmt *stmt) {
+    for (size_t i = 0; i < m_columns.size(); i++) {
+      Column &c = m_columns[i];
+      if (m_rows % 8 == 0)
+        c.nulls += '\0';
+      if (sqlite3_column_type(stmt, int(i)) == SQLITE_NULL) {
+        c.nulls.back() = char(c.nulls.back() | (1 << (m_rows % 8)));
+        continue;
+      }
+      switch (c.kind) {
+      case KindInteger: {
+        int64_t v = sqlite3_column_int64(stmt, int(i));
+        int64_t d = int64_t(uint64_t(v) - uint64_t(c.previous));
+        putVarint(c.data, (uint64_t(d) << 1) ^ uint64_t(d >> 63));
+        c.previous = v;
+        break;
+      }
+      case KindReal:
+        putDouble(c.data, sqlite3_column_double(stmt, int(i)));
+        break;
+      case KindBytes: {
+        const void *bytes = sqlite3_column_blob(stmt, int(i));
+        int n = sqlite3_column_bytes(stmt, int(i));
+        putVarint(c.data, uint64_t(n));
+        c.data.append(static_cast<const char *>(bytes), size_t(n));
+        break;
+      }
+      }
+    }
+    if (++m_rows == EXPORT_GROUP_ROWS)
+      flush();
+  }
+
+  // Writes the pending group, then the end marker.
+  void finish() {
+    flush();
+    std::string end;
+    putLE(end, uint32_t(0));
+    m_out << end;
+  }
+
+private:
+  struct Column {
+    ColumnKind kind;
+    std::string nulls;
+    std::string data;
+    int64_t previous = 0;
+  };
+
+  void flush() {
+    if (!m_rows)
+      return;
+    std::string rows;
+    putLE(rows, m_rows);
+    m_out << rows;
+    for (Column &c : m_columns) {
+      m_out << c.nulls << c.data;
+      c.nulls.clear();
+      c.data.clear();
+      c.previous = 0;
+    }
+    m_rows = 0;
+  }
+
+  std::ostream &m_out;
+  std::vector<Column> m_columns;
+  uint32_t m_rows = 0;
+};
+
+} // namespace
+
+// ================= BACKUP =================
+
+bool Backup_Database(sqlite3 *src, const std::string &destPath,
+                     const BackupOptions &options) {
+  TRACE_SCOPE("store", "backup");
+  std::string tmpPath = destPath + ".tmp";
+  std::remove(tmpPath.c_str());
+
+  sqlite3 *dest = nullptr;
+  if (sqlite3_open_v2(tmpPath.c_str(), &dest,
+                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                      nullptr) != SQLITE_OK) {
+    std::cerr << "SQLite open error (" << tmpPath
+              << "): " << (dest ? sqlite3_errmsg(dest) : "out of memory")
+              << std::endl;
+    sqlite3_close(dest);
+    return false;
+  }
+
+  // Pin one snapshot: under WAL the poller keeps committing next to it,
+  // and the copy never sees (or restarts for) those commits.
+  if (!exec(src, "BEGIN; SELECT COUNT(*) FROM sqlite_master;", "backup")) {
+    sqlite3_close(dest);
+    return false;
+  }
+
+  bool ok = false;
+  sqlite3_backup *backup = sqlite3_backup_init(dest, "main", src, "main");
+  if (backup) {
+    int rc;
+    while ((rc = sqlite3_backup_step(backup, options.pagesPerStep)) ==
+               SQLITE_OK ||
+           rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(options.sleepMs));
+    }
+    ok = rc == SQLITE_DONE;
+    int total = sqlite3_backup_pagecount(backup);
+    if (sqlite3_backup_finish(backup) != SQLITE_OK)
+      ok = false;
+    if (ok)
+      std::cerr << "Backup " << sqlite3_db_filename(src, "main") << " -> "
+                << destPath << ": " << total << " pages" << std::endl;
+  }
+  if (!ok)
+    std::cerr << "Backup error (" << destPath << "): " << sqlite3_errmsg(dest)
+              << std::endl;
+  exec(src, "COMMIT;", "backup");
+  sqlite3_close(dest);
+
+  if (!ok) {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  // A WAL left over from an earlier file of the same name would be
+  // replayed into the new one.
+  std::remove((destPath + "-wal").c_str());
+  std::remove((destPath + "-shm").c_str());
+  if (std::rename(tmpPath.c_str(), destPath.c_str()) != 0) {
+    std::cerr << "Cannot rename " << tmpPath << " to " << destPath
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// ================= EXPORT =================
+
+int64_t Export_Range(sqlite3 *db, const std::string &table, int64_t fromS,
+                     int64_t toS, ExportFormat format, std::ostream &out) {
+  TRACE_SCOPE("store", "export");
+  // The time column, which also proves the table exists.
+  sqlite3_stmt *info = nullptr;
+  std::string timeColumn;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT name FROM pragma_table_info(?) "
+                         "WHERE name IN ('ts', 'timestamp') ORDER BY name;",
+                         -1, &info, 0) == SQLITE_OK) {
+    sqlite3_bind_text(info, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(info) == SQLITE_ROW)
+      timeColumn =
+          reinterpret_cast<const char *>(sqlite3_column_text(info, 0));
+  }
+  sqlite3_finalize(info);
+  if (timeColumn.empty()) {
+    std::cerr << "Export: no table " << table << " with a ts or timestamp column"
+              << std::endl;
+    return -1;
+  }
+  int64_t scale = timeColumn == "ts" ? 1000 : 1;
+
+  // No ORDER BY: a sort would buffer the whole range.
+  std::string sql = "SELECT * FROM " + quoteIdentifier(table) + " WHERE " +
+                    timeColumn + " >= ? AND " + timeColumn + " < ?;";
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (export): " << sqlite3_errmsg(db) << std::endl;
+    return -1;
+  }
+  sqlite3_bind_int64(stmt, 1, fromS * scale);
+  sqlite3_bind_int64(stmt, 2, toS * scale);
+
+  int columns = sqlite3_column_count(stmt);
+  int64_t rows = 0;
+  int rc;
+  if (format == ExportFormat::Csv) {
+    for (int i = 0; i < columns; i++)
+      out << (i ? "," : "") << sqlite3_column_name(stmt, i);
+    out << '\n';
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      for (int i = 0; i < columns; i++) {
+        if (i)
+          out << ',';
+        writeCsvField(out, stmt, i);
+      }
+      out << '\n';
+      rows++;
+    }
+  } else {
+    ColumnarWriter writer(stmt, out);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      writer.add(stmt);
+      rows++;
+    }
+    writer.finish();
+  }
+  if (rc != SQLITE_DONE) {
+    std::cerr << "SQL error (export): " << sqlite3_errmsg(db) << std::endl;
+    rows = -1;
+  }
+  sqlite3_finalize(stmt);
+  out.flush();
+  return out ? rows : -1;
+}
+
+// ================= RE-DERIVATION =================
+
+int64_t Rederive_Range(sqlite3 *db, int64_t fromS, int64_t toS) {
+  TRACE_SCOPE("store", "rederive_range");
+  ChannelStore channels(db);
+  SnapshotStore raw(db);
+  if (!channels.setup() || !raw.setup())
+    return -1;
+
+  std::vector<std::pair<int64_t, std::string>> units;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, "SELECT unit_key, model FROM units;", -1, &stmt,
+                         0) != SQLITE_OK) {
+    std::cerr << "SQL error (rederive): " << sqlite3_errmsg(db) << std::endl;
+    return -1;
+  }
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const unsigned char *model = sqlite3_column_text(stmt, 1);
+    units.emplace_back(sqlite3_column_int64(stmt, 0),
+                       model ? reinterpret_cast<const char *>(model) : "");
+  }
+  sqlite3_finalize(stmt);
+
+  int64_t total = 0;
+  for (const auto &[key, model] : units) {
+    std::span<const RegisterDesc> list;
+    if (model == "iPM2xxx")
+      list = PM_CHANNELS;
+    else if (model == "iA9MEM15")
+      list = A9_CHANNELS;
+    else
+      continue;
+    int64_t n = raw.rederive(channels, list, key, fromS * 1000, toS * 1000);
+    if (n < 0)
+      return -1;
+    if (n)
+      std::cerr << "Unit " << key << " (" << model << "): " << n
+                << " snapshot(s) re-derived" << std::endl;
+    total += n;
+  }
+  return total;
+}
@@ -0,0 +1,202 @@
+#include "meter_transport.h"
+#include "trace.h"
+
+#include <ModbusPort.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+std::unique_ptr<MeterTransport>
+MeterTransport::create(uint8_t unitId, const std::string &ipAddress, int port,
+                       int timeout) {
+  std::string gateway = ipAddress + ":" + std::to_string(port);
+  if (RtuLine::isSerial(ipAddress)) {
+    // Direct RS-485: every unit on the line shares the bus port
+    RtuBus *bus =
+        RtuBuses::instance().bus(RtuLine::parse(ipAddress), uint32_t(timeout));
+    if (!bus)
+      throw std::runtime_error("Failed to create Modbus RTU port");
+    return std::make_unique<MeterTransport>(
+        bus->port(), std::make_shared<ModbusClient>(unitId, bus->port().get()),
+        gateway, bus);
+  }
+
+  Modbus::TcpSettings settings;
+  settings.host = ipAddress.c_str();
+  settings.port = port;
+  settings.timeout = timeout;
+
+  ModbusClientPort *rawPort =
+      Modbus::createClientPort(Modbus::TCP, &settings, true);
+  if (!rawPort)
+    throw std::runtime_error("Failed to create Modbus client port");
+
+  // Open now; on failure the transport is still returned so the caller can
+  // check isConnected() and see false
+  Modbus::StatusCode status = rawPort->port()->open();
+  if (Modbus::StatusIsBad(status))
+    std::cerr << "[DEBUG] Port open failed. Status: " << status
+              << " Error: " << rawPort->port()->lastErrorText() << std::endl;
+
+  std::shared_ptr<ModbusClientPort> sharedPort(rawPort);
+  auto sharedClient = std::make_shared<ModbusClient>(unitId, rawPort);
+  return std::make_unique<MeterTransport>(sharedPort, sharedClient, gateway);
+}
+
+MeterTransport::MeterTransport(std::shared_ptr<ModbusClientPort> port,
+                               std::shared_ptr<ModbusClient> client,
+                               const std::string &gateway, RtuBus *bus)
+    : m_port(std::move(port)), m_client(std::move(client)), m_bus(bus) {
+  if (m_port && m_client) {
+    m_series = ModbusMetrics::instance().series(
+        gateway, m_client->unit(), MBF_READ_HOLDING_REGISTERS);
+    m_breaker = CircuitBreakers::instance().breaker(gateway, m_client->unit());
+    m_queue = GatewayQueues::instance().queue(gateway);
+    m_timeoutMs = m_port->port()->timeout();
+    m_rtt = RttEstimators::instance().estimator(gateway, m_client->unit(),
+                                                m_timeoutMs);
+    m_tap.attach(m_port.get());
+  }
+}
+
+MeterTransport::~MeterTransport() {
+  disconnect();
+  if (m_port)
+    m_tap.detach(m_port.get());
+}
+
+bool MeterTransport::isConnected() const {
+  return m_client && m_client->isOpen();
+}
+
+void MeterTransport::disconnect() {
+  // A bus port serves every unit on the line and stays open
+  if (m_port && !m_bus)
+    m_port->close();
+}
+
+// ================= READS =================
+
+// Every register read goes through here so it is timed and counted.
+Modbus::StatusCode MeterTransport::readRegisters(uint16_t address,
+                                                 uint16_t count,
+                                                 uint16_t *values) {
+  TRACE_SCOPE("modbus", "read", address);
+  if (m_breaker && !m_breaker->allow()) {
+    // Unit is known dead: fail fast instead of waiting out the timeout
+    m_lastStatus = Modbus::Status_BadGatewayTargetDeviceFailedToRespond;
+    m_readErrors++;
+    return m_lastStatus;
+  }
+  // Wait for our turn on the gateway (Interactive ahead of Poll/Backfill)
+  std::optional<GatewayQueue::Slot> slot;
+  if (m_queue)
+    slot.emplace(*m_queue, m_priority);
+  // RS-485: wait for the line (and its silent interval) first
+  std::optional<RtuBus::Transaction> line;
+  if (m_bus)
+    line.emplace(*m_bus);
+  m_tap.setCurrent(m_series);
+
+  uint32_t retries = m_rtt ? m_rtt->retries() : 0;
+  for (uint32_t attempt = 0;; attempt++) {
+    applyTimeout();
+    auto start = std::chrono::steady_clock::now();
+    m_lastStatus = m_client->readHoldingRegisters(address, count, values);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    ModbusMetrics::record(m_series, m_lastStatus, uint64_t(us), count);
+
+    if (classifyStatus(m_lastStatus) != ModbusOutcome::Timeout) {
+      // Karn: only first attempts are sampled
+      if (m_rtt && attempt == 0 && !CircuitBreaker::isDeadStatus(m_lastStatus))
+        m_rtt->sample(uint64_t(us));
+      if (m_rtt && attempt > 0 && Modbus::StatusIsGood(m_lastStatus))
+        m_rtt->recovered.fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+
+    // Reconnect so a late reply cannot be taken as the answer to the next
+    // request (the port does not match transaction ids).
+    if (m_rtt)
+      m_rtt->onTimeout();
+    reconnect(m_rtt ? m_rtt->timeoutMs() : m_timeoutMs);
+    if (!m_rtt || attempt >= retries)
+      break;
+    m_rtt->retriesSent.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  m_tap.setCurrent(nullptr); // the port may be shared with other units
+  if (line)
+    line->done(m_lastStatus);
+
+  if (m_breaker)
+    m_breaker->onResult(m_lastStatus);
+  if (!Modbus::StatusIsGood(m_lastStatus))
+    m_readErrors++;
+  return m_lastStatus;
+}
+
+Modbus::StatusCode MeterTransport::readBlock(uint16_t address, uint16_t count,
+                                             uint16_t *values) {
+  // FC03 carries at most 125 registers per request
+  Modbus::StatusCode status = Modbus::Status_Good;
+  for (uint16_t done = 0; done < count && Modbus::StatusIsGood(status);) {
+    uint16_t n = std::min<uint16_t>(MAX_READ_REGS, count - done);
+    status = readRegisters(address + done, n, values + done);
+    done += n;
+  }
+  return status;
+}
+
+uint16_t MeterTransport::readU16(uint16_t address) {
+  uint16_t val = 0;
+  auto status = readRegisters(address, 1, &val);
+  return Modbus::StatusIsGood(status) ? val : 0;
+}
+
+std::string MeterTransport::readString(uint16_t address, uint16_t length) {
+  std::vector<uint16_t> buff(length);
+  if (!Modbus::StatusIsGood(readRegisters(address, length, buff.data())))
+    return "";
+
+  std::string s;
+  s.reserve(length * 2);
+  for (uint16_t r : buff) {
+    char high = (char)(r >> 8);
+    char low = (char)(r & 0xFF);
+    if (high != 0)
+      s.push_back(high);
+    if (low != 0)
+      s.push_back(low);
+  }
+  return s;
+}
+
+// ================= TIMEOUT =================
+
+// The port only picks up a new timeout when it (re)opens, so changing it
+// costs a reconnect: follow real moves of the estimate (beyond +-25 %), not
+// every sample.
+void MeterTransport::applyTimeout() {
+  // A bus port is shared, so it keeps the line's timeout for every unit
+  if (!m_rtt || m_bus)
+    return;
+  uint32_t ms = m_rtt->timeoutMs();
+  if (uint64_t(ms) * 4 < uint64_t(m_timeoutMs) * 3 ||
+      uint64_t(ms) * 4 > uint64_t(m_timeoutMs) * 5)
+    reconnect(ms);
+}
+
+void MeterTransport::reconnect(uint32_t timeoutMs) {
+  m_port->close();
+  if (!m_bus) {
+    m_port->port()->setTimeout(timeoutMs);
+    m_timeoutMs = timeoutMs;
+  }
+  m_port->port()->open();
+}
@@ -0,0 +1,671 @@
+#include "metrics_http.h"
+#include "circuit_breaker.h"
+#include "gateway_queue.h"
+#include "rtt_estimator.h"
+#include "rtu_bus.h"
+#include "series_query.h"
+#include "modbus_metrics.h"
+#include "pipeline_metrics.h"
+#include "trace.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+/* ---------- OpenMetrics rendering ---------- */
+
+namespace {
+
+std::string escapeLabel(const std::string &v) {
+  std::string out;
+  out.reserve(v.size());
+  for (char c : v) {
+    if (c == '\\' || c == '"')
+      out.push_back('\\');
+    if (c == '\n') {
+      out += "\\n";
+      continue;
+    }
+    out.push_back(c);
+  }
+  return out;
+}
+
+void appendDouble(std::string &out, double v) {
+  if (std::isnan(v)) {
+    out += "NaN";
+    return;
+  }
+  if (std::isinf(v)) {
+    out += v > 0 ? "+Inf" : "-Inf";
+    return;
+  }
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.9g", v);
+  out += buf;
+}
+
+void family(std::string &out, const char *name, const char *type,
+            const char *unit, const char *help) {
+  out += "# TYPE ";
+  out += name;
+  out += " ";
+  out += type;
+  out += "\n";
+  if (unit && *unit) {
+    out += "# UNIT ";
+    out += name;
+    out += " ";
+    out += unit;
+    out += "\n";
+  }
+  out += "# HELP ";
+  out += name;
+  out += " ";
+  out += help;
+  out += "\n";
+}
+
+void sample(std::string &out, const std::string &name,
+            const std::string &labels, double value) {
+  out += name;
+  if (!labels.empty()) {
+    out += "{";
+    out += labels;
+    out += "}";
+  }
+  out += " ";
+  appendDouble(out, value);
+  out += "\n";
+}
+
+void sample(std::string &out, const std::string &name,
+            const std::string &labels, uint64_t value) {
+  out += name;
+  if (!labels.empty()) {
+    out += "{";
+    out += labels;
+    out += "}";
+  }
+  out += " ";
+  out += std::to_string(value);
+  out += "\n";
+}
+
+// Histogram buckets at powers of two microseconds (128 us .. 134 s). These
+// coincide with LatencyHistogram bucket edges, so the cumulative counts are
+// exact rather than interpolated.
+constexpr int LE_MIN_POW2 = 7;
+constexpr int LE_MAX_POW2 = LatencyHistogram::MAX_MAGNITUDE;
+
+void histogram(std::string &out, const std::string &name,
+               const std::string &labels, const LatencyHistogram &h) {
+  std::string sep = labels.empty() ? "" : labels + ",";
+
+  uint64_t cumulative = 0;
+  int idx = 0;
+  for (int k = LE_MIN_POW2; k <= LE_MAX_POW2; k++) {
+    int end = (k - LatencyHistogram::SUB_BUCKET_BITS + 1) *
+              LatencyHistogram::SUB_BUCKETS;
+    for (; idx < end; idx++)
+      cumulative += h.bucketCount(idx);
+
+    std::string le = sep + "le=\"";
+    appendDouble(le, double(uint64_t(1) << k) / 1e6);
+    le += "\"";
+    sample(out, name + "_bucket", le, cumulative);
+  }
+  for (; idx < LatencyHistogram::BUCKETS; idx++)
+    cumulative += h.bucketCount(idx);
+
+  // Count from the buckets themselves so +Inf and _count always agree.
+  sample(out, name + "_bucket", sep + "le=\"+Inf\"", cumulative);
+  sample(out, name + "_count", labels, cumulative);
+  sample(out, name + "_sum", labels, double(h.sumUs()) / 1e6);
+}
+
+std::string modbusLabels(const ModbusSeries &s) {
+  return "gateway=\"" + escapeLabel(s.gateway) + "\",unit=\"" +
+         std::to_string(s.unit) + "\",function=\"" +
+         std::to_string(s.function) + "\"";
+}
+
+template <typename T> std::string unitLabels(const T &u) {
+  return "gateway=\"" + escapeLabel(u.gateway) + "\",unit=\"" +
+         std::to_string(u.unit) + "\"";
+}
+
+std::string deviceLabels(const DeviceHealth &d) {
+  return "gateway=\"" + escapeLabel(d.gateway) + "\",unit=\"" +
+         std::to_string(d.unit) + "\",model=\"" + escapeLabel(d.model) + "\"";
+}
+
+} // namespace
+
+std::string renderOpenMetrics() {
+  const ModbusMetrics &mb = ModbusMetrics::instance();
+  const PipelineMetrics &pl = PipelineMetrics::instance();
+  auto load = [](const auto &a) { return a.load(std::memory_order_relaxed); };
+
+  std::string out;
+  out.reserve(16384);
+
+  /* ---- Poll loop ---- */
+  family(out, "pipeline_poll_cycle_seconds", "histogram", "seconds",
+         "Duration of one poll + publish cycle.");
+  histogram(out, "pipeline_poll_cycle_seconds", "", pl.pollCycle);
+
+  family(out, "pipeline_last_poll_cycle_seconds", "gauge", "seconds",
+         "Duration of the most recent cycle.");
+  sample(out, "pipeline_last_poll_cycle_seconds", "",
+         double(load(pl.lastPollCycleUs)) / 1e6);
+
+  family(out, "pipeline_queue_depth", "gauge", "",
+         "Work items waiting in each pipeline stage.");
+  sample(out, "pipeline_queue_depth", "stage=\"poll\"",
+         double(load(pl.pollQueueDepth)));
+  sample(out, "pipeline_queue_depth", "stage=\"publish\"",
+         double(load(pl.publishQueueDepth)));
+
+  /* ---- SQLite ---- */
+  family(out, "sqlite_commit_seconds", "histogram", "seconds",
+         "Latency of autocommit INSERT/UPDATE statements.");
+  histogram(out, "sqlite_commit_seconds", "", pl.sqliteCommit);
+
+  family(out, "sqlite_errors", "counter", "", "Failed SQLite writes.");
+  sample(out, "sqlite_errors_total", "", load(pl.sqliteErrors));
+
+  /* ---- MQTT ---- */
+  family(out, "mqtt_inflight", "gauge", "",
+         "Publishes sent but not yet acknowledged.");
+  sample(out, "mqtt_inflight", "", double(load(pl.mqttInFlight)));
+
+  family(out, "mqtt_publish_seconds", "histogram", "seconds",
+         "Time from publish to broker acknowledgement.");
+  histogram(out, "mqtt_publish_seconds", "", pl.mqttPublish);
+
+  family(out, "mqtt_publish_errors", "counter", "", "Failed publishes.");
+  sample(out, "mqtt_publish_errors_total", "", load(pl.mqttErrors));
+
+  family(out, "outbox_backlog_rows", "gauge", "",
+         "Stored rows not yet published (-1 = unknown).");
+  sample(out, "outbox_backlog_rows", "table=\"readings\"",
+         double(load(pl.outboxA9)));
+  sample(out, "outbox_backlog_rows", "table=\"readings_pm2xxx\"",
+         double(load(pl.outboxPM)));
+
+  family(out, "facade_requests", "counter", "",
+         "Modbus façade reads by outcome (served from RAM or refused).");
+  sample(out, "facade_requests_total", "result=\"served\"",
+         load(pl.facadeServed));
+  sample(out, "facade_requests_total", "result=\"stale\"",
+         load(pl.facadeStale));
+  sample(out, "facade_requests_total", "result=\"bad_range\"",
+         load(pl.facadeBadRange));
+  sample(out, "facade_requests_total", "result=\"unmapped\"",
+         load(pl.facadeUnmapped));
+
+  /* ---- Devices ---- */
+  int64_t nowMs = PipelineMetrics::wallMs();
+
+  family(out, "device_staleness_seconds", "gauge", "seconds",
+         "Age of the newest complete reading per device (NaN = never).");
+  pl.forEachDevice([&](const DeviceHealth &d) {
+    int64_t ok = load(d.lastOkMs);
+    sample(out, "device_staleness_seconds", deviceLabels(d),
+           ok ? double(nowMs - ok) / 1e3 : std::nan(""));
+  });
+
+  family(out, "device_polls", "counter", "", "Poll attempts per device.");
+  pl.forEachDevice([&](const DeviceHealth &d) {
+    sample(out, "device_polls_total", deviceLabels(d), load(d.polls));
+  });
+
+  family(out, "device_poll_failures", "counter", "",
+         "Polls with a failed read or insert.");
+  pl.forEachDevice([&](const DeviceHealth &d) {
+    sample(out, "device_poll_failures_total", deviceLabels(d),
+           load(d.failures));
+  });
+
+  /* ---- Modbus transactions ---- */
+  family(out, "modbus_request_seconds", "histogram", "seconds",
+         "Modbus request round-trip time.");
+  mb.forEach([&](const ModbusSeries &s) {
+    histogram(out, "modbus_request_seconds", modbusLabels(s), s.latency);
+  });
+
+  family(out, "modbus_requests", "counter", "",
+         "Modbus requests by outcome.");
+  mb.forEach([&](const ModbusSeries &s) {
+    std::string l = modbusLabels(s) + ",result=";
+    sample(out, "modbus_requests_total", l + "\"ok\"", load(s.ok));
+    sample(out, "modbus_requests_total", l + "\"timeout\"", load(s.timeouts));
+    sample(out, "modbus_requests_total", l + "\"exception\"",
+           load(s.exceptions));
+    sample(out, "modbus_requests_total", l + "\"gateway_error\"",
+           load(s.gatewayErrors));
+    sample(out, "modbus_requests_total", l + "\"crc_error\"",
+           load(s.crcErrors));
+    sample(out, "modbus_requests_total", l + "\"other_error\"",
+           load(s.otherErrors));
+  });
+
+  family(out, "modbus_bytes", "counter", "bytes", "Raw bytes on the wire.");
+  mb.forEach([&](const ModbusSeries &s) {
+    std::string l = modbusLabels(s) + ",direction=";
+    sample(out, "modbus_bytes_total", l + "\"tx\"", load(s.bytesTx));
+    sample(out, "modbus_bytes_total", l + "\"rx\"", load(s.bytesRx));
+  });
+
+  /* ---- Circuit breakers ---- */
+  const CircuitBreakers &cb = CircuitBreakers::instance();
+
+  family(out, "modbus_circuit_state", "gauge", "",
+         "Breaker state per unit (0 closed, 1 open, 2 half-open).");
+  cb.forEach([&](const CircuitBreaker &b) {
+    sample(out, "modbus_circuit_state", unitLabels(b),
+           double(b.state()));
+  });
+
+  family(out, "modbus_circuit_trips", "counter", "",
+         "Times the breaker opened.");
+  cb.forEach([&](const CircuitBreaker &b) {
+    sample(out, "modbus_circuit_trips_total", unitLabels(b),
+           load(b.trips));
+  });
+
+  family(out, "modbus_circuit_rejected", "counter", "",
+         "Requests failed fast while the breaker was open.");
+  cb.forEach([&](const CircuitBreaker &b) {
+    sample(out, "modbus_circuit_rejected_total", unitLabels(b),
+           load(b.rejected));
+  });
+
+  /* ---- Adaptive timeouts ---- */
+  const RttEstimators &rtt = RttEstimators::instance();
+
+  family(out, "modbus_rtt_smoothed_seconds", "gauge", "seconds",
+         "Smoothed request round-trip time (SRTT).");
+  rtt.forEach([&](const RttEstimator &e) {
+    sample(out, "modbus_rtt_smoothed_seconds", unitLabels(e),
+           double(load(e.srttUs)) / 1e6);
+  });
+
+  family(out, "modbus_rtt_variance_seconds", "gauge", "seconds",
+         "Round-trip time mean deviation (RTTVAR).");
+  rtt.forEach([&](const RttEstimator &e) {
+    sample(out, "modbus_rtt_variance_seconds", unitLabels(e),
+           double(load(e.rttvarUs)) / 1e6);
+  });
+
+  family(out, "modbus_timeout_seconds", "gauge", "seconds",
+         "Request timeout currently derived from the RTT.");
+  rtt.forEach([&](const RttEstimator &e) {
+    sample(out, "modbus_timeout_seconds", unitLabels(e),
+           double(e.timeoutMs()) / 1e3);
+  });
+
+  family(out, "modbus_retry_budget", "gauge", "",
+         "Retries a timed-out read currently gets.");
+  rtt.forEach([&](const RttEstimator &e) {
+    sample(out, "modbus_retry_budget", unitLabels(e), double(e.retries()));
+  });
+
+  family(out, "modbus_retries", "counter", "", "Reads retried after a timeout.");
+  rtt.forEach([&](const RttEstimator &e) {
+    sample(out, "modbus_retries_total", unitLabels(e), load(e.retriesSent));
+  });
+
+  family(out, "modbus_retries_recovered", "counter", "",
+         "Reads that succeeded on a retry.");
+  rtt.forEach([&](const RttEstimator &e) {
+    sample(out, "modbus_retries_recovered_total", unitLabels(e),
+           load(e.recovered));
+  });
+
+  /* ---- Gateway queues ---- */
+  const GatewayQueues &queues = GatewayQueues::instance();
+  auto queueLabels = [](const GatewayQueue &q, size_t cls) {
+    return "gateway=\"" + escapeLabel(q.gateway) + "\",priority=\"" +
+           priorityName(ModbusPriority(cls)) + "\"";
+  };
+
+  family(out, "modbus_queue_waiting", "gauge", "",
+         "Transactions waiting for their turn on the gateway.");
+  queues.forEach([&](const GatewayQueue &q) {
+    for (size_t c = 0; c < MODBUS_PRIORITIES; c++)
+      sample(out, "modbus_queue_waiting", queueLabels(q, c),
+             double(load(q.waiting[c])));
+  });
+
+  family(out, "modbus_queue_granted", "counter", "",
+         "Transactions admitted to the gateway.");
+  queues.forEach([&](const GatewayQueue &q) {
+    for (size_t c = 0; c < MODBUS_PRIORITIES; c++)
+      sample(out, "modbus_queue_granted_total", queueLabels(q, c),
+             load(q.granted[c]));
+  });
+
+  family(out, "modbus_queue_wait_seconds", "counter", "seconds",
+         "Total time spent waiting for admission.");
+  queues.forEach([&](const GatewayQueue &q) {
+    for (size_t c = 0; c < MODBUS_PRIORITIES; c++)
+      sample(out, "modbus_queue_wait_seconds_total", queueLabels(q, c),
+             double(load(q.waitUs[c])) / 1e6);
+  });
+
+  family(out, "modbus_queue_max_wait_seconds", "gauge", "seconds",
+         "Longest admission wait seen.");
+  queues.forEach([&](const GatewayQueue &q) {
+    for (size_t c = 0; c < MODBUS_PRIORITIES; c++)
+      sample(out, "modbus_queue_max_wait_seconds", queueLabels(q, c),
+             double(load(q.maxWaitUs[c])) / 1e6);
+  });
+
+  family(out, "modbus_queue_aged", "counter", "",
+         "Grants that overtook a higher class through aging.");
+  queues.forEach([&](const GatewayQueue &q) {
+    sample(out, "modbus_queue_aged_total",
+           "gateway=\"" + escapeLabel(q.gateway) + "\"", load(q.aged));
+  });
+
+  /* ---- RS-485 buses ---- */
+  const RtuBuses &buses = RtuBuses::instance();
+
+  family(out, "modbus_rtu_transactions", "counter", "",
+         "Requests sent on the RS-485 line.");
+  buses.forEach([&](const RtuBus &b) {
+    sample(out, "modbus_rtu_transactions_total",
+           "bus=\"" + escapeLabel(b.name) + "\"", load(b.transactions));
+  });
+
+  family(out, "modbus_rtu_busy_seconds", "counter", "seconds",
+         "Time the line was owned by a request (utilization = rate).");
+  buses.forEach([&](const RtuBus &b) {
+    sample(out, "modbus_rtu_busy_seconds_total",
+           "bus=\"" + escapeLabel(b.name) + "\"",
+           double(load(b.busyUs)) / 1e6);
+  });
+
+  family(out, "modbus_rtu_silence_seconds", "counter", "seconds",
+         "Inter-frame silence (t3.5 + turnaround) waited before requests.");
+  buses.forEach([&](const RtuBus &b) {
+    sample(out, "modbus_rtu_silence_seconds_total",
+           "bus=\"" + escapeLabel(b.name) + "\"",
+           double(load(b.silenceUs)) / 1e6);
+  });
+
+  family(out, "modbus_rtu_queued_seconds", "counter", "seconds",
+         "Time requests waited for the line, silence included.");
+  buses.forEach([&](const RtuBus &b) {
+    sample(out, "modbus_rtu_queued_seconds_total",
+           "bus=\"" + escapeLabel(b.name) + "\"",
+           double(load(b.queuedUs)) / 1e6);
+  });
+
+  out += "# EOF\n";
+  return out;
+}
+
+/* ---------- HTTP server ---------- */
+
+namespace {
+
+std::string httpResponse(const std::string &status, const std::string &type,
+                         const std::string &body) {
+  return "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+         "\r\nContent-Length: " + std::to_string(body.size()) +
+         "\r\nConnection: close\r\n\r\n" + body;
+}
+
+} // namespace
+
+MetricsHttpServer::MetricsHttpServer(uint16_t port, const std::string &bindAddr)
+    : m_port(port), m_bindAddr(bindAddr) {}
+
+MetricsHttpServer::~MetricsHttpServer() { stop(); }
+
+bool MetricsHttpServer::start() {
+  m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (m_listenFd < 0)
+    return false;
+
+  int one = 1;
+  ::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(m_port);
+  if (::inet_pton(AF_INET, m_bindAddr.c_str(), &addr.sin_addr) != 1 ||
+      ::bind(m_listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+      ::listen(m_listenFd, 8) < 0) {
+    std::cerr << "Metrics: cannot listen on " << m_bindAddr << ":" << m_port
+              << std::endl;
+    ::close(m_listenFd);
+    m_listenFd = -1;
+    return false;
+  }
+
+  // Port 0 = pick any free port
+  socklen_t len = sizeof(addr);
+  if (::getsockname(m_listenFd, (sockaddr *)&addr, &len) == 0)
+    m_port = ntohs(addr.sin_port);
+
+  m_wakeFd = ::eventfd(0, EFD_NONBLOCK);
+  if (m_wakeFd < 0) {
+    ::close(m_listenFd);
+    m_listenFd = -1;
+    return false;
+  }
+
+  m_running = true;
+  m_thread = std::thread(&MetricsHttpServer::run, this);
+  m_seriesThread = std::thread(&MetricsHttpServer::runSeries, this);
+  return true;
+}
+
+void MetricsHttpServer::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_seriesMutex);
+    m_running = false;
+  }
+  m_seriesCv.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+  if (m_seriesThread.joinable())
+    m_seriesThread.join();
+  m_seriesJobs.clear();
+  m_seriesDone.clear();
+  if (m_listenFd >= 0) {
+    ::close(m_listenFd);
+    m_listenFd = -1;
+  }
+  if (m_wakeFd >= 0) {
+    ::close(m_wakeFd);
+    m_wakeFd = -1;
+  }
+}
+
+void MetricsHttpServer::run() {
+  std::vector<Conn> conns;
+  uint64_t nextId = 0;
+
+  while (m_running) {
+    // [0] listener, [1] series wakeup, then one per connection; a parked
+    // connection is only watched for hangups.
+    std::vector<pollfd> fds;
+    fds.push_back({m_listenFd, POLLIN, 0});
+    fds.push_back({m_wakeFd, POLLIN, 0});
+    for (const Conn &c : conns)
+      fds.push_back({c.fd,
+                     short(c.parked ? 0 : c.out.empty() ? POLLIN : POLLOUT),
+                     0});
+
+    if (::poll(fds.data(), fds.size(), 200) <= 0)
+      continue;
+
+    if (fds[0].revents & POLLIN) {
+      int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+      if (fd >= 0)
+        conns.push_back(Conn{fd, nextId++, {}, {}, 0, false});
+    }
+
+    for (size_t i = 2; i < fds.size(); i++) {
+      Conn &c = conns[i - 2];
+      bool keep = true;
+      if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+        keep = false;
+      else if (fds[i].revents & POLLIN)
+        keep = onReadable(c);
+      else if (fds[i].revents & POLLOUT)
+        keep = onWritable(c);
+
+      if (!keep) {
+        ::close(c.fd);
+        c.fd = -1;
+      }
+    }
+
+    if (fds[1].revents & POLLIN)
+      collectSeries(conns);
+
+    std::erase_if(conns, [](const Conn &c) { return c.fd < 0; });
+  }
+
+  for (Conn &c : conns)
+    ::close(c.fd);
+}
+
+// Hands answered /series requests back to their (still open) connections.
+void MetricsHttpServer::collectSeries(std::vector<Conn> &conns) {
+  uint64_t n;
+  while (::read(m_wakeFd, &n, sizeof(n)) > 0) {
+  }
+  std::vector<SeriesJob> done;
+  {
+    std::lock_guard<std::mutex> lock(m_seriesMutex);
+    done.swap(m_seriesDone);
+  }
+  for (SeriesJob &job : done) {
+    for (Conn &c : conns) {
+      if (c.fd < 0 || c.id != job.conn)
+        continue;
+      c.parked = false;
+      c.out = std::move(job.response);
+      c.sent = 0;
+      if (!onWritable(c)) {
+        ::close(c.fd);
+        c.fd = -1;
+      }
+      break;
+    }
+  }
+}
+
+void MetricsHttpServer::runSeries() {
+  std::unique_lock<std::mutex> lock(m_seriesMutex);
+  while (true) {
+    m_seriesCv.wait(lock, [&] { return !m_running || !m_seriesJobs.empty(); });
+    if (!m_running)
+      return;
+    SeriesJob job = std::move(m_seriesJobs.front());
+    m_seriesJobs.pop_front();
+    lock.unlock();
+
+    std::string status = "200 OK";
+    std::string body = renderSeriesJson(job.query, status);
+    job.response = httpResponse(status, "application/json", body);
+
+    lock.lock();
+    m_seriesDone.push_back(std::move(job));
+    // Cannot fail short of 2^64 - 1 pending wakeups
+    uint64_t one = 1;
+    ssize_t written = ::write(m_wakeFd, &one, sizeof(one));
+    (void)written;
+  }
+}
+
+bool MetricsHttpServer::onReadable(Conn &c) {
+  char tmp[2048];
+  ssize_t n = ::recv(c.fd, tmp, sizeof(tmp), 0);
+  if (n == 0)
+    return false;
+  if (n < 0)
+    return errno == EAGAIN || errno == EINTR;
+
+  c.in.append(tmp, size_t(n));
+  if (c.in.size() > 8192)
+    return false; // not a scrape
+
+  if (c.in.find("\r\n\r\n") != std::string::npos ||
+      c.in.find("\n\n") != std::string::npos) {
+    respond(c);
+    return c.parked || onWritable(c);
+  }
+  return true;
+}
+
+bool MetricsHttpServer::onWritable(Conn &c) {
+  while (c.sent < c.out.size()) {
+    ssize_t n = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent,
+                       MSG_NOSIGNAL);
+    if (n < 0)
+      return errno == EAGAIN || errno == EINTR;
+    c.sent += size_t(n);
+  }
+  return false; // response complete, close
+}
+
+void MetricsHttpServer::respond(Conn &c) {
+  std::string status = "200 OK";
+  std::string type =
+      "application/openmetrics-text; version=1.0.0; charset=utf-8";
+  std::string body;
+
+  bool isGet = c.in.rfind("GET ", 0) == 0;
+  std::string path = isGet ? c.in.substr(4, c.in.find(' ', 4) - 4) : "";
+
+  if (!isGet) {
+    status = "405 Method Not Allowed";
+    type = "text/plain";
+    body = "method not allowed\n";
+  } else if (path == "/metrics" || path.rfind("/metrics?", 0) == 0) {
+    body = renderOpenMetrics();
+    m_scrapes.fetch_add(1, std::memory_order_relaxed);
+  } else if (path == "/trace") {
+    std::ostringstream json;
+    Trace::writeChromeJson(json);
+    body = json.str();
+    type = "application/json";
+  } else if (path.rfind("/series?", 0) == 0) {
+    std::lock_guard<std::mutex> lock(m_seriesMutex);
+    if (m_seriesJobs.size() < SERIES_QUEUE_MAX) {
+      m_seriesJobs.push_back(SeriesJob{c.id, path.substr(8), {}});
+      m_seriesCv.notify_one();
+      c.parked = true;
+      return;
+    }
+    status = "503 Service Unavailable";
+    type = "application/json";
+    body = "{\"error\":\"too many series queries\"}";
+  } else {
+    status = "404 Not Found";
+    type = "text/plain";
+    body = "try /metrics, /trace or /series?channel=..\n";
+  }
+
+  c.out = httpResponse(status, type, body);
+  c.sent = 0;
+}
@@ -0,0 +1,151 @@
+#include "modbus_facade.h"
+#include "pipeline_metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// ================= FAÇADE =================
+
+ModbusFacade::ModbusFacade(uint16_t port, const std::string &bindAddr,
+                           uint32_t maxAgeMs)
+    : m_port(port), m_bindAddr(bindAddr), m_maxAgeMs(maxAgeMs) {
+  for (auto &u : m_units)
+    u.store(nullptr, std::memory_order_relaxed);
+}
+
+ModbusFacade::~ModbusFacade() { stop(); }
+
+void ModbusFacade::map(uint8_t virtualUnit, const RegisterSnapshot *snapshot) {
+  m_units[virtualUnit].store(snapshot, std::memory_order_release);
+}
+
+void ModbusFacade::mapLive(const std::string &rules) {
+  struct Rule {
+    int virtualUnit;
+    std::string gateway;
+    int unit;
+  };
+  std::vector<Rule> parsed;
+  size_t pos = 0;
+  while (pos < rules.size()) {
+    size_t comma = rules.find(',', pos);
+    std::string item = rules.substr(pos, comma - pos);
+    pos = comma == std::string::npos ? rules.size() : comma + 1;
+
+    size_t eq = item.find('=');
+    size_t slash = item.rfind('/');
+    if (eq == std::string::npos || slash == std::string::npos || slash < eq) {
+      std::cerr << "Facade: ignoring rule '" << item << "'" << std::endl;
+      continue;
+    }
+    parsed.push_back({std::atoi(item.c_str()),
+                      item.substr(eq + 1, slash - eq - 1),
+                      std::atoi(item.c_str() + slash + 1)});
+  }
+
+  LiveImages::instance().forEach([&](const LiveImage &img) {
+    if (std::find(m_mapped.begin(), m_mapped.end(), &img) != m_mapped.end())
+      return;
+
+    int virtualUnit = img.unit;
+    bool ruled = false;
+    bool reserved = false; // own ID given to another device by a rule
+    for (const Rule &r : parsed) {
+      if (r.gateway == img.gateway && r.unit == img.unit) {
+        virtualUnit = r.virtualUnit;
+        ruled = true;
+      } else if (r.virtualUnit == img.unit) {
+        reserved = true;
+      }
+    }
+    if (virtualUnit < 1 || virtualUnit > 247 || (!ruled && reserved) ||
+        m_units[virtualUnit].load(std::memory_order_relaxed)) {
+      std::cerr << "Facade: " << img.gateway << "/" << int(img.unit)
+                << " not served (virtual unit " << virtualUnit << " taken)"
+                << std::endl;
+    } else {
+      map(uint8_t(virtualUnit), &img.regs);
+      std::cout << "Facade: " << img.gateway << "/" << int(img.unit) << " ("
+                << img.model << ") -> unit " << virtualUnit << std::endl;
+    }
+    m_mapped.push_back(&img);
+  });
+}
+
+Modbus::StatusCode ModbusFacade::readHoldingRegisters(uint8_t unit,
+                                                      uint16_t offset,
+                                                      uint16_t count,
+                                                      uint16_t *values) {
+  m_busy = true;
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  const RegisterSnapshot *snap = m_units[unit].load(std::memory_order_acquire);
+  if (!snap) {
+    metrics.facadeUnmapped.fetch_add(1, std::memory_order_relaxed);
+    return Modbus::Status_BadGatewayTargetDeviceFailedToRespond;
+  }
+
+  int64_t ageMs;
+  if (!snap->copy(offset, count, values, ageMs)) {
+    metrics.facadeBadRange.fetch_add(1, std::memory_order_relaxed);
+    return Modbus::Status_BadIllegalDataAddress;
+  }
+  if (ageMs < 0 || ageMs > int64_t(m_maxAgeMs)) {
+    metrics.facadeStale.fetch_add(1, std::memory_order_relaxed);
+    return Modbus::Status_BadGatewayTargetDeviceFailedToRespond;
+  }
+  metrics.facadeServed.fetch_add(1, std::memory_order_relaxed);
+  return Modbus::Status_Good;
+}
+
+bool ModbusFacade::start() {
+  m_server = std::make_unique<ModbusTcpServer>(this);
+  m_server->setIpaddr(m_bindAddr.c_str());
+  m_server->setPort(m_port);
+  m_server->setMaxConnections(16);
+
+  Modbus::StatusCode status = m_server->open();
+  while (Modbus::StatusIsProcessing(status))
+    status = m_server->process();
+  if (Modbus::StatusIsBad(status)) {
+    std::cerr << "Facade: cannot listen on port " << m_port << std::endl;
+    m_server.reset();
+    return false;
+  }
+
+  m_server->connect(&ModbusServerPort::signalRx, this, &ModbusFacade::onRx);
+  m_server->connect(&ModbusTcpServer::signalNewConnection, this,
+                    &ModbusFacade::onConnection);
+
+  m_running = true;
+  m_thread = std::thread([this] {
+    uint32_t sleepUs = 0;
+    while (m_running) {
+      m_busy = false;
+      m_server->process();
+      if (m_busy) {
+        sleepUs = 0;
+        continue;
+      }
+      // Idle: 100 us, doubling up to IDLE_SLEEP_MAX_US
+      sleepUs = std::clamp<uint32_t>(sleepUs * 2, 100, IDLE_SLEEP_MAX_US);
+      std::this_thread::sleep_for(std::chrono::microseconds(sleepUs));
+    }
+    m_server->close();
+  });
+  return true;
+}
+
+void ModbusFacade::onRx(const Modbus::Char *, const uint8_t *, uint16_t) {
+  m_busy = true;
+}
+
+void ModbusFacade::onConnection(const Modbus::Char *) { m_busy = true; }
+
+void ModbusFacade::stop() {
+  m_running = false;
+  if (m_thread.joinable())
+    m_thread.join();
+  m_server.reset();
+}
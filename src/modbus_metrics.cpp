@@ -0,0 +1,210 @@
+#include "modbus_metrics.h"
+
+#include <ModbusClientPort.h>
+
+#include <bit>
+#include <fstream>
+
+// ================= HISTOGRAM =================
+
+int LatencyHistogram::bucketIndex(uint64_t us) {
+  if (us < SUB_BUCKETS)
+    return int(us);
+  int msb = 63 - std::countl_zero(us);
+  int shift = msb - SUB_BUCKET_BITS;
+  int idx = (shift + 1) * SUB_BUCKETS + int((us >> shift) & (SUB_BUCKETS - 1));
+  return idx < BUCKETS ? idx : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::bucketUpperUs(int idx) {
+  if (idx < SUB_BUCKETS)
+    return uint64_t(idx);
+  int shift = idx / SUB_BUCKETS - 1;
+  uint64_t sub = uint64_t(idx % SUB_BUCKETS);
+  return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t us) {
+  m_buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(us, std::memory_order_relaxed);
+
+  uint64_t prev = m_max.load(std::memory_order_relaxed);
+  while (us > prev &&
+         !m_max.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::percentileUs(double q) const {
+  uint64_t total = count();
+  if (total == 0)
+    return 0;
+
+  uint64_t rank = uint64_t(q * double(total) + 0.5);
+  if (rank == 0)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += bucketCount(i);
+    if (seen >= rank)
+      return std::min(bucketUpperUs(i), maxUs());
+  }
+  return maxUs();
+}
+
+// ================= REGISTRY =================
+
+ModbusMetrics &ModbusMetrics::instance() {
+  static ModbusMetrics metrics;
+  return metrics;
+}
+
+ModbusSeries *ModbusMetrics::series(const std::string &gateway, uint8_t unit,
+                                    uint8_t function) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+
+  for (ModbusSeries *s = m_head.load(std::memory_order_acquire); s;
+       s = s->next) {
+    if (s->unit == unit && s->function == function && s->gateway == gateway)
+      return s;
+  }
+
+  // Intentionally never freed: pointers are cached by drivers and exporters.
+  ModbusSeries *s = new ModbusSeries;
+  s->gateway = gateway;
+  s->unit = unit;
+  s->function = function;
+  s->next = m_head.load(std::memory_order_relaxed);
+  m_head.store(s, std::memory_order_release);
+  return s;
+}
+
+ModbusOutcome classifyStatus(Modbus::StatusCode status) {
+  if (Modbus::StatusIsGood(status))
+    return ModbusOutcome::Ok;
+  // A blocking port that times out reports the request as still processing.
+  if (Modbus::StatusIsProcessing(status) ||
+      status == Modbus::Status_BadSerialReadTimeout ||
+      status == Modbus::Status_BadSerialWriteTimeout)
+    return ModbusOutcome::Timeout;
+  if (status == Modbus::Status_BadGatewayPathUnavailable ||
+      status == Modbus::Status_BadGatewayTargetDeviceFailedToRespond)
+    return ModbusOutcome::GatewayError;
+  if (Modbus::StatusIsStandardError(status))
+    return ModbusOutcome::Exception;
+  if (status == Modbus::Status_BadCrc || status == Modbus::Status_BadLrc)
+    return ModbusOutcome::CrcError;
+  return ModbusOutcome::OtherError;
+}
+
+void ModbusMetrics::record(ModbusSeries *s, Modbus::StatusCode status,
+                           uint64_t latencyUs, uint16_t registers) {
+  if (!s)
+    return;
+
+  s->requests.fetch_add(1, std::memory_order_relaxed);
+  s->latency.record(latencyUs);
+
+  switch (classifyStatus(status)) {
+  case ModbusOutcome::Ok:
+    s->ok.fetch_add(1, std::memory_order_relaxed);
+    s->registers.fetch_add(registers, std::memory_order_relaxed);
+    break;
+  case ModbusOutcome::Timeout:
+    s->timeouts.fetch_add(1, std::memory_order_relaxed);
+    break;
+  case ModbusOutcome::GatewayError:
+    s->gatewayErrors.fetch_add(1, std::memory_order_relaxed);
+    break;
+  case ModbusOutcome::Exception:
+    s->exceptions.fetch_add(1, std::memory_order_relaxed);
+    break;
+  case ModbusOutcome::CrcError:
+    s->crcErrors.fetch_add(1, std::memory_order_relaxed);
+    break;
+  case ModbusOutcome::OtherError:
+    s->otherErrors.fetch_add(1, std::memory_order_relaxed);
+    break;
+  }
+}
+
+std::vector<ModbusSeriesSnapshot> ModbusMetrics::snapshot() const {
+  std::vector<ModbusSeriesSnapshot> out;
+  forEach([&](const ModbusSeries &s) {
+    ModbusSeriesSnapshot snap;
+    snap.gateway = s.gateway;
+    snap.unit = s.unit;
+    snap.function = s.function;
+    snap.requests = s.requests.load(std::memory_order_relaxed);
+    snap.ok = s.ok.load(std::memory_order_relaxed);
+    snap.timeouts = s.timeouts.load(std::memory_order_relaxed);
+    snap.exceptions = s.exceptions.load(std::memory_order_relaxed);
+    snap.gatewayErrors = s.gatewayErrors.load(std::memory_order_relaxed);
+    snap.crcErrors = s.crcErrors.load(std::memory_order_relaxed);
+    snap.otherErrors = s.otherErrors.load(std::memory_order_relaxed);
+    snap.registers = s.registers.load(std::memory_order_relaxed);
+    snap.bytesTx = s.bytesTx.load(std::memory_order_relaxed);
+    snap.bytesRx = s.bytesRx.load(std::memory_order_relaxed);
+    snap.p50Us = s.latency.percentileUs(0.50);
+    snap.p90Us = s.latency.percentileUs(0.90);
+    snap.p99Us = s.latency.percentileUs(0.99);
+    snap.maxUs = s.latency.maxUs();
+    snap.sumUs = s.latency.sumUs();
+    out.push_back(std::move(snap));
+  });
+  return out;
+}
+
+void ModbusMetrics::writeJson(std::ostream &out) const {
+  out << "{\"series\":[";
+  bool first = true;
+  for (const ModbusSeriesSnapshot &s : snapshot()) {
+    if (!first)
+      out << ",";
+    first = false;
+    out << "{\"gateway\":\"" << s.gateway << "\",\"unit\":" << int(s.unit)
+        << ",\"function\":" << int(s.function)
+        << ",\"requests\":" << s.requests << ",\"ok\":" << s.ok
+        << ",\"timeouts\":" << s.timeouts << ",\"exceptions\":" << s.exceptions
+        << ",\"gateway_errors\":" << s.gatewayErrors
+        << ",\"crc_errors\":" << s.crcErrors
+        << ",\"other_errors\":" << s.otherErrors
+        << ",\"registers\":" << s.registers << ",\"bytes_tx\":" << s.bytesTx
+        << ",\"bytes_rx\":" << s.bytesRx << ",\"latency_us\":{\"p50\":"
+        << s.p50Us << ",\"p90\":" << s.p90Us << ",\"p99\":" << s.p99Us
+        << ",\"max\":" << s.maxUs << ",\"sum\":" << s.sumUs << "}}";
+  }
+  out << "]}\n";
+}
+
+bool ModbusMetrics::writeJsonFile(const std::string &path) const {
+  // Write-then-rename so readers never see a half-written snapshot.
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::trunc);
+    if (!f)
+      return false;
+    writeJson(f);
+  }
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// ================= WIRE TAP =================
+
+void ModbusWireTap::attach(ModbusClientPort *port) {
+  port->connect(&ModbusClientPort::signalTx, this, &ModbusWireTap::onTx);
+  port->connect(&ModbusClientPort::signalRx, this, &ModbusWireTap::onRx);
+}
+
+void ModbusWireTap::detach(ModbusClientPort *port) { port->disconnect(this); }
+
+void ModbusWireTap::onTx(const Modbus::Char *, const uint8_t *, uint16_t size) {
+  if (ModbusSeries *s = m_current.load(std::memory_order_relaxed))
+    s->bytesTx.fetch_add(size, std::memory_order_relaxed);
+}
+
+void ModbusWireTap::onRx(const Modbus::Char *, const uint8_t *, uint16_t size) {
+  if (ModbusSeries *s = m_current.load(std::memory_order_relaxed))
+    s->bytesRx.fetch_add(size, std::memory_order_relaxed);
+}
@@ -0,0 +1,26 @@
+#include "pipeline_metrics.h"
+
+PipelineMetrics &PipelineMetrics::instance() {
+  static PipelineMetrics metrics;
+  return metrics;
+}
+
+DeviceHealth *PipelineMetrics::device(const std::string &gateway, uint8_t unit,
+                                      const std::string &model) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+
+  for (DeviceHealth *d = m_devices.load(std::memory_order_acquire); d;
+       d = d->next) {
+    if (d->unit == unit && d->gateway == gateway)
+      return d;
+  }
+
+  // Intentionally never freed, same as ModbusSeries.
+  DeviceHealth *d = new DeviceHealth;
+  d->gateway = gateway;
+  d->unit = unit;
+  d->model = model;
+  d->next = m_devices.load(std::memory_order_relaxed);
+  m_devices.store(d, std::memory_order_release);
+  return d;
+}
@@ -0,0 +1,84 @@
+#include "rtt_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+// ================= ESTIMATOR =================
+
+void RttEstimator::sample(uint64_t rttUs) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  double r = double(rttUs);
+  if (!m_hasSample) {
+    m_srttUs = r;
+    m_rttvarUs = r / 2;
+    m_hasSample = true;
+  } else {
+    m_rttvarUs = 0.75 * m_rttvarUs + 0.25 * std::fabs(m_srttUs - r);
+    m_srttUs = 0.875 * m_srttUs + 0.125 * r;
+  }
+  m_backoff = 0;
+  samples.fetch_add(1, std::memory_order_relaxed);
+  srttUs.store(uint64_t(m_srttUs), std::memory_order_relaxed);
+  rttvarUs.store(uint64_t(m_rttvarUs), std::memory_order_relaxed);
+  update();
+}
+
+void RttEstimator::onTimeout() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_backoff = std::min(m_backoff + 1, 6);
+  timeouts.fetch_add(1, std::memory_order_relaxed);
+  update();
+}
+
+void RttEstimator::update() {
+  double ms = m_hasSample
+                  ? (m_srttUs + std::max(double(m_policy.granularityMs) * 1e3,
+                                         4 * m_rttvarUs)) /
+                        1e3
+                  : double(m_initialMs);
+  ms = std::clamp(ms, double(m_policy.minTimeoutMs),
+                  double(m_policy.maxTimeoutMs));
+  ms = std::min(ms * double(1 << m_backoff), double(m_policy.maxTimeoutMs));
+  m_timeoutMs.store(uint32_t(std::ceil(ms)), std::memory_order_relaxed);
+}
+
+uint32_t RttEstimator::retries() const {
+  uint32_t rto = std::max<uint32_t>(timeoutMs(), 1);
+  uint32_t attempts = m_initialMs / rto;
+  return attempts > 1 ? std::min(attempts - 1, m_policy.maxRetries) : 0;
+}
+
+// ================= REGISTRY =================
+
+RttEstimators &RttEstimators::instance() {
+  static RttEstimators estimators;
+  return estimators;
+}
+
+void RttEstimators::setPolicy(const RttPolicy &policy) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+  m_policy = policy;
+}
+
+RttEstimator *RttEstimators::estimator(const std::string &gateway,
+                                       uint8_t unit,
+                                       uint32_t initialTimeoutMs) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+
+  for (RttEstimator *e = m_head.load(std::memory_order_acquire); e;
+       e = e->next) {
+    if (e->unit == unit && e->gateway == gateway)
+      return e;
+  }
+
+  // Intentionally never freed, same as ModbusSeries.
+  RttEstimator *e = new RttEstimator;
+  e->gateway = gateway;
+  e->unit = unit;
+  e->m_policy = m_policy;
+  e->m_initialMs = initialTimeoutMs;
+  e->update();
+  e->next = m_head.load(std::memory_order_relaxed);
+  m_head.store(e, std::memory_order_release);
+  return e;
+}
@@ -0,0 +1,162 @@
+#include "rtu_bus.h"
+#include "modbus_metrics.h"
+
+#include <ModbusPort.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+// ================= LINE =================
+
+bool RtuLine::isSerial(const std::string &endpoint) {
+  return endpoint.rfind("/dev/", 0) == 0 || endpoint.rfind("COM", 0) == 0;
+}
+
+RtuLine RtuLine::parse(const std::string &endpoint) {
+  RtuLine line;
+  size_t at = endpoint.find('@');
+  line.device = endpoint.substr(0, at);
+  if (at == std::string::npos)
+    return line;
+
+  // "<baud>[,<data><parity><stop>][,t<turnaround us>]"
+  std::string rest = endpoint.substr(at + 1);
+  size_t field = 0;
+  while (!rest.empty()) {
+    size_t comma = rest.find(',');
+    std::string item = rest.substr(0, comma);
+    rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
+
+    if (!item.empty() && item[0] == 't') {
+      line.turnaroundUs = uint32_t(std::atol(item.c_str() + 1));
+    } else if (field == 0) {
+      line.baudRate = std::atoi(item.c_str());
+      field++;
+    } else if (item.size() >= 3) {
+      line.dataBits = int8_t(item[0] - '0');
+      switch (item[1]) {
+      case 'N': line.parity = Modbus::NoParity; break;
+      case 'O': line.parity = Modbus::OddParity; break;
+      default: line.parity = Modbus::EvenParity; break;
+      }
+      line.stopBits = item[2] == '2' ? Modbus::TwoStop : Modbus::OneStop;
+    }
+  }
+  return line;
+}
+
+uint32_t RtuLine::charUs() const {
+  uint32_t bits = 1 + uint32_t(dataBits) +
+                  (parity == Modbus::NoParity ? 0 : 1) +
+                  (stopBits == Modbus::TwoStop ? 2 : 1);
+  return uint32_t((uint64_t(bits) * 1000000 + baudRate - 1) /
+                  std::max<int32_t>(baudRate, 1));
+}
+
+uint32_t RtuLine::silentIntervalUs() const {
+  return baudRate > 19200 ? 1750 : (charUs() * 7 + 1) / 2;
+}
+
+uint32_t RtuLine::interByteTimeoutMs() const {
+  return std::max<uint32_t>(1, (silentIntervalUs() + 999) / 1000);
+}
+
+// ================= TRANSACTION =================
+
+RtuBus::Transaction::Transaction(RtuBus &bus) : m_bus(bus) {
+  auto queued = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point idleFrom;
+  {
+    std::unique_lock<std::mutex> lock(bus.m_mutex);
+    uint64_t ticket = bus.m_nextTicket++;
+    bus.m_turn.wait(lock, [&] { return bus.m_serving == ticket; });
+    idleFrom = bus.m_idleFrom;
+  }
+
+  // Owed silence: sleep most of it, spin the sub-millisecond tail
+  auto now = std::chrono::steady_clock::now();
+  if (now < idleFrom) {
+    auto coarse = idleFrom - std::chrono::microseconds(200);
+    if (now < coarse)
+      std::this_thread::sleep_until(coarse);
+    while (std::chrono::steady_clock::now() < idleFrom) {
+    }
+    bus.silenceUs.fetch_add(
+        uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                     idleFrom - now)
+                     .count()),
+        std::memory_order_relaxed);
+  }
+
+  m_start = std::chrono::steady_clock::now();
+  bus.queuedUs.fetch_add(
+      uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                   m_start - queued)
+                   .count()),
+      std::memory_order_relaxed);
+}
+
+RtuBus::Transaction::~Transaction() {
+  auto end = std::chrono::steady_clock::now();
+  const RtuLine &line = m_bus.line;
+
+  int64_t owedUs = int64_t(line.silentIntervalUs()) + line.turnaroundUs;
+  if (classifyStatus(m_status) != ModbusOutcome::Timeout)
+    owedUs -= int64_t(line.interByteTimeoutMs()) * 1000; // already waited
+  m_bus.transactions.fetch_add(1, std::memory_order_relaxed);
+  m_bus.busyUs.fetch_add(
+      uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                   end - m_start)
+                   .count()),
+      std::memory_order_relaxed);
+
+  {
+    std::lock_guard<std::mutex> lock(m_bus.m_mutex);
+    m_bus.m_idleFrom =
+        end + std::chrono::microseconds(std::max<int64_t>(owedUs, 0));
+    m_bus.m_serving++;
+  }
+  m_bus.m_turn.notify_all();
+}
+
+// ================= REGISTRY =================
+
+RtuBuses &RtuBuses::instance() {
+  static RtuBuses buses;
+  return buses;
+}
+
+RtuBus *RtuBuses::bus(const RtuLine &line, uint32_t timeoutMs) {
+  std::lock_guard<std::mutex> lock(m_createMutex);
+
+  for (RtuBus *b = m_head.load(std::memory_order_acquire); b; b = b->next) {
+    if (b->name == line.device)
+      return b;
+  }
+
+  Modbus::SerialSettings settings;
+  settings.portName = line.device.c_str();
+  settings.baudRate = line.baudRate;
+  settings.dataBits = line.dataBits;
+  settings.parity = line.parity;
+  settings.stopBits = line.stopBits;
+  settings.flowControl = Modbus::NoFlowControl;
+  settings.timeoutFirstByte = timeoutMs;
+  settings.timeoutInterByte = line.interByteTimeoutMs();
+
+  ModbusClientPort *port =
+      Modbus::createClientPort(Modbus::RTU, &settings, true);
+  if (!port)
+    return nullptr;
+  port->port()->open();
+
+  // Intentionally never freed, same as ModbusSeries.
+  RtuBus *b = new RtuBus;
+  b->name = line.device;
+  b->line = line;
+  b->m_port.reset(port);
+  b->next = m_head.load(std::memory_order_relaxed);
+  m_head.store(b, std::memory_order_release);
+  return b;
+}
@@ -0,0 +1,317 @@
+#include "series_query.h"
+#include "pipeline_metrics.h"
+#include "storage.h"
+#include "storage_units.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <vector>
+
+namespace {
+
+constexpr size_t SERIES_DEFAULT_POINTS = 300;
+constexpr size_t SERIES_MAX_POINTS = 10000;
+constexpr int64_t SERIES_DEFAULT_RANGE_MS = 24LL * 3600 * 1000;
+
+std::map<std::string, std::string> parseQuery(const std::string &query) {
+  std::map<std::string, std::string> params;
+  size_t pos = 0;
+  while (pos < query.size()) {
+    size_t amp = query.find('&', pos);
+    std::string pair = query.substr(pos, amp == std::string::npos
+                                             ? std::string::npos
+                                             : amp - pos);
+    size_t eq = pair.find('=');
+    if (eq != std::string::npos)
+      params[pair.substr(0, eq)] = pair.substr(eq + 1);
+    if (amp == std::string::npos)
+      break;
+    pos = amp + 1;
+  }
+  return params;
+}
+
+void appendNumber(std::string &out, double v) {
+  char buf[32];
+  if (std::isnan(v))
+    out += "null";
+  else
+    out.append(buf, size_t(std::snprintf(buf, sizeof(buf), "%.10g", v)));
+}
+
+} // namespace
+
+// ================= QUERY =================
+
+int64_t SeriesQuery::unitKey(const std::string &gateway_ip, int unit_id) {
+  return Find_UnitKey(m_db, gateway_ip, unit_id);
+}
+
+const AggTier *SeriesQuery::sourceFor(int64_t fromMs, int64_t nowMs) {
+  auto covers = [&](int days) {
+    return fromMs >= nowMs - int64_t(days) * 86400 * 1000;
+  };
+  if (covers(CHANNEL_RETENTION_DAYS))
+    return nullptr;
+  for (const AggTier &t : AGG_TIERS)
+    if (covers(t.retentionDays))
+      return &t;
+  return &AGG_TIERS[std::size(AGG_TIERS) - 1];
+}
+
+bool SeriesQuery::buckets(
+    uint16_t channel, int64_t unitKey, int64_t fromMs, int64_t toMs,
+    size_t buckets, const std::function<bool(const SeriesAggregate &)> &out) {
+  TRACE_SCOPE("query", "series_buckets", channel);
+  if (!buckets || toMs <= fromMs)
+    return true;
+  int64_t width = std::max<int64_t>(
+      1, (toMs - fromMs + int64_t(buckets) - 1) / int64_t(buckets));
+
+  // Finest source still covering fromMs, or a coarser tier that still fits
+  // in a bucket: fewer rows, same buckets.
+  const AggTier *tier = sourceFor(fromMs, PipelineMetrics::wallMs());
+  for (const AggTier &t : AGG_TIERS)
+    if (t.widthMs <= width && (!tier || t.widthMs > tier->widthMs))
+      tier = &t;
+  if (tier) {
+    fromMs -= fromMs % tier->widthMs;
+    width = (width + tier->widthMs - 1) / tier->widthMs * tier->widthMs;
+    while ((toMs - fromMs + width - 1) / width > int64_t(buckets))
+      width += tier->widthMs;
+  }
+
+  SeriesAggregate agg;
+  bool stopped = false;
+  auto fold = [&](const SeriesAggregate &in) {
+    int64_t start = fromMs + (in.ts - fromMs) / width * width;
+    if (agg.count && start != agg.ts) {
+      if (!out(agg))
+        return !(stopped = true);
+      agg = {};
+    }
+    agg.ts = start;
+    agg.merge(in);
+    return true;
+  };
+  bool ok = tier ? m_samples.scanTier(*tier, channel, unitKey, fromMs, toMs,
+                                      fold)
+                 : m_samples.scan(channel, unitKey, fromMs, toMs,
+                                  [&](int64_t ts, double v) {
+                                    SeriesAggregate one{ts};
+                                    one.add(v);
+                                    return fold(one);
+                                  });
+  if (ok && !stopped && agg.count)
+    out(agg);
+  return ok;
+}
+
+bool SeriesQuery::lttb(uint16_t channel, int64_t unitKey, int64_t fromMs,
+                       int64_t toMs, size_t points,
+                       const std::function<bool(const SeriesPoint &)> &out,
+                       const AggTier **source) {
+  TRACE_SCOPE("query", "series_lttb", channel);
+  const AggTier *tier = sourceFor(fromMs, PipelineMetrics::wallMs());
+  if (source)
+    *source = tier;
+  if (!points || toMs <= fromMs)
+    return true;
+  auto scan = [&](const std::function<bool(const SeriesPoint &)> &fn) {
+    if (tier)
+      return m_samples.scanTier(*tier, channel, unitKey, fromMs, toMs,
+                                [&](const SeriesAggregate &a) {
+                                  return fn({a.ts, a.avg(), a.min, a.max});
+                                });
+    return m_samples.scan(channel, unitKey, fromMs, toMs,
+                          [&](int64_t ts, double v) {
+                            return fn({ts, v, v, v});
+                          });
+  };
+  if (points < 3) {
+    SeriesPoint ends[2];
+    size_t n = 0;
+    bool ok = scan([&](const SeriesPoint &p) {
+      ends[n ? 1 : 0] = p;
+      n++;
+      return points > 1;
+    });
+    if (ok && n && out(ends[0]) && n > 1)
+      out(ends[1]);
+    return ok;
+  }
+  // First and last point are always kept; the rest of the range is split
+  // into equal-width buckets that contribute one point each.
+  const int64_t inner = int64_t(points) - 2;
+  const int64_t span = toMs - fromMs;
+  auto bucketOf = [&](int64_t ts) {
+    return std::min(inner - 1, (ts - fromMs) * inner / span);
+  };
+
+  SeriesPoint a{}; // last sample emitted
+  bool started = false, stopped = false;
+  auto emit = [&](const SeriesPoint &p) {
+    a = p;
+    stopped = !out(p);
+    return !stopped;
+  };
+  auto mean = [](const std::vector<SeriesPoint> &bucket) {
+    double ts = 0, v = 0;
+    for (const SeriesPoint &p : bucket) {
+      ts += double(p.ts);
+      v += p.value;
+    }
+    v /= double(bucket.size());
+    return SeriesPoint{int64_t(ts / double(bucket.size())), v, v, v};
+  };
+  // Emits the sample of `bucket` spanning the largest triangle with the
+  // previous pick and `c` (the next bucket's mean).
+  auto pick = [&](const std::vector<SeriesPoint> &bucket, SeriesPoint c) {
+    size_t best = 0;
+    double bestArea = -1;
+    for (size_t i = 0; i < bucket.size(); i++) {
+      const SeriesPoint &p = bucket[i];
+      double area = std::fabs(double(a.ts - c.ts) * (p.value - a.value) -
+                              double(a.ts - p.ts) * (c.value - a.value));
+      if (area > bestArea) {
+        bestArea = area;
+        best = i;
+      }
+    }
+    return emit(bucket[best]);
+  };
+
+  // Only the current bucket and the one after it are held.
+  std::vector<SeriesPoint> cur, next;
+  int64_t curBucket = 0, nextBucket = 0;
+  bool ok = scan([&](const SeriesPoint &s) {
+    if (!started) {
+      started = true;
+      return emit(s);
+    }
+    int64_t b = bucketOf(s.ts);
+    if (cur.empty() || (next.empty() && b == curBucket)) {
+      curBucket = b;
+      cur.push_back(s);
+    } else if (next.empty() || b == nextBucket) {
+      nextBucket = b;
+      next.push_back(s);
+    } else {
+      if (!pick(cur, mean(next)))
+        return false;
+      cur.swap(next);
+      curBucket = nextBucket;
+      next.assign(1, s);
+      nextBucket = b;
+    }
+    return true;
+  });
+  if (!ok || stopped || cur.empty())
+    return ok;
+
+  // The last point of the range closes the series.
+  std::vector<SeriesPoint> &tail = next.empty() ? cur : next;
+  SeriesPoint last = tail.back();
+  tail.pop_back();
+  if (!cur.empty() && !pick(cur, next.empty() ? last : mean(next)))
+    return true;
+  if (!next.empty() && !pick(next, last))
+    return true;
+  emit(last);
+  return true;
+}
+
+// ================= HTTP =================
+
+std::string renderSeriesJson(const std::string &query, std::string &status) {
+  std::map<std::string, std::string> p = parseQuery(query);
+  const char *model = nullptr;
+  const RegisterDesc *desc =
+      p.count("channel") ? find_channel(uint16_t(std::atoi(p["channel"].c_str())),
+                                        &model)
+                         : nullptr;
+  if (!desc) {
+    status = "400 Bad Request";
+    return "{\"error\":\"unknown channel\"}";
+  }
+
+  int64_t to = p.count("to") ? std::atoll(p["to"].c_str())
+                             : PipelineMetrics::wallMs();
+  int64_t from = p.count("from") ? std::atoll(p["from"].c_str())
+                                 : to - SERIES_DEFAULT_RANGE_MS;
+  size_t points = p.count("points") ? size_t(std::atol(p["points"].c_str()))
+                                    : SERIES_DEFAULT_POINTS;
+  points = std::min(std::max<size_t>(points, 1), SERIES_MAX_POINTS);
+  bool buckets = p["method"] == "buckets";
+
+  Database &file = std::string(model) == "iPM2xxx" ? Storage::instance().pm()
+                                                   : Storage::instance().a9();
+  sqlite3 *db = file.reader();
+  if (!db) {
+    status = "503 Service Unavailable";
+    return "{\"error\":\"database not available\"}";
+  }
+  SeriesQuery q(db);
+  int64_t key = q.unitKey(p["gateway"], std::atoi(p["unit"].c_str()));
+  if (key < 0) {
+    status = "404 Not Found";
+    return "{\"error\":\"no samples for this meter (CHANNEL_STORE=1?)\"}";
+  }
+
+  std::string body = "{\"channel\":" + std::to_string(desc->channel) +
+                     ",\"name\":\"" + desc->name + "\",\"unit\":\"" +
+                     desc->unit + "\",\"method\":\"" +
+                     (buckets ? "buckets" : "lttb") + "\",";
+  bool first = true;
+  bool ok;
+  const AggTier *tier = nullptr; // source of the points
+  if (buckets) {
+    // [start, count, min, max, avg, first, last]
+    body += "\"buckets\":[";
+    ok = q.buckets(desc->channel, key, from, to, points,
+                   [&](const SeriesAggregate &a) {
+                     body += first ? "[" : ",[";
+                     first = false;
+                     body += std::to_string(a.ts) + "," +
+                             std::to_string(a.count);
+                     for (double v : {a.min, a.max, a.avg(), a.first, a.last}) {
+                       body += ",";
+                       appendNumber(body, v);
+                     }
+                     body += "]";
+                     return true;
+                   });
+  } else {
+    // [ts, value] from the samples, [ts, avg, min, max] from a tier
+    body += "\"points\":[";
+    ok = q.lttb(desc->channel, key, from, to, points,
+                [&](const SeriesPoint &s) {
+                  body += first ? "[" : ",[";
+                  first = false;
+                  body += std::to_string(s.ts) + ",";
+                  appendNumber(body, s.value);
+                  if (tier) {
+                    body += ",";
+                    appendNumber(body, s.min);
+                    body += ",";
+                    appendNumber(body, s.max);
+                  }
+                  body += "]";
+                  return true;
+                },
+                &tier);
+  }
+  if (!ok) {
+    status = "500 Internal Server Error";
+    return "{\"error\":\"query failed\"}";
+  }
+  body += "]";
+  if (!buckets)
+    body += ",\"source\":\"" + std::string(tier ? tier->name : "raw") + "\"";
+  return body + "}";
+}
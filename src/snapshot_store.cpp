@@ -0,0 +1,315 @@
+#include "snapshot_store.h"
+#include "pipeline_metrics.h"
+#include "storage.h"
+#include "storage_units.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+std::atomic<bool> SnapshotStore::s_enabled{false};
+
+namespace {
+
+void putU16(std::vector<uint8_t> &out, uint16_t v) {
+  out.push_back(uint8_t(v));
+  out.push_back(uint8_t(v >> 8));
+}
+
+uint16_t getU16(const uint8_t *p) { return uint16_t(p[0] | (p[1] << 8)); }
+
+template <size_t N>
+std::string describe(const RegisterDesc (&list)[N]) {
+  std::string out;
+  for (const RegisterDesc &d : list) {
+    out += std::to_string(d.channel) + ":" + d.name + "@" +
+           std::to_string(d.address) +
+           (d.type == RegType::UInt64 ? ":u64" : ":f32") + "\n";
+  }
+  return out;
+}
+
+} // namespace
+
+// ================= RAW IMAGE =================
+
+std::vector<uint8_t>
+RawImage::pack(std::initializer_list<const BlockSnapshot *> blocks) {
+  std::vector<uint8_t> out;
+  size_t words = 0;
+  for (const BlockSnapshot *b : blocks)
+    words += b->regs.size();
+  out.reserve(2 + blocks.size() * 4 + words * 2);
+
+  out.push_back(RAW_FORMAT_VERSION);
+  out.push_back(uint8_t(blocks.size()));
+  for (const BlockSnapshot *b : blocks) {
+    uint16_t count = b->ok() ? uint16_t(b->regs.size()) : 0;
+    putU16(out, b->start);
+    putU16(out, count);
+    for (uint16_t i = 0; i < count; i++)
+      putU16(out, b->regs[i]);
+  }
+  return out;
+}
+
+bool RawImage::parse(const void *blob, int bytes) {
+  m_blocks.clear();
+  const uint8_t *p = static_cast<const uint8_t *>(blob);
+  if (!p || bytes < 2 || p[0] != RAW_FORMAT_VERSION)
+    return false;
+  const uint8_t *end = p + bytes;
+  size_t n = p[1];
+  p += 2;
+  for (size_t i = 0; i < n; i++) {
+    if (end - p < 4)
+      return false;
+    Block b{getU16(p), getU16(p + 2), p + 4};
+    p += 4 + size_t(b.count) * 2;
+    if (p > end)
+      return false;
+    if (b.count)
+      m_blocks.push_back(b);
+  }
+  return true;
+}
+
+bool RawImage::words(uint16_t address, uint16_t count, uint16_t *out) const {
+  for (const Block &b : m_blocks) {
+    if (address < b.start || uint32_t(address - b.start) + count > b.count)
+      continue;
+    const uint8_t *p = b.data + size_t(address - b.start) * 2;
+    for (uint16_t i = 0; i < count; i++)
+      out[i] = getU16(p + i * 2);
+    return true;
+  }
+  return false;
+}
+
+double RawImage::value(const RegisterDesc &desc) const {
+  uint16_t r[4];
+  if (desc.type == RegType::UInt64)
+    return words(desc.address, 4, r)
+               ? double(RegisterCodec<uint64_t>::decode(r))
+               : NAN;
+  return words(desc.address, 2, r) ? RegisterCodec<float>::decode(r) : NAN;
+}
+
+// ================= STORE =================
+
+SnapshotStore::SnapshotStore(sqlite3 *db) : m_db(db) {}
+
+SnapshotStore::~SnapshotStore() {
+  sqlite3_finalize(m_insert);
+  sqlite3_finalize(m_scan);
+}
+
+std::unique_ptr<SnapshotStore> SnapshotStore::create(sqlite3 *db) {
+  if (!enabled() || !db)
+    return nullptr;
+  auto store = std::make_unique<SnapshotStore>(db);
+  int64_t now = PipelineMetrics::wallMs();
+  MaintenanceSchedule &schedule = MaintenanceSchedule::instance();
+  if (!schedule.due(db, "raw_snapshots", now, RAW_MAINTENANCE_MS))
+    return store;
+  if (!store->setup())
+    return nullptr;
+  store->prune(now - int64_t(RAW_RETENTION_DAYS) * 86400 * 1000);
+  schedule.done(db, "raw_snapshots", now);
+  return store;
+}
+
+bool SnapshotStore::exec(const char *sql) {
+  char *errMsg = 0;
+  if (sqlite3_exec(m_db, sql, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (snapshot store): " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+    PipelineMetrics::instance().sqliteErrors.fetch_add(
+        1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool SnapshotStore::setup() {
+  TRACE_SCOPE("store", "snapshot_setup");
+  if (!exec("CREATE TABLE IF NOT EXISTS raw_snapshots ("
+            "unit_key INTEGER NOT NULL, "
+            "ts INTEGER NOT NULL, " // epoch ms of the first block
+            "map_version INTEGER, "
+            "blocks BLOB, "
+            "PRIMARY KEY (unit_key, ts)"
+            ") WITHOUT ROWID;"
+            "CREATE TABLE IF NOT EXISTS register_maps ("
+            "model TEXT, version INTEGER, descriptors TEXT, "
+            "first_seen INTEGER, "
+            "PRIMARY KEY (model, version)"
+            ");") ||
+      !SetupUnitsTable(m_db))
+    return false;
+
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(m_db,
+                         "INSERT OR IGNORE INTO register_maps "
+                         "(model, version, descriptors, first_seen) "
+                         "VALUES (?, ?, ?, strftime('%s', 'now'));",
+                         -1, &stmt, 0) != SQLITE_OK)
+    return false;
+  auto record = [&](const char *model, uint32_t version,
+                    const std::string &text) {
+    sqlite3_bind_text(stmt, 1, model, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, version);
+    sqlite3_bind_text(stmt, 3, text.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+    return ok;
+  };
+  bool ok = record("iPM2xxx", PM_MAP_VERSION, describe(PM_CHANNELS)) &&
+            record("iA9MEM15", A9_MAP_VERSION, describe(A9_CHANNELS));
+  sqlite3_finalize(stmt);
+  return ok;
+}
+
+int64_t SnapshotStore::unitKey(const std::string &gateway_ip, int unit_id,
+                               const std::string &model) {
+  auto cached = m_units.find({gateway_ip, unit_id});
+  if (cached != m_units.end())
+    return cached->second;
+  int64_t key = Lookup_UnitKey(m_db, gateway_ip, unit_id, model);
+  if (key >= 0)
+    m_units[{gateway_ip, unit_id}] = key;
+  return key;
+}
+
+bool SnapshotStore::append(int64_t unitKey, int64_t tsMs, uint32_t mapVersion,
+                           std::initializer_list<const BlockSnapshot *> blocks) {
+  TRACE_SCOPE("store", "raw_snapshot", unitKey);
+  PipelineMetrics &metrics = PipelineMetrics::instance();
+  ScopedLatency commit(metrics.sqliteCommit);
+
+  if (!m_insert &&
+      sqlite3_prepare_v2(m_db,
+                         "INSERT OR REPLACE INTO raw_snapshots "
+                         "(unit_key, ts, map_version, blocks) "
+                         "VALUES (?, ?, ?, ?);",
+                         -1, &m_insert, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (raw_snapshots): " << sqlite3_errmsg(m_db)
+              << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  std::vector<uint8_t> blob = RawImage::pack(blocks);
+  sqlite3_bind_int64(m_insert, 1, unitKey);
+  sqlite3_bind_int64(m_insert, 2, tsMs);
+  sqlite3_bind_int64(m_insert, 3, mapVersion);
+  sqlite3_bind_blob(m_insert, 4, blob.data(), int(blob.size()), SQLITE_STATIC);
+  bool ok = sqlite3_step(m_insert) == SQLITE_DONE;
+  sqlite3_reset(m_insert);
+  if (!ok) {
+    std::cerr << "SQL error (raw_snapshots): " << sqlite3_errmsg(m_db)
+              << std::endl;
+    metrics.sqliteErrors.fetch_add(1, std::memory_order_relaxed);
+  }
+  return ok;
+}
+
+bool SnapshotStore::scan(
+    int64_t unitKey, int64_t fromMs, int64_t toMs,
+    const std::function<bool(int64_t, uint32_t, const RawImage &)> &fn) {
+  if (!m_scan &&
+      sqlite3_prepare_v2(m_db,
+                         "SELECT ts, map_version, blocks FROM raw_snapshots "
+                         "WHERE unit_key = ? AND ts >= ? AND ts < ? "
+                         "ORDER BY ts;",
+                         -1, &m_scan, 0) != SQLITE_OK) {
+    std::cerr << "SQL error (raw_snapshots scan): " << sqlite3_errmsg(m_db)
+              << std::endl;
+    return false;
+  }
+  sqlite3_bind_int64(m_scan, 1, unitKey);
+  sqlite3_bind_int64(m_scan, 2, fromMs);
+  sqlite3_bind_int64(m_scan, 3, toMs);
+  RawImage image;
+  int rc;
+  while ((rc = sqlite3_step(m_scan)) == SQLITE_ROW) {
+    if (!image.parse(sqlite3_column_blob(m_scan, 2),
+                     sqlite3_column_bytes(m_scan, 2)))
+      continue; // unknown format: written by a newer build
+    if (!fn(sqlite3_column_int64(m_scan, 0),
+            uint32_t(sqlite3_column_int64(m_scan, 1)), image))
+      break;
+  }
+  sqlite3_reset(m_scan);
+  return rc == SQLITE_ROW || rc == SQLITE_DONE;
+}
+
+bool SnapshotStore::scanChannel(const RegisterDesc &desc, int64_t unitKey,
+                                int64_t fromMs, int64_t toMs,
+                                const std::function<bool(int64_t, double)> &fn) {
+  return scan(unitKey, fromMs, toMs,
+              [&](int64_t ts, uint32_t, const RawImage &image) {
+                double v = image.value(desc);
+                return std::isnan(v) || fn(ts, v);
+              });
+}
+
+int64_t SnapshotStore::rederive(ChannelStore &channels,
+                                std::span<const RegisterDesc> list,
+                                int64_t unitKey, int64_t fromMs,
+                                int64_t toMs) {
+  TRACE_SCOPE("store", "rederive", unitKey);
+  // Samples are kept for CHANNEL_RETENTION_DAYS, the images for longer:
+  // never rewrite before the samples still there, or the tiers of the
+  // pruned part would be rebuilt from a fraction of it.
+  int64_t floor = -1;
+  for (const RegisterDesc &d : list)
+    floor = std::max(floor, channels.oldestSample(d.channel, unitKey));
+  if (floor < 0)
+    return 0;
+  fromMs = std::max(fromMs, floor);
+  if (fromMs >= toMs)
+    return 0;
+
+  int64_t rows = 0, first = 0, last = 0;
+  bool ok = true;
+  std::vector<ChannelSample> samples;
+  if (!exec("BEGIN;"))
+    return -1;
+  bool scanned = scan(unitKey, fromMs, toMs,
+                      [&](int64_t ts, uint32_t, const RawImage &image) {
+                        samples.clear();
+                        for (const RegisterDesc &d : list) {
+                          double v = image.value(d);
+                          if (!std::isnan(v))
+                            samples.push_back({d.channel, v});
+                        }
+                        ok = channels.rewrite(unitKey, ts, samples);
+                        if (!rows++)
+                          first = ts;
+                        last = ts;
+                        return ok;
+                      });
+  // The tiers still aggregate the old values of the rewritten intervals.
+  if (rows)
+    ok = ok && channels.rebuildTiers(unitKey, list, first, last + 1);
+  if (!scanned || !ok) {
+    exec("ROLLBACK;");
+    return -1;
+  }
+  return exec("COMMIT;") ? rows : -1;
+}
+
+int64_t SnapshotStore::prune(int64_t beforeMs) {
+  TRACE_SCOPE("store", "raw_prune");
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(m_db,
+                         "DELETE FROM raw_snapshots WHERE unit_key IN "
+                         "(SELECT unit_key FROM units) AND ts < ?;",
+                         -1, &stmt, 0) != SQLITE_OK)
+    return -1;
+  sqlite3_bind_int64(stmt, 1, beforeMs);
+  int64_t removed = sqlite3_step(stmt) == SQLITE_DONE ? sqlite3_changes(m_db) : -1;
+  sqlite3_finalize(stmt);
+  return removed;
+}
@@ -0,0 +1,100 @@
+#include "storage.h"
+#include "pipeline_metrics.h"
+
+#include <iostream>
+
+namespace {
+
+constexpr int BUSY_TIMEOUT_MS = 5000;
+
+void configure(sqlite3 *db, const char *sql, const std::string &path) {
+  char *errMsg = 0;
+  if (sqlite3_exec(db, sql, 0, 0, &errMsg) != SQLITE_OK) {
+    std::cerr << "SQL error (" << path << " pragmas): " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+    PipelineMetrics::instance().sqliteErrors.fetch_add(
+        1, std::memory_order_relaxed);
+  }
+}
+
+sqlite3 *open(const std::string &path, int flags) {
+  sqlite3 *db = nullptr;
+  if (sqlite3_open_v2(path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+    std::cerr << "SQLite open error (" << path
+              << "): " << (db ? sqlite3_errmsg(db) : "out of memory")
+              << std::endl;
+    sqlite3_close(db);
+    return nullptr;
+  }
+  sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+  return db;
+}
+
+} // namespace
+
+// ================= DATABASE =================
+
+sqlite3 *Database::writer() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_writer) {
+    m_writer = open(m_path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    // WAL lets the reader connection run alongside the writer; NORMAL sync
+    // is durable across crashes of this process in WAL mode.
+    if (m_writer)
+      configure(m_writer,
+                "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;",
+                m_path);
+  }
+  return m_writer;
+}
+
+sqlite3 *Database::reader() {
+  if (!writer()) // creates the file and switches it to WAL
+    return nullptr;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_reader) {
+    m_reader = open(m_path, SQLITE_OPEN_READONLY);
+    if (m_reader)
+      configure(m_reader, "PRAGMA query_only=1;", m_path);
+  }
+  return m_reader;
+}
+
+void Database::close() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  sqlite3_close_v2(m_reader);
+  sqlite3_close_v2(m_writer);
+  m_reader = nullptr;
+  m_writer = nullptr;
+}
+
+// ================= STORAGE =================
+
+Storage &Storage::instance() {
+  static Storage storage;
+  return storage;
+}
+
+void Storage::close() {
+  m_a9.close();
+  m_pm.close();
+}
+
+// ================= MAINTENANCE SCHEDULE =================
+
+MaintenanceSchedule &MaintenanceSchedule::instance() {
+  static MaintenanceSchedule schedule;
+  return schedule;
+}
+
+bool MaintenanceSchedule::due(sqlite3 *db, const char *job, int64_t nowMs,
+                              int64_t intervalMs) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto last = m_last.find({sqlite3_db_filename(db, "main"), job});
+  return last == m_last.end() || nowMs - last->second >= intervalMs;
+}
+
+void MaintenanceSchedule::done(sqlite3 *db, const char *job, int64_t nowMs) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_last[{sqlite3_db_filename(db, "main"), job}] = nowMs;
+}
@@ -0,0 +1,224 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+std::atomic<bool> Trace::s_enabled{true};
+
+namespace {
+
+const std::chrono::steady_clock::time_point g_epoch =
+    std::chrono::steady_clock::now();
+
+std::mutex g_registerMutex;
+std::atomic<TraceRing *> g_rings{nullptr};
+
+std::atomic<bool> g_dumpRequested{false};
+
+void onDumpSignal(int) { g_dumpRequested.store(true); }
+
+void writeEscaped(std::ostream &out, const char *s) {
+  for (; s && *s; s++) {
+    if (*s == '"' || *s == '\\')
+      out << '\\';
+    out << *s;
+  }
+}
+
+} // namespace
+
+uint64_t Trace::nowNs() {
+  // +1 so a valid timestamp is never 0 (0 marks a disabled span)
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - g_epoch)
+                      .count()) +
+         1;
+}
+
+void TraceRing::writeOwner(int ownerTid, uint64_t from,
+                           const std::string &name) {
+  uint32_t seq = ownerSeq.load(std::memory_order_relaxed);
+  ownerSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  tid.store(ownerTid, std::memory_order_relaxed);
+  begin.store(from, std::memory_order_relaxed);
+  size_t n = std::min(name.size(), NAME_SIZE - 1);
+  for (size_t i = 0; i < n; i++)
+    threadName[i].store(name[i], std::memory_order_relaxed);
+  threadName[n].store('\0', std::memory_order_relaxed);
+  ownerSeq.store(seq + 2, std::memory_order_release);
+}
+
+void TraceRing::setOwner(int ownerTid, const std::string &name) {
+  writeOwner(ownerTid, head.load(std::memory_order_relaxed), name);
+}
+
+void TraceRing::setName(const std::string &name) {
+  writeOwner(tid.load(std::memory_order_relaxed),
+             begin.load(std::memory_order_relaxed), name);
+}
+
+bool TraceRing::readOwner(Owner &out) const {
+  uint32_t seq = ownerSeq.load(std::memory_order_acquire);
+  if (seq & 1)
+    return false;
+  out.tid = tid.load(std::memory_order_relaxed);
+  out.begin = begin.load(std::memory_order_relaxed);
+  // Read inside the lock: a new owner only records once it is written.
+  out.head = head.load(std::memory_order_acquire);
+  for (size_t i = 0; i < NAME_SIZE; i++)
+    out.name[i] = threadName[i].load(std::memory_order_relaxed);
+  out.name[NAME_SIZE - 1] = '\0';
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return ownerSeq.load(std::memory_order_relaxed) == seq;
+}
+
+namespace {
+
+// The calling thread's ring, released for reuse when the thread exits.
+struct RingLease {
+  TraceRing *ring = nullptr;
+  ~RingLease() {
+    if (ring)
+      ring->free.store(true, std::memory_order_release);
+    ring = nullptr;
+  }
+};
+
+} // namespace
+
+TraceRing *Trace::ring(const std::string *name) {
+  thread_local RingLease local;
+  if (local.ring) {
+    if (name)
+      local.ring->setName(*name);
+    return local.ring;
+  }
+
+  int tid = int(::syscall(SYS_gettid));
+  std::string label = name ? *name : "thread " + std::to_string(tid);
+
+  std::lock_guard<std::mutex> lock(g_registerMutex);
+  TraceRing *r = g_rings.load(std::memory_order_relaxed);
+  while (r && !r->free.load(std::memory_order_acquire))
+    r = r->next;
+  if (r) {
+    r->free.store(false, std::memory_order_relaxed);
+    r->setOwner(tid, label);
+  } else {
+    r = new TraceRing;
+    r->setOwner(tid, label);
+    r->next = g_rings.load(std::memory_order_relaxed);
+    g_rings.store(r, std::memory_order_release);
+  }
+  local.ring = r;
+  return r;
+}
+
+void Trace::record(const char *cat, const char *name, uint64_t startNs,
+                   uint64_t durNs, int64_t arg) {
+  TraceRing *r = ring();
+  uint64_t idx = r->head.load(std::memory_order_relaxed);
+  TraceSlot &s = r->slots[idx % TraceRing::CAPACITY];
+
+  s.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.name.store(name, std::memory_order_relaxed);
+  s.cat.store(cat, std::memory_order_relaxed);
+  s.startNs.store(startNs, std::memory_order_relaxed);
+  s.durNs.store(durNs, std::memory_order_relaxed);
+  s.arg.store(arg, std::memory_order_relaxed);
+  s.seq.store(idx + 1, std::memory_order_release);
+
+  r->head.store(idx + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const std::string &name) { ring(&name); }
+
+void Trace::writeChromeJson(std::ostream &out) {
+  int pid = int(::getpid());
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  auto comma = [&] {
+    if (!first)
+      out << ",\n";
+    first = false;
+  };
+
+  for (TraceRing *r = g_rings.load(std::memory_order_acquire); r;
+       r = r->next) {
+    TraceRing::Owner owner;
+    while (!r->readOwner(owner))
+      std::this_thread::yield(); // being renamed or reused, a few stores
+    comma();
+    out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+        << ",\"tid\":" << owner.tid << ",\"args\":{\"name\":\"";
+    writeEscaped(out, owner.name);
+    out << "\"}}";
+
+    uint64_t head = owner.head;
+    uint64_t begin = std::max(
+        owner.begin, head > TraceRing::CAPACITY ? head - TraceRing::CAPACITY : 0);
+
+    for (uint64_t i = begin; i < head; i++) {
+      const TraceSlot &s = r->slots[i % TraceRing::CAPACITY];
+      if (s.seq.load(std::memory_order_acquire) != i + 1)
+        continue; // being overwritten
+      const char *name = s.name.load(std::memory_order_relaxed);
+      const char *cat = s.cat.load(std::memory_order_relaxed);
+      uint64_t start = s.startNs.load(std::memory_order_relaxed);
+      uint64_t dur = s.durNs.load(std::memory_order_relaxed);
+      int64_t arg = s.arg.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (s.seq.load(std::memory_order_relaxed) != i + 1)
+        continue; // torn copy
+
+      char ts[64];
+      std::snprintf(ts, sizeof(ts), "\"ts\":%.3f,\"dur\":%.3f",
+                    double(start) / 1e3, double(dur) / 1e3);
+
+      comma();
+      out << "{\"ph\":\"X\",\"name\":\"";
+      writeEscaped(out, name);
+      out << "\",\"cat\":\"";
+      writeEscaped(out, cat);
+      out << "\"," << ts << ",\"pid\":" << pid << ",\"tid\":" << owner.tid
+          << ",\"args\":{\"arg\":" << arg << "}}";
+    }
+  }
+  out << "]}\n";
+}
+
+bool Trace::writeChromeJsonFile(const std::string &path) {
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::trunc);
+    if (!f)
+      return false;
+    writeChromeJson(f);
+  }
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+void Trace::dumpOnSignal(const std::string &path) {
+  std::signal(SIGUSR1, onDumpSignal);
+
+  std::thread([path] {
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      if (!g_dumpRequested.exchange(false))
+        continue;
+      if (writeChromeJsonFile(path))
+        std::fprintf(stderr, "Trace written to %s\n", path.c_str());
+      else
+        std::fprintf(stderr, "Cannot write trace %s\n", path.c_str());
+    }
+  }).detach();
+}
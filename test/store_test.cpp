@@ -0,0 +1,295 @@
+// Unit checks of the channel store, the generated table statements and the
+// series downsampling (ctest: store_test). Each section runs on its own in-memory database; a
+// failed CHECK prints its line and the run exits non-zero.
+
+#include "channel_store.h"
+#include "pipeline_metrics.h"
+#include "readings_pm2xxx.h"
+#include "series_query.h"
+#include "sqlite_schema.h"
+
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond    \
+                << std::endl;                                                  \
+      g_failures++;                                                            \
+    }                                                                          \
+  } while (0)
+
+sqlite3 *openMemory() {
+  sqlite3 *db = nullptr;
+  sqlite3_open(":memory:", &db);
+  return db;
+}
+
+// The `tier` interval of (channel, unit) starting at `ts`; count 0 if none.
+SeriesAggregate tierRow(ChannelStore &store, const AggTier &tier,
+                        uint16_t channel, int64_t unitKey, int64_t ts) {
+  SeriesAggregate row;
+  store.scanTier(tier, channel, unitKey, ts, ts + 1,
+                 [&](const SeriesAggregate &a) {
+                   row = a;
+                   return false;
+                 });
+  return row;
+}
+
+/* ---------- Tier folding ---------- */
+
+void testTierFolding() {
+  sqlite3 *db = openMemory();
+  {
+    ChannelStore store(db);
+    CHECK(store.setup());
+    int64_t unit = store.unitKey("10.0.0.1", 1, "iPM2xxx");
+    const RegisterDesc &desc = PM_CHANNELS[0];
+    const uint16_t ch = desc.channel;
+    const AggTier &m1 = AGG_TIERS[0], &h1 = AGG_TIERS[2];
+
+    // An hour boundary inside the samples' retention.
+    int64_t now = PipelineMetrics::wallMs();
+    int64_t base = now - now % h1.widthMs - h1.widthMs;
+
+    CHECK(store.oldestSample(ch, unit) == -1);
+    CHECK(store.append(unit, base, {{ch, 1}}));
+    CHECK(store.append(unit, base + 30000, {{ch, 3}}));
+    CHECK(store.append(unit, base + 60000, {{ch, 10}}));
+    CHECK(store.oldestSample(ch, unit) == base);
+
+    SeriesAggregate a = tierRow(store, m1, ch, unit, base);
+    CHECK(a.count == 2 && a.min == 1 && a.max == 3 && a.sum == 4);
+    CHECK(a.first == 1 && a.last == 3);
+    SeriesAggregate b = tierRow(store, m1, ch, unit, base + 60000);
+    CHECK(b.count == 1 && b.sum == 10);
+    SeriesAggregate h = tierRow(store, h1, ch, unit, base);
+    CHECK(h.count == 3 && h.sum == 14 && h.first == 1 && h.last == 10);
+
+    // A sample already stored is ignored, in the tiers too.
+    CHECK(store.append(unit, base + 30000, {{ch, 100}}));
+    CHECK(tierRow(store, m1, ch, unit, base).count == 2);
+    CHECK(tierRow(store, h1, ch, unit, base).sum == 14);
+
+    // rebuildTiers: every interval touching the range is recomputed whole,
+    // the next one is left alone.
+    CHECK(store.rewrite(unit, base + 30000, {{ch, 5}}));
+    CHECK(store.rebuildTiers(unit, std::span(&desc, 1), base + 30000,
+                             base + 30001));
+    a = tierRow(store, m1, ch, unit, base);
+    CHECK(a.count == 2 && a.sum == 6 && a.max == 5 && a.last == 5);
+    CHECK(tierRow(store, m1, ch, unit, base + 60000).sum == 10);
+    h = tierRow(store, h1, ch, unit, base);
+    CHECK(h.count == 3 && h.sum == 16);
+
+    // An interval older than both the oldest sample and the retention
+    // horizon may have lost samples to prune(): it keeps its values.
+    int64_t old = base - 3 * 86400000LL;
+    std::string sql = "INSERT INTO samples_agg VALUES (" +
+                      std::to_string(h1.id) + ", " + std::to_string(ch) +
+                      ", " + std::to_string(unit) + ", " +
+                      std::to_string(old) + ", 7, 1, 1, 7, 1, 1);";
+    CHECK(sqlite3_exec(db, sql.c_str(), 0, 0, 0) == SQLITE_OK);
+    CHECK(store.rebuildTiers(unit, std::span(&desc, 1), old, base + 60000));
+    CHECK(tierRow(store, h1, ch, unit, old).count == 7);
+    CHECK(tierRow(store, h1, ch, unit, base).sum == 16);
+  }
+  sqlite3_close(db);
+}
+
+/* ---------- Generated statements ---------- */
+
+constexpr ColumnDesc TEST_COLUMNS[] = {
+    {"id", ColType::Integer, "PRIMARY KEY", false},
+    {"name", ColType::Text},
+    {"value", ColType::Real},
+    {"is_read", ColType::Integer, "DEFAULT 0", false},
+    {"count", ColType::Integer},
+};
+
+constexpr auto TEST_CREATE_SQL = make_sql<[](SqlWriter &w) {
+  write_create_table(w, "t", TEST_COLUMNS);
+}>();
+
+constexpr auto TEST_INSERT_SQL = make_sql<[](SqlWriter &w) {
+  write_insert(w, "t", TEST_COLUMNS);
+}>();
+
+// Positions skip the columns the INSERT leaves out.
+static_assert(inserted_count(TEST_COLUMNS) == 3);
+static_assert(column_index(TEST_COLUMNS, "name") == 0);
+static_assert(column_index(TEST_COLUMNS, "count") == 2);
+
+void testGeneratedStatements() {
+  CHECK(std::string_view(TEST_CREATE_SQL.c_str()) ==
+        "CREATE TABLE IF NOT EXISTS t (id INTEGER PRIMARY KEY, name TEXT, "
+        "value REAL, is_read INTEGER DEFAULT 0, count INTEGER);");
+  CHECK(std::string_view(TEST_INSERT_SQL.c_str()) ==
+        "INSERT INTO t (name, value, count) VALUES (?, ?, ?);");
+  // The text is exactly as long as measured, NUL-terminated.
+  CHECK(std::strlen(TEST_INSERT_SQL.c_str()) == sizeof(TEST_INSERT_SQL) - 1);
+
+  sqlite3 *db = openMemory();
+  CHECK(sqlite3_exec(db, TEST_CREATE_SQL.c_str(), 0, 0, 0) == SQLITE_OK);
+  sqlite3_stmt *insert = nullptr;
+  CHECK(sqlite3_prepare_v2(db, TEST_INSERT_SQL.c_str(), -1, &insert, 0) ==
+        SQLITE_OK);
+  CHECK(sqlite3_bind_parameter_count(insert) == 3);
+
+  SqlRow<TEST_COLUMNS> row;
+  row.set<column_index(TEST_COLUMNS, "name")>("meter");
+  row.set<column_index(TEST_COLUMNS, "value")>(1.5f);
+  row.set<column_index(TEST_COLUMNS, "count")>(7);
+  CHECK(row.get<1>() == 1.5 && row.get<2>() == 7);
+  CHECK(row.bind(insert) && sqlite3_step(insert) == SQLITE_DONE);
+  row.setReal(1, 2.5);
+  row.setInteger(2, 8);
+  CHECK(row.bind(insert) && sqlite3_step(insert) == SQLITE_DONE);
+  sqlite3_finalize(insert);
+
+  sqlite3_stmt *select = nullptr;
+  CHECK(sqlite3_prepare_v2(db,
+                           "SELECT id, name, value, is_read, count FROM t "
+                           "ORDER BY id;",
+                           -1, &select, 0) == SQLITE_OK);
+  CHECK(sqlite3_step(select) == SQLITE_ROW);
+  CHECK(std::string(reinterpret_cast<const char *>(
+            sqlite3_column_text(select, 1))) == "meter");
+  CHECK(sqlite3_column_double(select, 2) == 1.5);
+  CHECK(sqlite3_column_int(select, 3) == 0); // left to its default
+  CHECK(sqlite3_column_int(select, 4) == 7);
+  CHECK(sqlite3_step(select) == SQLITE_ROW);
+  CHECK(sqlite3_column_double(select, 2) == 2.5);
+  CHECK(sqlite3_column_int(select, 4) == 8);
+  sqlite3_finalize(select);
+
+  // readings_pm2xxx: one placeholder per inserted column, and the publish
+  // SELECT returns each column at pm_select(name).
+  CHECK(sqlite3_exec(db, PM_CREATE_SQL.c_str(), 0, 0, 0) == SQLITE_OK);
+  CHECK(sqlite3_prepare_v2(db, PM_INSERT_SQL.c_str(), -1, &insert, 0) ==
+        SQLITE_OK);
+  CHECK(sqlite3_bind_parameter_count(insert) == int(PMRow::size));
+  PMRow pm;
+  pm.set<pm_col("acquired_ms")>(int64_t(1234));
+  CHECK(pm.bind(insert) && sqlite3_step(insert) == SQLITE_DONE);
+  sqlite3_finalize(insert);
+  CHECK(sqlite3_prepare_v2(db, PM_SELECT_UNREAD_SQL.c_str(), -1, &select,
+                           0) == SQLITE_OK);
+  sqlite3_bind_int(select, 1, 10);
+  CHECK(sqlite3_column_count(select) == PM_SELECT_FIRST + int(PMRow::size));
+  CHECK(sqlite3_step(select) == SQLITE_ROW);
+  CHECK(sqlite3_column_int64(select, pm_select("acquired_ms")) == 1234);
+  CHECK(sqlite3_column_int64(select, 1) == 1234);
+  sqlite3_finalize(select);
+  sqlite3_close(db);
+}
+
+/* ---------- Downsampling ---------- */
+
+void testDownsampling() {
+  const int64_t day = 86400000;
+  int64_t now = PipelineMetrics::wallMs();
+  CHECK(SeriesQuery::sourceFor(now - day, now) == nullptr);
+  CHECK(SeriesQuery::sourceFor(now - 3 * day, now) == &AGG_TIERS[0]);
+  CHECK(SeriesQuery::sourceFor(now - 30 * day, now) == &AGG_TIERS[1]);
+  CHECK(SeriesQuery::sourceFor(now - 4000 * day, now) == &AGG_TIERS[2]);
+
+  sqlite3 *db = openMemory();
+  {
+    ChannelStore store(db);
+    CHECK(store.setup());
+    int64_t unit = store.unitKey("10.0.0.1", 1, "iPM2xxx");
+    const uint16_t ch = PM_CHANNELS[0].channel;
+    SeriesQuery q(db);
+
+    // 100 samples 1 s apart, flat but for one peak.
+    const AggTier &q15 = AGG_TIERS[1];
+    int64_t t0 = now - now % q15.widthMs - 2 * q15.widthMs + 7000;
+    for (int i = 0; i < 100; i++)
+      CHECK(store.append(unit, t0 + i * 1000, {{ch, i == 37 ? 50.0 : 1.0}}));
+    int64_t end = t0 + 100 * 1000;
+
+    auto lttb = [&](size_t points) {
+      std::vector<SeriesPoint> out;
+      CHECK(q.lttb(ch, unit, t0, end, points, [&](const SeriesPoint &p) {
+        out.push_back(p);
+        return true;
+      }));
+      return out;
+    };
+    auto hasPeak = [](const std::vector<SeriesPoint> &pts) {
+      for (const SeriesPoint &p : pts)
+        if (p.value == 50 && p.min == 50 && p.max == 50)
+          return true;
+      return false;
+    };
+
+    CHECK(lttb(0).empty());
+    std::vector<SeriesPoint> one = lttb(1);
+    CHECK(one.size() == 1 && one[0].ts == t0);
+    std::vector<SeriesPoint> two = lttb(2);
+    CHECK(two.size() == 2 && two[0].ts == t0 && two[1].ts == end - 1000);
+    // One middle bucket: the peak spans the largest triangle.
+    std::vector<SeriesPoint> three = lttb(3);
+    CHECK(three.size() == 3 && three[1].ts == t0 + 37000);
+    for (size_t points : {size_t(10), size_t(50)}) {
+      std::vector<SeriesPoint> pts = lttb(points);
+      CHECK(pts.size() == points);
+      CHECK(pts.front().ts == t0 && pts.back().ts == end - 1000);
+      CHECK(hasPeak(pts));
+      for (size_t i = 1; i < pts.size(); i++)
+        CHECK(pts[i].ts > pts[i - 1].ts);
+    }
+    // More points than samples: every sample once.
+    CHECK(lttb(500).size() == 100);
+
+    // Raw buckets: [from + k * width, from + (k + 1) * width); a sample on
+    // an edge opens the next bucket, `to` itself is outside.
+    std::vector<SeriesAggregate> raw;
+    CHECK(q.buckets(ch, unit, t0, t0 + 10000, 2,
+                    [&](const SeriesAggregate &a) {
+                      raw.push_back(a);
+                      return true;
+                    }));
+    CHECK(raw.size() == 2);
+    CHECK(raw[0].ts == t0 && raw[0].count == 5);
+    CHECK(raw[1].ts == t0 + 5000 && raw[1].count == 5);
+
+    // Buckets wider than a tier interval merge that tier: 15 min fits in a
+    // 30 min bucket, 1 h does not. The first bucket starts on the interval
+    // boundary at or before `from`.
+    std::vector<SeriesAggregate> tiered;
+    int64_t from = t0 + 3000;
+    CHECK(q.buckets(ch, unit, from, from + 2 * 1800000, 2,
+                    [&](const SeriesAggregate &a) {
+                      tiered.push_back(a);
+                      return true;
+                    }));
+    CHECK(tiered.size() == 1);
+    CHECK(!tiered.empty() && tiered[0].ts == t0 - t0 % q15.widthMs);
+    CHECK(!tiered.empty() && tiered[0].count == 100 && tiered[0].max == 50);
+  }
+  sqlite3_close(db);
+}
+
+} // namespace
+
+int main() {
+  testTierFolding();
+  testGeneratedStatements();
+  testDownsampling();
+  if (g_failures)
+    std::cerr << g_failures << " check(s) failed" << std::endl;
+  return g_failures ? 1 : 0;
+}